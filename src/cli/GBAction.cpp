@@ -9,6 +9,7 @@
 #include "mathicgb/F4Reducer.hpp"
 #include "mathicgb/Scanner.hpp"
 #include "mathicgb/MathicIO.hpp"
+#include "mathicgb/MemoryBudget.hpp"
 #include <fstream>
 #include <iostream>
 
@@ -39,6 +40,21 @@ GBAction::GBAction():
    "A value of 0 indicates not to store any matrices.",
    0),
 
+  mMemoryBudget("memoryBudget",
+    "The number of megabytes that the F4 matrices, monomial maps, dense "
+    "rows and basis polynomials may take together. When an F4 matrix would "
+    "go over the budget, its S-pairs are reduced as several smaller "
+    "matrices instead. A value of 0 indicates no budget.",
+    0),
+
+  mMatrixTimeTarget("matrixTimeTarget",
+    "If using a matrix-based reducer and sPairGroupSize is 0, choose the "
+    "number of S-pairs in each matrix so that building and reducing the "
+    "matrix takes about this many milliseconds. The number is learned from "
+    "the previous matrices. A value of 0 indicates to put all S-pairs of "
+    "the same degree in one matrix.",
+    0),
+
    mParams(1, 1)
 {}
 
@@ -63,7 +79,7 @@ void GBAction::performAction() {
   Scanner in(inputFile);
   auto p = MathicIO<>().readRing(true, in);
   auto& ring = *p.first;
-  auto basis = MathicIO<>().readBasis(ring, false, in);
+  auto basis = MathicIO<>().readBasisParallel(ring, false, in);
 
   // run algorithm
   const auto reducerType = Reducer::reducerType(mGBParams.mReducer.value());
@@ -79,21 +95,25 @@ void GBAction::performAction() {
     auto f4Reducer = make_unique<F4Reducer>(ring, type);
     if (mMinMatrixToStore.value() > 0)
       f4Reducer->writeMatricesTo(projectName, mMinMatrixToStore);
+    f4Reducer->setMatrixTimeTarget(mMatrixTimeTarget.value() / 1000.0);
     reducer = std::move(f4Reducer);
   }
 
   ClassicGBAlg alg(
-    basis,
+    std::move(basis),
     *reducer,
     mGBParams.mDivisorLookup.value(),
     mGBParams.mPreferSparseReducers.value(),
-    mGBParams.mSPairQueue.value());
+    mGBParams.mSPairQueue.value(),
+    mGBParams.mSugar.value());
   alg.setBreakAfter(mGBParams.mBreakAfter.value());
   alg.setPrintInterval(mGBParams.mPrintInterval.value());
   alg.setSPairGroupSize(mSPairGroupSize.value());
   alg.setReducerMemoryQuantum(mGBParams.mMemoryQuantum.value());
   alg.setUseAutoTopReduction(mAutoTopReduce.value());
   alg.setUseAutoTailReduction(mAutoTailReduce.value());
+  MemoryBudget::singleton().setBudget
+    (static_cast<size_t>(mMemoryBudget.value()) * 1024 * 1024);
 
   alg.computeGrobnerBasis();
   alg.printStats(std::cerr);
@@ -139,6 +159,8 @@ void GBAction::pushBackParameters(
   parameters.push_back(&mAutoTopReduce);
   parameters.push_back(&mSPairGroupSize);
   parameters.push_back(&mMinMatrixToStore);
+  parameters.push_back(&mMemoryBudget);
+  parameters.push_back(&mMatrixTimeTarget);
 }
 
 MATHICGB_NAMESPACE_END
@@ -37,6 +37,8 @@ private:
   //mic::IntegerParameter mTermOrder;
   mathic::IntegerParameter mSPairGroupSize;
   mathic::IntegerParameter mMinMatrixToStore;
+  mathic::IntegerParameter mMemoryBudget;
+  mathic::IntegerParameter mMatrixTimeTarget;
 };
 
 MATHICGB_NAMESPACE_END
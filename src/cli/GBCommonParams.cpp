@@ -56,7 +56,13 @@ GBCommonParams::GBCommonParams():
 
   mMemoryQuantum("memoryQuantumForReducer",
     "Specifies how many items to allocate memory for at a time for the reducer.",
-    1024 * 1024)
+    1024 * 1024),
+
+  mSugar("sugar",
+    "If true, choose the S-pairs of minimal sugar first instead of the "
+    "S-pairs of minimal lcm. This helps for non-homogeneous input. Only "
+    "relevant to the classic Buchberger algorithm.",
+    false)
 {
   {
     std::ostringstream reducerOut;
@@ -87,6 +93,7 @@ void GBCommonParams::pushBackParameters(
   parameters.push_back(&mDivisorLookup);
   parameters.push_back(&mReducer);
   parameters.push_back(&mMemoryQuantum);
+  parameters.push_back(&mSugar);
 }
 
 void GBCommonParams::perform() {
@@ -23,6 +23,7 @@ public:
   mathic::IntegerParameter mDivisorLookup;
   mathic::IntegerParameter mReducer;
   mathic::IntegerParameter mMemoryQuantum;
+  mathic::BoolParameter mSugar;
 };
 
 MATHICGB_NAMESPACE_END
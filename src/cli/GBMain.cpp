@@ -29,6 +29,7 @@ int main(int argc, char **argv) {
     commandLine.erase(commandLine.begin());
 
     parser.parse(commandLine)->performAction();
+    mgb::LogDomainSet::singleton().writeTraceFiles();
   } catch (const mathic::MathicException& e) {
     mathic::display(e.what());
     return -1;
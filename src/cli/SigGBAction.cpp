@@ -55,7 +55,7 @@ void SigGBAction::performAction() {
   auto p = MathicIO<>().readRing(true, in);
   auto& ring = *p.first;
   auto& processor = p.second;
-  auto basis = MathicIO<>().readBasis(ring, false, in);
+  auto basis = MathicIO<>().readBasisParallel(ring, false, in);
   if (processor.schreyering())
     processor.setSchreyerMultipliers(basis);
 
@@ -6,9 +6,18 @@
 #include "mathicgb/Poly.hpp"
 #include "mathicgb/Reducer.hpp"
 #include "mathicgb/ClassicGBAlg.hpp"
+#include "mathicgb/SignatureGB.hpp"
+#include "mathicgb/SigPolyBasis.hpp"
+#include "mathicgb/MTArray.hpp"
+#include "mathicgb/F4Reducer.hpp"
+#include "mathicgb/PolyBasis.hpp"
+#include "mathicgb/DivisorLookup.hpp"
 #include "mathicgb/mtbb.hpp"
 #include "mathicgb/LogDomainSet.hpp"
+#include "mathicgb/MultiModularGB.hpp"
+#include "mathicgb/Fglm.hpp"
 #include <mathic.h>
+#include <thread>
 
 #ifndef MATHICGB_ASSERT
 #ifdef MATHICGB_DEBUG
@@ -342,7 +351,10 @@ struct GroebnerConfiguration::Pimpl {
     mComponentsAscending(true),
     mSchreyering(true),
     mReducer(DefaultReducer),
+    mAlgorithm(DefaultAlgorithm),
     mMaxSPairGroupSize(0),
+    mUseSugar(false),
+    mUseFglm(false),
     mMaxThreadCount(0),
     mLogging(),
     mCallbackData(0),
@@ -373,11 +385,19 @@ struct GroebnerConfiguration::Pimpl {
       reducer == MatrixReducer;
   }
 
+  static bool algorithmValid(const Algorithm algorithm) {
+    return
+      algorithm == DefaultAlgorithm ||
+      algorithm == BuchbergerAlgorithm ||
+      algorithm == SignatureAlgorithm;
+  }
+
   bool debugAssertValid() const {
 #ifdef MATHICGB_DEBUG
     MATHICGB_ASSERT(this != 0);
     MATHICGB_ASSERT(baseOrderValid(mBaseOrder));
     MATHICGB_ASSERT(reducerValid(mReducer));
+    MATHICGB_ASSERT(algorithmValid(mAlgorithm));
     MATHICGB_ASSERT(mModulus != 0);
     MATHICGB_ASSERT(mCallback != 0 || mCallbackData == 0);
     MATHICGB_ASSERT_NO_ASSUME(!mHasBeenDestroyed);
@@ -393,7 +413,10 @@ struct GroebnerConfiguration::Pimpl {
   bool mComponentsAscending;
   bool mSchreyering;
   Reducer mReducer;
+  Algorithm mAlgorithm;
   unsigned int mMaxSPairGroupSize;
+  bool mUseSugar;
+  bool mUseFglm;
   unsigned int mMaxThreadCount;
   std::string mLogging;
   void* mCallbackData;
@@ -551,6 +574,15 @@ auto GroebnerConfiguration::reducer() const -> Reducer {
   return mPimpl->mReducer;
 }
 
+void GroebnerConfiguration::setAlgorithm(Algorithm algorithm) {
+  MATHICGB_ASSERT(Pimpl::algorithmValid(algorithm));
+  mPimpl->mAlgorithm = algorithm;
+}
+
+auto GroebnerConfiguration::algorithm() const -> Algorithm {
+  return mPimpl->mAlgorithm;
+}
+
 void GroebnerConfiguration::setMaxSPairGroupSize(unsigned int size) {
   mPimpl->mMaxSPairGroupSize = size;
 }
@@ -559,6 +591,22 @@ uint32 GroebnerConfiguration::maxSPairGroupSize() const {
   return mPimpl->mMaxSPairGroupSize;
 }
 
+void GroebnerConfiguration::setUseSugar(bool value) {
+  mPimpl->mUseSugar = value;
+}
+
+bool GroebnerConfiguration::useSugar() const {
+  return mPimpl->mUseSugar;
+}
+
+void GroebnerConfiguration::setUseFglm(bool value) {
+  mPimpl->mUseFglm = value;
+}
+
+bool GroebnerConfiguration::useFglm() const {
+  return mPimpl->mUseFglm;
+}
+
 void GroebnerConfiguration::setMaxThreadCount(unsigned int maxThreadCount) {
   mPimpl->mMaxThreadCount = maxThreadCount;
 }
@@ -598,21 +646,22 @@ namespace {
       return Internal::LexBaseOrderFromRight;
     }
   }
+
+  PolyRing::Monoid::Order makeOrder(const GroebnerConfiguration& conf) {
+    return PolyRing::Monoid::Order(
+      conf.varCount(),
+      std::move(conf.monomialOrder().second),
+      translateBaseOrder(conf.monomialOrder().first),
+      conf.componentBefore(),
+      conf.componentsAscending(),
+      conf.schreyering()
+    );
+  }
 }
 
 struct GroebnerInputIdealStream::Pimpl {
   Pimpl(const GroebnerConfiguration& conf):
-    ring(
-      PolyRing::Field(conf.modulus()),
-      PolyRing::Monoid::Order(
-        conf.varCount(),
-        std::move(conf.monomialOrder().second),
-        translateBaseOrder(conf.monomialOrder().first),
-        conf.componentBefore(),
-        conf.componentsAscending(),
-        conf.schreyering()
-      )
-    ),
+    ring(PolyRing::Field(conf.modulus()), makeOrder(conf)),
     basis(ring),
     poly(ring),
     monomial(ring.allocMonomial()),
@@ -774,7 +823,22 @@ namespace mgbi {
 // ** Implementation of mgbi::IdealAdapter
 namespace mgbi {
   struct IdealAdapter::Pimpl {
-    std::unique_ptr<Basis> basis;
+    Pimpl(): ring(0), freedCount(0) {}
+
+    void setPolys(std::vector<std::unique_ptr<Poly>> heapPolys) {
+      polys.clear();
+      polys.reserve(heapPolys.size());
+      for (auto it = heapPolys.begin(); it != heapPolys.end(); ++it)
+        polys.push_back(std::move(*it));
+    }
+
+    const PolyRing* ring;
+
+    /// The polynomials can be in arena, so it is declared before polys
+    /// to be destructed after them.
+    std::unique_ptr<PolyArena> arena;
+    std::vector<ArenaPolyPtr> polys;
+    size_t freedCount; /// How many of polys have been freed.
     std::unique_ptr<Exponent[]> tmpTerm;
   };
 
@@ -788,30 +852,30 @@ namespace mgbi {
   }
 
   auto IdealAdapter::varCount() const -> VarIndex {
-    MATHICGB_ASSERT(mPimpl->basis.get() != 0);
-    return mPimpl->basis->ring().getNumVars();
+    MATHICGB_ASSERT(mPimpl->ring != 0);
+    return mPimpl->ring->getNumVars();
   }
 
   size_t IdealAdapter::polyCount() const {
-    MATHICGB_ASSERT(mPimpl->basis.get() != 0);
-    return mPimpl->basis->size();
+    MATHICGB_ASSERT(mPimpl->ring != 0);
+    return mPimpl->polys.size();
   }
 
   size_t IdealAdapter::termCount(PolyIndex poly) const {
-    MATHICGB_ASSERT(mPimpl->basis.get() != 0);
-    MATHICGB_ASSERT(poly < mPimpl->basis->size());
-    return mPimpl->basis->getPoly(poly)->nTerms();
+    MATHICGB_ASSERT(poly < polyCount());
+    MATHICGB_ASSERT(mPimpl->polys[poly].get() != 0);
+    return mPimpl->polys[poly]->nTerms();
   }
 
   auto IdealAdapter::term(
     PolyIndex poly,
     TermIndex term
   ) const -> std::pair<Coefficient, const Exponent*> {
-    MATHICGB_ASSERT(mPimpl->basis.get() != 0);
-    MATHICGB_ASSERT(poly < mPimpl->basis->size());
+    MATHICGB_ASSERT(poly < polyCount());
+    MATHICGB_ASSERT(mPimpl->polys[poly].get() != 0);
 
-    const auto& monoid = mPimpl->basis->ring().monoid();
-    const auto& p = *mPimpl->basis->getPoly(poly);
+    const auto& monoid = mPimpl->ring->monoid();
+    const auto& p = *mPimpl->polys[poly];
     MATHICGB_ASSERT(term < p.nTerms());
     MATHICGB_ASSERT(p.ring().monoid() == monoid);
 
@@ -821,6 +885,16 @@ namespace mgbi {
       to[var] = monoid.externalExponent(from, var);
     return std::make_pair(p.coefficientAt(term), to);
   }
+
+  void IdealAdapter::freePoly(PolyIndex poly) {
+    MATHICGB_ASSERT(poly < polyCount());
+    MATHICGB_ASSERT(mPimpl->polys[poly].get() != 0);
+    mPimpl->polys[poly].reset();
+    // The memory of polynomials in the arena is only freed with the arena.
+    ++mPimpl->freedCount;
+    if (mPimpl->freedCount == polyCount())
+      mPimpl->arena.reset();
+  }
 }
 
 namespace {
@@ -853,58 +927,333 @@ namespace {
   };
 }
 
-// ** Implementation of function mgbi::internalComputeGroebnerBasis
-namespace mgbi {
-  bool internalComputeGroebnerBasis(
-    GroebnerInputIdealStream& inputWhichWillBeCleared,
-    IdealAdapter& output
-  ) {
-    /// @todo: make a scheme where the output Groebner basis is freed
-    /// polynomial-by-polynomial as data is transferred to out. Also
-    /// make it so that ideal is not copied.
-
-    auto&& basis = PimplOf()(inputWhichWillBeCleared).basis;
-    auto&& conf = inputWhichWillBeCleared.configuration();
-    auto&& ring = basis.ring();
-    const auto varCount = ring.getNumVars();
-    MATHICGB_ASSERT(PimplOf()(conf).debugAssertValid());
-
-    // Tell tbb how many threads to use
+namespace {
+  // Returns the number of threads to tell tbb to use for conf.
+  int tbbMaxThreadCount(const GroebnerConfiguration& conf) {
     const auto maxThreadCount = int(conf.maxThreadCount());
-    const auto tbbMaxThreadCount = maxThreadCount == 0 ?
+    return maxThreadCount == 0 ?
       mgb::mtbb::task_scheduler_init::automatic : maxThreadCount;
-    mgb::mtbb::task_scheduler_init scheduler(tbbMaxThreadCount);
+  }
 
-    // Set up logging
+  void setUpLogging(const GroebnerConfiguration& conf) {
     LogDomainSet::singleton().reset();
     LogDomainSet::singleton().performLogCommands(conf.logging());
+  }
 
-    // Make reducer
+  // Returns true if conf and conf2 describe the same polynomial ring.
+  bool sameRing(
+    const GroebnerConfiguration& conf,
+    const GroebnerConfiguration& conf2
+  ) {
+    return
+      conf.modulus() == conf2.modulus() &&
+      conf.varCount() == conf2.varCount() &&
+      conf.monomialOrder() == conf2.monomialOrder() &&
+      conf.componentBefore() == conf2.componentBefore() &&
+      conf.componentsAscending() == conf2.componentsAscending() &&
+      conf.schreyering() == conf2.schreyering();
+  }
+
+  // Returns a copy of poly in ring, which must have the same monoid as the
+  // ring of poly though it is a different object.
+  std::unique_ptr<Poly> copyToRing(const Poly& poly, const PolyRing& ring) {
+    const auto& monoid = ring.monoid();
+    auto copy = make_unique<Poly>(ring);
+    copy->reserve(poly.termCount());
+    auto mono = monoid.alloc();
+    for (size_t term = 0; term < poly.termCount(); ++term) {
+      monoid.copy(poly.ring().monoid(), poly.monomialAt(term), mono);
+      copy->appendTerm(poly.coefficientAt(term), mono);
+    }
+    return copy;
+  }
+
+  // Returns a copy of poly in ring, which must have the same field and
+  // variables as the ring of poly but can have another monomial order.
+  std::unique_ptr<Poly> copyToOrder(const Poly& poly, const PolyRing& ring) {
+    const auto& monoid = ring.monoid();
+    const auto& monoidFrom = poly.ring().monoid();
+    const auto varCount = monoid.varCount();
+    auto copy = make_unique<Poly>(ring);
+    copy->reserve(poly.termCount());
+    auto mono = monoid.alloc();
+    std::vector<PolyRing::Monoid::Exponent> exponents(varCount);
+    for (size_t term = 0; term < poly.termCount(); ++term) {
+      const auto from = poly.monomialAt(term);
+      for (size_t var = 0; var < varCount; ++var)
+        exponents[var] = monoidFrom.externalExponent(from, var);
+      monoid.setExternalExponents(exponents.data(), mono);
+      copy->appendTerm(poly.coefficientAt(term), mono);
+    }
+    if (!copy->termsAreInDescendingOrder())
+      copy->sortTermsDescending();
+    return copy;
+  }
+
+  Reducer::ReducerType reducerType(const GroebnerConfiguration& conf) {
     typedef GroebnerConfiguration GConf;
-    Reducer::ReducerType reducerType;
     switch (conf.reducer()) {
     case GConf::ClassicReducer:
-      reducerType = Reducer::Reducer_BjarkeGeo;
-      break;
+      return Reducer::Reducer_BjarkeGeo;
 
     default:
     case GConf::DefaultReducer:
     case GConf::MatrixReducer:
-      reducerType = Reducer::Reducer_F4_New;
-      break;
+      return Reducer::Reducer_F4_New;
     }
-    const auto reducer = Reducer::makeReducer(reducerType, ring);
+  }
+
+  // Applies the settings of conf to alg except for the callback.
+  void configure(ClassicGBAlg& alg, const GroebnerConfiguration& conf) {
+    alg.setReducerMemoryQuantum(100 * 1024);
+    alg.setUseAutoTopReduction(true);
+    alg.setUseAutoTailReduction(false);
+    alg.setSPairGroupSize(conf.maxSPairGroupSize());
+  }
+
+  // As computeBasis, but computes a Groebner basis for (1, ..., 1)-graded
+  // reverse lex first and then converts it to the order of the input with
+  // FGLM. If the ideal is not zero-dimensional, then this sets
+  // zeroDimensional to false and leaves the input and the output alone.
+  bool computeFglmBasis(
+    GroebnerInputIdealStream& inputWhichWillBeCleared,
+    IdealAdapter& output,
+    bool& zeroDimensional
+  ) {
+    typedef GroebnerConfiguration GConf;
+    auto&& basis = PimplOf()(inputWhichWillBeCleared).basis;
+    auto&& conf = inputWhichWillBeCleared.configuration();
+    auto&& ring = basis.ring();
+    zeroDimensional = true;
+
+    // The input is copied so that it is still there if it turns out that
+    // the ideal is not zero-dimensional.
+    const PolyRing grevlexRing(
+      ring.field(),
+      PolyRing::Monoid(PolyRing::Monoid::Order(ring.varCount()))
+    );
+    Basis generators(grevlexRing);
+    for (size_t i = 0; i < basis.size(); ++i)
+      if (!basis.getPoly(i)->isZero())
+        generators.insert(copyToOrder(*basis.getPoly(i), grevlexRing));
+
+    const auto reducer = Reducer::makeReducer(reducerType(conf), grevlexRing);
+    CallbackAdapter callback(
+      PimplOf()(conf).mCallbackData,
+      PimplOf()(conf).mCallback
+    );
+    ClassicGBAlg alg
+      (std::move(generators), *reducer, 2, true, 0, conf.useSugar());
+    configure(alg, conf);
+    if (!callback.isNull())
+      alg.setCallback(&callback);
+    alg.computeGrobnerBasis();
+
+    typedef mgb::GroebnerConfiguration::Callback::Action Action;
+    std::unique_ptr<Basis> result;
+    if (callback.lastAction() == Action::StopWithNoOutputAction)
+      return false;
+    else if (callback.lastAction() == Action::StopWithPartialOutputAction) {
+      result = make_unique<Basis>(ring);
+      const auto& gb = alg.basis();
+      for (size_t i = 0; i < gb.size(); ++i)
+        if (!gb.retired(i))
+          result->insert(copyToOrder(gb.poly(i), ring));
+    } else if (Fglm::zeroDimensional(alg.basis()))
+      result = Fglm(alg.basis()).convert(ring);
+    else {
+      zeroDimensional = false;
+      return false;
+    }
+
+    basis.takeGenerators();
+    PimplOf()(output).setPolys(result->takeGenerators());
+    PimplOf()(output).ring = &ring;
+    PimplOf()(output).tmpTerm =
+      make_unique_array<GConf::Exponent>(ring.varCount());
+    return true;
+  }
+
+  // As computeBasis, but uses the signature algorithm. If syzygies is not
+  // null then it gets one polynomial per input polynomial. The terms of
+  // the polynomial for input polynomial i are the monomials m such that
+  // m*e_i is the lead term of a syzygy that the algorithm found.
+  void computeSignatureBasis(
+    GroebnerInputIdealStream& inputWhichWillBeCleared,
+    IdealAdapter& output,
+    IdealAdapter* syzygies
+  ) {
+    typedef GroebnerConfiguration GConf;
+    auto&& conf = inputWhichWillBeCleared.configuration();
+    auto&& ring = PimplOf()(inputWhichWillBeCleared).ring;
+    const auto& monoid = ring.monoid();
+    MATHICGB_ASSERT(PimplOf()(conf).debugAssertValid());
+
+    // The signature algorithm requires non-zero generators. The basis
+    // vector of a zero generator is itself a syzygy, so it is handled here.
+    auto polys = PimplOf()(inputWhichWillBeCleared).basis.takeGenerators();
+    std::vector<char> isZero;
+    Basis basis(ring);
+    for (auto it = polys.begin(); it != polys.end(); ++it) {
+      isZero.push_back((*it)->isZero());
+      if (!(*it)->isZero())
+        basis.insert(std::move(*it));
+    }
+    polys.clear();
+
+    SignatureGB::Processor processor
+      (monoid, conf.componentsAscending(), conf.schreyering());
+    if (processor.schreyering())
+      processor.setSchreyerMultipliers(basis);
+
+    // These are the defaults of the siggb action except that the Koszul
+    // syzygies are not postponed when the syzygies are requested. That
+    // way all of them end up in the syzygy table.
+    SignatureGB alg(
+      std::move(basis),
+      std::move(processor),
+      Reducer::Reducer_BjarkeGeo,
+      2,
+      2,
+      syzygies == 0,
+      true,
+      true,
+      false,
+      0
+    );
+    alg.computeGrobnerBasis();
+
+    // A signature basis is usually far from minimal, so leave out the
+    // elements whose lead monomial is a multiple of another lead monomial.
+    // In ascending order of lead monomial any such other element comes
+    // first.
+    const auto& sigBasis = *alg.getGB();
+    std::vector<size_t> indices;
+    for (size_t i = 0; i < sigBasis.size(); ++i)
+      indices.push_back(i);
+    std::sort(indices.begin(), indices.end(), [&](size_t a, size_t b) {
+      return monoid.lessThan
+        (sigBasis.getLeadMonomial(a), sigBasis.getLeadMonomial(b));
+    });
+    PolyBasis minimal
+      (ring, DivisorLookup::makeFactory(ring, 2)->create(true, true));
+    for (auto it = indices.begin(); it != indices.end(); ++it) {
+      const auto& poly = sigBasis.poly(*it);
+      const auto reducer = minimal.classicReducer(poly.getLeadMonomial());
+      if (reducer != static_cast<size_t>(-1))
+        continue;
+      auto copy = make_unique<Poly>(ring);
+      poly.copy(*copy);
+      minimal.insert(std::move(copy));
+    }
+    minimal.retireAll(PimplOf()(output).polys, PimplOf()(output).arena);
+    PimplOf()(output).ring = &ring;
+    PimplOf()(output).tmpTerm =
+      make_unique_array<GConf::Exponent>(ring.varCount());
+
+    if (syzygies == 0)
+      return;
+    std::vector<const_monomial> syzygyLeads;
+    alg.getSyzTable()->getMonomials(syzygyLeads);
+    std::vector<std::unique_ptr<Poly>> byComponent;
+    auto one = monoid.alloc();
+    monoid.setIdentity(one);
+    for (size_t i = 0; i < isZero.size(); ++i) {
+      byComponent.push_back(make_unique<Poly>(ring));
+      if (isZero[i])
+        byComponent.back()->appendTerm(1, one);
+    }
+    std::sort(
+      syzygyLeads.begin(),
+      syzygyLeads.end(),
+      [&](const_monomial a, const_monomial b) {
+        return monoid.lessThan(b, a);
+      }
+    );
+    // The components of the algorithm only count the non-zero generators.
+    std::vector<size_t> inputIndex;
+    for (size_t i = 0; i < isZero.size(); ++i)
+      if (!isZero[i])
+        inputIndex.push_back(i);
+    for (auto it = syzygyLeads.begin(); it != syzygyLeads.end(); ++it) {
+      const auto component = monoid.component(*it);
+      MATHICGB_ASSERT(component < inputIndex.size());
+      byComponent[inputIndex[component]]->appendTerm(1, *it);
+    }
+    PimplOf()(*syzygies).setPolys(std::move(byComponent));
+    PimplOf()(*syzygies).ring = &ring;
+    PimplOf()(*syzygies).tmpTerm =
+      make_unique_array<GConf::Exponent>(ring.varCount());
+  }
+
+  // Computes the Groebner basis once the threads and logging are set up.
+  // If groebnerBasisWhichWillBeCleared is not null, then its polynomials
+  // must form a Groebner basis and that basis gets extended by the
+  // polynomials of inputWhichWillBeCleared instead of being recomputed.
+  bool computeBasis(
+    GroebnerInputIdealStream* groebnerBasisWhichWillBeCleared,
+    GroebnerInputIdealStream& inputWhichWillBeCleared,
+    IdealAdapter& output
+  ) {
+    auto&& basis = PimplOf()(inputWhichWillBeCleared).basis;
+    auto&& conf = inputWhichWillBeCleared.configuration();
+    auto&& ring = basis.ring();
+    MATHICGB_ASSERT(PimplOf()(conf).debugAssertValid());
+
+    if (
+      conf.algorithm() == GroebnerConfiguration::SignatureAlgorithm &&
+      groebnerBasisWhichWillBeCleared == 0
+    ) {
+      computeSignatureBasis(inputWhichWillBeCleared, output, 0);
+      return true;
+    }
+
+    if (conf.useFglm() && groebnerBasisWhichWillBeCleared == 0) {
+      bool zeroDimensional;
+      const bool done =
+        computeFglmBasis(inputWhichWillBeCleared, output, zeroDimensional);
+      if (zeroDimensional)
+        return done;
+    }
+
+    // The Groebner basis is in a ring of its own, so it gets copied into
+    // the ring of the input.
+    Basis groebnerBasis(ring);
+    if (groebnerBasisWhichWillBeCleared != 0) {
+      auto&& gbStream = *groebnerBasisWhichWillBeCleared;
+      if (!sameRing(gbStream.configuration(), conf)) {
+        throw std::invalid_argument
+          ("A Groebner basis must be in the same ring as the generators.");
+      }
+      auto polys = PimplOf()(gbStream).basis.takeGenerators();
+      for (auto it = polys.begin(); it != polys.end(); ++it) {
+        if (!(*it)->isZero())
+          groebnerBasis.insert(copyToRing(**it, ring));
+        it->reset();
+      }
+    }
+
+    // Make reducer
+    typedef GroebnerConfiguration GConf;
+    const auto reducer = Reducer::makeReducer(reducerType(conf), ring);
     CallbackAdapter callback(
       PimplOf()(conf).mCallbackData,
       PimplOf()(conf).mCallback
     );
 
     // Set up and configure algorithm
-    ClassicGBAlg alg(basis, *reducer, 2, true, 0);
-    alg.setReducerMemoryQuantum(100 * 1024);
-    alg.setUseAutoTopReduction(true);
-    alg.setUseAutoTailReduction(false);
-    alg.setSPairGroupSize(conf.maxSPairGroupSize());
+    // The input polynomials are moved into the algorithm, which is what
+    // leaves inputWhichWillBeCleared empty.
+    ClassicGBAlg alg(
+      std::move(groebnerBasis),
+      std::move(basis),
+      *reducer,
+      2,
+      true,
+      0,
+      conf.useSugar()
+    );
+    configure(alg, conf);
     if (!callback.isNull())
       alg.setCallback(&callback);
 
@@ -912,13 +1261,276 @@ namespace mgbi {
     alg.computeGrobnerBasis();
     typedef mgb::GroebnerConfiguration::Callback::Action Action;
     if (callback.lastAction() != Action::StopWithNoOutputAction) {
-      PimplOf()(output).basis = alg.basis().toBasisAndRetireAll();
+      // The polynomials are moved out of the algorithm together with the
+      // arena that holds them. They are freed one at a time by the caller
+      // as they are written to the output and the arena is freed after the
+      // last one.
+      auto&& adapter = PimplOf()(output);
+      alg.basis().retireAll(adapter.polys, adapter.arena);
+      PimplOf()(output).ring = &ring;
       PimplOf()(output).tmpTerm =
-        make_unique_array<GConf::Exponent>(basis.ring().varCount());
+        make_unique_array<GConf::Exponent>(ring.varCount());
       return true;
     } else
       return false;
   }
 }
 
+// ** Implementation of class GroebnerSession
+struct GroebnerSession::Pimpl {
+  Pimpl(const GroebnerConfiguration& conf):
+    scheduler(tbbMaxThreadCount(conf))
+  {}
+
+  mgb::mtbb::task_scheduler_init scheduler;
+};
+
+GroebnerSession::GroebnerSession(const GroebnerConfiguration& conf):
+  mPimpl(new Pimpl(conf))
+{
+  MATHICGB_ASSERT(PimplOf()(conf).debugAssertValid());
+  setUpLogging(conf);
+}
+
+GroebnerSession::~GroebnerSession() {
+  MATHICGB_ASSERT(mPimpl != 0);
+  delete mPimpl;
+}
+
+// ** Implementation of class GroebnerReducer
+struct GroebnerReducer::Pimpl {
+  Pimpl(const GroebnerConfiguration& conf):
+    conf(conf),
+    scheduler(tbbMaxThreadCount(conf)),
+    ring(PolyRing::Field(conf.modulus()), makeOrder(conf)),
+    basis(ring, DivisorLookup::makeFactory(ring, 2)->create(true, true)),
+    reducer(ring, F4Reducer::NewType)
+  {
+    reducer.setMemoryQuantum(100 * 1024);
+  }
+
+  const GroebnerConfiguration conf;
+  mgb::mtbb::task_scheduler_init scheduler;
+  const PolyRing ring;
+  PolyBasis basis;
+  F4Reducer reducer;
+};
+
+GroebnerReducer::GroebnerReducer(
+  GroebnerInputIdealStream& basisWhichWillBeCleared
+):
+  mPimpl(new Pimpl(basisWhichWillBeCleared.configuration()))
+{
+  setUpLogging(mPimpl->conf);
+
+  // Insert the polynomials in ascending order of lead monomial so that a
+  // polynomial whose lead monomial is divisible by that of another one can
+  // be left out. That keeps the lead monomials of the basis unique.
+  auto polys = PimplOf()(basisWhichWillBeCleared).basis.takeGenerators();
+  const auto& monoid = PimplOf()(basisWhichWillBeCleared).ring.monoid();
+  polys.erase(
+    std::remove_if(
+      polys.begin(),
+      polys.end(),
+      [](const std::unique_ptr<Poly>& poly) {return poly->isZero();}
+    ),
+    polys.end()
+  );
+  std::sort(
+    polys.begin(),
+    polys.end(),
+    [&](const std::unique_ptr<Poly>& a, const std::unique_ptr<Poly>& b) {
+      return monoid.lessThan(a->getLeadMonomial(), b->getLeadMonomial());
+    }
+  );
+  auto& basis = mPimpl->basis;
+  for (auto it = polys.begin(); it != polys.end(); ++it) {
+    auto poly = copyToRing(**it, mPimpl->ring);
+    it->reset();
+    if (basis.classicReducer(poly->getLeadMonomial()) != static_cast<size_t>(-1))
+      continue;
+    poly->makeMonic();
+    basis.insert(std::move(poly));
+  }
+}
+
+GroebnerReducer::~GroebnerReducer() {
+  MATHICGB_ASSERT(mPimpl != 0);
+  delete mPimpl;
+}
+
+// ** Implementation of the functions mgbi::internalComputeGroebnerBasis,
+// ** mgbi::internalComputeSessionGroebnerBasis,
+// ** mgbi::internalExtendGroebnerBasis and mgbi::internalComputeGroebnerBases
+namespace mgbi {
+  bool internalComputeGroebnerBasis(
+    GroebnerInputIdealStream& inputWhichWillBeCleared,
+    IdealAdapter& output
+  ) {
+    auto&& conf = inputWhichWillBeCleared.configuration();
+    mgb::mtbb::task_scheduler_init scheduler(tbbMaxThreadCount(conf));
+    setUpLogging(conf);
+    return computeBasis(0, inputWhichWillBeCleared, output);
+  }
+
+  bool internalComputeSessionGroebnerBasis(
+    GroebnerInputIdealStream& inputWhichWillBeCleared,
+    IdealAdapter& output
+  ) {
+    return computeBasis(0, inputWhichWillBeCleared, output);
+  }
+
+  void internalComputeSignatureBasis(
+    GroebnerInputIdealStream& inputWhichWillBeCleared,
+    IdealAdapter& output,
+    IdealAdapter& syzygies
+  ) {
+    auto&& conf = inputWhichWillBeCleared.configuration();
+    mgb::mtbb::task_scheduler_init scheduler(tbbMaxThreadCount(conf));
+    setUpLogging(conf);
+    computeSignatureBasis(inputWhichWillBeCleared, output, &syzygies);
+  }
+
+  bool internalExtendGroebnerBasis(
+    GroebnerInputIdealStream& groebnerBasisWhichWillBeCleared,
+    GroebnerInputIdealStream& generatorsWhichWillBeCleared,
+    IdealAdapter& output
+  ) {
+    auto&& conf = generatorsWhichWillBeCleared.configuration();
+    mgb::mtbb::task_scheduler_init scheduler(tbbMaxThreadCount(conf));
+    setUpLogging(conf);
+    return computeBasis
+      (&groebnerBasisWhichWillBeCleared, generatorsWhichWillBeCleared, output);
+  }
+
+  void internalComputeNormalForms(
+    GroebnerReducer& reducer,
+    GroebnerInputIdealStream& inputWhichWillBeCleared,
+    IdealAdapter& output
+  ) {
+    auto&& pimpl = PimplOf()(reducer);
+    if (!sameRing(inputWhichWillBeCleared.configuration(), pimpl.conf)) {
+      throw std::invalid_argument
+        ("The input of a GroebnerReducer must be in the ring of the basis.");
+    }
+
+    // Each batch is one matrix. Larger batches share more reducer rows but
+    // also make larger matrices.
+    const size_t batchSize = 10000;
+    auto polys = PimplOf()(inputWhichWillBeCleared).basis.takeGenerators();
+    auto& normalForms = PimplOf()(output).polys;
+    normalForms.clear();
+    normalForms.reserve(polys.size());
+    std::vector<std::unique_ptr<Poly>> batch;
+    std::vector<std::unique_ptr<Poly>> reduced;
+    for (size_t begin = 0; begin < polys.size(); begin += batchSize) {
+      const auto end = std::min(polys.size(), begin + batchSize);
+      batch.clear();
+      for (auto i = begin; i < end; ++i) {
+        batch.push_back(copyToRing(*polys[i], pimpl.ring));
+        polys[i].reset();
+      }
+      pimpl.reducer.classicNormalForms(batch, pimpl.basis, reduced);
+      for (auto it = reduced.begin(); it != reduced.end(); ++it)
+        normalForms.push_back(std::move(*it));
+    }
+    PimplOf()(output).ring = &pimpl.ring;
+    PimplOf()(output).tmpTerm =
+      make_unique_array<GroebnerConfiguration::Exponent>(pimpl.ring.varCount());
+  }
+
+  void internalComputeGroebnerBases(
+    GroebnerInputIdealStream* const* inputsWhichWillBeCleared,
+    const size_t count,
+    IdealAdapter* outputs,
+    bool* doOutput
+  ) {
+    // Each input has its own ring, so the computations do not share any
+    // memory pools and can run at the same time.
+    mgb::mtbb::parallel_for(
+      mgb::mtbb::blocked_range<size_t>(0, count),
+      [&](const mgb::mtbb::blocked_range<size_t>& range) {
+        for (auto i = range.begin(); i != range.end(); ++i) {
+          MATHICGB_ASSERT(inputsWhichWillBeCleared[i] != 0);
+          doOutput[i] =
+            computeBasis(0, *inputsWhichWillBeCleared[i], outputs[i]);
+        }
+      }
+    );
+  }
+}
+
+// ** Implementation of function computeRationalGroebnerBasis
+namespace {
+  MultiModularGB::RationalTerm parseRationalTerm(
+    const RationalTerm& term,
+    const size_t varCount
+  ) {
+    if (term.exponents.size() != varCount)
+      throw std::invalid_argument
+        ("A rational term must have one exponent per variable.");
+
+    MultiModularGB::RationalTerm parsed;
+    const auto& str = term.coefficient;
+    const auto slash = str.find('/');
+    parsed.numerator = BigInt::fromString(str.substr(0, slash));
+    if (slash == std::string::npos)
+      parsed.denominator = 1;
+    else {
+      parsed.denominator = BigInt::fromString(str.substr(slash + 1));
+      if (parsed.denominator.isZero() || parsed.denominator.isNegative())
+        throw std::invalid_argument
+          ("The denominator of " + str + " is not positive.");
+      const auto gcd = BigInt::gcd(parsed.numerator, parsed.denominator);
+      parsed.numerator = parsed.numerator / gcd;
+      parsed.denominator = parsed.denominator / gcd;
+    }
+    parsed.exponents.assign(term.exponents.begin(), term.exponents.end());
+    return parsed;
+  }
+}
+
+std::vector<RationalPolynomial> computeRationalGroebnerBasis(
+  const GroebnerConfiguration& conf,
+  const std::vector<RationalPolynomial>& ideal
+) {
+  MATHICGB_ASSERT(mgbi::PimplOf()(conf).debugAssertValid());
+
+  mgb::mtbb::task_scheduler_init scheduler(tbbMaxThreadCount(conf));
+  setUpLogging(conf);
+
+  const auto varCount = conf.varCount();
+  std::vector<MultiModularGB::RationalPoly> input;
+  for (const auto& poly : ideal) {
+    MultiModularGB::RationalPoly parsed;
+    for (const auto& term : poly)
+      parsed.push_back(parseRationalTerm(term, varCount));
+    input.push_back(std::move(parsed));
+  }
+
+  // Run one prime per thread at a time.
+  const auto maxThreadCount = conf.maxThreadCount();
+  const size_t batchSize = maxThreadCount != 0 ?
+    maxThreadCount : std::max(std::thread::hardware_concurrency(), 1u);
+  MultiModularGB alg(makeOrder(conf), batchSize);
+  alg.setUseSugar(conf.useSugar());
+  const auto basis = alg.computeGroebnerBasis(input);
+
+  std::vector<RationalPolynomial> output;
+  for (const auto& poly : basis) {
+    RationalPolynomial converted;
+    for (const auto& term : poly) {
+      RationalTerm convertedTerm;
+      convertedTerm.coefficient = term.numerator.toString();
+      if (!term.denominator.isOne())
+        convertedTerm.coefficient += '/' + term.denominator.toString();
+      convertedTerm.exponents.assign
+        (term.exponents.begin(), term.exponents.end());
+      converted.push_back(std::move(convertedTerm));
+    }
+    output.push_back(std::move(converted));
+  }
+  return output;
+}
+
 MATHICGB_NAMESPACE_END
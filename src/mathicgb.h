@@ -4,6 +4,7 @@
 #include <ostream>
 #include <vector>
 #include <utility>
+#include <string>
 
 // The main function in this file is computeGroebnerBasis. See the comment
 // preceding that function for an example of how to use this library
@@ -203,6 +204,22 @@ namespace mgb { // Part of the public interface of MathicGB
     void setReducer(Reducer reducer);
     Reducer reducer() const;
 
+    enum Algorithm {
+      DefaultAlgorithm = 0, /// Let the library decide for itself.
+      BuchbergerAlgorithm = 1, /// Buchberger's algorithm.
+      SignatureAlgorithm = 2 /// The signature algorithm with syzygy module.
+    };
+
+    /// Specify the algorithm used to compute a Groebner basis. The
+    /// signature algorithm keeps track of the syzygy module of the input
+    /// and uses it, including the Koszul syzygies, to avoid reductions to
+    /// zero. That can be a lot faster than Buchberger's algorithm for
+    /// inputs with many syzygies. The signature algorithm honors the module
+    /// monomial order settings, does not call the callback and always uses
+    /// a classic reducer. The default is Buchberger's algorithm.
+    void setAlgorithm(Algorithm algorithm);
+    Algorithm algorithm() const;
+
     /// Sets the maximum number of S-pairs to reduce at one time. This is
     /// mainly useful as a (weak) control on memory usage for F4 reducers.
     /// A value of 0 indicates to let the library decide this value for
@@ -214,6 +231,33 @@ namespace mgb { // Part of the public interface of MathicGB
     void setMaxSPairGroupSize(unsigned int size);
     unsigned int maxSPairGroupSize() const;
 
+    /// Sets whether to choose S-pairs according to the sugar strategy.
+    /// The sugar of a polynomial is an estimate of the degree that it
+    /// would have had if the input had been homogenized. Choosing S-pairs
+    /// of minimal sugar first can greatly reduce the size of the
+    /// intermediate polynomials for non-homogeneous input. For homogeneous
+    /// input under a degree order it makes no difference.
+    ///
+    /// The default value is false.
+    void setUseSugar(bool value);
+    bool useSugar() const;
+
+    /// Sets whether to compute the Groebner basis of a zero-dimensional
+    /// ideal by first computing a Groebner basis for (1, ..., 1)-graded
+    /// reverse lex and then converting that basis to the requested monomial
+    /// order with the FGLM algorithm. That is usually much faster than a
+    /// direct computation for lex orders. If the ideal turns out not to be
+    /// zero-dimensional then the basis is computed directly after all, so
+    /// only turn this on if the ideals are expected to be zero-dimensional.
+    /// The output is then the reduced Groebner basis in ascending order of
+    /// lead term. This does not apply to extendGroebnerBasis or to the
+    /// signature algorithm. A partial output from the callback is a partial
+    /// basis for reverse lex.
+    ///
+    /// The default value is false.
+    void setUseFglm(bool value);
+    bool useFglm() const;
+
     /// Sets the maximum number of threads to use. May use fewer threads.
     /// A value of 0 indicates to let the library decide this value for
     /// itself, which is also the default value.
@@ -361,6 +405,152 @@ namespace mgb { // Part of the public interface of MathicGB
     OutputStream& output
   );
 
+  /// Computes a Groebner basis of the ideal generated by the polynomials on
+  /// both groebnerBasisWhichWillBeCleared and generatorsWhichWillBeCleared.
+  /// The polynomials on groebnerBasisWhichWillBeCleared must form a
+  /// Groebner basis, such as one from computeGroebnerBasis. Then the
+  /// S-pairs between those polynomials are known to reduce to zero and
+  /// only the S-pairs that involve a new basis element get reduced. That is
+  /// a lot faster than computing the basis from scratch when only a few
+  /// generators are added. The result is not correct if the polynomials on
+  /// groebnerBasisWhichWillBeCleared do not form a Groebner basis.
+  ///
+  /// The computation is configured by the configuration of
+  /// generatorsWhichWillBeCleared, except that this always uses Buchberger's
+  /// algorithm. The configuration of
+  /// groebnerBasisWhichWillBeCleared must have the same modulus, number of
+  /// variables and monomial order. Throws std::invalid_argument if not.
+  template<class OutputStream>
+  void extendGroebnerBasis(
+    GroebnerInputIdealStream& groebnerBasisWhichWillBeCleared,
+    GroebnerInputIdealStream& generatorsWhichWillBeCleared,
+    OutputStream& output
+  );
+
+  /// As computeGroebnerBasis(input, output), but always uses the signature
+  /// algorithm and also writes the lead terms of the syzygies of the input
+  /// polynomials to syzygyOutput, which must have the same functions as
+  /// output. Let f_1, ..., f_k be the input polynomials and let e_i be the
+  /// basis vector of the module R^k that f_i corresponds to. Then
+  /// syzygyOutput gets k monomial ideals one after the other, each with its
+  /// own idealBegin and idealDone. The i'th ideal is generated by the
+  /// monomials m such that m*e_i is the lead term, in the module monomial
+  /// order of the configuration, of a syzygy that the algorithm found. Each
+  /// monomial is written as a polynomial with a single term whose
+  /// coefficient is 1.
+  template<class OutputStream, class SyzygyStream>
+  void computeGroebnerBasis(
+    GroebnerInputIdealStream& inputWhichWillBeCleared,
+    OutputStream& output,
+    SyzygyStream& syzygyOutput
+  );
+
+  /// A term of a polynomial with rational coefficients. The coefficient is
+  /// written in base 10 as "a" or "a/b" where a and b are integers of any
+  /// size and b is positive, such as "-3/4". There is one exponent per
+  /// variable.
+  struct RationalTerm {
+    std::string coefficient;
+    std::vector<GroebnerConfiguration::Exponent> exponents;
+  };
+  typedef std::vector<RationalTerm> RationalPolynomial;
+
+  /// Returns the reduced Groebner basis of ideal over the rational numbers.
+  /// The polynomials are monic with terms in descending order and the
+  /// coefficients are in lowest terms. The basis is computed modulo many
+  /// primes in parallel and lifted to the rationals, and the computation
+  /// stops once the lifted basis stops changing. That is probabilistic -
+  /// the result is very likely but not certain to be correct.
+  ///
+  /// The modulus and the callback of configuration are ignored and the
+  /// reducer is always the classic one. maxThreadCount also sets the
+  /// number of primes computed at a time. The terms of a polynomial in
+  /// ideal can be in any order but no two of them may have the same
+  /// monomial. Throws std::invalid_argument on malformed coefficients.
+  std::vector<RationalPolynomial> computeRationalGroebnerBasis(
+    const GroebnerConfiguration& configuration,
+    const std::vector<RationalPolynomial>& ideal
+  );
+
+  /// Keeps the thread pool and the logging set up between Groebner basis
+  /// computations. The function computeGroebnerBasis sets those up and
+  /// tears them down again on every call, which takes a large part of the
+  /// time for small ideals. So use a session to compute many bases.
+  ///
+  /// The thread count and the logging are taken from the configuration that
+  /// the session is constructed with and the logs accumulate over all the
+  /// computations of the session. Everything else is taken from the
+  /// configuration of each input ideal. The ring of an input ideal and its
+  /// tables and memory pools live in the GroebnerInputIdealStream, which can
+  /// be used again for the next ideal once a computation has cleared it. So
+  /// keep and reuse input streams to also avoid setting up a ring each time.
+  class GroebnerSession {
+  public:
+    GroebnerSession(const GroebnerConfiguration& conf);
+    ~GroebnerSession();
+
+    /// As the function computeGroebnerBasis.
+    template<class OutputStream>
+    void computeGroebnerBasis(
+      GroebnerInputIdealStream& inputWhichWillBeCleared,
+      OutputStream& output
+    );
+
+    /// Computes the Groebner bases of the ideals in inputsWhichWillBeCleared
+    /// concurrently and then writes the basis of *inputsWhichWillBeCleared[i]
+    /// to *outputs[i] for each i in order. The two vectors must have the same
+    /// size and no two of the inputs can be the same stream. The callbacks
+    /// of the configurations of the inputs can be called from several
+    /// threads at the same time.
+    template<class OutputStream>
+    void computeGroebnerBases(
+      const std::vector<GroebnerInputIdealStream*>& inputsWhichWillBeCleared,
+      const std::vector<OutputStream*>& outputs
+    );
+
+  private:
+    GroebnerSession(const GroebnerSession&); // not available
+    void operator=(const GroebnerSession&); // not available
+
+    struct Pimpl;
+    friend class mgbi::PimplOf;
+    Pimpl* const mPimpl;
+  };
+
+  /// Computes normal forms of polynomials with respect to a Groebner basis.
+  /// The polynomials are reduced in batches, each batch as a single F4
+  /// matrix so that the polynomials of a batch share the reducer rows. The
+  /// matrices are built and reduced in parallel.
+  class GroebnerReducer {
+  public:
+    /// Takes the polynomials on basisWhichWillBeCleared as the basis. The
+    /// normal forms are only well defined if that is a Groebner basis, such
+    /// as one from computeGroebnerBasis. The thread count and the logging
+    /// are taken from the configuration of basisWhichWillBeCleared.
+    GroebnerReducer(GroebnerInputIdealStream& basisWhichWillBeCleared);
+    ~GroebnerReducer();
+
+    /// Writes the normal form of each polynomial on inputWhichWillBeCleared
+    /// to output in the same order. So output gets as many polynomials as
+    /// there are on the input and a normal form of zero is written as a
+    /// polynomial with no terms. The normal forms are not made monic. The
+    /// input must have the same modulus, number of variables and monomial
+    /// order as the basis. Throws std::invalid_argument if not.
+    template<class OutputStream>
+    void computeNormalForms(
+      GroebnerInputIdealStream& inputWhichWillBeCleared,
+      OutputStream& output
+    );
+
+  private:
+    GroebnerReducer(const GroebnerReducer&); // not available
+    void operator=(const GroebnerReducer&); // not available
+
+    struct Pimpl;
+    friend class mgbi::PimplOf;
+    Pimpl* const mPimpl;
+  };
+
   class NullIdealStream;
 
   /// Passes on all method calls to an inner ideal stream while printing out
@@ -792,6 +982,9 @@ namespace mgb {
       // Return value only valid until the next call to term.
       ConstTerm term(PolyIndex poly, TermIndex term) const;
 
+      // Frees the memory used by poly. Do not access poly after this.
+      void freePoly(PolyIndex poly);
+
     private:
       friend class mgbi::PimplOf;
       struct Pimpl;
@@ -802,6 +995,87 @@ namespace mgb {
       GroebnerInputIdealStream& inputWhichWillBeCleared,
       IdealAdapter& output
     );
+
+    /// As internalComputeGroebnerBasis, but leaves the threads and the
+    /// logging as a GroebnerSession has set them up.
+    bool internalComputeSessionGroebnerBasis(
+      GroebnerInputIdealStream& inputWhichWillBeCleared,
+      IdealAdapter& output
+    );
+
+    void internalComputeSignatureBasis(
+      GroebnerInputIdealStream& inputWhichWillBeCleared,
+      IdealAdapter& output,
+      IdealAdapter& syzygies
+    );
+
+    bool internalExtendGroebnerBasis(
+      GroebnerInputIdealStream& groebnerBasisWhichWillBeCleared,
+      GroebnerInputIdealStream& generatorsWhichWillBeCleared,
+      IdealAdapter& output
+    );
+
+    /// Computes the basis of inputsWhichWillBeCleared[i] into outputs[i]
+    /// and sets doOutput[i] to whether the basis should be output.
+    void internalComputeGroebnerBases(
+      GroebnerInputIdealStream* const* inputsWhichWillBeCleared,
+      size_t count,
+      IdealAdapter* outputs,
+      bool* doOutput
+    );
+
+    void internalComputeNormalForms(
+      GroebnerReducer& reducer,
+      GroebnerInputIdealStream& inputWhichWillBeCleared,
+      IdealAdapter& output
+    );
+
+    /// Writes ideal to output and frees the polynomials of ideal as it goes.
+    template<class OutputStream>
+    void writeIdeal(IdealAdapter& ideal, OutputStream& output) {
+      typedef IdealAdapter::ConstTerm ConstTerm;
+      const size_t varCount = ideal.varCount();
+      const size_t polyCount = ideal.polyCount();
+      output.idealBegin(polyCount);
+      for (size_t polyIndex = 0; polyIndex < polyCount; ++polyIndex) {
+        const size_t termCount = ideal.termCount(polyIndex);
+        output.appendPolynomialBegin(termCount);
+        for (size_t termIndex = 0; termIndex < termCount; ++termIndex) {
+          output.appendTermBegin();
+          const ConstTerm term = ideal.term(polyIndex, termIndex);
+          for (size_t var = 0; var < varCount; ++var)
+            output.appendExponent(var, term.second[var]);
+          output.appendTermDone(term.first);
+        }
+        output.appendPolynomialDone();
+        ideal.freePoly(polyIndex);
+      }
+      output.idealDone();
+    }
+
+    /// Writes each polynomial of ideals to output as a monomial ideal with
+    /// one generator per term and frees the polynomials as it goes.
+    template<class OutputStream>
+    void writeMonomialIdeals(IdealAdapter& ideals, OutputStream& output) {
+      typedef IdealAdapter::ConstTerm ConstTerm;
+      const size_t varCount = ideals.varCount();
+      const size_t idealCount = ideals.polyCount();
+      for (size_t idealIndex = 0; idealIndex < idealCount; ++idealIndex) {
+        const size_t termCount = ideals.termCount(idealIndex);
+        output.idealBegin(termCount);
+        for (size_t termIndex = 0; termIndex < termCount; ++termIndex) {
+          output.appendPolynomialBegin(1);
+          output.appendTermBegin();
+          const ConstTerm term = ideals.term(idealIndex, termIndex);
+          for (size_t var = 0; var < varCount; ++var)
+            output.appendExponent(var, term.second[var]);
+          output.appendTermDone(term.first);
+          output.appendPolynomialDone();
+        }
+        output.idealDone();
+        ideals.freePoly(idealIndex);
+      }
+    }
   }
 
   template<class OutputStream>
@@ -809,29 +1083,91 @@ namespace mgb {
     GroebnerInputIdealStream& inputWhichWillBeCleared,
     OutputStream& output
   ) {
-    typedef mgbi::IdealAdapter::ConstTerm ConstTerm;
     mgbi::IdealAdapter ideal;
     const bool doOutput =
       mgbi::internalComputeGroebnerBasis(inputWhichWillBeCleared, ideal);
-    if (!doOutput)
+    if (doOutput)
+      mgbi::writeIdeal(ideal, output);
+  }
+
+  template<class OutputStream, class SyzygyStream>
+  void computeGroebnerBasis(
+    GroebnerInputIdealStream& inputWhichWillBeCleared,
+    OutputStream& output,
+    SyzygyStream& syzygyOutput
+  ) {
+    mgbi::IdealAdapter ideal;
+    mgbi::IdealAdapter syzygies;
+    mgbi::internalComputeSignatureBasis
+      (inputWhichWillBeCleared, ideal, syzygies);
+    mgbi::writeIdeal(ideal, output);
+    mgbi::writeMonomialIdeals(syzygies, syzygyOutput);
+  }
+
+  template<class OutputStream>
+  void extendGroebnerBasis(
+    GroebnerInputIdealStream& groebnerBasisWhichWillBeCleared,
+    GroebnerInputIdealStream& generatorsWhichWillBeCleared,
+    OutputStream& output
+  ) {
+    mgbi::IdealAdapter ideal;
+    const bool doOutput = mgbi::internalExtendGroebnerBasis
+      (groebnerBasisWhichWillBeCleared, generatorsWhichWillBeCleared, ideal);
+    if (doOutput)
+      mgbi::writeIdeal(ideal, output);
+  }
+
+  template<class OutputStream>
+  void GroebnerSession::computeGroebnerBasis(
+    GroebnerInputIdealStream& inputWhichWillBeCleared,
+    OutputStream& output
+  ) {
+    mgbi::IdealAdapter ideal;
+    const bool doOutput = mgbi::internalComputeSessionGroebnerBasis
+      (inputWhichWillBeCleared, ideal);
+    if (doOutput)
+      mgbi::writeIdeal(ideal, output);
+  }
+
+  template<class OutputStream>
+  void GroebnerReducer::computeNormalForms(
+    GroebnerInputIdealStream& inputWhichWillBeCleared,
+    OutputStream& output
+  ) {
+    mgbi::IdealAdapter ideal;
+    mgbi::internalComputeNormalForms(*this, inputWhichWillBeCleared, ideal);
+    mgbi::writeIdeal(ideal, output);
+  }
+
+  template<class OutputStream>
+  void GroebnerSession::computeGroebnerBases(
+    const std::vector<GroebnerInputIdealStream*>& inputsWhichWillBeCleared,
+    const std::vector<OutputStream*>& outputs
+  ) {
+    const size_t count = inputsWhichWillBeCleared.size();
+#ifdef MATHICGB_DEBUG
+    assert(outputs.size() == count);
+#endif
+    if (count == 0)
       return;
 
-    const size_t varCount = ideal.varCount();
-    const size_t polyCount = ideal.polyCount();
-    output.idealBegin(polyCount);
-    for (size_t polyIndex = 0; polyIndex < polyCount; ++polyIndex) {
-      const size_t termCount = ideal.termCount(polyIndex);
-      output.appendPolynomialBegin(termCount);
-      for (size_t termIndex = 0; termIndex < termCount; ++termIndex) {
-        output.appendTermBegin();
-        const ConstTerm term = ideal.term(polyIndex, termIndex);
-        for (size_t var = 0; var < varCount; ++var)
-          output.appendExponent(var, term.second[var]);
-        output.appendTermDone(term.first);
-      }
-      output.appendPolynomialDone();
+    // The adapters are not copyable so they cannot go in a std::vector
+    // without C++11, and std::vector<bool> is not an array of bool.
+    mgbi::IdealAdapter* const ideals = new mgbi::IdealAdapter[count];
+    bool* const doOutput = new bool[count];
+    try {
+      mgbi::internalComputeGroebnerBases
+        (&*inputsWhichWillBeCleared.begin(), count, ideals, doOutput);
+      for (size_t i = 0; i < count; ++i)
+        if (doOutput[i])
+          mgbi::writeIdeal(ideals[i], *outputs[i]);
+    } catch (...) {
+      delete[] doOutput;
+      delete[] ideals;
+      throw;
     }
-    output.idealDone();
+    delete[] doOutput;
+    delete[] ideals;
   }
 }
 
@@ -38,6 +38,14 @@ public:
   bool empty() const {return mGenerators.empty();}
   void reserve(size_t size) {mGenerators.reserve(size);}
 
+  /// Moves the generators out of the basis and leaves it empty. Use this
+  /// to hand the polynomials on without copying them.
+  std::vector<std::unique_ptr<Poly>> takeGenerators() {
+    std::vector<std::unique_ptr<Poly>> generators;
+    generators.swap(mGenerators);
+    return generators;
+  }
+
   void sort();
 
 private:
@@ -0,0 +1,376 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#include "stdinc.h"
+#include "BigInt.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+MATHICGB_NAMESPACE_BEGIN
+
+BigInt::BigInt(int64 value): mNegative(value < 0) {
+  // Negate in unsigned arithmetic so that the minimum int64 works too.
+  uint64 magnitude = static_cast<uint64>(value);
+  if (mNegative)
+    magnitude = ~magnitude + 1;
+  while (magnitude != 0) {
+    mLimbs.push_back(static_cast<Limb>(magnitude));
+    magnitude >>= 32;
+  }
+}
+
+BigInt BigInt::fromString(const std::string& str) {
+  size_t pos = 0;
+  const bool negative = !str.empty() && str[0] == '-';
+  if (negative)
+    ++pos;
+  if (pos == str.size())
+    throw std::invalid_argument("Expected an integer but got \"" + str + "\".");
+
+  BigInt result;
+  for (; pos < str.size(); ++pos) {
+    if (str[pos] < '0' || str[pos] > '9')
+      throw std::invalid_argument
+        ("Expected an integer but got \"" + str + "\".");
+    multiplyAddSmall(result.mLimbs, 10, str[pos] - '0');
+  }
+  result.mNegative = negative;
+  result.normalize();
+  return result;
+}
+
+std::string BigInt::toString() const {
+  if (isZero())
+    return "0";
+
+  // Peel off 9 decimal digits at a time from the least significant end.
+  const Limb chunk = 1000000000;
+  Limbs magnitude = mLimbs;
+  std::string digits;
+  while (!magnitude.empty()) {
+    Limb rest = divideSmall(magnitude, chunk);
+    for (int i = 0; i < 9; ++i) {
+      digits.push_back(static_cast<char>('0' + rest % 10));
+      rest /= 10;
+      if (magnitude.empty() && rest == 0)
+        break;
+    }
+  }
+  if (mNegative)
+    digits.push_back('-');
+  std::reverse(digits.begin(), digits.end());
+  return digits;
+}
+
+BigInt BigInt::abs() const {
+  BigInt a(*this);
+  a.mNegative = false;
+  return a;
+}
+
+BigInt BigInt::operator-() const {
+  BigInt a(*this);
+  a.mNegative = !mNegative;
+  a.normalize();
+  return a;
+}
+
+BigInt operator+(const BigInt& a, const BigInt& b) {
+  BigInt sum;
+  if (a.mNegative == b.mNegative) {
+    BigInt::addMagnitude(a.mLimbs, b.mLimbs, sum.mLimbs);
+    sum.mNegative = a.mNegative;
+  } else if (BigInt::compareMagnitude(a.mLimbs, b.mLimbs) >= 0) {
+    BigInt::subtractMagnitude(a.mLimbs, b.mLimbs, sum.mLimbs);
+    sum.mNegative = a.mNegative;
+  } else {
+    BigInt::subtractMagnitude(b.mLimbs, a.mLimbs, sum.mLimbs);
+    sum.mNegative = b.mNegative;
+  }
+  sum.normalize();
+  return sum;
+}
+
+BigInt operator-(const BigInt& a, const BigInt& b) {
+  return a + -b;
+}
+
+BigInt operator*(const BigInt& a, const BigInt& b) {
+  BigInt product;
+  if (a.isZero() || b.isZero())
+    return product;
+
+  product.mLimbs.assign(a.mLimbs.size() + b.mLimbs.size(), 0);
+  for (size_t i = 0; i < a.mLimbs.size(); ++i) {
+    uint64 carry = 0;
+    for (size_t j = 0; j < b.mLimbs.size(); ++j) {
+      const uint64 t = static_cast<uint64>(a.mLimbs[i]) * b.mLimbs[j] +
+        product.mLimbs[i + j] + carry;
+      product.mLimbs[i + j] = static_cast<BigInt::Limb>(t);
+      carry = t >> 32;
+    }
+    product.mLimbs[i + b.mLimbs.size()] = static_cast<BigInt::Limb>(carry);
+  }
+  product.mNegative = a.mNegative != b.mNegative;
+  product.normalize();
+  return product;
+}
+
+void BigInt::divide(
+  const BigInt& a,
+  const BigInt& b,
+  BigInt& quotient,
+  BigInt& remainder
+) {
+  MATHICGB_ASSERT(!b.isZero());
+  if (b.isZero())
+    throw std::invalid_argument("Division by zero.");
+
+  Limbs q;
+  Limbs r;
+  divideMagnitude(a.mLimbs, b.mLimbs, q, r);
+  quotient.mLimbs.swap(q);
+  quotient.mNegative = a.mNegative != b.mNegative;
+  quotient.normalize();
+  remainder.mLimbs.swap(r);
+  remainder.mNegative = a.mNegative;
+  remainder.normalize();
+}
+
+BigInt operator/(const BigInt& a, const BigInt& b) {
+  BigInt quotient;
+  BigInt remainder;
+  BigInt::divide(a, b, quotient, remainder);
+  return quotient;
+}
+
+BigInt operator%(const BigInt& a, const BigInt& b) {
+  BigInt quotient;
+  BigInt remainder;
+  BigInt::divide(a, b, quotient, remainder);
+  return remainder;
+}
+
+uint32 BigInt::mod(uint32 modulus) const {
+  MATHICGB_ASSERT(modulus != 0);
+  uint64 rest = 0;
+  for (size_t i = mLimbs.size(); i != 0; --i)
+    rest = ((rest << 32) | mLimbs[i - 1]) % modulus;
+  if (mNegative && rest != 0)
+    rest = modulus - rest;
+  return static_cast<uint32>(rest);
+}
+
+int BigInt::compare(const BigInt& a, const BigInt& b) {
+  if (a.mNegative != b.mNegative)
+    return a.mNegative ? -1 : 1;
+  const int cmp = compareMagnitude(a.mLimbs, b.mLimbs);
+  return a.mNegative ? -cmp : cmp;
+}
+
+BigInt BigInt::gcd(BigInt a, BigInt b) {
+  a.mNegative = false;
+  b.mNegative = false;
+  while (!b.isZero()) {
+    BigInt r = a % b;
+    a.mLimbs.swap(b.mLimbs);
+    b.mLimbs.swap(r.mLimbs);
+  }
+  return a;
+}
+
+BigInt BigInt::sqrt(const BigInt& a) {
+  MATHICGB_ASSERT(!a.isNegative());
+  if (a.isZero())
+    return a;
+
+  // Newton iteration from a power of two that is at least sqrt(a). The
+  // iterates decrease until they reach the floor of the square root.
+  size_t bits = 32 * (a.mLimbs.size() - 1);
+  for (Limb top = a.mLimbs.back(); top != 0; top >>= 1)
+    ++bits;
+  const size_t shift = (bits + 1) / 2;
+  BigInt x;
+  x.mLimbs.assign(shift / 32 + 1, 0);
+  x.mLimbs.back() = Limb(1) << (shift % 32);
+
+  while (true) {
+    BigInt next = a / x;
+    next = next + x;
+    divideSmall(next.mLimbs, 2);
+    next.normalize();
+    if (next >= x)
+      return x;
+    x = std::move(next);
+  }
+}
+
+void BigInt::normalize() {
+  while (!mLimbs.empty() && mLimbs.back() == 0)
+    mLimbs.pop_back();
+  if (mLimbs.empty())
+    mNegative = false;
+}
+
+int BigInt::compareMagnitude(const Limbs& a, const Limbs& b) {
+  if (a.size() != b.size())
+    return a.size() < b.size() ? -1 : 1;
+  for (size_t i = a.size(); i != 0; --i)
+    if (a[i - 1] != b[i - 1])
+      return a[i - 1] < b[i - 1] ? -1 : 1;
+  return 0;
+}
+
+void BigInt::addMagnitude(const Limbs& a, const Limbs& b, Limbs& result) {
+  const Limbs& longer = a.size() >= b.size() ? a : b;
+  const Limbs& shorter = a.size() >= b.size() ? b : a;
+  Limbs sum(longer.size() + 1);
+  uint64 carry = 0;
+  for (size_t i = 0; i < longer.size(); ++i) {
+    carry += longer[i];
+    if (i < shorter.size())
+      carry += shorter[i];
+    sum[i] = static_cast<Limb>(carry);
+    carry >>= 32;
+  }
+  sum.back() = static_cast<Limb>(carry);
+  result.swap(sum);
+}
+
+void BigInt::subtractMagnitude(const Limbs& a, const Limbs& b, Limbs& result) {
+  MATHICGB_ASSERT(compareMagnitude(a, b) >= 0);
+  Limbs difference(a.size());
+  int64 borrow = 0;
+  for (size_t i = 0; i < a.size(); ++i) {
+    int64 t = static_cast<int64>(a[i]) - borrow;
+    if (i < b.size())
+      t -= b[i];
+    borrow = t < 0 ? 1 : 0;
+    difference[i] = static_cast<Limb>(t + (borrow << 32));
+  }
+  MATHICGB_ASSERT(borrow == 0);
+  result.swap(difference);
+}
+
+void BigInt::multiplyAddSmall(Limbs& a, Limb factor, Limb summand) {
+  uint64 carry = summand;
+  for (size_t i = 0; i < a.size(); ++i) {
+    carry += static_cast<uint64>(a[i]) * factor;
+    a[i] = static_cast<Limb>(carry);
+    carry >>= 32;
+  }
+  if (carry != 0)
+    a.push_back(static_cast<Limb>(carry));
+}
+
+auto BigInt::divideSmall(Limbs& a, Limb divisor) -> Limb {
+  MATHICGB_ASSERT(divisor != 0);
+  uint64 rest = 0;
+  for (size_t i = a.size(); i != 0; --i) {
+    rest = (rest << 32) | a[i - 1];
+    a[i - 1] = static_cast<Limb>(rest / divisor);
+    rest %= divisor;
+  }
+  while (!a.empty() && a.back() == 0)
+    a.pop_back();
+  return static_cast<Limb>(rest);
+}
+
+void BigInt::divideMagnitude(
+  const Limbs& a,
+  const Limbs& b,
+  Limbs& quotient,
+  Limbs& remainder
+) {
+  MATHICGB_ASSERT(!b.empty() && b.back() != 0);
+  if (compareMagnitude(a, b) < 0) {
+    quotient.clear();
+    remainder = a;
+    return;
+  }
+  if (b.size() == 1) {
+    quotient = a;
+    const Limb rest = divideSmall(quotient, b[0]);
+    remainder.clear();
+    if (rest != 0)
+      remainder.push_back(rest);
+    return;
+  }
+
+  // Knuth's algorithm D (TAOCP vol. 2, 4.3.1). Shift both operands so that
+  // the top limb of the divisor has its high bit set, which makes the
+  // estimate of each quotient limb off by at most 2.
+  const size_t n = b.size();
+  const size_t m = a.size() - n;
+  int shift = 0;
+  for (Limb top = b.back(); (top & 0x80000000u) == 0; top <<= 1)
+    ++shift;
+
+  Limbs v(n);
+  for (size_t i = n - 1; i != 0; --i)
+    v[i] = (b[i] << shift) |
+      (shift == 0 ? 0 : static_cast<Limb>(b[i - 1] >> (32 - shift)));
+  v[0] = b[0] << shift;
+
+  Limbs u(a.size() + 1);
+  u[a.size()] = shift == 0 ? 0 : static_cast<Limb>(a.back() >> (32 - shift));
+  for (size_t i = a.size() - 1; i != 0; --i)
+    u[i] = (a[i] << shift) |
+      (shift == 0 ? 0 : static_cast<Limb>(a[i - 1] >> (32 - shift)));
+  u[0] = a[0] << shift;
+
+  const uint64 base = uint64(1) << 32;
+  Limbs q(m + 1);
+  for (size_t j = m + 1; j != 0;) {
+    --j;
+    const uint64 top = (static_cast<uint64>(u[j + n]) << 32) | u[j + n - 1];
+    uint64 qhat = top / v[n - 1];
+    uint64 rhat = top % v[n - 1];
+    while (
+      qhat >= base ||
+      qhat * v[n - 2] > ((rhat << 32) | u[j + n - 2])
+    ) {
+      --qhat;
+      rhat += v[n - 1];
+      if (rhat >= base)
+        break;
+    }
+
+    // Subtract qhat * v from the current window of u.
+    int64 borrow = 0;
+    for (size_t i = 0; i < n; ++i) {
+      const uint64 p = qhat * v[i];
+      const int64 t = static_cast<int64>(u[i + j]) - borrow -
+        static_cast<int64>(p & 0xFFFFFFFFu);
+      u[i + j] = static_cast<Limb>(t);
+      borrow = static_cast<int64>(p >> 32) - (t >> 32);
+    }
+    const int64 t = static_cast<int64>(u[j + n]) - borrow;
+    u[j + n] = static_cast<Limb>(t);
+
+    // qhat was one too large, so add v back once.
+    if (t < 0) {
+      --qhat;
+      uint64 carry = 0;
+      for (size_t i = 0; i < n; ++i) {
+        carry += static_cast<uint64>(u[i + j]) + v[i];
+        u[i + j] = static_cast<Limb>(carry);
+        carry >>= 32;
+      }
+      u[j + n] = static_cast<Limb>(u[j + n] + carry);
+    }
+    q[j] = static_cast<Limb>(qhat);
+  }
+
+  remainder.resize(n);
+  for (size_t i = 0; i < n; ++i)
+    remainder[i] = (u[i] >> shift) |
+      (shift == 0 ? 0 : static_cast<Limb>(u[i + 1] << (32 - shift)));
+  while (!remainder.empty() && remainder.back() == 0)
+    remainder.pop_back();
+  while (!q.empty() && q.back() == 0)
+    q.pop_back();
+  quotient.swap(q);
+}
+
+MATHICGB_NAMESPACE_END
@@ -0,0 +1,122 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#ifndef MATHICGB_BIG_INT_GUARD
+#define MATHICGB_BIG_INT_GUARD
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+MATHICGB_NAMESPACE_BEGIN
+
+/// A signed integer of arbitrary size. This only implements what is needed
+/// to lift results computed modulo primes to the integers and rationals, so
+/// it uses the simple quadratic algorithms throughout.
+class BigInt {
+public:
+  typedef uint32 Limb;
+
+  BigInt(): mNegative(false) {}
+  BigInt(int64 value);
+
+  /// Parses an optional minus sign followed by one or more decimal digits.
+  /// Throws std::invalid_argument if str is not of that form.
+  static BigInt fromString(const std::string& str);
+
+  /// Returns the value in base 10.
+  std::string toString() const;
+
+  bool isZero() const {return mLimbs.empty();}
+  bool isNegative() const {return mNegative;}
+  bool isOne() const {return !mNegative && mLimbs.size() == 1 && mLimbs[0] == 1;}
+
+  BigInt abs() const;
+  BigInt operator-() const;
+
+  friend BigInt operator+(const BigInt& a, const BigInt& b);
+  friend BigInt operator-(const BigInt& a, const BigInt& b);
+  friend BigInt operator*(const BigInt& a, const BigInt& b);
+
+  /// Sets quotient and remainder such that a = quotient * b + remainder
+  /// where quotient is rounded towards zero, so the remainder has the same
+  /// sign as a. b must not be zero.
+  static void divide(
+    const BigInt& a,
+    const BigInt& b,
+    BigInt& quotient,
+    BigInt& remainder
+  );
+
+  friend BigInt operator/(const BigInt& a, const BigInt& b);
+  friend BigInt operator%(const BigInt& a, const BigInt& b);
+
+  /// Returns the residue of this number modulo modulus in the range
+  /// [0, modulus). modulus must not be zero.
+  uint32 mod(uint32 modulus) const;
+
+  /// Returns -1, 0 or 1 as a is less than, equal to or greater than b.
+  static int compare(const BigInt& a, const BigInt& b);
+
+  friend bool operator==(const BigInt& a, const BigInt& b) {
+    return compare(a, b) == 0;
+  }
+  friend bool operator!=(const BigInt& a, const BigInt& b) {
+    return compare(a, b) != 0;
+  }
+  friend bool operator<(const BigInt& a, const BigInt& b) {
+    return compare(a, b) < 0;
+  }
+  friend bool operator<=(const BigInt& a, const BigInt& b) {
+    return compare(a, b) <= 0;
+  }
+  friend bool operator>(const BigInt& a, const BigInt& b) {
+    return compare(a, b) > 0;
+  }
+  friend bool operator>=(const BigInt& a, const BigInt& b) {
+    return compare(a, b) >= 0;
+  }
+
+  /// Returns the non-negative greatest common divisor of a and b.
+  static BigInt gcd(BigInt a, BigInt b);
+
+  /// Returns the largest integer whose square is at most a. a must not be
+  /// negative.
+  static BigInt sqrt(const BigInt& a);
+
+private:
+  typedef std::vector<Limb> Limbs;
+
+  /// Removes leading zero limbs and makes zero non-negative.
+  void normalize();
+
+  static int compareMagnitude(const Limbs& a, const Limbs& b);
+  static void addMagnitude(const Limbs& a, const Limbs& b, Limbs& result);
+
+  /// a must have at least the magnitude of b.
+  static void subtractMagnitude(const Limbs& a, const Limbs& b, Limbs& result);
+
+  /// Sets a to a * factor + summand.
+  static void multiplyAddSmall(Limbs& a, Limb factor, Limb summand);
+
+  /// Divides a by divisor in place and returns the remainder.
+  static Limb divideSmall(Limbs& a, Limb divisor);
+
+  static void divideMagnitude(
+    const Limbs& a,
+    const Limbs& b,
+    Limbs& quotient,
+    Limbs& remainder
+  );
+
+  /// The magnitude in base 2^32 with the least significant limb first and
+  /// no leading zero limbs. Zero is the empty vector.
+  Limbs mLimbs;
+  bool mNegative;
+};
+
+inline std::ostream& operator<<(std::ostream& out, const BigInt& a) {
+  return out << a.toString();
+}
+
+MATHICGB_NAMESPACE_END
+#endif
@@ -5,7 +5,13 @@
 
 #include "Basis.hpp"
 #include "LogDomain.hpp"
+#include "LogDomainSet.hpp"
+#include "MemoryBudget.hpp"
+#include "MathicIO.hpp"
 #include <iostream>
+#include <algorithm>
+#include <string>
+#include <limits>
 
 MATHICGB_DEFINE_LOG_DOMAIN(
   SPairDegree,
@@ -16,45 +22,275 @@ MATHICGB_DEFINE_LOG_DOMAIN(
 MATHICGB_NAMESPACE_BEGIN
 
 ClassicGBAlg::ClassicGBAlg(
-  const Basis& basis,
+  Basis&& basis,
   Reducer& reducer,
   int divisorLookupType,
   bool preferSparseReducers,
-  size_t queueType
+  size_t queueType,
+  bool useSugar
 ):
   mCallback(0),
   mBreakAfter(0),
   mPrintInterval(0),
-  mSPairGroupSize(reducer.preferredSetSize()),
+  mSPairGroupSize(0),
   mUseAutoTopReduction(true),
   mUseAutoTailReduction(false),
+  mDegreeBound(std::numeric_limits<exponent>::max()),
   mRing(*basis.getPolyRing()),
   mReducer(reducer),
   mBasis(mRing, DivisorLookup::makeFactory(
     *basis.getPolyRing(),
     divisorLookupType)->create(preferSparseReducers, true)
   ),
-  mSPairs(mBasis, preferSparseReducers),
-  mSPolyReductionCount(0)
+  mSPairs(mBasis, preferSparseReducers, useSugar),
+  mSPolyReductionCount(0),
+  mTrace(0),
+  mTraceStep(0),
+  mTraceLeadCount(0),
+  mHilbertSeries(0),
+  mHilbertSkipCount(0),
+  mHilbertBasisSize(0),
+  mHilbertDegree(0),
+  mHilbertComplete(false)
 {
+  mBasis.setUseArena(true);
+  mBasis.setUseSugar(useSugar);
+
   // Reduce and insert the generators of the ideal into the starting basis
-  size_t const basisSize = basis.size();
-  std::vector<std::unique_ptr<Poly> > polys;
-  for (size_t gen = 0; gen != basisSize; ++gen)
-    polys.push_back(make_unique<Poly>(*basis.getPoly(gen)));
-  insertPolys(polys);
+  auto polys = basis.takeGenerators();
+  insertPolys(polys, 0);
+}
+
+ClassicGBAlg::ClassicGBAlg(
+  Basis&& groebnerBasis,
+  Basis&& generators,
+  Reducer& reducer,
+  int divisorLookupType,
+  bool preferSparseReducers,
+  size_t queueType,
+  bool useSugar
+):
+  mCallback(0),
+  mBreakAfter(0),
+  mPrintInterval(0),
+  mSPairGroupSize(0),
+  mUseAutoTopReduction(true),
+  mUseAutoTailReduction(false),
+  mDegreeBound(std::numeric_limits<exponent>::max()),
+  mRing(*groebnerBasis.getPolyRing()),
+  mReducer(reducer),
+  mBasis(mRing, DivisorLookup::makeFactory(
+    *groebnerBasis.getPolyRing(),
+    divisorLookupType)->create(preferSparseReducers, true)
+  ),
+  mSPairs(mBasis, preferSparseReducers, useSugar),
+  mSPolyReductionCount(0),
+  mTrace(0),
+  mTraceStep(0),
+  mTraceLeadCount(0),
+  mHilbertSeries(0),
+  mHilbertSkipCount(0),
+  mHilbertBasisSize(0),
+  mHilbertDegree(0),
+  mHilbertComplete(false)
+{
+  MATHICGB_ASSERT(generators.getPolyRing() == groebnerBasis.getPolyRing());
+  mBasis.setUseArena(true);
+  mBasis.setUseSugar(useSugar);
+  auto polys = groebnerBasis.takeGenerators();
+  insertGroebnerBasis(polys);
+  polys = generators.takeGenerators();
+  insertPolys(polys, 0);
 }
 
 void ClassicGBAlg::setSPairGroupSize(unsigned int groupSize) {
-  if (groupSize == 0)
-    groupSize = mReducer.preferredSetSize();
+  mSPairGroupSize = groupSize;
+}
+
+void ClassicGBAlg::setTrace(F4Trace* trace) {
+  mTrace = trace;
+  mTraceStep = 0;
+  mTraceLeadCount = 0;
+  mReducer.setTrace(trace);
+}
+
+void ClassicGBAlg::setHilbertSeries(const HilbertSeries* series) {
+  MATHICGB_ASSERT
+    (series == 0 || series->varCount() == mRing.monoid().varCount());
+  if (series != 0) {
+    // S-pairs are dropped by the degree of their lcm, which only tells
+    // what they reduce to if the ideal is homogeneous.
+    const auto& monoid = mRing.monoid();
+    for (size_t i = 0; i < mBasis.size(); ++i) {
+      if (mBasis.retired(i))
+        continue;
+      const auto& poly = mBasis.poly(i);
+      const auto degree = monoid.totalDegree(poly.getLeadMonomial());
+      for (auto it = poly.begin(); it != poly.end(); ++it) {
+        if (monoid.totalDegree(it.getMonomial()) != degree) {
+          mathic::reportError("A Hilbert series can only be used for "
+            "generators that are homogeneous with respect to total degree.");
+        }
+      }
+    }
+  }
+  mHilbertSeries = series;
+  mHilbertBasisSeries.reset();
+}
+
+bool ClassicGBAlg::hilbertComplete(const exponent degree) {
+  MATHICGB_ASSERT(mHilbertSeries != 0);
+  if (mHilbertBasisSeries.get() == 0 || mHilbertBasisSize != mBasis.size()) {
+    // Each new basis element changes the lead term ideal, while S-pairs
+    // that reduce to zero do not, so this is only recomputed for the steps
+    // that did something.
+    mHilbertBasisSeries =
+      make_unique<HilbertSeries>(HilbertSeries::fromLeadMonomials(mBasis));
+    mHilbertBasisSize = mBasis.size();
+  } else if (mHilbertDegree == degree)
+    return mHilbertComplete;
+
+  // The lead term ideal of the basis is contained in that of the ideal, so
+  // it leaves at least as many monomials outside of it.
+  const auto missing = mHilbertBasisSeries->hilbertFunction(degree) -
+    mHilbertSeries->hilbertFunction(degree);
+  if (missing.isNegative()) {
+    mathic::reportError
+      ("The Hilbert series does not match the ideal in degree " +
+        std::to_string(degree) + '.');
+  }
+  mHilbertDegree = degree;
+  mHilbertComplete = missing.isZero();
+  return mHilbertComplete;
+}
+
+void ClassicGBAlg::removeHilbertUselessPairs(
+  std::vector<std::pair<size_t, size_t> >& spairGroup
+) {
+  const auto& monoid = mRing.monoid();
+  const auto varCount = monoid.varCount();
+  auto isUseless = [&](const std::pair<size_t, size_t>& p) {
+    const auto a = mBasis.leadMonomial(p.first);
+    const auto b = mBasis.leadMonomial(p.second);
+    exponent degree = 0;
+    for (size_t var = 0; var < varCount; ++var) {
+      degree += std::max(
+        monoid.externalExponent(a, var),
+        monoid.externalExponent(b, var)
+      );
+    }
+    return hilbertComplete(degree);
+  };
+  const auto oldSize = spairGroup.size();
+  spairGroup.erase(
+    std::remove_if(spairGroup.begin(), spairGroup.end(), isUseless),
+    spairGroup.end()
+  );
+  mHilbertSkipCount += oldSize - spairGroup.size();
+}
+
+void ClassicGBAlg::insertIntoBasis(
+  std::unique_ptr<Poly> poly,
+  const exponent sugar
+) {
+  MATHICGB_ASSERT(poly.get() != 0);
+  MATHICGB_ASSERT(!poly->isZero());
+  if (mTrace != 0) {
+    const auto& monoid = mRing.monoid();
+    const auto varCount = monoid.varCount();
+    const auto lead = poly->getLeadMonomial();
+    if (mTrace->learning()) {
+      for (size_t var = 0; var < varCount; ++var)
+        mTrace->leadExponents.push_back(monoid.externalExponent(lead, var));
+    } else {
+      const auto offset = mTraceLeadCount * varCount;
+      if (offset + varCount > mTrace->leadExponents.size())
+        throw F4Trace::Mismatch();
+      for (size_t var = 0; var < varCount; ++var)
+        if (monoid.externalExponent(lead, var) !=
+          mTrace->leadExponents[offset + var])
+          throw F4Trace::Mismatch();
+    }
+    ++mTraceLeadCount;
+  }
+  mBasis.insert(std::move(poly), sugar);
+}
+
+void ClassicGBAlg::addPairs(const size_t newGenBegin, const size_t newGenEnd) {
+  if (!replaying())
+    mSPairs.addPairs(newGenBegin, newGenEnd);
+}
+
+bool ClassicGBAlg::hasPendingSPairs() const {
+  if (replaying())
+    return mTraceStep < mTrace->steps.size();
   else
-    mSPairGroupSize = groupSize;
+    return !mSPairs.empty();
 }
 
-void ClassicGBAlg::insertPolys
-(std::vector<std::unique_ptr<Poly> >& polynomials)
-{
+exponent ClassicGBAlg::completeDegree() const {
+  if (!hasPendingSPairs())
+    return std::numeric_limits<exponent>::max();
+  const auto w = replaying() ?
+    mTrace->steps[mTraceStep].degree : mSPairs.nextWeight();
+  // The S-pairs are processed in ascending order of degree, so everything
+  // below the degree of the next S-pair is done.
+  return mSPairs.weightDegree(w) - 1;
+}
+
+void ClassicGBAlg::writeState(std::ostream& out) const {
+  size_t count = 0;
+  for (size_t i = 0; i < mBasis.size(); ++i)
+    if (!mBasis.retired(i))
+      ++count;
+  out << count << '\n';
+  for (size_t i = 0; i < mBasis.size(); ++i) {
+    if (mBasis.retired(i))
+      continue;
+    out << ' ' << mBasis.sugar(i) << ' ';
+    MathicIO<>().writePoly(mBasis.poly(i), false, out);
+    out << '\n';
+  }
+  if (hasPendingSPairs())
+    out << completeDegree() << '\n';
+  else
+    out << "complete\n";
+}
+
+void ClassicGBAlg::readState(Scanner& in) {
+  MATHICGB_ASSERT(mBasis.size() == 0);
+  const auto polyCount = in.readInteger<size_t>();
+  for (size_t i = 0; i < polyCount; ++i) {
+    const auto sugar = in.readInteger<exponent>();
+    auto poly = make_unique<Poly>(MathicIO<>().readPoly(mRing, false, in));
+    poly->sortTermsDescending();
+    insertIntoBasis(std::move(poly), sugar);
+  }
+  if (in.match("complete")) {
+    mSPairs.addReducedPairs(0, mBasis.size());
+    return;
+  }
+
+  // The computation that wrote the state processed all of the S-pairs
+  // of degree at most degree, so those are popped here without reducing
+  // them. The others are the S-pairs that were pending.
+  const auto degree = in.readInteger<exponent>();
+  addPairs(0, mBasis.size());
+  std::vector<std::pair<size_t, size_t>> done;
+  while (
+    !mSPairs.empty() &&
+    mSPairs.weightDegree(mSPairs.nextWeight()) <= degree
+  )
+    mSPairs.popFirstDegree(done);
+}
+
+void ClassicGBAlg::insertPolys(
+  std::vector<std::unique_ptr<Poly> >& polynomials,
+  const exponent sugar
+) {
+  // The S-pairs of the new basis elements are added in one batch at the
+  // end so that the S-pair elimination criteria get to see all of them.
+  const size_t newGenBegin = mBasis.size();
   if (!mUseAutoTopReduction) {
     for (auto it = polynomials.begin(); it != polynomials.end(); ++it) {
       MATHICGB_ASSERT(it->get() != 0);
@@ -66,10 +302,10 @@ void ClassicGBAlg::insertPolys
           continue;
       }
 
-      mBasis.insert(std::move(*it));
-      mSPairs.addPairs(mBasis.size() - 1);
+      insertIntoBasis(std::move(*it), sugar);
     }
     polynomials.clear();
+    addPairs(newGenBegin, mBasis.size());
     return;
   }
 
@@ -95,9 +331,9 @@ void ClassicGBAlg::insertPolys
       if (mBasis.divisor((*it)->getLeadMonomial()) != static_cast<size_t>(-1))
         toReduce.push_back(std::move(*it));
       else {
-        mBasis.insert(std::move(*it));
+        insertIntoBasis(std::move(*it), sugar);
         MATHICGB_ASSERT(toRetire.empty());
-        mSPairs.addPairsAssumeAutoReduce(mBasis.size() - 1, toRetire);
+        mSPairs.findMultiplesToRetire(mBasis.size() - 1, toRetire);
         for (auto r = toRetire.begin(); r != toRetire.end(); ++r)
           toReduce.push_back(mBasis.retire(*r));
         toRetire.clear();
@@ -116,6 +352,36 @@ void ClassicGBAlg::insertPolys
   MATHICGB_ASSERT(toRetire.empty());
   MATHICGB_ASSERT(toInsert.empty());
   MATHICGB_ASSERT(toReduce.empty());
+
+  addPairs(newGenBegin, mBasis.size());
+}
+
+void ClassicGBAlg::insertGroebnerBasis(
+  std::vector<std::unique_ptr<Poly> >& groebnerBasis
+) {
+  // The polynomials are inserted in the order they are given in so that a
+  // basis that is extended by nothing comes back out the same way.
+  const size_t newGenBegin = mBasis.size();
+  std::vector<size_t> toRetire;
+  for (auto it = groebnerBasis.begin(); it != groebnerBasis.end(); ++it) {
+    MATHICGB_ASSERT(it->get() != 0);
+    if ((*it)->isZero())
+      continue;
+    if (mBasis.divisor((*it)->getLeadMonomial()) != static_cast<size_t>(-1))
+      continue;
+    insertIntoBasis(std::move(*it), 0);
+
+    // A basis element whose lead monomial is a multiple of the new one is
+    // not needed for a Groebner basis, so it can go without reducing it.
+    MATHICGB_ASSERT(toRetire.empty());
+    mSPairs.findMultiplesToRetire(mBasis.size() - 1, toRetire);
+    for (auto r = toRetire.begin(); r != toRetire.end(); ++r)
+      mBasis.retire(*r);
+    toRetire.clear();
+  }
+  groebnerBasis.clear();
+  if (!replaying())
+    mSPairs.addReducedPairs(newGenBegin, mBasis.size());
 }
 
 void ClassicGBAlg::insertReducedPoly(
@@ -143,8 +409,8 @@ void ClassicGBAlg::insertReducedPoly(
 
   if (!mUseAutoTopReduction) {
     size_t const newGen = mBasis.size();
-    mBasis.insert(std::move(polyToInsert));
-    mSPairs.addPairs(newGen);
+    insertIntoBasis(std::move(polyToInsert), 0);
+    addPairs(newGen, newGen + 1);
     return;
   }
 
@@ -180,13 +446,14 @@ void ClassicGBAlg::insertReducedPoly(
         if (reduced->isZero())
           continue;
         reduced->makeMonic(); 
-        mBasis.insert(std::move(reduced));
+        insertIntoBasis(std::move(reduced), 0);
       }
 
       // form S-pairs and retire basis elements that become top reducible.
       const size_t newGen = mBasis.size() - 1;
       MATHICGB_ASSERT(toRetireAndReduce.empty());
-      mSPairs.addPairsAssumeAutoReduce(newGen, toRetireAndReduce);
+      mSPairs.findMultiplesToRetire(newGen, toRetireAndReduce);
+      addPairs(newGen, newGen + 1);
       for (std::vector<size_t>::const_iterator it = toRetireAndReduce.begin();
         it != toRetireAndReduce.end(); ++it) {
         toReduce.push_back(0); // allocate space in vector before .release()
@@ -211,9 +478,11 @@ void ClassicGBAlg::computeGrobnerBasis() {
   if (mUseAutoTailReduction)
     autoTailReduce();
 
-  while (!mSPairs.empty()) {
+  while (hasPendingSPairs()) {
     if (mCallback != 0 && !mCallback->call())
       break;
+    if (completeDegree() >= mDegreeBound)
+      break;
 
     step();
     if (mBreakAfter != 0 && mBasis.size() > mBreakAfter) {
@@ -225,6 +494,13 @@ void ClassicGBAlg::computeGrobnerBasis() {
     if (mPrintInterval != 0 && (++counter % mPrintInterval) == 0)
       printStats(std::cerr);
   }
+  if (
+    replaying() &&
+    mTraceStep == mTrace->steps.size() &&
+    mTraceLeadCount * mRing.monoid().varCount() !=
+      mTrace->leadExponents.size()
+  )
+    throw F4Trace::Mismatch();
   //printStats(std::cerr);
   //mReducer->dump();
   /*
@@ -236,36 +512,92 @@ void ClassicGBAlg::computeGrobnerBasis() {
 }
 
 void ClassicGBAlg::step() {
-  MATHICGB_ASSERT(!mSPairs.empty());
+  MATHICGB_ASSERT(hasPendingSPairs());
   if (tracingLevel > 30)
     std::cerr << "Determining next S-pair" << std::endl;
 
-  MATHICGB_ASSERT(mSPairGroupSize >= 1);
   std::vector<std::pair<size_t, size_t> > spairGroup;
   exponent w = 0;
-  for (unsigned int i = 0; i < mSPairGroupSize; ++i) {
-    auto p = mSPairs.pop(w);
-    if (p.first == static_cast<size_t>(-1)) {
-      MATHICGB_ASSERT(p.second == static_cast<size_t>(-1));
-      break; // no more S-pairs
+  if (replaying()) {
+    MATHICGB_ASSERT(mTraceStep < mTrace->steps.size());
+    const auto& traceStep = mTrace->steps[mTraceStep];
+    ++mTraceStep;
+    const auto end = traceStep.sPairs.end();
+    for (auto it = traceStep.sPairs.begin(); it != end; ++it) {
+      if (
+        it->first >= mBasis.size() || mBasis.retired(it->first) ||
+        it->second >= mBasis.size() || mBasis.retired(it->second)
+      )
+        throw F4Trace::Mismatch();
+    }
+    spairGroup = traceStep.sPairs;
+    w = traceStep.degree;
+  } else if (
+    mSPairGroupSize == 0 &&
+    mReducer.preferredSetSize() > 1 &&
+    !mReducer.adaptiveSetSize() &&
+    mSPairs.hasDegrees()
+  ) {
+    // Hand all the S-pairs of the same degree to the reducer at once
+    // instead of splitting them up between several reductions. Without
+    // degrees that would be all of the S-pairs, so then they are popped in
+    // groups of preferredSetSize() below instead. With a degree bound, do
+    // not go on to the next degree if all of the S-pairs of this degree are
+    // useless, since that degree may be beyond the bound.
+    if (mDegreeBound != std::numeric_limits<exponent>::max())
+      w = mSPairs.popFirstDegree(spairGroup);
+    else
+      w = mSPairs.popDegree(spairGroup);
+  } else {
+    const unsigned int groupSize = mSPairGroupSize != 0 ?
+      mSPairGroupSize : mReducer.preferredSetSize();
+    MATHICGB_ASSERT(groupSize >= 1);
+    if (mDegreeBound != std::numeric_limits<exponent>::max())
+      w = mSPairs.nextWeight(); // stay in the degree checked by the caller
+    for (unsigned int i = 0; i < groupSize; ++i) {
+      auto p = mSPairs.pop(w);
+      if (p.first == static_cast<size_t>(-1)) {
+        MATHICGB_ASSERT(p.second == static_cast<size_t>(-1));
+        break; // no more S-pairs
+      }
+      MATHICGB_ASSERT(p.first != static_cast<size_t>(-1));
+      MATHICGB_ASSERT(p.second != static_cast<size_t>(-1));
+      MATHICGB_ASSERT(!mBasis.retired(p.first));
+      MATHICGB_ASSERT(!mBasis.retired(p.second));
+
+      spairGroup.push_back(p);
     }
-    MATHICGB_ASSERT(p.first != static_cast<size_t>(-1));
-    MATHICGB_ASSERT(p.second != static_cast<size_t>(-1));
-    MATHICGB_ASSERT(!mBasis.retired(p.first));
-    MATHICGB_ASSERT(!mBasis.retired(p.second));
-    
-    spairGroup.push_back(p);
   }
+  if (mHilbertSeries != 0 && !replaying())
+    removeHilbertUselessPairs(spairGroup);
   if (spairGroup.empty())
-    return; // no more s-pairs
+    return; // no more s-pairs or all of them were useless
+  if (learning()) {
+    mTrace->steps.push_back(F4Trace::Step());
+    mTrace->steps.back().sPairs = spairGroup;
+    mTrace->steps.back().degree = w;
+  }
   std::vector<std::unique_ptr<Poly>> reduced;
 
-  // w is the negative of the degree of the lcm's of the chosen spairs
-  MATHICGB_LOG(SPairDegree) <<
-    spairGroup.size() << " pairs in degree " << -w << std::endl;
+  // w is the weight of the chosen spairs as for SPairs::pop(w)
+  MATHICGB_LOG(SPairDegree) << spairGroup.size() <<
+    (mSPairs.useSugar() ? " pairs of sugar " : " pairs in degree ") <<
+    mSPairs.weightDegree(w) << std::endl;
 
   mReducer.classicReduceSPolySet(spairGroup, mBasis, reduced);
 
+  auto& logs = LogDomainSet::singleton();
+  if (logs.tracing()) {
+    LogDomainSet::TraceArgs args;
+    args.push_back(std::make_pair("degree",
+      static_cast<double>(mSPairs.weightDegree(w))));
+    args.push_back(std::make_pair("pairs",
+      static_cast<double>(spairGroup.size())));
+    args.push_back(std::make_pair("nonZero",
+      static_cast<double>(reduced.size())));
+    logs.recordTraceEvent("SPairs", 'i', std::move(args));
+  }
+
   // sort the elements to get deterministic behavior. The order will change
   // arbitrarily when running multithreaded. Also, if preferring older
   // reducers, it is of benefit to break ties by preferring the sparser
@@ -303,7 +635,8 @@ void ClassicGBAlg::step() {
   };
   std::sort(reduced.begin(), reduced.end(), order);
   
-  insertPolys(reduced);
+  // The sugar of a reduced S-polynomial is the sugar of the S-pair.
+  insertPolys(reduced, mSPairs.useSugar() ? w : 0);
   if (mUseAutoTailReduction)
     autoTailReduce();
 }
@@ -334,7 +667,11 @@ void ClassicGBAlg::printStats(std::ostream& out) const {
   out << " divisor tab type:   " << mBasis.divisorLookup().getName() << '\n';
   out << " S-pair queue type:  " << mSPairs.name() << '\n';
   out << " total compute time: " << mTimer.getMilliseconds()/1000.0 << " seconds " << '\n';
-  out << " S-pair group size:  " << mSPairGroupSize << '\n';
+  out << " S-pair group size:  ";
+  if (mSPairGroupSize == 0)
+    out << "automatic\n";
+  else
+    out << mSPairGroupSize << '\n';
 
   mic::ColumnPrinter pr;
   pr.addColumn(true, " ");
@@ -379,6 +716,15 @@ void ClassicGBAlg::printStats(std::ostream& out) const {
   extra << mic::ColumnPrinter::percentInteger(timeSinceLastMinLead, basisSize)
         << " of basis added since then\n";
 
+  const auto& budget = MemoryBudget::singleton();
+  name << "Peak tracked memory:\n";
+  value << mic::ColumnPrinter::bytesInUnit(budget.peak()) << '\n';
+  if (budget.hasBudget())
+    extra << mic::ColumnPrinter::percentInteger(budget.peak(), budget.budget())
+      << " of memory budget\n";
+  else
+    extra << '\n';
+
   const unsigned long long considered =
     mBasis.size() * (mBasis.size() - 1) / 2;
   name << "S-pairs considered:\n";
@@ -395,6 +741,12 @@ void ClassicGBAlg::printStats(std::ostream& out) const {
   value << mic::ColumnPrinter::commafy(reductions) << '\n';
   extra << '\n';
 
+  if (mHilbertSeries != 0) {
+    name << "Hilbert sp eliminated:\n";
+    value << mic::ColumnPrinter::commafy(mHilbertSkipCount) << '\n';
+    extra << '\n';
+  }
+
   Reducer::Stats reducerStats = mReducer.sigStats();
   SPairs::Stats sPairStats = mSPairs.stats();
 
@@ -471,6 +823,13 @@ void ClassicGBAlg::printStats(std::ostream& out) const {
     " of remaining S-pairs\n";
   marginal -= simpleHits;
 
+  unsigned long long const sameLcmHits = sPairStats.sameLcmHits;
+  name << "Same lcm hits:\n";
+  value << mic::ColumnPrinter::commafy(sameLcmHits) << '\n';
+  extra << mic::ColumnPrinter::percentInteger(sameLcmHits, marginal) <<
+    " of remaining S-pairs\n";
+  marginal -= sameLcmHits;
+
   unsigned long long const simpleHitsLate = sPairStats.buchbergerLcmSimpleHitsLate;
   name << "Buchb late lcm simple hits:\n";
   value << mic::ColumnPrinter::commafy(simpleHitsLate) << '\n';
@@ -519,6 +878,11 @@ void ClassicGBAlg::printMemoryUse(std::ostream& out) const
     name << "Grobner basis:\n";
     value << mic::ColumnPrinter::bytesInUnit(basisMem) << '\n';
     extra << mic::ColumnPrinter::percentInteger(basisMem, total) << '\n';
+
+    const size_t unusedMem = mBasis.getUnusedMemory();
+    name << "  of which unused:\n";
+    value << mic::ColumnPrinter::bytesInUnit(unusedMem) << '\n';
+    extra << mic::ColumnPrinter::percentInteger(unusedMem, basisMem) << '\n';
   }
   { // Spairs
     const size_t sPairMem = mSPairs.getMemoryUse();
@@ -547,6 +911,26 @@ void ClassicGBAlg::printMemoryUse(std::ostream& out) const
   value << mic::ColumnPrinter::bytesInUnit(total) << "\n";
   extra << "\n";
 
+  // The memory above is what is held now. MemoryBudget also sees the
+  // memory that is only held for a while, like the F4 matrices.
+  const auto& budget = MemoryBudget::singleton();
+  name << "\nPeak of tracked memory:\n";
+  value << "\n\n";
+  extra << "\n\n";
+  for (size_t i = 0; i < MemoryBudget::CategoryCount; ++i) {
+    const auto category = static_cast<MemoryBudget::Category>(i);
+    name << "  " << MemoryBudget::categoryName(category) << ":\n";
+    value << mic::ColumnPrinter::bytesInUnit(budget.peak(category)) << '\n';
+    extra << '\n';
+  }
+  name << "  all together:\n";
+  value << mic::ColumnPrinter::bytesInUnit(budget.peak()) << '\n';
+  if (budget.hasBudget())
+    extra << mic::ColumnPrinter::percentInteger(budget.peak(), budget.budget())
+      << " of budget\n";
+  else
+    extra << '\n';
+
   out << "*** Memory use by component ***\n" << pr << std::flush;
 }
 
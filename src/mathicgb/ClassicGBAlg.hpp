@@ -6,6 +6,8 @@
 #include "Reducer.hpp"
 #include "SPairs.hpp"
 #include "PolyBasis.hpp"
+#include "F4Trace.hpp"
+#include "HilbertSeries.hpp"
 #include <mathic.h>
 #include <memory>
 #include <ostream>
@@ -14,21 +16,77 @@
 MATHICGB_NAMESPACE_BEGIN
 
 class Basis;
+class Scanner;
 
 /// Calculates a classic Grobner basis using Buchberger's algorithm.
 class ClassicGBAlg {
 public:
+  /// The polynomials of basis are moved into the algorithm, so basis is
+  /// empty afterwards. If useSugar is true then S-pairs are selected
+  /// according to the sugar strategy. See SPairs.
   ClassicGBAlg(
-    const Basis& basis,
+    Basis&& basis,
     Reducer& reducer,
     int divisorLookupType,
     bool preferSparseReducers,
-    size_t queueType
+    size_t queueType,
+    bool useSugar
+  );
+
+  /// As the other constructor, but starts from groebnerBasis, which must
+  /// be a Groebner basis, and then adds the polynomials of generators to
+  /// it. The S-pairs between elements of groebnerBasis are known to reduce
+  /// to zero, so only the S-pairs that involve new basis elements get
+  /// reduced. That makes extending a Groebner basis by a few generators
+  /// much cheaper than computing the basis from scratch. Both groebnerBasis
+  /// and generators are empty afterwards.
+  ClassicGBAlg(
+    Basis&& groebnerBasis,
+    Basis&& generators,
+    Reducer& reducer,
+    int divisorLookupType,
+    bool preferSparseReducers,
+    size_t queueType,
+    bool useSugar
   );
 
   // Replaces the current basis with a Grobner basis of the same ideal.
   void computeGrobnerBasis();
 
+  /// Makes computeGrobnerBasis() stop once all the S-pairs of degree at
+  /// most degree have been processed, leaving the S-pairs of higher degree
+  /// pending. See SPairs::weightDegree for what the degree of an S-pair
+  /// is, so the bound has no effect for orders without a grading unless
+  /// using sugar. For homogeneous input the basis is then a Groebner basis
+  /// up to degree. Calling computeGrobnerBasis() again, usually after
+  /// raising the bound, continues where the computation stopped without
+  /// redoing any work. The default is no bound, which is also what the
+  /// largest value of exponent means.
+  void setDegreeBound(exponent degree) {mDegreeBound = degree;}
+
+  /// Returns true if there are more S-pairs to reduce, so that the basis is
+  /// not yet known to be a Groebner basis.
+  bool hasPendingSPairs() const;
+
+  /// Returns the largest degree d such that all S-pairs of degree at most
+  /// d have been processed. Returns the largest value of exponent if there
+  /// are no pending S-pairs.
+  exponent completeDegree() const;
+
+  /// Writes the basis elements that are not retired along with their sugar
+  /// and completeDegree(), which is the state that is needed to continue
+  /// the computation later by readState().
+  void writeState(std::ostream& out) const;
+
+  /// Reads a state written by writeState() into the basis. The pairs of
+  /// degree at most the complete degree of the state are recorded as done
+  /// and the rest become pending, so computeGrobnerBasis() then continues
+  /// from where the computation that wrote the state stopped. The basis
+  /// must be empty, so construct the algorithm from an empty Basis, and
+  /// the ring and the sugar setting must be the same as those of the
+  /// computation that wrote the state.
+  void readState(Scanner& in);
+
   // How many S-pairs were not eliminated before reduction of the
   // corresponding S-polynomial.
   unsigned long long sPolyReductionCount() const {return mSPolyReductionCount;}
@@ -52,7 +110,9 @@ public:
   }
 
   /// A value of zero means to let the algorithm decide a reasonable
-  /// value based on the other settings.
+  /// value based on the other settings. For a reducer that prefers to
+  /// do more than one reduction at a time, that means to reduce all the
+  /// S-pairs of the minimal degree together.
   void setSPairGroupSize(unsigned int groupSize);
 
   void setReducerMemoryQuantum(size_t memoryQuantum) {
@@ -67,6 +127,31 @@ public:
     mUseAutoTailReduction = value;
   }
 
+  /// Records the computation into trace if trace is learning and otherwise
+  /// replays the computation from trace, which then throws
+  /// F4Trace::Mismatch if the computation turns out to be different. The
+  /// trace is also passed on to the reducer. A null trace turns tracing
+  /// off. The generators inserted by the constructor are not part of the
+  /// trace, so a trace should be replayed on a basis of the same shape as
+  /// the one it was learned from.
+  void setTrace(F4Trace* trace);
+
+  /// Uses series, which must be the Hilbert series of the ideal, to skip
+  /// S-pairs. The generators must be homogeneous with respect to total
+  /// degree. Once the lead monomials of the basis leave as many monomials
+  /// of degree d outside the lead term ideal as series says there are, the
+  /// basis is complete in degree d and every S-polynomial of degree d
+  /// reduces to zero, so the S-pairs of degree d are dropped without
+  /// reducing them. The Hilbert series can be computed from a basis of the
+  /// same ideal modulo another prime or for another monomial order. series
+  /// is not copied and a null series turns this off, which is the default.
+  /// Throws if the generators are not homogeneous and if series turns out
+  /// to be wrong in a degree.
+  void setHilbertSeries(const HilbertSeries* series);
+
+  /// Returns how many S-pairs were dropped because of the Hilbert series.
+  unsigned long long hilbertSkipCount() const {return mHilbertSkipCount;}
+
   class Callback {
   public:
     /// Stop the computation if call return false.
@@ -84,6 +169,7 @@ private:
   unsigned int mSPairGroupSize;
   bool mUseAutoTopReduction;
   bool mUseAutoTailReduction;
+  exponent mDegreeBound;
 
   // Perform a step of the algorithm.
   void step();
@@ -92,8 +178,39 @@ private:
 
   void insertReducedPoly(std::unique_ptr<Poly> poly);
 
-  // clears polynomials.
-  void insertPolys(std::vector<std::unique_ptr<Poly> >& polynomials);
+  // Inserts poly into the basis and records or checks its lead monomial
+  // if tracing.
+  void insertIntoBasis(std::unique_ptr<Poly> poly, exponent sugar);
+
+  // Adds the S-pairs of basis elements [newGenBegin, newGenEnd) unless
+  // replaying a trace, since then the S-pairs come from the trace.
+  void addPairs(size_t newGenBegin, size_t newGenEnd);
+
+  bool learning() const {return mTrace != 0 && mTrace->learning();}
+  bool replaying() const {return mTrace != 0 && !mTrace->learning();}
+
+  // Removes the S-pairs of a degree that the basis is complete in
+  // according to the Hilbert series.
+  void removeHilbertUselessPairs
+    (std::vector<std::pair<size_t, size_t> >& spairGroup);
+
+  // Returns true if the lead monomials of the basis span the degree part
+  // of the lead term ideal according to the Hilbert series.
+  bool hilbertComplete(exponent degree);
+
+  // Inserts the polynomials into the basis and then adds the S-pairs for
+  // all of the new basis elements in one batch. Clears polynomials. The
+  // sugar of the new basis elements is at least sugar.
+  void insertPolys(
+    std::vector<std::unique_ptr<Poly> >& polynomials,
+    exponent sugar
+  );
+
+  // Inserts the polynomials of a Groebner basis into the basis without
+  // adding their S-pairs. Polynomials that are zero or whose lead monomial
+  // is a multiple of that of another polynomial are left out. Clears
+  // groebnerBasis.
+  void insertGroebnerBasis(std::vector<std::unique_ptr<Poly> >& groebnerBasis);
 
   const PolyRing& mRing;
   Reducer& mReducer;
@@ -101,6 +218,20 @@ private:
   SPairs mSPairs;
   mic::Timer mTimer;
   unsigned long long mSPolyReductionCount;
+  F4Trace* mTrace;
+  size_t mTraceStep; // index of the next step to replay
+  size_t mTraceLeadCount; // number of lead monomials recorded or checked
+
+  const HilbertSeries* mHilbertSeries;
+  unsigned long long mHilbertSkipCount;
+
+  // The Hilbert series of the lead monomials of the basis when it had
+  // mHilbertBasisSize elements, and whether it agreed with mHilbertSeries
+  // in degree mHilbertDegree.
+  std::unique_ptr<HilbertSeries> mHilbertBasisSeries;
+  size_t mHilbertBasisSize;
+  exponent mHilbertDegree;
+  bool mHilbertComplete;
 };
 
 MATHICGB_NAMESPACE_END
@@ -6,6 +6,9 @@
 #include "SigPolyBasis.hpp"
 #include "DivisorLookup.hpp"
 #include "PolyRing.hpp"
+#include "Atomic.hpp"
+#include "mtbb.hpp"
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -184,6 +187,9 @@ public:
   bool getMinimizeOnInsert() const {return _minimize_on_insert;}
 
   bool getDoAutomaticRebuilds() const {return _useAutomaticRebuild;}
+  void setDoAutomaticRebuilds(bool value) {
+    _useAutomaticRebuild = value && UseDivMask;
+  }
   double getRebuildRatio() const {return _rebuildRatio;}
   size_t getRebuildMin() const {return _minRebuild;}
 
@@ -226,7 +232,7 @@ private:
   const bool _minimize_on_insert;
   const bool _sortOnInsert;
   const bool _useDivisorCache;
-  const bool _useAutomaticRebuild;
+  bool _useAutomaticRebuild;
   const double _rebuildRatio;
   const size_t _minRebuild;
   mutable unsigned long long _expQueryCount;
@@ -243,91 +249,112 @@ class DivLookup : public DivisorLookup {
   typedef typename Finder::Configuration Configuration;
   typedef Configuration C;
 
-  DivLookup(const Configuration &C) :
-        _finder(C)
+  /// If C asks for automatic rebuilds then those are done by this class
+  /// rather than by Finder. Finder rebuilds synchronously in the middle of
+  /// an insert, which for a large basis causes a pause proportional to the
+  /// size of the basis. Instead, a new Finder is built from a copy of the
+  /// entries as a background task while queries and updates keep going to
+  /// the current Finder. The new Finder is swapped in once it is done.
+  DivLookup(const Configuration &C):
+    _finder(make_unique<Finder>(C)),
+    mBackgroundRebuild(C.getDoAutomaticRebuilds()),
+    mRebuilding(false),
+    mRebuildDone(false),
+    mInsertsSinceRebuild(0),
+    mSizeAtRebuild(0)
   {
     MATHICGB_ASSERT(!C.UseTreeDivMask || C.UseDivMask);
+    _finder->getConfiguration().setDoAutomaticRebuilds(false);
   }
 
-  ~DivLookup() {}
+  ~DivLookup() {
+    if (mRebuilding)
+      mRebuildTasks.wait();
+  }
 
   virtual void setBasis(const PolyBasis& basis) {
-    _finder.getConfiguration().setBasis(basis);
+    MATHICGB_ASSERT(!mRebuilding);
+    _finder->getConfiguration().setBasis(basis);
   }
 
   virtual void setSigBasis(const SigPolyBasis& sigBasis) {
-    _finder.getConfiguration().setSigBasis(sigBasis);
+    MATHICGB_ASSERT(!mRebuilding);
+    _finder->getConfiguration().setSigBasis(sigBasis);
   }
 
 
-  virtual int type() const {return _finder.getConfiguration().type();}
+  virtual int type() const {return _finder->getConfiguration().type();}
 
   virtual void lowBaseDivisors(
     std::vector<size_t>& divisors,
     size_t maxDivisors,
     size_t newGenerator
   ) const {
-    const SigPolyBasis* GB = _finder.getConfiguration().sigBasis();
+    const SigPolyBasis* GB = _finder->getConfiguration().sigBasis();
 
     const_monomial sigNew = GB->getSignature(newGenerator);
 
     MATHICGB_ASSERT(newGenerator < GB->size());
     LowBaseDivisor searchObject(*GB, divisors, maxDivisors, newGenerator);
-    _finder.findAllDivisors(sigNew, searchObject);
+    _finder->findAllDivisors(sigNew, searchObject);
   }
 
   virtual size_t highBaseDivisor(size_t newGenerator) const {
-    const SigPolyBasis* basis = _finder.getConfiguration().sigBasis();
+    const SigPolyBasis* basis = _finder->getConfiguration().sigBasis();
     MATHICGB_ASSERT(newGenerator < basis->size());
 
     HighBaseDivisor searchObject(*basis, newGenerator);
-    _finder.findAllDivisors
+    _finder->findAllDivisors
       (basis->getLeadMonomial(newGenerator), searchObject);
     return searchObject.highDivisor();
   }
 
   virtual size_t minimalLeadInSig(const_monomial sig) const {
-    MinimalLeadInSig searchObject(*_finder.getConfiguration().sigBasis());
-    _finder.findAllDivisors(sig, searchObject);
+    MinimalLeadInSig searchObject(*_finder->getConfiguration().sigBasis());
+    _finder->findAllDivisors(sig, searchObject);
     return searchObject.minLeadGen();
   }
 
   virtual size_t classicReducer(const_monomial mon) const {
-    const auto& conf = _finder.getConfiguration();
+    const auto& conf = _finder->getConfiguration();
     ClassicReducer searchObject(*conf.basis(), conf.preferSparseReducers());
-    _finder.findAllDivisors(mon, searchObject);
+    _finder->findAllDivisors(mon, searchObject);
     return searchObject.reducer();
   }
 
   virtual size_t divisor(const_monomial mon) const {
-    const Entry* entry = _finder.findDivisor(mon);
+    const Entry* entry = _finder->findDivisor(mon);
     return entry == 0 ? static_cast<size_t>(-1) : entry->index;
   }
 
   virtual void divisors(const_monomial mon, EntryOutput& consumer) const {
     PassOn out(consumer);
-    _finder.findAllDivisors(mon, out);
+    _finder->findAllDivisors(mon, out);
   }
 
   virtual void multiples(const_monomial mon, EntryOutput& consumer) const {
     PassOn out(consumer);
-    _finder.findAllMultiples(mon, out);
+    _finder->findAllMultiples(mon, out);
   }
 
   virtual void removeMultiples(const_monomial mon) {
-    _finder.removeMultiples(mon);
+    _finder->removeMultiples(mon);
+    if (mRebuilding)
+      recordRemoval(mon, true);
   }
 
   virtual void remove(const_monomial mon) {
-    _finder.removeElement(mon);
+    _finder->removeElement(mon);
+    if (mRebuilding)
+      recordRemoval(mon, false);
   }
 
   virtual size_t size() const {
-    return _finder.size();
+    return _finder->size();
   }
 
-  const C& getConfiguration() const {return _finder.getConfiguration();}
-  C& getConfiguration() {return _finder.getConfiguration();}
+  const C& getConfiguration() const {return _finder->getConfiguration();}
+  C& getConfiguration() {return _finder->getConfiguration();}
 
   std::string getName() const;
   const PolyRing * getPolyRing() const { return getConfiguration().getPolyRing(); }
@@ -566,7 +593,23 @@ private:
 
 public:
   virtual void insert(const_monomial mon, size_t val) {
-        _finder.insert(Entry(mon, val));
+    _finder->insert(Entry(mon, val));
+    if (!mBackgroundRebuild)
+      return;
+
+    ++mInsertsSinceRebuild;
+    if (mRebuilding) {
+      mInsertedDuringRebuild.push_back(Entry(mon, val));
+      // If the task has not finished by the time the next rebuild would be
+      // due, then wait for it. Without worker threads that is also where
+      // the task runs.
+      if (
+        mRebuildDone.load(std::memory_order_acquire) ||
+        mInsertsSinceRebuild >= rebuildThreshold()
+      )
+        finishRebuild();
+    } else if (mInsertsSinceRebuild >= rebuildThreshold())
+      startRebuild();
   }
 
   virtual size_t regularReducer(const_monomial sig, const_monomial mon) const
@@ -577,32 +620,175 @@ public:
       mon,
       getConfiguration().preferSparseReducers()
     );
-    _finder.findAllDivisors(mon, out);
+    _finder->findAllDivisors(mon, out);
     return out.reducer();
   }
 
   unsigned long long getExpQueryCount() const {
-    return _finder.getConfiguration().getExpQueryCount();
+    return _finder->getConfiguration().getExpQueryCount();
   }
 
-  size_t n_elems() const { return _finder.size(); }
+  size_t n_elems() const { return _finder->size(); }
 
   void display(std::ostream &o, int level) const;  /**TODO: WRITE ME */
   void dump(int level) const; /**TODO: WRITE ME */
  private:
-  Finder _finder;
+  // A removal done while a rebuild was running. The monomial is at
+  // mRemovedMonomials.data() + offset since the original may be gone by
+  // the time the removal is replayed on the rebuilt Finder.
+  struct Removal {
+    size_t offset;
+    bool multiples;
+  };
+
+  // Used to copy out the entries of a Finder.
+  class CopyEntries {
+  public:
+    CopyEntries(std::vector<Entry>& entries): mEntries(entries) {}
+    bool proceed(const Entry& entry) {
+      mEntries.push_back(entry);
+      return true;
+    }
+  private:
+    std::vector<Entry>& mEntries;
+  };
+
+  size_t rebuildThreshold() const {
+    const auto& conf = getConfiguration();
+    const auto byRatio =
+      static_cast<size_t>(conf.getRebuildRatio() * mSizeAtRebuild);
+    return std::max<size_t>(1, std::max(conf.getRebuildMin(), byRatio));
+  }
+
+  // Takes a snapshot of the entries and builds a new Finder from it in
+  // the background. The monomials are copied so that the task does not
+  // read basis memory that may be freed while it runs.
+  void startRebuild() {
+    MATHICGB_ASSERT(!mRebuilding);
+    const size_t monoSize = getPolyRing()->maxMonomialSize();
+
+    mRebuildEntries.clear();
+    mRebuildEntries.reserve(_finder->size());
+    CopyEntries copier(mRebuildEntries);
+    _finder->forAll(copier);
+
+    mRebuildMonomials.resize(mRebuildEntries.size() * monoSize);
+    for (size_t i = 0; i < mRebuildEntries.size(); ++i) {
+      exponent* copy = mRebuildMonomials.data() + i * monoSize;
+      const exponent* original =
+        mRebuildEntries[i].monom.unsafeGetRepresentation();
+      std::copy(original, original + monoSize, copy);
+      mRebuildEntries[i].monom = copy;
+    }
+
+    // Let Finder do its own rebuilds while building up the new structure.
+    // That only ever happens on the background task.
+    Configuration conf(getConfiguration());
+    conf.setDoAutomaticRebuilds(true);
+    mRebuilt = make_unique<Finder>(conf);
+
+    mRebuilding = true;
+    mRebuildDone.store(false, std::memory_order_relaxed);
+    mInsertsSinceRebuild = 0;
+    mSizeAtRebuild = mRebuildEntries.size();
+    mRebuildTasks.run([this]() {
+      mRebuilt->insert(mRebuildEntries.begin(), mRebuildEntries.end());
+      mRebuildDone.store(true, std::memory_order_release);
+    });
+  }
+
+  // Waits for the rebuild task, brings the new Finder up to date with the
+  // updates done since the snapshot and then swaps it in.
+  void finishRebuild() {
+    MATHICGB_ASSERT(mRebuilding);
+    mRebuildTasks.wait();
+
+    for (auto it = mRemovals.begin(); it != mRemovals.end(); ++it) {
+      const_monomial mon = mRemovedMonomials.data() + it->offset;
+      if (it->multiples)
+        mRebuilt->removeMultiples(mon);
+      else
+        mRebuilt->removeElement(mon);
+    }
+    for (auto it = mInsertedDuringRebuild.begin();
+      it != mInsertedDuringRebuild.end(); ++it)
+      mRebuilt->insert(*it);
+    mRebuilt->getConfiguration().setDoAutomaticRebuilds(false);
+    MATHICGB_ASSERT(mRebuilt->size() == _finder->size());
+
+    std::swap(_finder, mRebuilt);
+    mMonomials.swap(mRebuildMonomials);
+    mRebuilt.reset();
+    mRebuildMonomials.clear();
+    mRebuildEntries.clear();
+    mInsertedDuringRebuild.clear();
+    mRemovals.clear();
+    mRemovedMonomials.clear();
+    mRebuilding = false;
+  }
+
+  // Removals are applied to the entries inserted since the snapshot right
+  // away, while their monomials are still valid. Removals from the
+  // snapshot are replayed on the rebuilt Finder in finishRebuild().
+  void recordRemoval(const_monomial mon, bool multiples) {
+    MATHICGB_ASSERT(mRebuilding);
+    const auto& conf = getConfiguration();
+    const auto removed = [&](const Entry& entry) {
+      return conf.divides(mon, entry) && (multiples || conf.divides(entry, mon));
+    };
+    mInsertedDuringRebuild.erase(
+      std::remove_if(
+        mInsertedDuringRebuild.begin(),
+        mInsertedDuringRebuild.end(),
+        removed
+      ),
+      mInsertedDuringRebuild.end()
+    );
+
+    Removal removal;
+    removal.offset = mRemovedMonomials.size();
+    removal.multiples = multiples;
+    const size_t monoSize = getPolyRing()->maxMonomialSize();
+    const exponent* original = mon.unsafeGetRepresentation();
+    mRemovedMonomials.insert
+      (mRemovedMonomials.end(), original, original + monoSize);
+    mRemovals.push_back(removal);
+  }
+
+  std::unique_ptr<Finder> _finder;
+
+  // Copies of monomials that entries of _finder point to. These come from
+  // the snapshot of the last completed rebuild.
+  std::vector<exponent> mMonomials;
+
+  const bool mBackgroundRebuild;
+  bool mRebuilding;
+  Atomic<bool> mRebuildDone;
+  size_t mInsertsSinceRebuild;
+  size_t mSizeAtRebuild;
+
+  // State of the rebuild in progress, if any.
+  std::unique_ptr<Finder> mRebuilt;
+  std::vector<Entry> mRebuildEntries;
+  std::vector<exponent> mRebuildMonomials;
+  std::vector<Entry> mInsertedDuringRebuild;
+  std::vector<Removal> mRemovals;
+  std::vector<exponent> mRemovedMonomials;
+  mtbb::task_group mRebuildTasks;
 };
 
 template<typename C>
 inline std::string DivLookup<C>::getName() const {
-  return "DL " + _finder.getName();
+  return "DL " + _finder->getName();
 }
 
 template<typename C>
 size_t DivLookup<C>::getMemoryUse() const
 {
 //#warning "implement getMemoryUse for DivLookup"
-  return 4 * sizeof(void *) * _finder.size();  // NOT CORRECT!!
+  return 4 * sizeof(void *) * _finder->size() +  // NOT CORRECT!!
+    (mMonomials.capacity() + mRebuildMonomials.capacity() +
+      mRemovedMonomials.capacity()) * sizeof(exponent);
 }
 
 MATHICGB_NAMESPACE_END
@@ -16,6 +16,12 @@ MATHICGB_DEFINE_LOG_DOMAIN(
   "Displays row and column count for each F4 matrix construction."
 );
 
+MATHICGB_DEFINE_LOG_DOMAIN(
+  F4MatrixBuildTerms,
+  "Counts the terms of the rows of F4 matrices, each of which requires a "
+  "column lookup."
+);
+
 MATHICGB_NAMESPACE_BEGIN
 
 MATHICGB_NO_INLINE
@@ -106,6 +112,16 @@ void F4MatrixBuilder2::addPolynomialToMatrix(const Poly& poly) {
   mTodo.push_back(task);
 }
 
+void F4MatrixBuilder2::addPolynomialToMatrixAsBottomRow(const Poly& poly) {
+  if (poly.isZero())
+    return;
+
+  // The row gets the coefficients of poly as its external scalars, which
+  // is how the projection recognizes the row.
+  addPolynomialToMatrix(poly);
+  mBottomRowScalars.push_back(poly.coefficientBegin());
+}
+
 void F4MatrixBuilder2::addPolynomialToMatrix
 (const_monomial multiple, const Poly& poly) {
   if (poly.isZero())
@@ -120,13 +136,21 @@ void F4MatrixBuilder2::addPolynomialToMatrix
   mTodo.push_back(task);
 }
 
-void F4MatrixBuilder2::buildMatrixAndClear(QuadMatrix& quadMatrix) {
+void F4MatrixBuilder2::buildMatrixAndClear(
+  QuadMatrix& quadMatrix,
+  F4MatrixProjection::Origin* origin
+) {
   MATHICGB_LOG_TIME(F4MatrixBuild2) <<
     "\n***** Constructing matrix *****\n";
 
   if (mTodo.empty()) {
     quadMatrix = QuadMatrix();
     quadMatrix.ring = &ring();
+    if (origin != 0) {
+      *origin = F4MatrixProjection::Origin();
+      origin->topRowCount = 0;
+      origin->rowBegins.assign(1, 0);
+    }
     return;
   }
 
@@ -217,6 +241,8 @@ void F4MatrixBuilder2::buildMatrixAndClear(QuadMatrix& quadMatrix) {
   {
     auto& data = threadData.local();
     const auto& poly = *task.poly;
+    MATHICGB_LOG_INCREMENT_BY(F4MatrixBuildTerms, poly.termCount() +
+      (task.sPairPoly == 0 ? 0 : task.sPairPoly->termCount()));
 
     // It is perfectly permissible for task.sPairPoly to be non-null. The
     // assert is there because of an interaction between S-pair
@@ -280,7 +306,9 @@ void F4MatrixBuilder2::buildMatrixAndClear(QuadMatrix& quadMatrix) {
     projection.addColumn(p.first, p.second, mIsColumnToLeft[p.first]);
   }
 
-  quadMatrix = projection.makeAndClear(mMemoryQuantum);
+  projection.setBottomRows(std::move(mBottomRowScalars));
+  mBottomRowScalars.clear();
+  quadMatrix = projection.makeAndClear(mMemoryQuantum, origin);
   threadData.clear();
 
   MATHICGB_LOG(F4MatrixSizes) 
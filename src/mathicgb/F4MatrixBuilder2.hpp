@@ -10,6 +10,7 @@
 #include "QuadMatrix.hpp"
 #include "MonomialMap.hpp"
 #include "F4ProtoMatrix.hpp"
+#include "F4MatrixProjection.hpp"
 #include "mtbb.hpp"
 #include <vector>
 
@@ -52,6 +53,14 @@ public:
   /// identity.
   void addPolynomialToMatrix(const Poly& poly);
 
+  /// As addPolynomialToMatrix(poly) except that the row of poly is always
+  /// a bottom row. These bottom rows come first in the order that they
+  /// were added, so after reducing the bottom rows by the top rows, the
+  /// bottom right part of a row is the normal form of its polynomial. A
+  /// zero polynomial does not get a row. The same polynomial must not be
+  /// added twice.
+  void addPolynomialToMatrixAsBottomRow(const Poly& poly);
+
   /** Builds an F4 matrix to the specifications given. Also clears the
     information in this object.
 
@@ -65,8 +74,14 @@ public:
     no guarantee that the bottom part of the matrix contains rows that
     exactly correspond to the polynomials that have been scheduled to
     be added to the matrix. It is only guaranteed that the whole matrix has
-    the same row-space as though that had been the case. */
-  void buildMatrixAndClear(QuadMatrix& matrix);
+    the same row-space as though that had been the case.
+
+    If origin is not null then it is set to describe where the rows and
+    columns of the matrix came from. */
+  void buildMatrixAndClear(
+    QuadMatrix& matrix,
+    F4MatrixProjection::Origin* origin = 0
+  );
 
   const PolyRing& ring() const {return mBasis.ring();}
 
@@ -141,6 +156,7 @@ private:
   const PolyBasis& mBasis;
   Map mMap;
   std::vector<RowTask> mTodo;
+  std::vector<const F4ProtoMatrix::ExternalScalar*> mBottomRowScalars;
 };
 
 MATHICGB_NAMESPACE_END
@@ -4,6 +4,8 @@
 #include "F4MatrixProjection.hpp"
 
 #include "ScopeExit.hpp"
+#include <unordered_map>
+#include <algorithm>
 
 MATHICGB_NAMESPACE_BEGIN
 
@@ -105,6 +107,18 @@ public:
   const RowVector& top() const {return mTopRows;}
   const RowVector& bottom() const {return mBottomRows;}
 
+  /// Sorts the bottom rows by the index that rowOrder assigns to them.
+  template<class RowOrder>
+  void sortBottom(RowOrder rowOrder) {
+    std::stable_sort(
+      mBottomRows.begin(),
+      mBottomRows.end(),
+      [&](const RowMultiple& a, const RowMultiple& b) {
+        return rowOrder(a.first) < rowOrder(b.first);
+      }
+    );
+  }
+
   RowVector moveTop() {return mTopRows;}
   RowVector moveBottom() {return mBottomRows;}
 
@@ -222,14 +236,46 @@ private:
   SparseMatrix mRight;
 };
 
-QuadMatrix F4MatrixProjection::makeAndClear(const size_t quantum) {
+QuadMatrix F4MatrixProjection::makeAndClear(
+  const size_t quantum,
+  Origin* origin
+) {
   if (true)
-    return makeAndClearOneStep(quantum);
-  else
+    return makeAndClearOneStep(quantum, origin);
+  else {
+    MATHICGB_ASSERT(origin == 0); // not supported
+    MATHICGB_ASSERT(mBottomRowScalars.empty()); // not supported
     return makeAndClearTwoStep(quantum);
+  }
 }
 
-QuadMatrix F4MatrixProjection::makeAndClearOneStep(const size_t quantum) {
+namespace {
+  template<class RowVector>
+  void recordOrigin(
+    const RowVector& rows,
+    F4MatrixProjection::Origin& origin
+  ) {
+    const auto end = rows.end();
+    for (auto it = rows.begin(); it != end; ++it) {
+      const auto& row = it->first;
+      origin.rowScalars.push_back(row.externalScalars);
+      origin.indices.insert
+        (origin.indices.end(), row.indices, row.indices + row.entryCount);
+      origin.rowBegins.push_back(origin.indices.size());
+    }
+  }
+}
+
+QuadMatrix F4MatrixProjection::makeAndClearOneStep(
+  const size_t quantum,
+  Origin* origin
+) {
+  // The position of each of the rows that have to be bottom rows.
+  typedef F4ProtoMatrix::ExternalScalar ExternalScalar;
+  std::unordered_map<const ExternalScalar*, size_t> bottomRowIndex;
+  for (size_t i = 0; i < mBottomRowScalars.size(); ++i)
+    bottomRowIndex[mBottomRowScalars[i]] = i;
+
   // Construct top/bottom row permutation
    TopBottom<F4ProtoMatrix::Row> tb(mLeftMonomials.size(), ring());
   const auto end = mMatrices.end();
@@ -240,6 +286,14 @@ QuadMatrix F4MatrixProjection::makeAndClearOneStep(const size_t quantum) {
       const auto& row = matrix.row(r); // const ref keeps temporary alive
       if (row.entryCount == 0)
         continue; // ignore zero rows
+      if (
+        !bottomRowIndex.empty() &&
+        row.externalScalars != 0 &&
+        bottomRowIndex.count(row.externalScalars) != 0
+      ) {
+        tb.addRow(row, std::numeric_limits<ColIndex>::max(), 0);
+        continue;
+      }
 
       // *** Look for leading left entry
       ColIndex lead = 0;
@@ -260,6 +314,22 @@ done:;
     }
   }
   MATHICGB_ASSERT(tb.debugAssertValid());
+  if (!bottomRowIndex.empty()) {
+    tb.sortBottom([&](const F4ProtoMatrix::Row& row) {
+      const auto it = bottomRowIndex.find(row.externalScalars);
+      return it == bottomRowIndex.end() ? mBottomRowScalars.size() : it->second;
+    });
+  }
+
+  if (origin != 0) {
+    origin->columns = mColProjectTo;
+    origin->topRowCount = static_cast<RowIndex>(tb.top().size());
+    origin->rowScalars.clear();
+    origin->rowBegins.assign(1, 0);
+    origin->indices.clear();
+    recordOrigin(tb.top(), *origin);
+    recordOrigin(tb.bottom(), *origin);
+  }
 
   // Split left/right and top/bottom simultaneously
   LeftRight top(mColProjectTo, ring(), quantum);
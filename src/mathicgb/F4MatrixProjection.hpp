@@ -18,6 +18,30 @@ public:
   typedef SparseMatrix::ColIndex ColIndex;
   typedef SparseMatrix::Scalar Scalar;
 
+  // This is for projection of columns
+  struct ColProjectTo {
+    ColIndex index;
+    bool isLeft;
+  };
+
+  /// Describes where the rows and columns of a matrix from makeAndClear
+  /// came from, so that the same matrix can be made again without the
+  /// proto matrices.
+  struct Origin {
+    /// Column i of the proto matrices became column columns[i].
+    std::vector<ColProjectTo> columns;
+
+    /// The top rows come first and then the bottom rows, in the order
+    /// that they have in the matrix. Row i has the column indices from
+    /// rowBegins[i] to rowBegins[i + 1] in indices, which are columns of
+    /// the proto matrices. rowScalars[i] are the external scalars of the
+    /// row, or null if the row has its own scalars.
+    RowIndex topRowCount;
+    std::vector<const F4ProtoMatrix::ExternalScalar*> rowScalars;
+    std::vector<size_t> rowBegins;
+    std::vector<ColIndex> indices;
+  };
+
   F4MatrixProjection(const PolyRing& ring, ColIndex colCount);
 
   void addProtoMatrix(F4ProtoMatrix&& matrix) {mMatrices.push_back(&matrix);}
@@ -25,12 +49,22 @@ public:
   // No reference to mono is retained.
   void addColumn(ColIndex index, const_monomial mono, const bool isLeft);
 
-  QuadMatrix makeAndClear(const size_t quantum);
+  /// The rows with external scalars in scalars become bottom rows even if
+  /// they could have been top rows. They come before any other bottom rows
+  /// and they are in the same order as their scalars are in scalars.
+  void setBottomRows(
+    std::vector<const F4ProtoMatrix::ExternalScalar*> scalars
+  ) {
+    mBottomRowScalars = std::move(scalars);
+  }
+
+  /// If origin is not null then it is set to describe the returned matrix.
+  QuadMatrix makeAndClear(const size_t quantum, Origin* origin = 0);
 
   const PolyRing& ring() const {return mRing;}
 
 private:
-  QuadMatrix makeAndClearOneStep(const size_t quantum);
+  QuadMatrix makeAndClearOneStep(const size_t quantum, Origin* origin);
   QuadMatrix makeAndClearTwoStep(const size_t quantum);
 
   // Utility class for building a left/right projection.
@@ -40,14 +74,10 @@ private:
   template<class Row>
   class TopBottom;
 
-  // This is for projection of columns
-  struct ColProjectTo {
-    ColIndex index;
-    bool isLeft;
-  };
   std::vector<ColProjectTo> mColProjectTo;
 
   std::vector<F4ProtoMatrix*> mMatrices;
+  std::vector<const F4ProtoMatrix::ExternalScalar*> mBottomRowScalars;
   std::vector<monomial> mLeftMonomials;
   std::vector<monomial> mRightMonomials;
   const PolyRing& mRing;
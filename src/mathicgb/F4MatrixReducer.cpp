@@ -7,6 +7,7 @@
 #include "SparseMatrix.hpp"
 #include "PolyRing.hpp"
 #include "LogDomain.hpp"
+#include "MemoryBudget.hpp"
 #include "mtbb.hpp"
 #include <algorithm>
 #include <vector>
@@ -31,9 +32,17 @@ MATHICGB_DEFINE_LOG_DOMAIN(
   "Displays time to reduce the bottom right submatrix of each F4 matrix."
 );
 
+MATHICGB_DEFINE_LOG_DOMAIN(
+  F4RowAdditions,
+  "Counts the additions of a multiple of a sparse row to a dense row "
+  "while reducing F4 matrices."
+);
+
 MATHICGB_NAMESPACE_BEGIN
 
 namespace {
+  typedef F4MatrixReducer::Field Field;
+
   class DenseRow {
   public:
     typedef uint16 Scalar;
@@ -56,20 +65,41 @@ namespace {
       sum += a;
     }
 
-    Scalar modulusOf(ScalarProductSum x, Scalar modulus) {
-      return static_cast<Scalar>(x % modulus);
+    static Scalar modulusOf(ScalarProductSum x, const Field& field) {
+      return field.reduce(x).value();
+    }
+
+    DenseRow(): mReportedBytes(0) {}
+    DenseRow(size_t colCount): mEntries(colCount), mReportedBytes(0) {
+      reportMemoryUse();
+    }
+
+    DenseRow(const DenseRow& row):
+      mEntries(row.mEntries),
+      mReportedBytes(0)
+    {
+      reportMemoryUse();
+    }
+
+    DenseRow(DenseRow&& row):
+      mEntries(std::move(row.mEntries)),
+      mReportedBytes(row.mReportedBytes)
+    {
+      row.mReportedBytes = 0;
     }
 
-    DenseRow() {}
-    DenseRow(size_t colCount): mEntries(colCount) {}
+    ~DenseRow() {
+      MemoryBudget::singleton().freed
+        (MemoryBudget::DenseRows, mReportedBytes);
+    }
 
     /// returns false if all entries are zero
-    bool takeModulus(const SparseMatrix::Scalar modulus) {
+    bool takeModulus(const Field& field) {
       ScalarProductSum bitwiseOr = 0; // bitwise or of all entries after modulus
       const auto end = mEntries.end();
       for (auto it = mEntries.begin(); it != end; ++it) {
-        if (*it >= modulus)
-          *it = modulusOf(*it, modulus);
+        if (*it >= field.charac())
+          *it = modulusOf(*it, field);
         bitwiseOr |= *it;
       }
       return bitwiseOr != 0;
@@ -81,6 +111,7 @@ namespace {
     void clear(size_t colCount = 0) {
       mEntries.clear();
       mEntries.resize(colCount);
+      reportMemoryUse();
     }
 
     ScalarProductSum& operator[](size_t col) {
@@ -95,19 +126,19 @@ namespace {
 
     void appendTo(SparseMatrix& matrix) {matrix.appendRow(mEntries);}
 
-    void makeUnitary(const SparseMatrix::Scalar modulus, const size_t lead) {
+    void makeUnitary(const Field& field, const size_t lead) {
       MATHICGB_ASSERT(lead < colCount());
       MATHICGB_ASSERT(mEntries[lead] != 0);
 
       const auto end = mEntries.end();
       auto it = mEntries.begin() + lead;
-      const auto toInvert = static_cast<SparseMatrix::Scalar>(*it % modulus);
-      const auto multiply = modularInverse(toInvert, modulus);
+      const auto toInvert = field.reduce(*it);
+      const auto multiply = field.inverse(toInvert);
       *it = 1;
       for (++it; it != end; ++it) {
-        const auto entry = modulusOf(*it, modulus);
-        if (entry != 0)
-          *it = modulusOf(product(entry, multiply), modulus);
+        const auto entry = field.reduce(*it);
+        if (!field.isZero(entry))
+          *it = field.product(entry, multiply).value();
         else
           *it = 0;
       }
@@ -168,32 +199,50 @@ namespace {
     void rowReduceByUnitary(
       const SparseMatrix::RowIndex pivotRow,
       const SparseMatrix& matrix,
-      const SparseMatrix::Scalar modulus
+      const Field& field
     ) {
       MATHICGB_ASSERT(matrix.rowBegin(pivotRow).scalar() == 1); // unitary
-      MATHICGB_ASSERT(modulus > 1);
+      MATHICGB_ASSERT(field.charac() > 1);
 
       auto begin = matrix.rowBegin(pivotRow);
       const auto col = begin.index();
-      const auto entry = modulusOf(mEntries[col], modulus);
+      const auto entry = field.reduce(mEntries[col]);
       mEntries[col] = 0;
-      if (entry == 0)
+      if (field.isZero(entry))
         return;
       ++begin; // can skip first entry as we just set it to zero.
       addRowMultiple(
-        modularNegativeNonZero(entry, modulus),
+        field.negativeNonZero(entry).value(),
         begin,
         matrix.rowEnd(pivotRow)
       );
     }
 
   private:
+    void operator=(const DenseRow&); // not available
+
+    /// Tells MemoryBudget about the change in the capacity of mEntries
+    /// since the last report.
+    void reportMemoryUse() {
+      const auto bytes = mEntries.capacity() * sizeof(ScalarProductSum);
+      auto& budget = MemoryBudget::singleton();
+      if (bytes > mReportedBytes)
+        budget.allocated(MemoryBudget::DenseRows, bytes - mReportedBytes);
+      else if (bytes < mReportedBytes)
+        budget.freed(MemoryBudget::DenseRows, mReportedBytes - bytes);
+      mReportedBytes = bytes;
+    }
+
     std::vector<ScalarProductSum> mEntries;
+    size_t mReportedBytes;
   };
 
+  /// If sourceRows is not null then the bottom row of qm that each row of
+  /// the returned matrix came from is appended to it.
   SparseMatrix reduce(
     const QuadMatrix& qm,
-    SparseMatrix::Scalar modulus
+    const Field& field,
+    std::vector<SparseMatrix::RowIndex>* sourceRows
   ) {
     const SparseMatrix& toReduceLeft = qm.bottomLeft;
     const SparseMatrix& toReduceRight = qm.bottomRight;
@@ -246,6 +295,7 @@ namespace {
       [&](const mgb::mtbb::blocked_range<SparseMatrix::RowIndex>& range)
     {
       auto& denseRow = denseRowPerThread.local();
+      size_t additions = 0;
       for (auto it = range.begin(); it != range.end(); ++it) {
         const auto row = it;
         denseRow.clear(leftColCount);
@@ -255,11 +305,11 @@ namespace {
         for  (size_t pivot = 0; pivot < pivotCount; ++pivot) {
           if (denseRow[pivot] != 0) {
             auto entry = denseRow[pivot];
-            entry %= modulus;
+            entry = DenseRow::modulusOf(entry, field);
             if (entry == 0) {
               denseRow[pivot] = 0;
             } else {
-              entry = modulus - entry;
+              entry = field.charac() - entry;
               const auto row = rowThatReducesCol[pivot];
               MATHICGB_ASSERT(row < pivotCount);
               MATHICGB_ASSERT(!reduceByLeft.emptyRow(row));
@@ -270,6 +320,7 @@ namespace {
                 ++reduceByLeft.rowBegin(row),
                 reduceByLeft.rowEnd(row)
               );
+              ++additions;
               denseRow[pivot] = entry;
             }
           }
@@ -283,6 +334,7 @@ namespace {
         tmp.rowDone();
         rowOrder[tmp.rowCount() - 1] = row;
       }
+      MATHICGB_LOG_INCREMENT_BY(F4RowAdditions, additions);
     });
 
     mgb::mtbb::parallel_for(mgb::mtbb::blocked_range<SparseMatrix::RowIndex>(0, rowCount),
@@ -297,6 +349,7 @@ namespace {
       denseRow.addRow(toReduceRight, row);
       auto it = tmp.rowBegin(i);
       const auto end = tmp.rowEnd(i);
+      MATHICGB_LOG_INCREMENT_BY(F4RowAdditions, end - it);
       for (; it != end; ++it) {
         const auto begin = reduceByRight.rowBegin(it.index());
         const auto end = reduceByRight.rowEnd(it.index());
@@ -307,21 +360,27 @@ namespace {
       bool zero = true;
 	  for (SparseMatrix::ColIndex col = 0; col < rightColCount; ++col) {
         const auto entry =
-          static_cast<SparseMatrix::Scalar>(denseRow[col] % modulus);
+          DenseRow::modulusOf(denseRow[col], field);
         if (entry != 0) {
           reduced.appendEntry(col, entry);
           zero = false;
         }
       }
-      if (!zero)
+      if (!zero) {
         reduced.rowDone();
+        if (sourceRows != 0)
+          sourceRows->push_back(row);
+      }
     }});
     return std::move(reduced);
   }
 
+  /// If pivotRows is not null then the rows of toReduce that became pivots
+  /// are appended to it. The other rows reduced to zero.
   SparseMatrix reduceToEchelonFormSparse(
     const SparseMatrix& toReduce,
-    const SparseMatrix::Scalar modulus
+    const Field& field,
+    std::vector<SparseMatrix::RowIndex>* pivotRows
   ) {
     const auto colCount = toReduce.computeColCount();
 
@@ -346,7 +405,7 @@ namespace {
         for (; leadingCol < colCount; ++leadingCol) {
           auto& entry = rowToReduce[leadingCol];
           if (entry != 0) {
-            entry %= modulus;
+            entry = DenseRow::modulusOf(entry, field);
             if (entry != 0)
               break;
           }
@@ -355,12 +414,14 @@ namespace {
           break; // The row has been reduced to zero.
         const auto pivotRow = pivotRowOfCol[leadingCol];
         if (pivotRow == noRow) { // If the row is a new pivot.
-          rowToReduce.makeUnitary(modulus, leadingCol);
+          rowToReduce.makeUnitary(field, leadingCol);
           pivotRowOfCol[leadingCol] = pivots.rowCount();
           rowToReduce.appendTo(pivots);
+          if (pivotRows != 0)
+            pivotRows->push_back(row);
           break;
         }
-        rowToReduce.rowReduceByUnitary(pivotRow, pivots, modulus);
+        rowToReduce.rowReduceByUnitary(pivotRow, pivots, field);
       }
     }
 
@@ -383,13 +444,13 @@ namespace {
         auto& entry = rowToReduce[col];
         if (entry == 0)
           continue;
-        entry %= modulus;
+        entry = DenseRow::modulusOf(entry, field);
         if (entry == 0)
           continue;
         const auto pivotRow = pivotRowOfCol[col];
         if (pivotRow != noRow)
-          rowToReduce.rowReduceByUnitary(pivotRow, reduced, modulus);
-        MATHICGB_ASSERT(entry < modulus);
+          rowToReduce.rowReduceByUnitary(pivotRow, reduced, field);
+        MATHICGB_ASSERT(entry < field.charac());
       }
       pivotRowOfCol[pivotCol] = reduced.rowCount();
       rowToReduce.appendTo(reduced);
@@ -397,9 +458,11 @@ namespace {
     return std::move(reduced);
   }
 
+  /// As reduceToEchelonFormSparse.
   SparseMatrix reduceToEchelonForm(
     const SparseMatrix& toReduce,
-    const SparseMatrix::Scalar modulus
+    const Field& field,
+    std::vector<SparseMatrix::RowIndex>* pivotRows
   ) {
     const auto colCount = toReduce.computeColCount();
     const auto rowCount = toReduce.rowCount();
@@ -452,18 +515,21 @@ namespace {
           continue;
 
         // reduce by each row of reduced.
+        size_t additions = 0;
         for (SparseMatrix::RowIndex reducerRow = 0; reducerRow < reducerCount; ++reducerRow) {
           const auto col = reduced.rowBegin(reducerRow).index();
           if (denseRow[col] == 0 || (isPivotRow[row] && col == leadCols[row]))
             continue;
-          denseRow.rowReduceByUnitary(reducerRow, reduced, modulus);
+          denseRow.rowReduceByUnitary(reducerRow, reduced, field);
+          ++additions;
         }
+        MATHICGB_LOG_INCREMENT_BY(F4RowAdditions, additions);
 
         // update leadCols[row]
         SparseMatrix::ColIndex col;
         MATHICGB_ASSERT(leadCols[row] <= colCount);
         for (col = leadCols[row]; col < colCount; ++col) {
-          denseRow[col] %= modulus;
+          denseRow[col] = DenseRow::modulusOf(denseRow[col], field);
           if (denseRow[col] != 0)
             break;
         }
@@ -485,7 +551,7 @@ namespace {
             }
           }
           if (isNewReducer)
-            denseRow.makeUnitary(modulus, col);
+            denseRow.makeUnitary(field, col);
         }
       }});
       //std::cout << "done reducing that batch" << std::endl;
@@ -513,7 +579,7 @@ namespace {
       {for (auto it = range.begin(); it != range.end(); ++it)
     {
       const size_t row = it;
-      dense[row].takeModulus(modulus);
+      dense[row].takeModulus(field);
     }});
 
 #ifdef MATHICGB_DEBUG
@@ -546,9 +612,13 @@ namespace {
 #endif
 
     reduced.clear();
-    for (size_t row = 0; row < rowCount; ++row)
-      if (!dense[row].empty())
+    for (SparseMatrix::RowIndex row = 0; row < rowCount; ++row) {
+      if (!dense[row].empty()) {
         dense[row].appendTo(reduced);
+        if (pivotRows != 0)
+          pivotRows->push_back(row);
+      }
+    }
     return std::move(reduced);
   }
 }
@@ -766,6 +836,20 @@ SparseMatrix reduceToEchelonFormShrawanDelayedModulus(
 }
 
 SparseMatrix F4MatrixReducer::reduceToBottomRight(const QuadMatrix& matrix) {
+  return reduceToBottomRightInternal(matrix, 0);
+}
+
+SparseMatrix F4MatrixReducer::reduceToBottomRight(
+  const QuadMatrix& matrix,
+  std::vector<SparseMatrix::RowIndex>& sourceRows
+) {
+  return reduceToBottomRightInternal(matrix, &sourceRows);
+}
+
+SparseMatrix F4MatrixReducer::reduceToBottomRightInternal(
+  const QuadMatrix& matrix,
+  std::vector<SparseMatrix::RowIndex>* sourceRows
+) {
   MATHICGB_ASSERT(matrix.debugAssertValid());
   MATHICGB_LOG_TIME(F4MatReduceTop);
   MATHICGB_LOG_TIME(F4MatrixReduce) <<
@@ -773,11 +857,18 @@ SparseMatrix F4MatrixReducer::reduceToBottomRight(const QuadMatrix& matrix) {
   MATHICGB_IF_STREAM_LOG(F4MatrixReduce)
     {matrix.printStatistics(log.stream());};
 
-  return reduce(matrix, mModulus);
+  return reduce(matrix, mField, sourceRows);
 }
 
 SparseMatrix F4MatrixReducer::reducedRowEchelonForm(
   const SparseMatrix& matrix
+) {
+  return reducedRowEchelonForm(matrix, 0);
+}
+
+SparseMatrix F4MatrixReducer::reducedRowEchelonForm(
+  const SparseMatrix& matrix,
+  std::vector<SparseMatrix::RowIndex>* pivotRows
 ) {
   MATHICGB_LOG_TIME(F4RedBottomRight);
   MATHICGB_LOG_TIME(F4MatrixReduce) <<
@@ -788,18 +879,22 @@ SparseMatrix F4MatrixReducer::reducedRowEchelonForm(
   const bool useShrawan = false;
   const bool useDelayedModulus = false;
   if (useShrawan) {
+    // These do not keep track of pivots, so report every row as useful.
+    if (pivotRows != 0)
+      for (SparseMatrix::RowIndex row = 0; row < matrix.rowCount(); ++row)
+        pivotRows->push_back(row);
     if (useDelayedModulus)
-      return reduceToEchelonFormShrawanDelayedModulus(matrix, mModulus);
+      return reduceToEchelonFormShrawanDelayedModulus(matrix, mField.charac());
     else    
-      return reduceToEchelonFormShrawan(matrix, mModulus);
+      return reduceToEchelonFormShrawan(matrix, mField.charac());
   } else {
     // todo: actually do some work to determine a good way to determine
     // when to use the sparse method, or alternatively make some some
     // sort of hybrid.
     if (matrix.computeDensity() < 0.02)
-      return reduceToEchelonFormSparse(matrix, mModulus);
+      return reduceToEchelonFormSparse(matrix, mField, pivotRows);
     else
-      return reduceToEchelonForm(matrix, mModulus);
+      return reduceToEchelonForm(matrix, mField, pivotRows);
   }
 }
 
@@ -809,6 +904,24 @@ SparseMatrix F4MatrixReducer::reducedRowEchelonFormBottomRight(
   return reducedRowEchelonForm(reduceToBottomRight(matrix));
 }
 
+SparseMatrix F4MatrixReducer::reducedRowEchelonFormBottomRight(
+  const QuadMatrix& matrix,
+  std::vector<SparseMatrix::RowIndex>& usefulBottomRows
+) {
+  std::vector<SparseMatrix::RowIndex> sourceRows;
+  std::vector<SparseMatrix::RowIndex> pivotRows;
+  auto reduced = reducedRowEchelonForm
+    (reduceToBottomRight(matrix, sourceRows), &pivotRows);
+
+  usefulBottomRows.clear();
+  for (auto it = pivotRows.begin(); it != pivotRows.end(); ++it) {
+    MATHICGB_ASSERT(*it < sourceRows.size());
+    usefulBottomRows.push_back(sourceRows[*it]);
+  }
+  std::sort(usefulBottomRows.begin(), usefulBottomRows.end());
+  return std::move(reduced);
+}
+
 namespace {
   /// this has to be a separate function that returns the scalar since signed
   /// overflow is undefine behavior so we cannot check after the cast and
@@ -826,6 +939,6 @@ namespace {
 }
 
 F4MatrixReducer::F4MatrixReducer(const coefficient modulus):
-  mModulus(checkModulus(modulus)) {}
+  mField(checkModulus(modulus)) {}
 
 MATHICGB_NAMESPACE_END
@@ -4,6 +4,7 @@
 #define MATHICGB_F4_MATRIX_REDUCER_GUARD
 
 #include "SparseMatrix.hpp"
+#include "PrimeField.hpp"
 
 MATHICGB_NAMESPACE_BEGIN
 
@@ -19,6 +20,8 @@ class PolyRing;
 /// lower left part of the matrix becomes all-zero after row reduction.
 class F4MatrixReducer {
 public:
+  typedef PrimeField<SparseMatrix::Scalar> Field;
+
   /// The ring used is Z/pZ where modulus is the prime p.
   ///
   ///
@@ -29,6 +32,14 @@ public:
   /// is not returned because it is always zero after row reduction.
   SparseMatrix reduceToBottomRight(const QuadMatrix& matrix);
 
+  /// As above, and also appends to sourceRows the bottom row of matrix that
+  /// each returned row came from. Bottom rows that reduce to zero are left
+  /// out of the returned matrix.
+  SparseMatrix reduceToBottomRight(
+    const QuadMatrix& matrix,
+    std::vector<SparseMatrix::RowIndex>& sourceRows
+  );
+
   /// Returns the reduced row echelon form of matrix.
   SparseMatrix reducedRowEchelonForm(const SparseMatrix& matrix);
 
@@ -37,8 +48,31 @@ public:
   /// always zero after row reduction.
   SparseMatrix reducedRowEchelonFormBottomRight(const QuadMatrix& matrix);
 
+  /// As above, and also sets usefulBottomRows to the bottom rows of matrix
+  /// that contribute a pivot to the result, in ascending order. The other
+  /// bottom rows reduce to zero, so removing them from matrix does not
+  /// change the result.
+  SparseMatrix reducedRowEchelonFormBottomRight(
+    const QuadMatrix& matrix,
+    std::vector<SparseMatrix::RowIndex>& usefulBottomRows
+  );
+
 private:
-  const SparseMatrix::Scalar mModulus;
+  /// If sourceRows is not null then the bottom row of matrix that each
+  /// returned row came from is appended to it.
+  SparseMatrix reduceToBottomRightInternal(
+    const QuadMatrix& matrix,
+    std::vector<SparseMatrix::RowIndex>* sourceRows
+  );
+
+  /// If pivotRows is not null then the rows of matrix that became pivots
+  /// are appended to it.
+  SparseMatrix reducedRowEchelonForm(
+    const SparseMatrix& matrix,
+    std::vector<SparseMatrix::RowIndex>* pivotRows
+  );
+
+  const Field mField;
 };
 
 MATHICGB_NAMESPACE_END
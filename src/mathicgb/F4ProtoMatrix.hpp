@@ -13,7 +13,7 @@ class F4ProtoMatrix {
 public:
   typedef uint32 RowIndex;
   typedef uint32 ColIndex;
-  typedef coefficient ExternalScalar;
+  typedef stored_coefficient ExternalScalar;
   typedef SparseMatrix::Scalar Scalar;
 
   struct Row {
@@ -8,6 +8,10 @@
 #include "F4MatrixReducer.hpp"
 #include "QuadMatrix.hpp"
 #include "LogDomain.hpp"
+#include "LogDomainSet.hpp"
+#include "MemoryBudget.hpp"
+#include <unordered_map>
+#include <algorithm>
 #include <iostream>
 #include <limits>
 
@@ -31,6 +35,18 @@ MATHICGB_DEFINE_LOG_DOMAIN(
   "Count number of non-zero entries in F4 matrices."
 );
 
+MATHICGB_DEFINE_LOG_DOMAIN(
+  F4SPairGroupSplits,
+  "Count number of times that a group of S-pairs was reduced as two smaller "
+  "matrices to stay within the memory budget."
+);
+
+MATHICGB_DEFINE_LOG_DOMAIN(
+  F4SPairGroupSize,
+  "Displays the number of S-pairs chosen for the next F4 matrix when there "
+  "is a matrix time target."
+);
+
 MATHICGB_DEFINE_LOG_ALIAS(
   "F4Detail",
   "F4MatrixEntries,F4MatrixBottomRows,F4MatrixTopRows,F4MatrixRows,"
@@ -43,6 +59,11 @@ MATHICGB_DEFINE_LOG_ALIAS(
   "F4MatReduceTop,F4RedBottomRight"
 );
 
+MATHICGB_DEFINE_LOG_ALIAS(
+  "F4Perf",
+  "PerfCounters,F4MatrixBuild2,F4MatReduceTop,F4RedBottomRight"
+);
+
 MATHICGB_NAMESPACE_BEGIN
 
 F4Reducer::F4Reducer(const PolyRing& ring, Type type):
@@ -52,11 +73,25 @@ F4Reducer::F4Reducer(const PolyRing& ring, Type type):
   mMemoryQuantum(0),
   mStoreToFile(""),
   mMinEntryCountForStore(0),
-  mMatrixSaveCount(0) {
+  mMatrixSaveCount(0),
+  mTrace(0),
+  mTraceMatrix(0),
+  mBytesPerSPair(0) {
 }
 
 unsigned int F4Reducer::preferredSetSize() const {
-  return 100000;
+  if (mGroupSizer.get() == 0)
+    return 100000;
+  const auto available = MemoryBudget::singleton().available();
+  return static_cast<unsigned int>
+    (mGroupSizer->groupSize(mBytesPerSPair, available));
+}
+
+void F4Reducer::setMatrixTimeTarget(const double seconds) {
+  if (seconds > 0)
+    mGroupSizer = make_unique<SPairGroupSizer>(seconds);
+  else
+    mGroupSizer.reset();
 }
 
 void F4Reducer::writeMatricesTo(std::string file, size_t minEntries) {
@@ -123,52 +158,75 @@ void F4Reducer::classicReduceSPolySet(
   if (tracingLevel >= 2 && false)
     std::cerr << "F4Reducer: Reducing " << spairs.size() << " S-polynomials.\n";
 
-  SparseMatrix reduced;
-  std::vector<monomial> monomials;
-  {
-    QuadMatrix qm;
-    {
-      if (mType == OldType) {
-        F4MatrixBuilder builder(basis, mMemoryQuantum);
-        for (auto it = spairs.begin(); it != spairs.end(); ++it) {
-          builder.addSPolynomialToMatrix
-            (basis.poly(it->first), basis.poly(it->second));
-        }
-        builder.buildMatrixAndClear(qm);
-      } else {
-        F4MatrixBuilder2 builder(basis, mMemoryQuantum);
-        for (auto it = spairs.begin(); it != spairs.end(); ++it) {
-          builder.addSPolynomialToMatrix
-            (basis.poly(it->first), basis.poly(it->second));
-        }
-        builder.buildMatrixAndClear(qm);
-      }
+  // If the matrix for all the S-pairs would likely take more memory than
+  // the budget has left, then reduce the two halves of the S-pairs as
+  // separate matrices. Those may be split again. The results are reduced
+  // with respect to basis but not with respect to each other, which is
+  // fine as ClassicGBAlg reduces the new basis elements as it inserts
+  // them. Splitting would make the matrices differ from a trace, so it is
+  // not done when learning or replaying.
+  auto& budget = MemoryBudget::singleton();
+  if (
+    spairs.size() > 1 &&
+    mBytesPerSPair != 0 &&
+    !learning() &&
+    !replaying() &&
+    spairs.size() > budget.available() / mBytesPerSPair
+  ) {
+    MATHICGB_LOG_INCREMENT(F4SPairGroupSplits);
+    const auto middle = spairs.begin() + spairs.size() / 2;
+    std::vector<std::pair<size_t, size_t>> firstHalf(spairs.begin(), middle);
+    std::vector<std::pair<size_t, size_t>> secondHalf(middle, spairs.end());
+    classicReduceSPolySet(firstHalf, basis, reducedOut);
+    std::vector<std::unique_ptr<Poly>> reduced;
+    classicReduceSPolySet(secondHalf, basis, reduced);
+    for (auto it = reduced.begin(); it != reduced.end(); ++it)
+      reducedOut.push_back(std::move(*it));
+    return;
+  }
+  const auto usedBefore = budget.inUse();
+  budget.resetRecentPeak();
+  const auto buildStart = mgb::mtbb::tick_count::now();
+
+  QuadMatrix qm;
+  F4MatrixProjection::Origin origin;
+  const F4Trace::Matrix* expected = 0;
+  if (replaying())
+    qm = replayMatrix(basis, 0, expected);
+  else if (mType == OldType) {
+    F4MatrixBuilder builder(basis, mMemoryQuantum);
+    for (auto it = spairs.begin(); it != spairs.end(); ++it) {
+      builder.addSPolynomialToMatrix
+        (basis.poly(it->first), basis.poly(it->second));
     }
-    MATHICGB_LOG_INCREMENT_BY(F4MatrixRows, qm.rowCount());
-    MATHICGB_LOG_INCREMENT_BY(F4MatrixTopRows, qm.topLeft.rowCount());
-    MATHICGB_LOG_INCREMENT_BY(F4MatrixBottomRows, qm.bottomLeft.rowCount());
-    MATHICGB_LOG_INCREMENT_BY(F4MatrixEntries, qm.entryCount());
-    saveMatrix(qm);
-    reduced = F4MatrixReducer(basis.ring().charac()).
-      reducedRowEchelonFormBottomRight(qm);
-    monomials = std::move(qm.rightColumnMonomials);
-    const auto end = qm.leftColumnMonomials.end();
-    for (auto it = qm.leftColumnMonomials.begin(); it != end; ++it)
-      mRing.freeMonomial(*it);
+    builder.buildMatrixAndClear(qm);
+  } else {
+    F4MatrixBuilder2 builder(basis, mMemoryQuantum);
+    for (auto it = spairs.begin(); it != spairs.end(); ++it) {
+      builder.addSPolynomialToMatrix
+        (basis.poly(it->first), basis.poly(it->second));
+    }
+    builder.buildMatrixAndClear(qm, learning() ? &origin : 0);
   }
-
-  if (tracingLevel >= 2 && false)
-    std::cerr << "F4Reducer: Extracted " << reduced.rowCount()
-              << " non-zero rows\n";
-
-  for (SparseMatrix::RowIndex row = 0; row < reduced.rowCount(); ++row) {
-    auto p = make_unique<Poly>(basis.ring());
-    reduced.rowToPolynomial(row, monomials, *p);
-    reducedOut.push_back(std::move(p));
+  const auto entryCount = qm.entryCount();
+  reduceMatrix(qm, basis, 0, &origin, expected, reducedOut);
+
+  if (mGroupSizer.get() != 0) {
+    const auto seconds =
+      (mgb::mtbb::tick_count::now() - buildStart).seconds();
+    mGroupSizer->recordMatrix(spairs.size(), entryCount, seconds);
+    MATHICGB_LOG(F4SPairGroupSize) << spairs.size() << " S-pairs took "
+      << seconds << "s. Next group size is "
+      << mGroupSizer->groupSize() << " S-pairs.\n";
   }
-  const auto end = monomials.end();
-  for (auto it = monomials.begin(); it != end; ++it)
-    mRing.freeMonomial(*it);
+
+  // The estimate follows the matrices as they grow, but it only goes down
+  // slowly so that one small matrix does not lead to a large one that
+  // goes over the budget.
+  const auto peak = budget.recentPeak();
+  const auto perSPair =
+    peak > usedBefore ? (peak - usedBefore) / spairs.size() : 0;
+  mBytesPerSPair = std::max(perSPair, mBytesPerSPair / 2);
 }
 
 void F4Reducer::classicReducePolySet
@@ -192,34 +250,148 @@ void F4Reducer::classicReducePolySet
   if (tracingLevel >= 2 && false)
     std::cerr << "F4Reducer: Reducing " << polys.size() << " polynomials.\n";
 
+  QuadMatrix qm;
+  F4MatrixProjection::Origin origin;
+  const F4Trace::Matrix* expected = 0;
+  if (replaying())
+    qm = replayMatrix(basis, &polys, expected);
+  else if (mType == OldType) {
+    F4MatrixBuilder builder(basis, mMemoryQuantum);
+    for (auto it = polys.begin(); it != polys.end(); ++it)
+      builder.addPolynomialToMatrix(**it);
+    builder.buildMatrixAndClear(qm);
+  } else {
+    F4MatrixBuilder2 builder(basis, mMemoryQuantum);
+    for (auto it = polys.begin(); it != polys.end(); ++it)
+      builder.addPolynomialToMatrix(**it);
+    builder.buildMatrixAndClear(qm, learning() ? &origin : 0);
+  }
+  reduceMatrix(qm, basis, &polys, &origin, expected, reducedOut);
+}
+
+void F4Reducer::classicNormalForms(
+  const std::vector<std::unique_ptr<Poly> >& polys,
+  const PolyBasis& basis,
+  std::vector<std::unique_ptr<Poly> >& normalForms
+) {
+  if (mType != NewType)
+    mathic::reportInternalError("F4Reducer: normal forms need the new type.");
+
+  normalForms.clear();
+  std::vector<size_t> rowToPoly;
+  F4MatrixBuilder2 builder(basis, mMemoryQuantum);
+  for (size_t i = 0; i < polys.size(); ++i) {
+    normalForms.push_back(make_unique<Poly>(basis.ring()));
+    if (!polys[i]->isZero()) {
+      builder.addPolynomialToMatrixAsBottomRow(*polys[i]);
+      rowToPoly.push_back(i);
+    }
+  }
+  if (rowToPoly.empty())
+    return;
+
+  QuadMatrix qm;
+  builder.buildMatrixAndClear(qm);
+  MATHICGB_ASSERT(qm.bottomLeft.rowCount() == rowToPoly.size());
+  MATHICGB_LOG_INCREMENT_BY(F4MatrixRows, qm.rowCount());
+  MATHICGB_LOG_INCREMENT_BY(F4MatrixTopRows, qm.topLeft.rowCount());
+  MATHICGB_LOG_INCREMENT_BY(F4MatrixBottomRows, qm.bottomLeft.rowCount());
+  MATHICGB_LOG_INCREMENT_BY(F4MatrixEntries, qm.entryCount());
+  saveMatrix(qm);
+
+  // The bottom rows are not reduced by each other, so each reduced row is
+  // the normal form of the polynomial of its row. Those that are not
+  // there reduced to zero.
+  std::vector<SparseMatrix::RowIndex> sourceRows;
+  auto reduced = F4MatrixReducer(basis.ring().charac())
+    .reduceToBottomRight(qm, sourceRows);
+  MATHICGB_ASSERT(sourceRows.size() == reduced.rowCount());
+  for (SparseMatrix::RowIndex row = 0; row < reduced.rowCount(); ++row) {
+    MATHICGB_ASSERT(sourceRows[row] < rowToPoly.size());
+    auto& normalForm = *normalForms[rowToPoly[sourceRows[row]]];
+    reduced.rowToPolynomial(row, qm.rightColumnMonomials, normalForm);
+  }
+
+  for (auto it = qm.leftColumnMonomials.begin();
+    it != qm.leftColumnMonomials.end(); ++it)
+    mRing.freeMonomial(*it);
+  for (auto it = qm.rightColumnMonomials.begin();
+    it != qm.rightColumnMonomials.end(); ++it)
+    mRing.freeMonomial(*it);
+}
+
+void F4Reducer::reduceMatrix(
+  QuadMatrix& qm,
+  const PolyBasis& basis,
+  const std::vector<std::unique_ptr<Poly> >* polys,
+  const F4MatrixProjection::Origin* origin,
+  const F4Trace::Matrix* expected,
+  std::vector<std::unique_ptr<Poly> >& reducedOut
+) {
+  MATHICGB_LOG_INCREMENT_BY(F4MatrixRows, qm.rowCount());
+  MATHICGB_LOG_INCREMENT_BY(F4MatrixTopRows, qm.topLeft.rowCount());
+  MATHICGB_LOG_INCREMENT_BY(F4MatrixBottomRows, qm.bottomLeft.rowCount());
+  MATHICGB_LOG_INCREMENT_BY(F4MatrixEntries, qm.entryCount());
+  saveMatrix(qm);
+
+  const auto reduceStart = mgb::mtbb::tick_count::now();
+  F4MatrixReducer reducer(basis.ring().charac());
   SparseMatrix reduced;
-  std::vector<monomial> monomials;
-  {
-    QuadMatrix qm;
-    {
-      if (mType == OldType) {
-        F4MatrixBuilder builder(basis, mMemoryQuantum);
-        for (auto it = polys.begin(); it != polys.end(); ++it)
-          builder.addPolynomialToMatrix(**it);
-        builder.buildMatrixAndClear(qm);
-      } else {
-        F4MatrixBuilder2 builder(basis, mMemoryQuantum);
-        for (auto it = polys.begin(); it != polys.end(); ++it)
-          builder.addPolynomialToMatrix(**it);
-        builder.buildMatrixAndClear(qm);
-      }
+  if (learning()) {
+    std::vector<SparseMatrix::RowIndex> usefulBottomRows;
+    reduced = reducer.reducedRowEchelonFormBottomRight(qm, usefulBottomRows);
+    recordMatrix(*origin, qm, usefulBottomRows, reduced, basis, polys);
+  } else
+    reduced = reducer.reducedRowEchelonFormBottomRight(qm);
+
+  auto& logs = LogDomainSet::singleton();
+  if (logs.tracing()) {
+    const double rows = static_cast<double>(qm.rowCount());
+    const double leftCols = static_cast<double>(qm.computeLeftColCount());
+    const double rightCols = static_cast<double>(qm.computeRightColCount());
+    const double cols = leftCols + rightCols;
+    const double entries = static_cast<double>(qm.entryCount());
+    LogDomainSet::TraceArgs args;
+    args.push_back(std::make_pair("topRows",
+      static_cast<double>(qm.topLeft.rowCount())));
+    args.push_back(std::make_pair("bottomRows",
+      static_cast<double>(qm.bottomLeft.rowCount())));
+    args.push_back(std::make_pair("leftColumns", leftCols));
+    args.push_back(std::make_pair("rightColumns", rightCols));
+    args.push_back(std::make_pair("entries", entries));
+    args.push_back(std::make_pair("density",
+      rows * cols == 0 ? 0.0 : entries / (rows * cols)));
+    args.push_back(std::make_pair("reducedRows",
+      static_cast<double>(reduced.rowCount())));
+    args.push_back(std::make_pair("reduceSeconds",
+      (mgb::mtbb::tick_count::now() - reduceStart).seconds()));
+    logs.recordTraceEvent("F4Matrix", 'i', std::move(args));
+  }
+
+  auto monomials = std::move(qm.rightColumnMonomials);
+  for (auto it = qm.leftColumnMonomials.begin();
+    it != qm.leftColumnMonomials.end(); ++it)
+    mRing.freeMonomial(*it);
+
+  if (expected != 0) {
+    // The lead terms of the result have to be the same as when learning,
+    // or the rest of the computation will not be the same either.
+    std::vector<SparseMatrix::ColIndex> leadColumns;
+    for (SparseMatrix::RowIndex row = 0; row < reduced.rowCount(); ++row)
+      leadColumns.push_back(reduced.leadCol(row));
+    std::sort(leadColumns.begin(), leadColumns.end());
+    if (leadColumns != expected->reducedLeadColumns)
+      throw F4Trace::Mismatch();
+
+    MATHICGB_ASSERT(monomials.empty());
+    const auto& monoid = mRing.monoid();
+    const auto varCount = monoid.varCount();
+    const auto& exponents = expected->rightMonomials;
+    for (size_t i = 0; i < exponents.size(); i += varCount) {
+      auto mono = mRing.allocMonomial();
+      monoid.setExternalExponents(exponents.data() + i, mono);
+      monomials.push_back(mono);
     }
-    MATHICGB_LOG_INCREMENT_BY(F4MatrixRows, qm.rowCount());
-    MATHICGB_LOG_INCREMENT_BY(F4MatrixTopRows, qm.topLeft.rowCount());
-    MATHICGB_LOG_INCREMENT_BY(F4MatrixBottomRows, qm.bottomLeft.rowCount());
-    MATHICGB_LOG_INCREMENT_BY(F4MatrixEntries, qm.entryCount());
-    saveMatrix(qm);
-    reduced = F4MatrixReducer(basis.ring().charac()).
-      reducedRowEchelonFormBottomRight(qm);
-    monomials = std::move(qm.rightColumnMonomials);
-    for (auto it = qm.leftColumnMonomials.begin();
-      it != qm.leftColumnMonomials.end(); ++it)
-      mRing.freeMonomial(*it);
   }
 
   if (tracingLevel >= 2 && false)
@@ -236,6 +408,136 @@ void F4Reducer::classicReducePolySet
     mRing.freeMonomial(*it);
 }
 
+void F4Reducer::recordMatrix(
+  const F4MatrixProjection::Origin& origin,
+  const QuadMatrix& qm,
+  const std::vector<SparseMatrix::RowIndex>& usefulBottomRows,
+  const SparseMatrix& reduced,
+  const PolyBasis& basis,
+  const std::vector<std::unique_ptr<Poly> >* polys
+) {
+  MATHICGB_ASSERT(learning());
+  MATHICGB_ASSERT(origin.rowBegins.size() == origin.rowScalars.size() + 1);
+  MATHICGB_ASSERT(origin.topRowCount == qm.topLeft.rowCount());
+
+  mTrace->matrices.push_back(F4Trace::Matrix());
+  auto& matrix = mTrace->matrices.back();
+  matrix.basisSize = basis.size();
+  matrix.polyCount = polys == 0 ? 0 : polys->size();
+  matrix.columns = origin.columns;
+
+  // Each row uses the coefficients of the polynomial that it is a multiple
+  // of, so we can tell which polynomial that is from the scalars.
+  std::unordered_map<const stored_coefficient*, size_t> sourceOfScalars;
+  for (size_t i = 0; i < basis.size(); ++i)
+    if (!basis.retired(i))
+      sourceOfScalars[basis.poly(i).coefficientBegin()] = i;
+  for (size_t i = 0; i < matrix.polyCount; ++i)
+    sourceOfScalars[(*polys)[i]->coefficientBegin()] = basis.size() + i;
+
+  auto recordRow = [&](const size_t row) {
+    const auto source = sourceOfScalars.find(origin.rowScalars[row]);
+    if (source == sourceOfScalars.end())
+      mathic::reportInternalError("F4Reducer: cannot trace matrix row.");
+    matrix.rowSources.push_back(source->second);
+    matrix.indices.insert(
+      matrix.indices.end(),
+      origin.indices.begin() + origin.rowBegins[row],
+      origin.indices.begin() + origin.rowBegins[row + 1]
+    );
+    matrix.rowBegins.push_back(matrix.indices.size());
+  };
+
+  // The bottom rows that reduce to zero are left out.
+  matrix.topRowCount = origin.topRowCount;
+  matrix.rowBegins.push_back(0);
+  for (size_t row = 0; row < origin.topRowCount; ++row)
+    recordRow(row);
+  for (auto it = usefulBottomRows.begin(); it != usefulBottomRows.end(); ++it)
+    recordRow(origin.topRowCount + *it);
+
+  const auto& monoid = mRing.monoid();
+  const auto end = qm.rightColumnMonomials.end();
+  for (auto it = qm.rightColumnMonomials.begin(); it != end; ++it)
+    for (size_t var = 0; var < monoid.varCount(); ++var)
+      matrix.rightMonomials.push_back(monoid.externalExponent(*it, var));
+
+  for (SparseMatrix::RowIndex row = 0; row < reduced.rowCount(); ++row)
+    matrix.reducedLeadColumns.push_back(reduced.leadCol(row));
+  std::sort(matrix.reducedLeadColumns.begin(), matrix.reducedLeadColumns.end());
+}
+
+QuadMatrix F4Reducer::replayMatrix(
+  const PolyBasis& basis,
+  const std::vector<std::unique_ptr<Poly> >* polys,
+  const F4Trace::Matrix*& expected
+) {
+  MATHICGB_ASSERT(replaying());
+  if (mTraceMatrix == mTrace->matrices.size())
+    throw F4Trace::Mismatch();
+  const auto& matrix = mTrace->matrices[mTraceMatrix];
+  ++mTraceMatrix;
+  expected = &matrix;
+
+  const auto polyCount = polys == 0 ? 0 : polys->size();
+  if (matrix.basisSize != basis.size() || matrix.polyCount != polyCount)
+    throw F4Trace::Mismatch();
+
+  typedef SparseMatrix::Scalar Scalar;
+  MATHICGB_ASSERT(mRing.charac() <= std::numeric_limits<Scalar>::max());
+  const auto modulus = static_cast<Scalar>(mRing.charac());
+
+  QuadMatrix qm;
+  qm.ring = &mRing;
+  qm.topLeft = SparseMatrix(mMemoryQuantum);
+  qm.topRight = SparseMatrix(mMemoryQuantum);
+
+  const auto rowCount = matrix.rowSources.size();
+  for (size_t row = 0; row < rowCount; ++row) {
+    const auto source = matrix.rowSources[row];
+    if (source < basis.size() && basis.retired(source))
+      throw F4Trace::Mismatch();
+    const auto& poly = source < basis.size() ?
+      basis.poly(source) : *(*polys)[source - basis.size()];
+
+    const auto begin = matrix.rowBegins[row];
+    const auto end = matrix.rowBegins[row + 1];
+    if (poly.termCount() != end - begin)
+      throw F4Trace::Mismatch();
+
+    const bool isTop = row < matrix.topRowCount;
+    auto& left = isTop ? qm.topLeft : qm.bottomLeft;
+    auto& right = isTop ? qm.topRight : qm.bottomRight;
+    auto scalar = poly.coefficientBegin();
+    for (auto i = begin; i != end; ++i, ++scalar) {
+      MATHICGB_ASSERT(*scalar < modulus);
+      const auto projected = matrix.columns[matrix.indices[i]];
+      if (projected.isLeft)
+        left.appendEntry(projected.index, static_cast<Scalar>(*scalar));
+      else
+        right.appendEntry(projected.index, static_cast<Scalar>(*scalar));
+    }
+    left.rowDone();
+    right.rowDone();
+
+    if (isTop) {
+      // Make the pivot of the top row one as F4MatrixProjection does.
+      const auto leftRow = static_cast<SparseMatrix::RowIndex>(row);
+      MATHICGB_ASSERT(!left.emptyRow(leftRow));
+      MATHICGB_ASSERT(left.leadCol(leftRow) == leftRow);
+      const auto lead = left.rowBegin(leftRow).scalar();
+      if (lead != 1) {
+        const auto inverse = modularInverse(lead, modulus);
+        left.multiplyRow(leftRow, inverse, modulus);
+        right.multiplyRow(leftRow, inverse, modulus);
+      }
+    }
+  }
+  // The column monomials are not needed for the reduction so they are
+  // made by reduceMatrix once the reduction turns out to match the trace.
+  return qm;
+}
+
 Poly* F4Reducer::regularReduce(
   const_monomial sig,
   const_monomial multiple,
@@ -255,6 +557,13 @@ void F4Reducer::setMemoryQuantum(size_t quantum) {
   mMemoryQuantum = quantum;
 }
 
+void F4Reducer::setTrace(F4Trace* trace) {
+  if (trace != 0 && mType != NewType)
+    mathic::reportError("F4 traces are only supported for the new F4 type.");
+  mTrace = trace;
+  mTraceMatrix = 0;
+}
+
 std::string F4Reducer::description() const {
   return "F4 reducer";
 }
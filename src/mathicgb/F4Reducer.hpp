@@ -5,7 +5,11 @@
 
 #include "Reducer.hpp"
 #include "PolyRing.hpp"
+#include "F4MatrixProjection.hpp"
+#include "F4Trace.hpp"
+#include "SPairGroupSizer.hpp"
 #include <string>
+#include <memory>
 
 MATHICGB_NAMESPACE_BEGIN
 
@@ -21,6 +25,15 @@ public:
   F4Reducer(const PolyRing& ring, Type type);
 
   virtual unsigned int preferredSetSize() const;
+  virtual bool adaptiveSetSize() const {return mGroupSizer.get() != 0;}
+
+  /// If seconds is positive, then preferredSetSize() is chosen after each
+  /// matrix so that building and reducing a matrix of S-pairs takes about
+  /// that many seconds, and so that the matrix fits in the memory budget
+  /// if there is one. See SPairGroupSizer. Otherwise preferredSetSize() is
+  /// large, so that all the S-pairs of a degree go in one matrix. That is
+  /// the default.
+  void setMatrixTimeTarget(double seconds);
 
   /// Store all future matrices to file-1.mat, file-2.mat and so on.
   /// Matrices with less than minEntries non-zero entries are not stored.
@@ -49,6 +62,18 @@ public:
     std::vector<std::unique_ptr<Poly> >& reducedOut
   );
 
+  /// Sets normalForms[i] to the normal form of polys[i] with respect to
+  /// basis. Unlike classicReducePolySet, the polynomials are not reduced by
+  /// each other and they are not made monic, but they are still all reduced
+  /// in a single matrix so that they share the reducer rows. The normal
+  /// forms are only unique if basis is a Groebner basis. Only supported for
+  /// NewType.
+  void classicNormalForms(
+    const std::vector<std::unique_ptr<Poly> >& polys,
+    const PolyBasis& basis,
+    std::vector<std::unique_ptr<Poly> >& normalForms
+  );
+
   virtual Poly* regularReduce(
     const_monomial sig,
     const_monomial multiple,
@@ -58,12 +83,48 @@ public:
 
   virtual void setMemoryQuantum(size_t quantum);
 
+  /// Traces are only supported for NewType.
+  virtual void setTrace(F4Trace* trace);
+
   virtual std::string description() const;
   virtual size_t getMemoryUse() const;
 
 private:
   void saveMatrix(const QuadMatrix& matrix);
 
+  bool learning() const {return mTrace != 0 && mTrace->learning();}
+  bool replaying() const {return mTrace != 0 && !mTrace->learning();}
+
+  /// Reduces matrix and appends the resulting polynomials to reducedOut.
+  /// The row sources of matrix are the basis and polys, which can be null.
+  /// If learning, origin must describe matrix so that it can be recorded.
+  /// If replaying, expected must be the trace of matrix.
+  void reduceMatrix(
+    QuadMatrix& matrix,
+    const PolyBasis& basis,
+    const std::vector<std::unique_ptr<Poly> >* polys,
+    const F4MatrixProjection::Origin* origin,
+    const F4Trace::Matrix* expected,
+    std::vector<std::unique_ptr<Poly> >& reducedOut
+  );
+
+  /// Appends the layout of matrix to the trace.
+  void recordMatrix(
+    const F4MatrixProjection::Origin& origin,
+    const QuadMatrix& matrix,
+    const std::vector<SparseMatrix::RowIndex>& usefulBottomRows,
+    const SparseMatrix& reduced,
+    const PolyBasis& basis,
+    const std::vector<std::unique_ptr<Poly> >* polys
+  );
+
+  /// Builds the next matrix of the trace and sets expected to its trace.
+  QuadMatrix replayMatrix(
+    const PolyBasis& basis,
+    const std::vector<std::unique_ptr<Poly> >* polys,
+    const F4Trace::Matrix*& expected
+  );
+
   Type mType;
   std::unique_ptr<Reducer> mFallback;
   const PolyRing& mRing;
@@ -71,6 +132,16 @@ private:
   std::string mStoreToFile; /// stem of file names to save matrices to
   size_t mMinEntryCountForStore; /// don't save matrices with fewer entries
   size_t mMatrixSaveCount; // how many matrices have been saved
+  F4Trace* mTrace;
+  size_t mTraceMatrix; /// index of the next matrix to replay
+
+  /// Estimate of how much memory reducing an S-pair in a matrix takes, as
+  /// tracked by MemoryBudget. Used to split groups of S-pairs into smaller
+  /// matrices when there is a memory budget. 0 if there is no estimate yet.
+  size_t mBytesPerSPair;
+
+  /// Chooses preferredSetSize() if there is a matrix time target.
+  std::unique_ptr<SPairGroupSizer> mGroupSizer;
 };
 
 MATHICGB_NAMESPACE_END
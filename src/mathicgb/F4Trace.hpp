@@ -0,0 +1,100 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#ifndef MATHICGB_F4_TRACE_GUARD
+#define MATHICGB_F4_TRACE_GUARD
+
+#include "PolyRing.hpp"
+#include "SparseMatrix.hpp"
+#include "F4MatrixProjection.hpp"
+#include <vector>
+#include <utility>
+#include <stdexcept>
+
+MATHICGB_NAMESPACE_BEGIN
+
+/// A record of a Groebner basis computation by ClassicGBAlg with an
+/// F4Reducer that can be replayed to do the same computation with
+/// different coefficients, such as for the same ideal modulo another
+/// prime. This is the tracer of Traverso.
+///
+/// While learning, ClassicGBAlg records the S-pairs that it reduces in each
+/// step and the lead monomials of the basis. F4Reducer records the layout
+/// of each matrix: the columns, which polynomial each row is a multiple of
+/// and which bottom rows did not reduce to zero. A replay takes the S-pairs
+/// from the trace instead of from the S-pair queue and builds each matrix
+/// directly from the recorded layout. So it skips S-pair elimination,
+/// symbolic preprocessing, the divisor queries to find reducers and the
+/// rows that reduce to zero.
+///
+/// A replay checks that the computation stays the same by comparing
+/// the lead monomials of the basis and of the reduced matrix rows to the
+/// trace. If they differ, as happens for an unlucky prime, the replay
+/// throws Mismatch.
+///
+/// A trace can be replayed by several computations at the same time but
+/// it has to be done learning before that.
+class F4Trace {
+public:
+  typedef SparseMatrix::RowIndex RowIndex;
+  typedef SparseMatrix::ColIndex ColIndex;
+  typedef PolyRing::Monoid::Exponent Exponent;
+  typedef F4MatrixProjection::ColProjectTo ColProjectTo;
+
+  class Mismatch : public std::runtime_error {
+  public:
+    Mismatch(): std::runtime_error("Computation does not match F4 trace.") {}
+  };
+
+  F4Trace(): mLearning(true) {}
+
+  /// Returns true if the trace is being recorded and false if it is being
+  /// replayed.
+  bool learning() const {return mLearning;}
+
+  /// After this the trace is replayed instead of recorded.
+  void finishLearning() {mLearning = false;}
+
+  /// One step of ClassicGBAlg.
+  struct Step {
+    std::vector<std::pair<size_t, size_t> > sPairs;
+
+    /// The sugar or degree that the S-pairs were popped at.
+    exponent degree;
+  };
+  std::vector<Step> steps;
+
+  /// The exponents of the lead monomial of each basis element in order of
+  /// insertion, one after the other.
+  std::vector<Exponent> leadExponents;
+
+  /// One matrix of F4Reducer. A row source is an index into the basis or
+  /// basisSize plus an index into the polynomials that were to be reduced.
+  struct Matrix {
+    size_t basisSize;
+    size_t polyCount;
+
+    /// The columns of the rows in indices get projected like this.
+    std::vector<ColProjectTo> columns;
+
+    /// The exponents of the right column monomials one after the other.
+    std::vector<Exponent> rightMonomials;
+
+    /// The top rows followed by the bottom rows that did not reduce to
+    /// zero. Each term of the source of row i is in column indices[j] for
+    /// j from rowBegins[i] to rowBegins[i + 1].
+    RowIndex topRowCount;
+    std::vector<size_t> rowSources;
+    std::vector<size_t> rowBegins;
+    std::vector<ColIndex> indices;
+
+    /// The sorted lead columns of the reduced bottom right matrix.
+    std::vector<ColIndex> reducedLeadColumns;
+  };
+  std::vector<Matrix> matrices;
+
+private:
+  bool mLearning;
+};
+
+MATHICGB_NAMESPACE_END
+#endif
@@ -0,0 +1,329 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#include "stdinc.h"
+#include "Fglm.hpp"
+
+#include "Basis.hpp"
+#include "Poly.hpp"
+#include "PolyBasis.hpp"
+#include "F4Reducer.hpp"
+#include "MonomialMap.hpp"
+#include <algorithm>
+#include <limits>
+
+MATHICGB_NAMESPACE_BEGIN
+
+namespace {
+  typedef Fglm::Monoid Monoid;
+  typedef Fglm::VarIndex VarIndex;
+  typedef Fglm::Exponent Exponent;
+
+  const size_t NoIndex = static_cast<size_t>(-1);
+
+  // Returns the index that mono maps to in map or NoIndex if there is none.
+  size_t find(const MonomialMap<size_t>& map, Monoid::ConstMonoRef mono) {
+    const MonomialMap<size_t>::Reader reader(map);
+    const auto found = reader.find(Monoid::toOld(mono));
+    return found.first == 0 ? NoIndex : *found.first;
+  }
+
+  // Sets mono to var times the monomial with the given external exponents.
+  void setProduct(
+    const Monoid& monoid,
+    std::vector<Exponent>& exponents,
+    const VarIndex var,
+    Monoid::MonoRef mono
+  ) {
+    ++exponents[var];
+    monoid.setExternalExponents(exponents.data(), mono);
+    --exponents[var];
+  }
+}
+
+Fglm::Fglm(const PolyBasis& basis):
+  mRing(basis.ring()),
+  mVarCount(basis.ring().varCount()),
+  mStandardCount(0),
+  mMultiply(mVarCount)
+{
+  MATHICGB_ASSERT(zeroDimensional(basis));
+  MATHICGB_ASSERT(mRing.charac() <=
+    std::numeric_limits<SparseMatrix::Scalar>::max());
+  const auto& monoid = mRing.monoid();
+
+  // Find the standard monomials by multiplying those found so far by each
+  // variable, starting from 1. The products that are not standard are the
+  // border monomials. products[i * mVarCount + var] is the index of var
+  // times standard monomial i among the standard or the border monomials.
+  struct Product {
+    bool border;
+    size_t index;
+  };
+  std::vector<Product> products;
+  std::vector<Exponent> standard;
+  MonomialMap<size_t> standardIndex(mRing);
+  MonomialMap<size_t> borderIndex(mRing);
+  std::vector<std::unique_ptr<Poly>> border;
+
+  auto mono = monoid.alloc();
+  const const_monomial oldMono = Monoid::toOld(*mono.ptr());
+  monoid.setIdentity(mono);
+  if (basis.classicReducer(oldMono) == NoIndex) {
+    standard.resize(mVarCount);
+    standardIndex.insert(std::make_pair(oldMono, size_t(0)));
+    mStandardCount = 1;
+  }
+  std::vector<Exponent> exponents(mVarCount);
+  for (size_t i = 0; i < mStandardCount; ++i) {
+    std::copy_n(standard.begin() + i * mVarCount, mVarCount, exponents.begin());
+    for (VarIndex var = 0; var < mVarCount; ++var) {
+      setProduct(monoid, exponents, var, mono);
+      Product product = {false, find(standardIndex, mono)};
+      if (product.index == NoIndex) {
+        product.border = true;
+        product.index = find(borderIndex, mono);
+      }
+      if (product.index != NoIndex) {
+        products.push_back(product);
+        continue;
+      }
+
+      if (basis.classicReducer(oldMono) == NoIndex) {
+        product.border = false;
+        product.index = mStandardCount;
+        ++mStandardCount;
+        for (VarIndex v = 0; v < mVarCount; ++v)
+          standard.push_back(monoid.externalExponent(mono, v));
+        standardIndex.insert(std::make_pair(oldMono, product.index));
+      } else {
+        product.index = border.size();
+        border.push_back(make_unique<Poly>(mRing));
+        border.back()->appendTerm(1, mono);
+        borderIndex.insert(std::make_pair(oldMono, product.index));
+      }
+      products.push_back(product);
+    }
+  }
+
+  // The normal forms of the border monomials give the rows of the
+  // multiplication matrices that do not just map a standard monomial to
+  // another one. Reducing them all in one matrix shares the reducer rows
+  // and spreads the work over the threads.
+  std::vector<std::unique_ptr<Poly>> normalForms;
+  if (!border.empty()) {
+    F4Reducer reducer(mRing, F4Reducer::NewType);
+    reducer.setMemoryQuantum(100 * 1024);
+    reducer.classicNormalForms(border, basis, normalForms);
+  }
+  border.clear();
+  MATHICGB_ASSERT(normalForms.size() == borderIndex.entryCount());
+
+  typedef SparseMatrix::ColIndex ColIndex;
+  typedef SparseMatrix::Scalar Scalar;
+  for (VarIndex var = 0; var < mVarCount; ++var) {
+    auto& matrix = mMultiply[var];
+    matrix.reserveRows(mStandardCount);
+    for (size_t i = 0; i < mStandardCount; ++i) {
+      const auto& product = products[i * mVarCount + var];
+      if (!product.border) {
+        matrix.appendEntry(static_cast<ColIndex>(product.index), 1);
+        matrix.rowDone();
+        continue;
+      }
+      const auto& normalForm = *normalForms[product.index];
+      for (size_t term = 0; term < normalForm.termCount(); ++term) {
+        const auto col = find(standardIndex, normalForm.monomialAt(term));
+        MATHICGB_ASSERT(col != NoIndex);
+        matrix.appendEntry(
+          static_cast<ColIndex>(col),
+          static_cast<Scalar>(normalForm.coefficientAt(term))
+        );
+      }
+      matrix.rowDone();
+    }
+  }
+}
+
+bool Fglm::zeroDimensional(const PolyBasis& basis) {
+  const auto& monoid = basis.ring().monoid();
+  const auto varCount = monoid.varCount();
+  std::vector<char> hasPurePower(varCount);
+  for (size_t i = 0; i < basis.size(); ++i) {
+    if (basis.retired(i))
+      continue;
+    const auto lead = basis.leadMonomial(i);
+    VarIndex support = 0;
+    VarIndex supportVar = 0;
+    for (VarIndex var = 0; var < varCount; ++var) {
+      if (monoid.externalExponent(lead, var) != 0) {
+        ++support;
+        supportVar = var;
+      }
+    }
+    if (support == 0)
+      return true; // the ideal is the whole ring
+    if (support == 1)
+      hasPurePower[supportVar] = true;
+  }
+  return std::find(hasPurePower.begin(), hasPurePower.end(), false) ==
+    hasPurePower.end();
+}
+
+void Fglm::multiply(
+  const DenseRow& vector,
+  const VarIndex var,
+  DenseRow& product
+) const {
+  MATHICGB_ASSERT(vector.size() == mStandardCount);
+  product.assign(mStandardCount, 0);
+  const auto& matrix = mMultiply[var];
+  for (size_t row = 0; row < mStandardCount; ++row) {
+    const auto factor = vector[row];
+    if (factor == 0)
+      continue;
+    const auto r = static_cast<SparseMatrix::RowIndex>(row);
+    const auto end = matrix.rowEnd(r);
+    for (auto it = matrix.rowBegin(r); it != end; ++it)
+      mRing.coefficientAddTo(product[it.index()], factor, it.scalar());
+  }
+}
+
+std::unique_ptr<Basis> Fglm::convert(const PolyRing& ring) const {
+  MATHICGB_ASSERT(ring.varCount() == mVarCount);
+  MATHICGB_ASSERT(ring.charac() == mRing.charac());
+  const auto& monoid = ring.monoid();
+  auto result = make_unique<Basis>(ring);
+  if (mStandardCount == 0) {
+    // The ideal is the whole ring.
+    auto one = monoid.alloc();
+    monoid.setIdentity(one);
+    auto poly = make_unique<Poly>(ring);
+    poly->appendTerm(1, one);
+    result->insert(std::move(poly));
+    return result;
+  }
+
+  // A monomial that is var times the standard monomial with index parent
+  // in the new order. These are processed in ascending order.
+  struct Candidate {
+    Monoid::Mono mono;
+    size_t parent;
+    VarIndex var;
+  };
+  const auto greater = [&](const Candidate& a, const Candidate& b) {
+    return monoid.lessThan(b.mono, a.mono);
+  };
+  std::vector<Candidate> candidates;
+  {
+    Candidate candidate = {monoid.alloc(), NoIndex, 0};
+    monoid.setIdentity(candidate.mono);
+    candidates.push_back(std::move(candidate));
+  }
+
+  // The standard monomials of the new order in ascending order and the
+  // coordinates of their normal forms in the old order.
+  std::vector<Monoid::Mono> standard;
+  std::vector<DenseRow> standardVectors;
+
+  // Row k of the echelon form is the linear combination of
+  // standardVectors with the coefficients in combinations[k]. Its entry
+  // in column pivots[k] is 1 and it is 0 in the pivot columns of the
+  // rows before it.
+  std::vector<DenseRow> echelon;
+  std::vector<DenseRow> combinations;
+  std::vector<size_t> pivots;
+
+  std::vector<Monoid::Mono> leads;
+  std::vector<Exponent> exponents(mVarCount);
+  DenseRow vector;
+  DenseRow combination;
+  while (!candidates.empty()) {
+    std::pop_heap(candidates.begin(), candidates.end(), greater);
+    auto candidate = std::move(candidates.back());
+    candidates.pop_back();
+
+    // A monomial can be a candidate several times, and then the copies
+    // are processed right after each other.
+    if (!standard.empty() && monoid.equal(standard.back(), candidate.mono))
+      continue;
+    const auto isMultiple = [&](const Monoid::Mono& lead) {
+      return monoid.divides(lead, candidate.mono);
+    };
+    if (std::any_of(leads.begin(), leads.end(), isMultiple))
+      continue;
+
+    if (candidate.parent == NoIndex) {
+      // 1 is the first standard monomial of the old order.
+      vector.assign(mStandardCount, 0);
+      vector[0] = 1;
+    } else
+      multiply(standardVectors[candidate.parent], candidate.var, vector);
+
+    // Reduce vector by the echelon form while tracking the combination of
+    // standard monomials that the result is the normal form of.
+    DenseRow reduced(vector);
+    combination.assign(standard.size() + 1, 0);
+    combination.back() = 1;
+    for (size_t k = 0; k < echelon.size(); ++k) {
+      const auto factor = reduced[pivots[k]];
+      if (factor == 0)
+        continue;
+      const auto negated = ring.coefficientNegateNonZero(factor);
+      const auto& row = echelon[k];
+      for (size_t col = 0; col < mStandardCount; ++col)
+        if (row[col] != 0)
+          ring.coefficientAddTo(reduced[col], negated, row[col]);
+      const auto& rowCombination = combinations[k];
+      for (size_t i = 0; i < rowCombination.size(); ++i)
+        if (rowCombination[i] != 0)
+          ring.coefficientAddTo(combination[i], negated, rowCombination[i]);
+    }
+
+    const auto pivot = static_cast<size_t>(
+      std::find_if(reduced.begin(), reduced.end(), [](coefficient c) {
+        return c != 0;
+      }) - reduced.begin()
+    );
+    if (pivot == mStandardCount) {
+      // The normal form of the candidate is a combination of those of the
+      // standard monomials, so that gives a basis element whose tail only
+      // has standard monomials. The standard monomials are smaller and in
+      // ascending order.
+      auto poly = make_unique<Poly>(ring);
+      poly->appendTerm(1, candidate.mono);
+      for (size_t i = standard.size(); i > 0; --i)
+        if (combination[i - 1] != 0)
+          poly->appendTerm(combination[i - 1], standard[i - 1]);
+      MATHICGB_ASSERT(poly->termsAreInDescendingOrder());
+      result->insert(std::move(poly));
+      leads.push_back(std::move(candidate.mono));
+      continue;
+    }
+
+    auto inverse = reduced[pivot];
+    ring.coefficientReciprocalTo(inverse);
+    for (auto it = reduced.begin(); it != reduced.end(); ++it)
+      ring.coefficientMultTo(*it, inverse);
+    for (auto it = combination.begin(); it != combination.end(); ++it)
+      ring.coefficientMultTo(*it, inverse);
+    echelon.push_back(std::move(reduced));
+    combinations.push_back(combination);
+    pivots.push_back(pivot);
+
+    const auto index = standard.size();
+    for (VarIndex var = 0; var < mVarCount; ++var)
+      exponents[var] = monoid.externalExponent(candidate.mono, var);
+    for (VarIndex var = 0; var < mVarCount; ++var) {
+      Candidate product = {monoid.alloc(), index, var};
+      setProduct(monoid, exponents, var, product.mono);
+      candidates.push_back(std::move(product));
+      std::push_heap(candidates.begin(), candidates.end(), greater);
+    }
+    standard.push_back(std::move(candidate.mono));
+    standardVectors.push_back(vector);
+  }
+  MATHICGB_ASSERT(standard.size() == mStandardCount);
+  return result;
+}
+
+MATHICGB_NAMESPACE_END
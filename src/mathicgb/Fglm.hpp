@@ -0,0 +1,82 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#ifndef MATHICGB_FGLM_GUARD
+#define MATHICGB_FGLM_GUARD
+
+#include "PolyRing.hpp"
+#include "SparseMatrix.hpp"
+#include <vector>
+#include <memory>
+
+MATHICGB_NAMESPACE_BEGIN
+
+class PolyBasis;
+class Basis;
+
+/// Converts a Groebner basis of a zero-dimensional ideal I to the reduced
+/// Groebner basis of I for another monomial order with the FGLM algorithm
+/// of Faugere, Gianni, Lazard and Mora. Computing a lex basis this way from
+/// a degree reverse lex basis is usually much faster than computing the lex
+/// basis directly.
+///
+/// R/I is a vector space of finite dimension whose basis is the standard
+/// monomials - the monomials that are not divisible by a lead monomial of
+/// the Groebner basis. Multiplication by a variable is a linear map of R/I
+/// and the constructor stores the matrix of that map for each variable.
+/// Those are given by the normal forms of the border monomials x*s for s a
+/// standard monomial, which are computed together in a single F4 matrix,
+/// so in parallel.
+///
+/// convert() then goes through the monomials of the other order in
+/// ascending order and gets the normal form of each one from that of a
+/// smaller monomial through a multiplication matrix. If the normal form is
+/// a linear combination of the normal forms of the previous monomials that
+/// were not lead monomials, then that combination gives a basis element.
+/// Otherwise the monomial is a standard monomial for the other order.
+class Fglm {
+public:
+  typedef PolyRing::Monoid Monoid;
+  typedef Monoid::VarIndex VarIndex;
+  typedef Monoid::Exponent Exponent;
+
+  /// basis must be a Groebner basis of a zero-dimensional ideal.
+  Fglm(const PolyBasis& basis);
+
+  /// Returns true if the ideal of basis is zero-dimensional, which is the
+  /// case when each variable has a pure power that is a lead monomial.
+  /// basis must be a Groebner basis.
+  static bool zeroDimensional(const PolyBasis& basis);
+
+  /// Returns the reduced Groebner basis of the ideal for the monomial order
+  /// of ring. ring must have the same field and variables as the ring of
+  /// the basis passed to the constructor. The basis elements are in
+  /// ascending order of lead monomial.
+  std::unique_ptr<Basis> convert(const PolyRing& ring) const;
+
+  /// Returns the dimension of R/I, which is the number of standard
+  /// monomials.
+  size_t dimension() const {return mStandardCount;}
+
+private:
+  typedef std::vector<coefficient> DenseRow;
+
+  /// Sets product to the coordinates of var times the element of R/I with
+  /// coordinates vector.
+  void multiply(
+    const DenseRow& vector,
+    VarIndex var,
+    DenseRow& product
+  ) const;
+
+  const PolyRing& mRing;
+  const VarIndex mVarCount;
+  size_t mStandardCount;
+
+  /// Row i of mMultiply[var] has the coordinates of var times standard
+  /// monomial i, where the coordinate of standard monomial j is in
+  /// column j.
+  std::vector<SparseMatrix> mMultiply;
+};
+
+MATHICGB_NAMESPACE_END
+#endif
@@ -6,6 +6,7 @@
 #include "Atomic.hpp"
 #include "mtbb.hpp"
 #include "PolyRing.hpp"
+#include "MemoryBudget.hpp"
 #include <memtailor.h>
 #include <limits>
 #include <vector>
@@ -44,8 +45,11 @@ public:
       make_unique_array<Atomic<Node*>>(hashMaskToBucketCount(mHashToIndexMask))
     ),
     mRing(ring),
-    mNodeAlloc(sizeofNode(ring))
+    mNodeAlloc(sizeofNode(ring)),
+    mNodeBytes(0)
   {
+    MemoryBudget::singleton().allocated
+      (MemoryBudget::MonomialMaps, bucketMemoryUse());
     // Calling new int[x] does not zero the array. std::atomic has a trivial
     // constructor so the same thing is true of new atomic[x]. Calling
     // new int[x]() is supposed to zero initialize but this apparently
@@ -72,8 +76,13 @@ public:
       make_unique_array<Atomic<Node*>>(hashMaskToBucketCount(mHashToIndexMask))
     ),
     mRing(map.ring()),
-    mNodeAlloc(std::move(map.mNodeAlloc))
+    mNodeAlloc(std::move(map.mNodeAlloc)),
+    mNodeBytes(map.mNodeBytes)
   {
+    // The nodes of map are now ours, so map does not report them as freed.
+    map.mNodeBytes = 0;
+    MemoryBudget::singleton().allocated
+      (MemoryBudget::MonomialMaps, bucketMemoryUse());
     // We can store relaxed as the constructor does not run concurrently.
     setTableEntriesToNullRelaxed();
     const auto tableEnd = map.mBuckets.get() + map.bucketCount();
@@ -88,6 +97,11 @@ public:
     }
   }
 
+  ~FixedSizeMonomialMap() {
+    MemoryBudget::singleton().freed
+      (MemoryBudget::MonomialMaps, bucketMemoryUse() + mNodeBytes);
+  }
+
   /// Return how many buckets the hash table has.
   size_t bucketCount() const {
     return hashMaskToBucketCount(mHashToIndexMask);
@@ -194,6 +208,9 @@ public:
     }
 
     const auto node = static_cast<Node*>(mNodeAlloc.alloc());
+    mNodeBytes += sizeofNode(ring());
+    MemoryBudget::singleton().allocated
+      (MemoryBudget::MonomialMaps, sizeofNode(ring()));
     const size_t index = hashToIndex(mRing.monomialHashValue(value.first));
     // the constructor initializes the first field of node->mono, so
     // it has to be called before copying the monomial.
@@ -229,6 +246,8 @@ public:
     // we have no way to know when it is safe to deallocate the monomials
     // since readers do no synchronization.
     mNodeAlloc.freeAllBuffers();
+    MemoryBudget::singleton().freed(MemoryBudget::MonomialMaps, mNodeBytes);
+    mNodeBytes = 0;
   }
 
 private:
@@ -273,6 +292,10 @@ private:
     return sizeof(Node) - sizeof(exponent) + ring.maxMonomialByteSize();
   }
 
+  size_t bucketMemoryUse() const {
+    return bucketCount() * sizeof(Atomic<Node*>);
+  }
+
   size_t hashToIndex(HashValue hash) const {
     const auto index = hash & mHashToIndexMask;
     MATHICGB_ASSERT(index == hash % bucketCount());
@@ -293,6 +316,7 @@ private:
   std::unique_ptr<Atomic<Node*>[]> const mBuckets;
   const PolyRing& mRing;
   memt::BufferPool mNodeAlloc; // nodes are allocated from here.
+  size_t mNodeBytes; // bytes of the nodes, as reported to MemoryBudget.
   mgb::mtbb::mutex mInsertionMutex;
 
 public:
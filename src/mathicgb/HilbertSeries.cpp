@@ -0,0 +1,208 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#include "stdinc.h"
+#include "HilbertSeries.hpp"
+
+#include "PolyBasis.hpp"
+#include <algorithm>
+
+MATHICGB_NAMESPACE_BEGIN
+
+namespace {
+  typedef HilbertSeries::VarIndex VarIndex;
+  typedef HilbertSeries::Exponent Exponent;
+  typedef std::vector<Exponent> Mono;
+  typedef std::vector<BigInt> Numerator;
+
+  Exponent degree(const Mono& mono) {
+    Exponent sum = 0;
+    for (auto it = mono.begin(); it != mono.end(); ++it)
+      sum += *it;
+    return sum;
+  }
+
+  bool divides(const Mono& divisor, const Mono& mono) {
+    for (size_t var = 0; var < mono.size(); ++var)
+      if (divisor[var] > mono[var])
+        return false;
+    return true;
+  }
+
+  // Removes the generators that are divisible by another generator and
+  // all but one of each set of equal generators.
+  void minimize(std::vector<Mono>& gens) {
+    std::sort(gens.begin(), gens.end(), [](const Mono& a, const Mono& b) {
+      return degree(a) < degree(b);
+    });
+    std::vector<Mono> minimal;
+    for (auto it = gens.begin(); it != gens.end(); ++it) {
+      bool isMinimal = true;
+      for (auto m = minimal.begin(); m != minimal.end(); ++m) {
+        if (divides(*m, *it)) {
+          isMinimal = false;
+          break;
+        }
+      }
+      if (isMinimal)
+        minimal.push_back(std::move(*it));
+    }
+    gens.swap(minimal);
+  }
+
+  // Adds t^shift * a to sum.
+  void addShifted(Numerator& sum, const Numerator& a, size_t shift) {
+    if (sum.size() < a.size() + shift)
+      sum.resize(a.size() + shift);
+    for (size_t i = 0; i < a.size(); ++i)
+      sum[i + shift] = sum[i + shift] + a[i];
+  }
+
+  // Returns true if no variable other than var appears in mono.
+  bool isPurePower(const Mono& mono, VarIndex var) {
+    for (VarIndex other = 0; other < mono.size(); ++other)
+      if (other != var && mono[other] != 0)
+        return false;
+    return true;
+  }
+
+  // Returns the numerator of the Hilbert series of R/I where the minimal
+  // generators of I are gens. This is the pivot algorithm of Bigatti: for
+  // a monomial p the numerator of I is the numerator of I + (p) plus
+  // t^deg(p) times the numerator of I : p.
+  Numerator hilbertNumerator(
+    std::vector<Mono>& gens,
+    const VarIndex varCount
+  ) {
+    if (gens.empty())
+      return Numerator(1, BigInt(1));
+
+    // Pivot on the variable that appears in the most generators.
+    std::vector<size_t> counts(varCount);
+    for (auto it = gens.begin(); it != gens.end(); ++it)
+      for (VarIndex var = 0; var < varCount; ++var)
+        if ((*it)[var] != 0)
+          ++counts[var];
+    const auto pivotVar = static_cast<VarIndex>
+      (std::max_element(counts.begin(), counts.end()) - counts.begin());
+
+    if (counts[pivotVar] <= 1) {
+      // The generators are pairwise relatively prime, so the numerator is
+      // the product of 1 - t^deg(g) over the generators g.
+      Numerator product(1, BigInt(1));
+      for (auto it = gens.begin(); it != gens.end(); ++it) {
+        const auto deg = static_cast<size_t>(degree(*it));
+        Numerator next(product);
+        next.resize(product.size() + deg);
+        for (size_t i = 0; i < product.size(); ++i)
+          next[i + deg] = next[i + deg] - product[i];
+        product.swap(next);
+      }
+      return product;
+    }
+
+    // Pivot on the median exponent of the variable among the generators
+    // that are not pure powers of the variable. Then the pivot is not in I,
+    // I + (p) has fewer generators that are not pure powers and I : p has
+    // generators of lower degree, so the recursion terminates.
+    std::vector<Exponent> exponents;
+    for (auto it = gens.begin(); it != gens.end(); ++it)
+      if ((*it)[pivotVar] != 0 && !isPurePower(*it, pivotVar))
+        exponents.push_back((*it)[pivotVar]);
+    MATHICGB_ASSERT(!exponents.empty());
+    std::nth_element(
+      exponents.begin(),
+      exponents.begin() + exponents.size() / 2,
+      exponents.end()
+    );
+    const auto pivotExponent = exponents[exponents.size() / 2];
+
+    std::vector<Mono> colon;
+    std::vector<Mono> sum;
+    for (auto it = gens.begin(); it != gens.end(); ++it) {
+      colon.push_back(*it);
+      auto& e = colon.back()[pivotVar];
+      e = std::max<Exponent>(e - pivotExponent, 0);
+      if ((*it)[pivotVar] < pivotExponent)
+        sum.push_back(std::move(*it));
+    }
+    gens.clear();
+    Mono pivot(varCount);
+    pivot[pivotVar] = pivotExponent;
+    sum.push_back(std::move(pivot));
+    minimize(sum);
+    minimize(colon);
+
+    auto result = hilbertNumerator(sum, varCount);
+    const auto shift = static_cast<size_t>(pivotExponent);
+    addShifted(result, hilbertNumerator(colon, varCount), shift);
+    return result;
+  }
+
+  // Returns n choose k.
+  BigInt binomial(const int64 n, const int64 k) {
+    if (k < 0 || n < k)
+      return BigInt(0);
+    BigInt result(1);
+    for (int64 i = 1; i <= k; ++i)
+      result = result * BigInt(n - k + i) / BigInt(i);
+    return result;
+  }
+}
+
+HilbertSeries::HilbertSeries(VarIndex varCount, std::vector<BigInt> numerator):
+  mVarCount(varCount),
+  mNumerator(std::move(numerator))
+{
+  normalize();
+}
+
+HilbertSeries HilbertSeries::fromMonomialIdeal(
+  const VarIndex varCount,
+  const std::vector<Exponent>& exponents
+) {
+  MATHICGB_ASSERT(varCount == 0 || exponents.size() % varCount == 0);
+  std::vector<Mono> gens;
+  if (varCount != 0)
+    for (auto it = exponents.begin(); it != exponents.end(); it += varCount)
+      gens.push_back(Mono(it, it + varCount));
+  minimize(gens);
+  return HilbertSeries(varCount, hilbertNumerator(gens, varCount));
+}
+
+HilbertSeries HilbertSeries::fromLeadMonomials(const PolyBasis& basis) {
+  const auto& monoid = basis.ring().monoid();
+  const auto varCount = monoid.varCount();
+  std::vector<Exponent> exponents;
+  for (size_t i = 0; i < basis.size(); ++i) {
+    if (basis.retired(i))
+      continue;
+    const auto lead = basis.leadMonomial(i);
+    for (VarIndex var = 0; var < varCount; ++var)
+      exponents.push_back(monoid.externalExponent(lead, var));
+  }
+  return fromMonomialIdeal(varCount, exponents);
+}
+
+BigInt HilbertSeries::hilbertFunction(const Exponent degree) const {
+  // The coefficient of t^d in 1 / (1 - t)^n is (d + n - 1) choose (n - 1).
+  BigInt value(0);
+  for (size_t k = 0; k < mNumerator.size(); ++k) {
+    if (static_cast<Exponent>(k) > degree)
+      break;
+    if (mNumerator[k].isZero())
+      continue;
+    const int64 n = mVarCount;
+    const int64 d = degree - static_cast<int64>(k);
+    const auto count = n == 0 ?
+      BigInt(d == 0 ? 1 : 0) : binomial(d + n - 1, n - 1);
+    value = value + mNumerator[k] * count;
+  }
+  return value;
+}
+
+void HilbertSeries::normalize() {
+  while (!mNumerator.empty() && mNumerator.back().isZero())
+    mNumerator.pop_back();
+}
+
+MATHICGB_NAMESPACE_END
@@ -0,0 +1,63 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#ifndef MATHICGB_HILBERT_SERIES_GUARD
+#define MATHICGB_HILBERT_SERIES_GUARD
+
+#include "BigInt.hpp"
+#include "PolyRing.hpp"
+#include <vector>
+
+MATHICGB_NAMESPACE_BEGIN
+
+class PolyBasis;
+
+/// The Hilbert series of R/I where R is a polynomial ring in varCount
+/// variables with the standard grading and I is a homogeneous ideal. The
+/// series is stored as the numerator N(t) of N(t) / (1 - t)^varCount.
+///
+/// R/I and R/in(I) have the same Hilbert series for any monomial order, so
+/// the series can be computed from the lead monomials of a Groebner basis,
+/// such as one computed modulo another prime or for another order.
+class HilbertSeries {
+public:
+  typedef PolyRing::Monoid::VarIndex VarIndex;
+  typedef PolyRing::Monoid::Exponent Exponent;
+
+  /// numerator[k] is the coefficient of t^k in the numerator.
+  HilbertSeries(VarIndex varCount, std::vector<BigInt> numerator);
+
+  /// Returns the Hilbert series of R/I where I is generated by monomials
+  /// whose exponent vectors are placed one after the other in exponents.
+  static HilbertSeries fromMonomialIdeal(
+    VarIndex varCount,
+    const std::vector<Exponent>& exponents
+  );
+
+  /// Returns the Hilbert series of R/J where J is generated by the lead
+  /// monomials of the basis elements that are not retired.
+  static HilbertSeries fromLeadMonomials(const PolyBasis& basis);
+
+  VarIndex varCount() const {return mVarCount;}
+  const std::vector<BigInt>& numerator() const {return mNumerator;}
+
+  /// Returns the dimension of the degree part of R/I.
+  BigInt hilbertFunction(Exponent degree) const;
+
+  bool operator==(const HilbertSeries& series) const {
+    return mVarCount == series.mVarCount && mNumerator == series.mNumerator;
+  }
+
+  bool operator!=(const HilbertSeries& series) const {
+    return !(*this == series);
+  }
+
+private:
+  /// Removes trailing zero coefficients from mNumerator.
+  void normalize();
+
+  VarIndex mVarCount;
+  std::vector<BigInt> mNumerator;
+};
+
+MATHICGB_NAMESPACE_END
+#endif
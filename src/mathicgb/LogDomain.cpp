@@ -23,21 +23,47 @@ LogDomain<true>::LogDomain(
   mOriginallyStreamEnabled(streamEnabled),
   mName(name),
   mDescription(description),
-  mInterval(),
   mHasTime(false),
-  mCount(0),
-  mHasCount(false)
+  mHasCount(false),
+  mHasPerfCounts(false)
 {
+  for (size_t i = 0; i < ShardCount; ++i) {
+    mShards[i].count.store(0, std::memory_order_relaxed);
+    mShards[i].nanoseconds.store(0, std::memory_order_relaxed);
+  }
+  for (size_t i = 0; i < PerfCounters::EventCount; ++i)
+    mPerfCounts[i].store(0, std::memory_order_relaxed);
   LogDomainSet::singleton().registerLogDomain(*this);
 }
 
 void LogDomain<true>::reset() {
   mEnabled = mOriginallyEnabled;
   mStreamEnabled = mOriginallyStreamEnabled;
-  mInterval = TimeInterval();
-  mHasTime = false;
-  mCount = 0;
-  mHasCount = false;
+  for (size_t i = 0; i < ShardCount; ++i) {
+    mShards[i].count.store(0, std::memory_order_relaxed);
+    mShards[i].nanoseconds.store(0, std::memory_order_relaxed);
+  }
+  for (size_t i = 0; i < PerfCounters::EventCount; ++i)
+    mPerfCounts[i].store(0, std::memory_order_relaxed);
+  mHasTime.store(false, std::memory_order_relaxed);
+  mHasCount.store(false, std::memory_order_relaxed);
+  mHasPerfCounts.store(false, std::memory_order_relaxed);
+}
+
+LogDomain<true>::Counter LogDomain<true>::count() const {
+  Counter sum = 0;
+  for (size_t i = 0; i < ShardCount; ++i)
+    sum += mShards[i].count.load(std::memory_order_relaxed);
+  return sum;
+}
+
+void LogDomain<true>::setCount(const Counter counter) {
+  if (!enabled())
+    return;
+  mShards[0].count.store(counter, std::memory_order_relaxed);
+  for (size_t i = 1; i < ShardCount; ++i)
+    mShards[i].count.store(0, std::memory_order_relaxed);
+  noteHasCount();
 }
 
 std::ostream& LogDomain<true>::stream() {
@@ -49,7 +75,10 @@ LogDomain<true>::Timer LogDomain<true>::timer() {
 }
 
 double LogDomain<true>::loggedSecondsReal() const {
-  return mInterval.realSeconds;
+  Counter nanoseconds = 0;
+  for (size_t i = 0; i < ShardCount; ++i)
+    nanoseconds += mShards[i].nanoseconds.load(std::memory_order_relaxed);
+  return nanoseconds / 1e9;
 }
 
 void LogDomain<true>::TimeInterval::print(std::ostream& out) const {
@@ -66,8 +95,11 @@ void LogDomain<true>::TimeInterval::print(std::ostream& out) const {
 void LogDomain<true>::recordTime(TimeInterval interval) {
   if (!enabled())
     return;
-  mInterval.realSeconds += interval.realSeconds;
-  mHasTime = true;
+  const auto nanoseconds = static_cast<Counter>(interval.realSeconds * 1e9);
+  mShards[shardIndex()].nanoseconds.fetch_add
+    (nanoseconds, std::memory_order_relaxed);
+  if (!mHasTime.load(std::memory_order_relaxed))
+    mHasTime.store(true, std::memory_order_relaxed);
 
   if (streamEnabled()) {
     MATHICGB_ASSERT(mName != 0);
@@ -77,6 +109,17 @@ void LogDomain<true>::recordTime(TimeInterval interval) {
   }
 }
 
+void LogDomain<true>::recordPerfCounts(
+  const Counter counts[PerfCounters::EventCount]
+) {
+  if (!enabled())
+    return;
+  for (size_t i = 0; i < PerfCounters::EventCount; ++i)
+    mPerfCounts[i].fetch_add(counts[i], std::memory_order_relaxed);
+  if (!mHasPerfCounts.load(std::memory_order_relaxed))
+    mHasPerfCounts.store(true, std::memory_order_relaxed);
+}
+
 LogDomain<true>::Timer::Timer(LogDomain<true>& logger):
   mLogger(logger),
   mTimerRunning(false),
@@ -85,6 +128,15 @@ LogDomain<true>::Timer::Timer(LogDomain<true>& logger):
   start();
 }
 
+LogDomain<true>::Timer::Timer(Timer&& timer):
+  mLogger(timer.mLogger),
+  mTimerRunning(timer.mTimerRunning),
+  mRealTicks(timer.mRealTicks),
+  mPerfCounters(std::move(timer.mPerfCounters))
+{
+  timer.mTimerRunning = false;
+}
+
 LogDomain<true>::Timer::~Timer() {
   stop();
 }
@@ -93,11 +145,30 @@ void LogDomain<true>::Timer::stop() {
   if (!running())
     return;
   mTimerRunning = false;
+  const auto now = mgb::mtbb::tick_count::now();
+
+  // Read the counters first so that the code below is not counted.
+  PerfCounters::Counter counts[PerfCounters::EventCount];
+  const bool counted =
+    mPerfCounters.get() != 0 && mPerfCounters->stop(counts);
+
+  LogDomainSet::TraceArgs args;
+  if (counted) {
+    for (size_t i = 0; i < PerfCounters::EventCount; ++i) {
+      const auto event = static_cast<PerfCounters::Event>(i);
+      args.push_back(std::make_pair
+        (PerfCounters::eventName(event), static_cast<double>(counts[i])));
+    }
+  }
+  LogDomainSet::singleton().recordTraceEvent
+    (mLogger.name(), 'E', std::move(args));
   if (!mLogger.enabled())
     return;
   TimeInterval interval;
-  interval.realSeconds = (mgb::mtbb::tick_count::now() - mRealTicks).seconds();
+  interval.realSeconds = (now - mRealTicks).seconds();
   mLogger.recordTime(interval);
+  if (counted)
+    mLogger.recordPerfCounts(counts);
   return;
 }
 
@@ -105,6 +176,13 @@ void LogDomain<true>::Timer::start() {
   if (!mLogger.enabled() || mTimerRunning)
     return;
   mTimerRunning = true;
+  LogDomainSet::singleton().recordTraceEvent(mLogger.name(), 'B');
+  if (LogDomainSet::singleton().perfCounting()) {
+    if (mPerfCounters.get() == 0)
+      mPerfCounters = make_unique<PerfCounters>();
+    mPerfCounters->start();
+  } else
+    mPerfCounters.reset();
   mRealTicks = mgb::mtbb::tick_count::now();
 }
 
@@ -4,6 +4,11 @@
 #define MATHICGB_LOG_DOMAIN_GUARD
 
 #include "mtbb.hpp"
+#include "PerfCounters.hpp"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <functional>
 #include <ostream>
 #include <ctime>
 #include <sstream>
@@ -23,6 +28,12 @@ MATHICGB_NAMESPACE_BEGIN
 /// Compile-time enabled loggers automatically register themselves at start-up
 /// with LogDomainSet::singleton().
 ///
+/// Counts and times can be recorded from several threads at the same time.
+/// They are kept in a number of shards that each sit on their own cache
+/// line and each thread adds to the shard given by its thread id, so
+/// threads rarely touch the same cache line. Reading the count or time adds
+/// up the shards.
+///
 /// @todo: support turning all loggers off globally with a macro, regardless
 /// of their individual compile-time on/off setting.
 
@@ -61,24 +72,43 @@ public:
   /// Returns true if any time has been logged on this logger, even if the
   /// duration of that time was zero (that is., less than the resolution
   /// of the timer).
-  bool hasTime() const {return mHasTime;}
+  bool hasTime() const {return mHasTime.load(std::memory_order_relaxed);}
 
   double loggedSecondsReal() const;
 
 
   typedef unsigned long long Counter;
 
-  Counter count() const {return mCount;}
+  Counter count() const;
+
+  /// Sets the count. Do not call this while other threads are changing the
+  /// count.
+  void setCount(const Counter counter);
+
+  /// Adds by to the count. Can be called from several threads at the same
+  /// time.
+  void increment(const Counter by) {
+    if (!enabled())
+      return;
+    mShards[shardIndex()].count.fetch_add(by, std::memory_order_relaxed);
+    noteHasCount();
+  }
+
+  /// Returns true if setCount or increment has been called.
+  bool hasCount() const {return mHasCount.load(std::memory_order_relaxed);}
 
-  void setCount(const Counter counter) {
-    if (enabled()) {
-      mCount = counter;
-      mHasCount = true;
-    }
+  /// Returns true if a timer on this logger has recorded hardware
+  /// performance counters. See LogDomainSet::perfCounting().
+  bool hasPerfCounts() const {
+    return mHasPerfCounts.load(std::memory_order_relaxed);
   }
 
-  /// Returns true if setCount has been called.
-  bool hasCount() const {return mHasCount;}
+  /// Returns the sum of the counts of event over the timers on this logger
+  /// that have recorded performance counters.
+  Counter perfCount(PerfCounters::Event event) const {
+    MATHICGB_ASSERT(event < PerfCounters::EventCount);
+    return mPerfCounts[event].load(std::memory_order_relaxed);
+  }
 
   /// Resets this object to the state it had when it was
   /// constructed.
@@ -93,6 +123,40 @@ private:
     void print(std::ostream& out) const;
   };
   void recordTime(TimeInterval interval);
+  void recordPerfCounts(const Counter counts[PerfCounters::EventCount]);
+
+  void noteHasCount() {
+    // Only store if needed so that the cache line is not written to all
+    // the time.
+    if (!mHasCount.load(std::memory_order_relaxed))
+      mHasCount.store(true, std::memory_order_relaxed);
+  }
+
+  static const size_t ShardBits = 5;
+  static const size_t ShardCount = static_cast<size_t>(1) << ShardBits;
+
+  /// Returns the shard for the calling thread. The index is computed once
+  /// per thread.
+  static size_t shardIndex() {
+    static thread_local const size_t index = computeShardIndex();
+    return index;
+  }
+
+  static size_t computeShardIndex() {
+    const auto id = std::hash<std::thread::id>()(std::this_thread::get_id());
+    // Thread ids are often aligned addresses, so mix the bits and use the
+    // high bits of the product.
+    const auto mixed = static_cast<uint64>(id) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(mixed >> (64 - ShardBits));
+  }
+
+  /// The part of the count and time recorded by the threads that use this
+  /// shard. Time is in nanoseconds so that it can be added atomically.
+  /// Each shard has a cache line of its own.
+  struct alignas(64) Shard {
+    std::atomic<Counter> count;
+    std::atomic<Counter> nanoseconds;
+  };
 
   bool mEnabled;
   const bool mOriginallyEnabled;
@@ -101,11 +165,12 @@ private:
   const char* mName;
   const char* mDescription;
 
-  TimeInterval mInterval; /// Total amount of time recorded on this log.
-  bool mHasTime; /// Whether any time has been registered (even if 0s).
+  Shard mShards[ShardCount]; /// The count and time recorded on this log.
+  std::atomic<bool> mHasTime; /// Whether any time has been registered.
+  std::atomic<bool> mHasCount; /// Whether the count has been set.
 
-  Counter mCount;
-  bool mHasCount; /// Whether the count has been set (even if set to zero)
+  std::atomic<Counter> mPerfCounts[PerfCounters::EventCount];
+  std::atomic<bool> mHasPerfCounts;
 };
 
 class LogDomain<true>::Timer {
@@ -114,19 +179,24 @@ public:
   /// once the timer is stopped or destructed.
   Timer(LogDomain<true>& logger);
 
+  Timer(Timer&& timer);
+
   /// Stops the timer.
   ~Timer();
 
   /// Returns true if the timer is currently recording time.
   bool running() const {return mTimerRunning;}
 
-  /// Stops recording time and logs the elapsed time to the logger.
+  /// Stops recording time and logs the elapsed time to the logger. Also
+  /// logs the performance counters if they were started.
   ///
   /// This is a no-op if the timer is not running. If the logger
   /// is disabled then no time is logged.
   void stop();
 
-  /// Start recording time on a stopped timer.
+  /// Start recording time on a stopped timer. This also starts the
+  /// hardware performance counters if LogDomainSet::perfCounting() is true
+  /// and the counters are available.
   ///
   /// This is a no-op if the timer is already running or if the logger is
   /// disabled.
@@ -136,6 +206,7 @@ private:
   LogDomain<true>& mLogger;
   bool mTimerRunning;
   mtbb::tick_count mRealTicks; // high precision
+  std::unique_ptr<PerfCounters> mPerfCounters; // null if not counting
 };
 
 /// This is a compile-time disabled logger. You are not supposed to dynamically
@@ -172,6 +243,7 @@ public:
   typedef unsigned long long Counter;
   Counter count() const {return 0;}
   void setCount(const Counter counter) {MATHICGB_ASSERT(false);}
+  void increment(const Counter /*by*/) {MATHICGB_ASSERT(false);}
   bool hasCount() const {return false;}
   void reset() {}
 };
@@ -316,7 +388,9 @@ MATHICGB_NAMESPACE_END
 
 /// Increments the count of DOMAIN by the value of the expression BY. The
 /// expression BY is evaluated at most once and it is not evaluated if
-/// DOMAIN is disabled.
+/// DOMAIN is disabled. This is safe to do from several threads at the same
+/// time. In a hot loop, add up the increments in a local variable and log
+/// the sum once at the end.
 ///
 /// Example:
 ///   MATHICGB_LOG_INCREMENT_BY(MyDomain, 3);
@@ -324,7 +398,7 @@ MATHICGB_NAMESPACE_END
   do { \
     auto& MGBLOG_log = MATHICGB_LOGGER(DOMAIN); \
     if (MGBLOG_log.enabled()) { \
-      MGBLOG_log.setCount(MGBLOG_log.count() + BY); \
+      MGBLOG_log.increment(BY); \
     } \
   } while (false)
 
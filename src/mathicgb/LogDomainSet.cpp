@@ -4,6 +4,29 @@
 #include "LogDomainSet.hpp"
 
 #include <mathic.h>
+#include <fstream>
+#include <cmath>
+
+MATHICGB_DEFINE_LOG_DOMAIN(
+  ChromeTrace,
+  "Writes the timed phases of the enabled logs and statistics on F4 "
+  "matrices and S-pairs to mgb-trace.json in the Chrome trace-event JSON "
+  "format."
+);
+
+MATHICGB_DEFINE_LOG_DOMAIN(
+  JsonTrace,
+  "As ChromeTrace but writes line-delimited JSON to mgb-trace.jsonl."
+);
+
+MATHICGB_DEFINE_LOG_DOMAIN(
+  PerfCounters,
+  "Records the hardware performance counters cycles, instructions, last "
+  "level cache misses and branch misses during each timer of an enabled "
+  "log, summed over the thread that runs the timer and the threads that "
+  "run tasks. Needs Linux perf events. Only time is recorded if those are "
+  "not available."
+);
 
 MATHICGB_NAMESPACE_BEGIN
 
@@ -119,6 +142,7 @@ void LogDomainSet::performLogCommandInternal(
 void LogDomainSet::printReport(std::ostream& out) const {
   printCountReport(out);
   printTimeReport(out);
+  printPerfReport(out);
 }
 
 void LogDomainSet::printCountReport(std::ostream& out) const {
@@ -199,8 +223,185 @@ void LogDomainSet::printTimeReport(std::ostream& out) const {
   out.flags(oldFlags);
 }
 
+void LogDomainSet::printPerfReport(std::ostream& out) const {
+  if (!perfCounting())
+    return;
+
+  mathic::ColumnPrinter pr;
+  auto& names = pr.addColumn(true);
+  auto& cycles = pr.addColumn(false);
+  auto& instructions = pr.addColumn(false);
+  auto& ipc = pr.addColumn(false);
+  auto& cacheMisses = pr.addColumn(false);
+  auto& missRate = pr.addColumn(false);
+  auto& branchMisses = pr.addColumn(false);
+  ipc.precision(2);
+  ipc << std::fixed;
+  missRate.precision(2);
+  missRate << std::fixed;
+
+  names << "Log name  \n";
+  cycles << "  " << PerfCounters::eventName(PerfCounters::Cycles) << '\n';
+  instructions << "  "
+    << PerfCounters::eventName(PerfCounters::Instructions) << '\n';
+  ipc << "  IPC\n";
+  cacheMisses << "  "
+    << PerfCounters::eventName(PerfCounters::CacheMisses) << '\n';
+  missRate << "  LLC misses/1k instr\n";
+  branchMisses << "  "
+    << PerfCounters::eventName(PerfCounters::BranchMisses) << '\n';
+  pr.repeatToEndOfLine('-');
+
+  bool somethingToReport = false;
+  const auto end = logDomains().cend();
+  for (auto it = logDomains().cbegin(); it != end; ++it) {
+    const auto& log = **it;
+    if (!log.enabled() || !log.hasPerfCounts())
+      continue;
+    somethingToReport = true;
+
+    const auto cycleCount = log.perfCount(PerfCounters::Cycles);
+    const auto instructionCount = log.perfCount(PerfCounters::Instructions);
+    const auto missCount = log.perfCount(PerfCounters::CacheMisses);
+    names << log.name() << "  \n";
+    cycles << "  " << mathic::ColumnPrinter::commafy(cycleCount) << '\n';
+    instructions << "  "
+      << mathic::ColumnPrinter::commafy(instructionCount) << '\n';
+    ipc << "  " << (cycleCount == 0 ? 0.0 :
+      static_cast<double>(instructionCount) / cycleCount) << '\n';
+    cacheMisses << "  " << mathic::ColumnPrinter::commafy(missCount) << '\n';
+    missRate << "  " << (instructionCount == 0 ? 0.0 :
+      1000.0 * missCount / instructionCount) << '\n';
+    branchMisses << "  " << mathic::ColumnPrinter::commafy
+      (log.perfCount(PerfCounters::BranchMisses)) << '\n';
+  }
+  if (!somethingToReport) {
+    out << "***** Performance counter report *****\n"
+      "Hardware performance counters are not available, so only time was "
+      "recorded.\n\n";
+    return;
+  }
+
+  out << "***** Performance counter report *****\n"
+    "Counts are summed over the threads that ran while each timer ran.\n\n"
+    << pr << '\n';
+}
+
+bool LogDomainSet::perfCounting() const {
+  return MATHICGB_LOGGER(PerfCounters).enabled();
+}
+
+bool LogDomainSet::tracing() const {
+  return
+    MATHICGB_LOGGER(ChromeTrace).enabled() ||
+    MATHICGB_LOGGER(JsonTrace).enabled();
+}
+
+void LogDomainSet::recordTraceEvent(
+  const char* name,
+  char phase,
+  TraceArgs args
+) {
+  MATHICGB_ASSERT(name != 0);
+  MATHICGB_ASSERT(phase == 'B' || phase == 'E' || phase == 'i');
+  if (!tracing())
+    return;
+  const auto now = mgb::mtbb::tick_count::now();
+  const auto id = std::this_thread::get_id();
+
+  const mgb::mtbb::mutex::scoped_lock lockGuard(mTraceMutex);
+  TraceEvent event;
+  event.name = name;
+  event.phase = phase;
+  event.thread = std::find(mTraceThreads.begin(), mTraceThreads.end(), id) -
+    mTraceThreads.begin();
+  if (event.thread == mTraceThreads.size())
+    mTraceThreads.push_back(id);
+  event.microseconds = (now - mStartTime).seconds() * 1e6;
+  event.args = std::move(args);
+  mTraceEvents.push_back(std::move(event));
+}
+
+void LogDomainSet::writeTraceEvent(
+  const TraceEvent& event,
+  std::ostream& out
+) {
+  // The names are identifiers and string literals from the source code, so
+  // they do not need escaping.
+  out << "{\"name\":\"" << event.name << "\",\"ph\":\"" << event.phase
+    << "\",\"ts\":";
+  writeJsonNumber(event.microseconds, out);
+  out << ",\"pid\":1,\"tid\":" << event.thread;
+  if (event.phase == 'i')
+    out << ",\"s\":\"t\"";
+  if (!event.args.empty()) {
+    out << ",\"args\":{";
+    for (auto it = event.args.begin(); it != event.args.end(); ++it) {
+      if (it != event.args.begin())
+        out << ',';
+      out << '"' << it->first << "\":";
+      writeJsonNumber(it->second, out);
+    }
+    out << '}';
+  }
+  out << '}';
+}
+
+void LogDomainSet::writeJsonNumber(const double value, std::ostream& out) {
+  if (std::isfinite(value))
+    out << value;
+  else
+    out << "null";
+}
+
+void LogDomainSet::writeChromeTrace(std::ostream& out) const {
+  const mgb::mtbb::mutex::scoped_lock lockGuard(mTraceMutex);
+  const auto oldPrecision = out.precision();
+  out.precision(15);
+  out << "{\"traceEvents\":[\n";
+  for (auto it = mTraceEvents.begin(); it != mTraceEvents.end(); ++it) {
+    if (it != mTraceEvents.begin())
+      out << ",\n";
+    writeTraceEvent(*it, out);
+  }
+  out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  out.precision(oldPrecision);
+}
+
+void LogDomainSet::writeJsonTrace(std::ostream& out) const {
+  const mgb::mtbb::mutex::scoped_lock lockGuard(mTraceMutex);
+  const auto oldPrecision = out.precision();
+  out.precision(15);
+  for (auto it = mTraceEvents.begin(); it != mTraceEvents.end(); ++it) {
+    writeTraceEvent(*it, out);
+    out << '\n';
+  }
+  out.precision(oldPrecision);
+}
+
+void LogDomainSet::writeTraceFiles() const {
+  const auto write = [&](
+    const char* fileName,
+    void (LogDomainSet::*writer)(std::ostream&) const
+  ) {
+    std::ofstream out(fileName);
+    if (!out)
+      mathic::reportError(std::string("Could not open ") + fileName + '.');
+    (this->*writer)(out);
+  };
+  if (MATHICGB_LOGGER(ChromeTrace).enabled())
+    write("mgb-trace.json", &LogDomainSet::writeChromeTrace);
+  if (MATHICGB_LOGGER(JsonTrace).enabled())
+    write("mgb-trace.jsonl", &LogDomainSet::writeJsonTrace);
+}
+
 void LogDomainSet::reset() {
   mStartTime = mgb::mtbb::tick_count::now();
+  {
+    const mgb::mtbb::mutex::scoped_lock lockGuard(mTraceMutex);
+    mTraceEvents.clear();
+    mTraceThreads.clear();
+  }
   const auto end = logDomains().cend();
   for (auto it = logDomains().cbegin(); it != end; ++it) {
     MATHICGB_ASSERT(*it != 0);
@@ -10,6 +10,7 @@
 #include <algorithm>
 #include <cstring>
 #include <ostream>
+#include <thread>
 
 MATHICGB_NAMESPACE_BEGIN
 
@@ -66,6 +67,46 @@ public:
   void printTimeReport(std::ostream& out) const;
   void printCountReport(std::ostream& out) const;
 
+  /// Prints the hardware performance counters recorded by the timers of
+  /// the enabled logs. Does nothing if perfCounting() is false.
+  void printPerfReport(std::ostream& out) const;
+
+  /// Returns true if timers record hardware performance counters along with
+  /// the time. That is the case when the log PerfCounters is enabled.
+  bool perfCounting() const;
+
+  /// The numbers attached to a trace event, as pairs of name and value.
+  typedef std::vector<std::pair<const char*, double>> TraceArgs;
+
+  /// Returns true if trace events are recorded. That is the case when the
+  /// log ChromeTrace or the log JsonTrace is enabled.
+  bool tracing() const;
+
+  /// Records an event for the calling thread at the current time if
+  /// tracing() is true. Otherwise nothing is done. phase is 'B' for the
+  /// beginning of a timed phase, 'E' for its end and 'i' for an event that
+  /// reports the statistics in args. Timers of enabled logs record their
+  /// phases automatically. name and the names in args must be string
+  /// literals or otherwise live until the trace is written. Can be called
+  /// from several threads at the same time.
+  void recordTraceEvent(
+    const char* name,
+    char phase,
+    TraceArgs args = TraceArgs()
+  );
+
+  /// Writes the recorded trace events in the Chrome trace-event JSON
+  /// format, which can be loaded into chrome://tracing and other profilers.
+  void writeChromeTrace(std::ostream& out) const;
+
+  /// Writes the recorded trace events as line-delimited JSON, one event
+  /// per line, with the same fields as for writeChromeTrace().
+  void writeJsonTrace(std::ostream& out) const;
+
+  /// Writes the trace events to mgb-trace.json if the log ChromeTrace is
+  /// enabled and to mgb-trace.jsonl if the log JsonTrace is enabled.
+  void writeTraceFiles() const;
+
   /// Resets the logging system as though the program had just started up.
   /// This resets all counts, all recorded time and the enabledness of all logs.
   /// You should not have a timer running for a log when you call this method.
@@ -86,9 +127,29 @@ private:
   );
   LogDomainSet(); // private for singleton
 
+  struct TraceEvent {
+    const char* name;
+    char phase;
+    size_t thread; /// Threads are numbered 0, 1, 2 in order of appearance.
+    double microseconds; /// Time since mStartTime.
+    TraceArgs args;
+  };
+
+  /// Writes event as a JSON object.
+  static void writeTraceEvent(const TraceEvent& event, std::ostream& out);
+
+  /// Writes value as a JSON number, or as null if value is NaN or infinite
+  /// since JSON has no way to write those.
+  static void writeJsonNumber(double value, std::ostream& out);
+
   std::vector<LogDomain<true>*> mLogDomains;
   std::vector<std::pair<const char*, const char*>> mAliases;
   mgb::mtbb::tick_count mStartTime;
+
+  /// Only access these fields while holding mTraceMutex.
+  std::vector<TraceEvent> mTraceEvents;
+  std::vector<std::thread::id> mTraceThreads;
+  mutable mgb::mtbb::mutex mTraceMutex;
 };
 
 MATHICGB_NAMESPACE_END
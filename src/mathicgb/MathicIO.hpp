@@ -8,8 +8,12 @@
 #include "Scanner.hpp"
 #include "PolyRing.hpp"
 #include "MonoProcessor.hpp"
+#include "mtbb.hpp"
+#include <algorithm>
 #include <ostream>
 #include <string>
+#include <vector>
+#include <memory>
 
 MATHICGB_NAMESPACE_BEGIN
 
@@ -74,6 +78,22 @@ public:
     Scanner& in
   );
 
+  /// Reads a basis in the same format as readBasis(), but faster for large
+  /// inputs. All of the remaining input of in is read into memory at once
+  /// and cut into blocks of about blockBytes bytes at the whitespace between
+  /// polynomials. The blocks are parsed in parallel directly from memory
+  /// instead of one character at a time through Scanner. A polynomial is
+  /// only sorted if its terms are not already in descending order in the
+  /// input, which they are for bases that were written by writeBasis().
+  ///
+  /// The basis must be the last thing in the input.
+  Basis readBasisParallel(
+    const PolyRing& ring,
+    const bool readComponent,
+    Scanner& in,
+    const size_t blockBytes = 1024 * 1024
+  );
+
   void writeBasis(
     const Basis& basis,
     const bool writeComponent,
@@ -171,8 +191,268 @@ public:
     ConstMonoRef mono,
     std::ostream& out
   );
+
+private:
+  class TextReader;
+};
+
+/// Parses polynomials directly from text in memory for readBasisParallel().
+/// The syntax is the same as for readPoly(), except that a polynomial always
+/// ends at whitespace. Several threads can use the same TextReader.
+template<class M, class BF>
+class MathicIO<M, BF>::TextReader {
+public:
+  /// The whole text starts at textBegin and the first character of it is on
+  /// line firstLine. This is only used for error messages.
+  TextReader(
+    const PolyRing& ring,
+    const bool readComponent,
+    const char* const textBegin,
+    const uint64 firstLine
+  ):
+    mRing(ring),
+    mReadComponent(readComponent),
+    mTextBegin(textBegin),
+    mFirstLine(firstLine)
+  {}
+
+  /// Reads the whitespace-separated polynomials in [pos, end) and appends
+  /// them to polys. mono and previous are used as scratch space.
+  void readPolys(
+    const char* pos,
+    const char* const end,
+    MonoRef mono,
+    MonoRef previous,
+    std::vector<std::unique_ptr<Poly>>& polys
+  ) const {
+    while (true) {
+      pos = skipWhite(pos, end);
+      if (pos == end)
+        break;
+      const auto polyEnd = skipNonWhite(pos, end);
+      polys.push_back
+        (make_unique<Poly>(readPoly(pos, polyEnd, mono, previous)));
+      pos = polyEnd;
+    }
+  }
+
+  /// The same as std::isspace() in the C locale, but faster.
+  static bool isWhite(const char c) {
+    return c == ' ' || ('\t' <= c && c <= '\r');
+  }
+
+  static const char* skipWhite(const char* pos, const char* const end) {
+    while (pos != end && isWhite(*pos))
+      ++pos;
+    return pos;
+  }
+
+  static const char* skipNonWhite(const char* pos, const char* const end) {
+    while (pos != end && !isWhite(*pos))
+      ++pos;
+    return pos;
+  }
+
+  /// Reports a syntax error on the line that pos is on.
+  void reportError(const char* const pos, const std::string& msg) const {
+    reportSyntaxError(msg, mFirstLine + std::count(mTextBegin, pos, '\n'));
+  }
+
+private:
+  static bool isDigit(const char c) {return '0' <= c && c <= '9';}
+
+  static bool isLetter(const char c) {
+    return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z');
+  }
+
+  static bool isSign(const char c) {return c == '+' || c == '-';}
+
+  /// Reads the polynomial in [pos, end), which contains no whitespace.
+  Poly readPoly(
+    const char* pos,
+    const char* const end,
+    MonoRef mono,
+    MonoRef previous
+  ) const;
+
+  /// Reads the monomial part of a term and any component.
+  void readMonomial(const char*& pos, const char* const end, MonoRef mono)
+    const;
+
+  void readComponent(const char*& pos, const char* const end, MonoRef mono)
+    const;
+
+  /// Reads a non-negative integer. There must be a digit at pos.
+  template<class T>
+  T readInteger(const char*& pos, const char* const end) const;
+
+  void expect(const char*& pos, const char* const end, const char c) const {
+    if (pos == end || *pos != c) {
+      std::ostringstream err;
+      err << '\'' << c << '\'';
+      reportUnexpected(pos, end, err.str());
+    }
+    ++pos;
+  }
+
+  /// Reports that expected was expected at pos.
+  void reportUnexpected(
+    const char* const pos,
+    const char* const end,
+    const std::string& expected
+  ) const {
+    std::ostringstream err;
+    err << "Expected " << expected << ", but got ";
+    if (pos == end)
+      err << "no more input.";
+    else
+      err << '\'' << *pos << "'.";
+    reportError(pos, err.str());
+  }
+
+  const PolyRing& mRing;
+  const bool mReadComponent;
+  const char* const mTextBegin;
+  const uint64 mFirstLine;
 };
 
+template<class M, class BF>
+Poly MathicIO<M, BF>::TextReader::readPoly(
+  const char* pos,
+  const char* const end,
+  MonoRef mono,
+  MonoRef previous
+) const {
+  MATHICGB_ASSERT(pos != end);
+  Poly p(mRing);
+
+  const auto afterSign = isSign(*pos) ? pos + 1 : pos;
+  if (end - afterSign == 1 && *afterSign == '0')
+    return std::move(p);
+
+  // Every term after the first one starts with a sign and signs appear
+  // nowhere else, so this is the number of terms.
+  p.reserve(1 + std::count_if(afterSign, end, isSign));
+
+  const auto& field = mRing.field();
+  const auto& monoid = mRing.monoid();
+  bool descending = true;
+  while (pos != end) {
+    bool negate = false;
+    if (isSign(*pos)) {
+      negate = *pos == '-';
+      ++pos;
+    } else if (!p.isZero())
+      reportUnexpected(pos, end, "'+' or '-'");
+
+    auto coef = field.zero();
+    if (pos != end && isDigit(*pos)) {
+      coef = field.toElement(readInteger<RawCoefficient>(pos, end));
+      if (negate)
+        coef = field.negative(coef);
+      if (pos == end || !isLetter(*pos)) {
+        // Identify a number c on its own as the monomial 1 times c.
+        monoid.setIdentity(mono);
+        if (mReadComponent)
+          readComponent(pos, end, mono);
+      } else
+        readMonomial(pos, end, mono);
+    } else {
+      coef = negate ? field.minusOne() : field.one();
+      readMonomial(pos, end, mono);
+    }
+
+    if (!p.isZero() && !monoid.lessThan(mono, previous))
+      descending = false;
+    p.appendTerm(coef.value(), mono);
+    monoid.copy(mono, previous);
+  }
+
+  if (!descending)
+    p.sortTermsDescending();
+  return std::move(p);
+}
+
+template<class M, class BF>
+void MathicIO<M, BF>::TextReader::readMonomial(
+  const char*& pos,
+  const char* const end,
+  MonoRef mono
+) const {
+  const auto& monoid = mRing.monoid();
+  const auto letterCount = 'z' - 'a' + 1;
+
+  monoid.setIdentity(mono);
+  if (pos == end || !isLetter(*pos))
+    reportUnexpected(pos, end, "letter while reading monomial");
+  do {
+    const auto letter = *pos;
+    const auto var = static_cast<VarIndex>('a' <= letter && letter <= 'z' ?
+      letter - 'a' : (letter - 'A') + letterCount);
+    if (var >= monoid.varCount()) {
+      std::ostringstream err;
+      err << "Saw the variable " << letter
+        << ", but the monoid only has "
+        << monoid.varCount() << " variables.";
+      reportError(pos, err.str());
+    }
+    if (monoid.externalExponent(mono, var) > static_cast<Exponent>(0)) {
+      std::ostringstream err;
+      err << "Variable " << letter <<
+        " must not be written twice in one monomial.";
+      reportError(pos, err.str());
+    }
+    ++pos;
+
+    if (pos != end && isDigit(*pos))
+      monoid.setExternalExponent(var, readInteger<Exponent>(pos, end), mono);
+    else
+      monoid.setExternalExponent(var, static_cast<Exponent>(1), mono);
+  } while (pos != end && isLetter(*pos));
+
+  if (mReadComponent)
+    readComponent(pos, end, mono);
+}
+
+template<class M, class BF>
+void MathicIO<M, BF>::TextReader::readComponent(
+  const char*& pos,
+  const char* const end,
+  MonoRef mono
+) const {
+  MATHICGB_ASSERT(Monoid::HasComponent);
+  expect(pos, end, '<');
+  if (pos == end || !isDigit(*pos))
+    reportUnexpected(pos, end, "an integer");
+  mRing.monoid().setComponent(readInteger<Exponent>(pos, end), mono);
+  expect(pos, end, '>');
+}
+
+template<class M, class BF>
+template<class T>
+T MathicIO<M, BF>::TextReader::readInteger(
+  const char*& pos,
+  const char* const end
+) const {
+  static_assert(std::numeric_limits<T>::is_integer, "");
+  MATHICGB_ASSERT(pos != end && isDigit(*pos));
+
+  const auto max = std::numeric_limits<T>::max();
+  const auto start = pos;
+  auto t = static_cast<T>(0);
+  do {
+    const auto d = static_cast<T>(*pos - '0');
+    if (t > (max - d) / 10) {
+      std::ostringstream err;
+      err << "Expected an integer in the range [0, " << unchar(max) << "].";
+      reportError(start, err.str());
+    }
+    t = t * 10 + d;
+    ++pos;
+  } while (pos != end && isDigit(*pos));
+  return t;
+}
+
 template<class M, class BF>
 auto MathicIO<M, BF>::readBaseField(Scanner& in) -> BaseField {
   return BaseField(in.readInteger<RawCoefficient>());
@@ -352,6 +632,78 @@ Basis MathicIO<M, BF>::readBasis(
   return std::move(basis);
 }
 
+template<class M, class BF>
+Basis MathicIO<M, BF>::readBasisParallel(
+  const PolyRing& ring,
+  const bool readComponent,
+  Scanner& in,
+  const size_t blockBytes
+) {
+  MATHICGB_ASSERT(blockBytes > 0);
+  const auto polyCount = in.readInteger<size_t>();
+  const auto firstLine = in.lineCount();
+  const auto text = in.readRemaining();
+  const char* const begin = text.data();
+  const char* const end = begin + text.size();
+
+  // Cut the text into blocks. A cut is moved forward to the next whitespace
+  // so that no polynomial is split between two blocks.
+  std::vector<const char*> cuts(1, begin);
+  while (static_cast<size_t>(end - cuts.back()) > blockBytes) {
+    auto cut = cuts.back() + blockBytes;
+    while (cut != end && !TextReader::isWhite(*cut))
+      ++cut;
+    cuts.push_back(cut);
+  }
+  if (cuts.back() != end)
+    cuts.push_back(end);
+  const auto blockCount = cuts.size() - 1;
+
+  // The monomial pool is not thread safe, so allocate the scratch
+  // monomials for each block here.
+  const auto& monoid = ring.monoid();
+  std::vector<typename Monoid::Mono> monos;
+  monos.reserve(2 * blockCount);
+  for (size_t i = 0; i < 2 * blockCount; ++i)
+    monos.push_back(monoid.alloc());
+
+  const TextReader reader(ring, readComponent, begin, firstLine);
+  std::vector<std::vector<std::unique_ptr<Poly>>> blockPolys(blockCount);
+  mgb::mtbb::parallel_for(mgb::mtbb::blocked_range<size_t>(0, blockCount),
+    [&](const mgb::mtbb::blocked_range<size_t>& range)
+    {for (auto block = range.begin(); block != range.end(); ++block)
+  {
+    reader.readPolys(
+      cuts[block],
+      cuts[block + 1],
+      monos[2 * block],
+      monos[2 * block + 1],
+      blockPolys[block]
+    );
+  }});
+
+  size_t readCount = 0;
+  for (size_t block = 0; block < blockCount; ++block)
+    readCount += blockPolys[block].size();
+  if (readCount != polyCount) {
+    // Point the error at the first polynomial too many or at the end.
+    auto pos = TextReader::skipWhite(begin, end);
+    for (size_t i = 0; i < polyCount && pos != end; ++i)
+      pos = TextReader::skipWhite(TextReader::skipNonWhite(pos, end), end);
+    std::ostringstream err;
+    err << "Expected " << polyCount << " polynomials, but got "
+      << readCount << '.';
+    reader.reportError(pos, err.str());
+  }
+
+  Basis basis(ring);
+  basis.reserve(polyCount);
+  for (size_t block = 0; block < blockCount; ++block)
+    for (auto& poly : blockPolys[block])
+      basis.insert(std::move(poly));
+  return std::move(basis);
+}
+
 template<class M, class BF>
 void MathicIO<M, BF>::writeBasis(
   const Basis& basis,
@@ -0,0 +1,72 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#include "stdinc.h"
+#include "MemoryBudget.hpp"
+
+#include <limits>
+
+MATHICGB_NAMESPACE_BEGIN
+
+MemoryBudget::MemoryBudget():
+  mInUse(0),
+  mPeak(0),
+  mRecentPeak(0),
+  mBudget(0)
+{
+  for (size_t i = 0; i < CategoryCount; ++i) {
+    mCategories[i].inUse.store(0, std::memory_order_relaxed);
+    mCategories[i].peak.store(0, std::memory_order_relaxed);
+  }
+}
+
+void MemoryBudget::allocated(const Category category, const size_t bytes) {
+  MATHICGB_ASSERT(category < CategoryCount);
+  auto& use = mCategories[category];
+  const auto categoryTotal =
+    use.inUse.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  raise(use.peak, categoryTotal);
+  const auto total = mInUse.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  raise(mPeak, total);
+  raise(mRecentPeak, total);
+}
+
+void MemoryBudget::freed(const Category category, const size_t bytes) {
+  MATHICGB_ASSERT(category < CategoryCount);
+  MATHICGB_ASSERT(inUse(category) >= bytes);
+  mCategories[category].inUse.fetch_sub(bytes, std::memory_order_relaxed);
+  mInUse.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+size_t MemoryBudget::available() const {
+  const auto budget = this->budget();
+  if (budget == 0)
+    return std::numeric_limits<size_t>::max();
+  const auto used = inUse();
+  return used < budget ? budget - used : 0;
+}
+
+const char* MemoryBudget::categoryName(const Category category) {
+  switch (category) {
+  case MatrixBlocks: return "F4 matrices";
+  case MonomialMaps: return "Monomial maps";
+  case PolyArenas: return "Polynomial arenas";
+  case DenseRows: return "Dense rows";
+  default:
+    MATHICGB_ASSERT(false);
+    return "";
+  }
+}
+
+MemoryBudget& MemoryBudget::singleton() {
+  static MemoryBudget budget;
+  return budget;
+}
+
+void MemoryBudget::raise(std::atomic<size_t>& peak, const size_t value) {
+  auto current = peak.load(std::memory_order_relaxed);
+  while (current < value &&
+    !peak.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    ;
+}
+
+MATHICGB_NAMESPACE_END
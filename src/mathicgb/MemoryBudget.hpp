@@ -0,0 +1,106 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#ifndef MATHICGB_MEMORY_BUDGET_GUARD
+#define MATHICGB_MEMORY_BUDGET_GUARD
+
+#include <atomic>
+
+MATHICGB_NAMESPACE_BEGIN
+
+/// Keeps track of the memory held by the allocators that use the most
+/// memory and of an optional budget for that memory. The allocators report
+/// each block that they allocate and free, so the totals are known at all
+/// times, unlike getMemoryUse() which has to be asked of each component.
+///
+/// The reports are whole blocks, hash table nodes and dense rows rather
+/// than single entries, so they are not frequent enough for contention on
+/// the counters to matter. Reporting can be done from several threads at
+/// the same time.
+///
+/// Nothing is done to stay within the budget here. Code that can use less
+/// memory at some cost in time, like F4Reducer, asks available() and adapts.
+class MemoryBudget {
+public:
+  enum Category {
+    MatrixBlocks, /// The entries of SparseMatrix.
+    MonomialMaps, /// The nodes and buckets of MonomialMap.
+    PolyArenas, /// The term storage of polynomials in a PolyArena.
+    DenseRows, /// The dense rows used by F4MatrixReducer.
+    CategoryCount
+  };
+
+  /// Records that bytes more memory is held for category.
+  void allocated(Category category, size_t bytes);
+
+  /// Records that bytes less memory is held for category.
+  void freed(Category category, size_t bytes);
+
+  /// Returns how many bytes are held in total.
+  size_t inUse() const {return mInUse.load(std::memory_order_relaxed);}
+
+  /// Returns how many bytes are held for category.
+  size_t inUse(Category category) const {
+    MATHICGB_ASSERT(category < CategoryCount);
+    return mCategories[category].inUse.load(std::memory_order_relaxed);
+  }
+
+  /// Returns the largest value that inUse() has had.
+  size_t peak() const {return mPeak.load(std::memory_order_relaxed);}
+
+  /// Returns the largest value that inUse(category) has had.
+  size_t peak(Category category) const {
+    MATHICGB_ASSERT(category < CategoryCount);
+    return mCategories[category].peak.load(std::memory_order_relaxed);
+  }
+
+  /// Returns the largest value that inUse() has had since the last call
+  /// to resetRecentPeak(). Use this to find out how much memory something
+  /// took at most.
+  size_t recentPeak() const {
+    return mRecentPeak.load(std::memory_order_relaxed);
+  }
+
+  /// Sets recentPeak() to inUse().
+  void resetRecentPeak() {
+    mRecentPeak.store(inUse(), std::memory_order_relaxed);
+  }
+
+  /// Sets the budget in bytes. 0 means that there is no budget.
+  void setBudget(size_t bytes) {
+    mBudget.store(bytes, std::memory_order_relaxed);
+  }
+
+  /// Returns the budget in bytes or 0 if there is no budget.
+  size_t budget() const {return mBudget.load(std::memory_order_relaxed);}
+
+  bool hasBudget() const {return budget() != 0;}
+
+  /// Returns how many bytes can be allocated before going over the budget.
+  /// Returns the maximum value of size_t if there is no budget.
+  size_t available() const;
+
+  /// Returns a short description of category for use in reports.
+  static const char* categoryName(Category category);
+
+  static MemoryBudget& singleton();
+
+private:
+  MemoryBudget(); // private for singleton
+
+  /// Raises peak to value if value is larger.
+  static void raise(std::atomic<size_t>& peak, size_t value);
+
+  struct CategoryUse {
+    std::atomic<size_t> inUse;
+    std::atomic<size_t> peak;
+  };
+
+  CategoryUse mCategories[CategoryCount];
+  std::atomic<size_t> mInUse;
+  std::atomic<size_t> mPeak;
+  std::atomic<size_t> mRecentPeak;
+  std::atomic<size_t> mBudget;
+};
+
+MATHICGB_NAMESPACE_END
+#endif
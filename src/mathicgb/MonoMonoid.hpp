@@ -874,9 +874,24 @@ public:
       return computeDegree(mono, grading);
   }
 
+  /// Returns the sum of the exponents of mono. This does not depend on
+  /// the gradings of the monoid.
+  Exponent totalDegree(ConstMonoRef mono) const {
+    Exponent sum = 0;
+    for (auto i = exponentsIndexBegin(); i != exponentsIndexEnd(); ++i)
+      sum += access(mono, i);
+    return sum;
+  }
+
   /// Returns the number of gradings.
   using Base::gradingCount;
 
+  /// Returns true if the base order is lex and false if it is reverse
+  /// lex. For a lex base order, a higher degree() means a greater
+  /// monomial and for reverse lex a lower degree() means a greater
+  /// monomial, since the gradings are then stored negated.
+  using Base::isLexBaseOrder;
+
 
   // *** Monomial mutating computations
 
@@ -1805,7 +1820,6 @@ private:
   using Base::hashIndex;
   using Base::orderIsTotalDegreeRevLex;
   using Base::gradings;
-  using Base::isLexBaseOrder;
   using Base::componentGradingIndex;
 
   VarIndex entriesIndexBegin() const {return 0;}
@@ -0,0 +1,378 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#include "stdinc.h"
+#include "MultiModularGB.hpp"
+
+#include "Basis.hpp"
+#include "Poly.hpp"
+#include "PolyBasis.hpp"
+#include "Reducer.hpp"
+#include "ClassicGBAlg.hpp"
+#include "mtbb.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+MATHICGB_NAMESPACE_BEGIN
+
+namespace {
+  bool isPrime(const coefficient n) {
+    if (n < 2)
+      return false;
+    for (coefficient d = 2; d * d <= n; ++d)
+      if (n % d == 0)
+        return false;
+    return true;
+  }
+}
+
+MultiModularGB::MultiModularGB(const Order& order, size_t batchSize):
+  mOrder(order),
+  mBatchSize(std::max<size_t>(batchSize, 1)),
+  mUseSugar(false),
+  mUseTrace(true),
+  mPrimeCount(0),
+  mUnluckyPrimeCount(0),
+  mTraceMismatchCount(0),
+  mTraceRelearnCount(0)
+{}
+
+auto MultiModularGB::computeGroebnerBasis(
+  const std::vector<RationalPoly>& ideal
+) -> std::vector<RationalPoly> {
+  mAccumulators.clear();
+  mPrimeCount = 0;
+  mUnluckyPrimeCount = 0;
+  mTraceMismatchCount = 0;
+  mTraceRelearnCount = 0;
+
+  std::unique_ptr<F4Trace> trace;
+  Image traceImage; // The image that trace was learned from.
+  // The coefficients are stored in 16 bits in some places, so that bounds
+  // the primes. Start at the top and go down.
+  coefficient prime = coefficient(1) << 16;
+  while (true) {
+    std::vector<coefficient> primes;
+    for (size_t i = 0; i < mBatchSize; ++i) {
+      prime = nextPrime(prime, ideal);
+      primes.push_back(prime);
+    }
+
+    std::vector<Image> images(primes.size());
+    size_t firstParallel = 0;
+    std::unique_ptr<F4Trace> learned;
+    if (mUseTrace) {
+      // The first prime of each batch is computed without replaying the
+      // trace and a new trace is learned from it. If there is no trace yet,
+      // that is done before the other primes replay it.
+      learned = make_unique<F4Trace>();
+      if (trace.get() == 0) {
+        images[0] = computeImage(primes[0], ideal, learned.get());
+        learned->finishLearning();
+        trace = std::move(learned);
+        traceImage = images[0];
+        firstParallel = 1;
+      }
+    }
+    std::vector<char> mismatches(primes.size());
+    mgb::mtbb::parallel_for(
+      mgb::mtbb::blocked_range<size_t>(firstParallel, primes.size()),
+      [&](const mgb::mtbb::blocked_range<size_t>& range) {
+        for (auto i = range.begin(); i != range.end(); ++i) {
+          if (i == 0 && learned.get() != 0) {
+            images[i] = computeImage(primes[i], ideal, learned.get());
+            continue;
+          }
+          if (trace.get() == 0) {
+            images[i] = computeImage(primes[i], ideal, 0);
+            continue;
+          }
+          try {
+            images[i] = computeImage(primes[i], ideal, trace.get());
+          } catch (const F4Trace::Mismatch&) {
+            mismatches[i] = true;
+            images[i] = computeImage(primes[i], ideal, 0);
+          }
+        }
+      }
+    );
+    const auto mismatchCount = static_cast<size_t>
+      (std::count(mismatches.begin(), mismatches.end(), true));
+    mTraceMismatchCount += mismatchCount;
+    if (learned.get() != 0) {
+      // Rows that reduce to zero modulo the prime of the trace are left
+      // out of every replay, so if that prime is unlucky, the replays can
+      // repeat its monomials without a mismatch. So the trace is replaced
+      // if an image computed without it has other monomials. It is also
+      // replaced if most of the replays did not match it.
+      learned->finishLearning();
+      const auto replayCount = primes.size() - 1;
+      if (
+        !sameMonomials(images[0], traceImage) ||
+        (replayCount > 0 && 2 * mismatchCount > replayCount)
+      ) {
+        trace = std::move(learned);
+        traceImage = images[0];
+        ++mTraceRelearnCount;
+      }
+    }
+    for (const auto& image : images)
+      accumulate(image);
+    mPrimeCount += images.size();
+
+    // The earliest accumulator wins ties since std::max_element returns
+    // the first maximal element.
+    auto best = std::max_element(
+      mAccumulators.begin(),
+      mAccumulators.end(),
+      [](const Accumulator& a, const Accumulator& b) {
+        return a.primeCount < b.primeCount;
+      }
+    );
+    MATHICGB_ASSERT(best != mAccumulators.end());
+    if (reconstruct(*best)) {
+      mUnluckyPrimeCount = mPrimeCount - best->primeCount;
+      return toBasis(*best);
+    }
+  }
+}
+
+coefficient MultiModularGB::nextPrime(
+  coefficient below,
+  const std::vector<RationalPoly>& ideal
+) {
+  while (true) {
+    --below;
+    if (below < 2)
+      throw std::runtime_error
+        ("Ran out of primes for multi-modular Groebner basis computation.");
+    if (!isPrime(below))
+      continue;
+    bool dividesDenominator = false;
+    for (const auto& poly : ideal) {
+      for (const auto& term : poly) {
+        if (term.denominator.mod(static_cast<uint32>(below)) == 0) {
+          dividesDenominator = true;
+          break;
+        }
+      }
+      if (dividesDenominator)
+        break;
+    }
+    if (!dividesDenominator)
+      return below;
+  }
+}
+
+auto MultiModularGB::computeImage(
+  coefficient prime,
+  const std::vector<RationalPoly>& ideal,
+  F4Trace* trace
+) const -> Image {
+  const PolyRing ring{PolyRing::Field(prime), Monoid(mOrder)};
+  const auto& monoid = ring.monoid();
+  const auto& field = ring.field();
+  const auto varCount = monoid.varCount();
+
+  Basis basis(ring);
+  auto mono = monoid.alloc();
+  for (const auto& rationalPoly : ideal) {
+    auto poly = make_unique<Poly>(ring);
+    for (const auto& term : rationalPoly) {
+      MATHICGB_ASSERT(term.exponents.size() == varCount);
+      const auto p = static_cast<uint32>(prime);
+      const auto numerator = field.toElementInRange(term.numerator.mod(p));
+      const auto denominator =
+        field.toElementInRange(term.denominator.mod(p));
+      const auto c = field.quotient(numerator, denominator);
+      if (field.isZero(c))
+        continue;
+      monoid.setExternalExponents(term.exponents.data(), mono);
+      poly->appendTerm(static_cast<coefficient>(c.value()), mono);
+    }
+    if (poly->isZero())
+      continue;
+    if (!poly->termsAreInDescendingOrder())
+      poly->sortTermsDescending();
+    basis.insert(std::move(poly));
+  }
+
+  const auto reducer = Reducer::makeReducer(Reducer::Reducer_F4_New, ring);
+  ClassicGBAlg alg(std::move(basis), *reducer, 2, true, 0, mUseSugar);
+  alg.setUseAutoTopReduction(true);
+  alg.setUseAutoTailReduction(false);
+  alg.setTrace(trace);
+  alg.computeGrobnerBasis();
+
+  // Auto top reduction leaves a minimal basis, so tail reducing that
+  // gives the reduced basis.
+  auto& gb = alg.basis();
+  std::vector<size_t> indices;
+  for (size_t i = 0; i < gb.size(); ++i) {
+    if (gb.retired(i))
+      continue;
+    auto reduced = reducer->classicTailReduce(gb.poly(i), gb);
+    reduced->makeMonic();
+    gb.replaceSameLeadTerm(i, std::move(reduced));
+    indices.push_back(i);
+  }
+  std::sort(indices.begin(), indices.end(), [&](size_t a, size_t b) {
+    return monoid.lessThan(gb.leadMonomial(a), gb.leadMonomial(b));
+  });
+
+  Image image;
+  image.prime = prime;
+  for (const auto index : indices) {
+    const auto& poly = gb.poly(index);
+    image.termCounts.push_back(poly.termCount());
+    for (size_t term = 0; term < poly.termCount(); ++term) {
+      for (size_t var = 0; var < varCount; ++var)
+        image.exponents.push_back
+          (monoid.externalExponent(poly.monomialAt(term), var));
+      image.coefficients.push_back(poly.coefficientAt(term));
+    }
+  }
+  return image;
+}
+
+bool MultiModularGB::sameMonomials(const Image& a, const Image& b) {
+  return a.termCounts == b.termCounts && a.exponents == b.exponents;
+}
+
+void MultiModularGB::accumulate(const Image& image) {
+  auto it = std::find_if(
+    mAccumulators.begin(),
+    mAccumulators.end(),
+    [&](const Accumulator& accumulator) {
+      return accumulator.termCounts == image.termCounts &&
+        accumulator.exponents == image.exponents;
+    }
+  );
+  if (it == mAccumulators.end()) {
+    Accumulator accumulator;
+    accumulator.termCounts = image.termCounts;
+    accumulator.exponents = image.exponents;
+    for (const auto c : image.coefficients)
+      accumulator.residues.emplace_back(static_cast<int64>(c));
+    accumulator.modulus = BigInt(static_cast<int64>(image.prime));
+    accumulator.primeCount = 1;
+    accumulator.reconstructedPrimeCount = 0;
+    mAccumulators.push_back(std::move(accumulator));
+    return;
+  }
+
+  // Chinese remaindering: with r the residue modulo M and c the residue
+  // modulo p, the residue modulo M * p is r + M * ((c - r) / M mod p).
+  auto& accumulator = *it;
+  const auto p = static_cast<uint32>(image.prime);
+  const PolyRing::Field field(p);
+  const auto modulusInverse =
+    field.inverse(field.toElementInRange(accumulator.modulus.mod(p)));
+  MATHICGB_ASSERT(accumulator.residues.size() == image.coefficients.size());
+  for (size_t i = 0; i < image.coefficients.size(); ++i) {
+    auto& residue = accumulator.residues[i];
+    const auto difference = field.difference(
+      field.toElementInRange(image.coefficients[i]),
+      field.toElementInRange(residue.mod(p))
+    );
+    const auto factor = field.product(difference, modulusInverse);
+    if (!field.isZero(factor))
+      residue = residue +
+        accumulator.modulus * BigInt(static_cast<int64>(factor.value()));
+  }
+  accumulator.modulus = accumulator.modulus * BigInt(static_cast<int64>(p));
+  ++accumulator.primeCount;
+}
+
+bool MultiModularGB::reconstruct(Accumulator& accumulator) {
+  const auto bound = BigInt::sqrt(accumulator.modulus / BigInt(2));
+  std::vector<BigInt> numerators(accumulator.residues.size());
+  std::vector<BigInt> denominators(accumulator.residues.size());
+  for (size_t i = 0; i < accumulator.residues.size(); ++i) {
+    const bool success = rationalReconstruction(
+      accumulator.residues[i],
+      accumulator.modulus,
+      bound,
+      numerators[i],
+      denominators[i]
+    );
+    if (!success) {
+      accumulator.numerators.clear();
+      accumulator.denominators.clear();
+      return false;
+    }
+  }
+
+  // The result is only stable if it did not change when more primes were
+  // added. The accumulator that gets reconstructed need not have gotten any
+  // primes since its last reconstruction, for example after the trace has
+  // been replaced because it was learned from an unlucky prime.
+  const bool stable =
+    accumulator.primeCount > accumulator.reconstructedPrimeCount &&
+    !accumulator.numerators.empty() &&
+    accumulator.numerators == numerators &&
+    accumulator.denominators == denominators;
+  accumulator.numerators = std::move(numerators);
+  accumulator.denominators = std::move(denominators);
+  accumulator.reconstructedPrimeCount = accumulator.primeCount;
+  return stable;
+}
+
+auto MultiModularGB::toBasis(
+  const Accumulator& accumulator
+) const -> std::vector<RationalPoly> {
+  const auto varCount = mOrder.varCount();
+  std::vector<RationalPoly> basis;
+  size_t term = 0;
+  for (const auto termCount : accumulator.termCounts) {
+    RationalPoly poly;
+    for (size_t i = 0; i < termCount; ++i, ++term) {
+      RationalTerm t;
+      t.numerator = accumulator.numerators[term];
+      t.denominator = accumulator.denominators[term];
+      const auto exponents = accumulator.exponents.begin() + term * varCount;
+      t.exponents.assign(exponents, exponents + varCount);
+      poly.push_back(std::move(t));
+    }
+    basis.push_back(std::move(poly));
+  }
+  return basis;
+}
+
+bool MultiModularGB::rationalReconstruction(
+  const BigInt& residue,
+  const BigInt& modulus,
+  const BigInt& bound,
+  BigInt& numerator,
+  BigInt& denominator
+) {
+  // Wang's algorithm: run the extended Euclidean algorithm on modulus and
+  // residue until the remainder is at most bound. Then remainder / t is
+  // the unique fraction with numerator and denominator at most bound that
+  // is congruent to residue, if there is such a fraction.
+  BigInt r0 = modulus;
+  BigInt r1 = residue;
+  BigInt t0 = 0;
+  BigInt t1 = 1;
+  while (r1 > bound) {
+    BigInt quotient;
+    BigInt remainder;
+    BigInt::divide(r0, r1, quotient, remainder);
+    BigInt t2 = t0 - quotient * t1;
+    r0 = std::move(r1);
+    r1 = std::move(remainder);
+    t0 = std::move(t1);
+    t1 = std::move(t2);
+  }
+  if (t1.abs() > bound || !BigInt::gcd(r1, t1).isOne())
+    return false;
+  if (t1.isNegative()) {
+    numerator = -r1;
+    denominator = -t1;
+  } else {
+    numerator = std::move(r1);
+    denominator = std::move(t1);
+  }
+  return true;
+}
+
+MATHICGB_NAMESPACE_END
@@ -0,0 +1,165 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#ifndef MATHICGB_MULTI_MODULAR_GB_GUARD
+#define MATHICGB_MULTI_MODULAR_GB_GUARD
+
+#include "BigInt.hpp"
+#include "PolyRing.hpp"
+#include "F4Trace.hpp"
+#include <vector>
+
+MATHICGB_NAMESPACE_BEGIN
+
+/// Computes reduced Groebner bases over the rational numbers by computing
+/// them modulo many primes and lifting the result to Q.
+///
+/// Primes are processed in batches and the primes of a batch are run in
+/// parallel, each with its own ring and ClassicGBAlg. The reduced basis
+/// modulo each prime is combined with the previous ones by the Chinese
+/// remainder theorem and then lifted to Q by rational reconstruction. The
+/// computation stops once the reconstructed basis is the same after two
+/// consecutive batches. That is a heuristic - the result is not verified.
+///
+/// A prime is unlucky if the basis modulo the prime does not have the same
+/// monomials as the basis over Q. Images with different monomials are
+/// accumulated separately and the one seen for the most primes is the one
+/// that gets reconstructed. Primes that divide a denominator of the input
+/// are skipped.
+///
+/// The computation modulo the first prime is recorded in an F4Trace and the
+/// other primes replay that trace, which is faster since the replay skips
+/// S-pair handling, symbolic preprocessing and the rows that reduce to
+/// zero. A prime whose computation does not match the trace is computed
+/// again without it. The first prime of each batch is computed without the
+/// trace and a new trace is learned from it. That new trace replaces the
+/// old one if the basis modulo that prime has other monomials than the
+/// basis modulo the prime of the old trace, since the old prime may have
+/// been unlucky, or if most primes of the batch did not match the old
+/// trace. So the trace only helps for batches of more than one prime.
+class MultiModularGB {
+public:
+  typedef PolyRing::Monoid Monoid;
+  typedef Monoid::Order Order;
+  typedef Monoid::Exponent Exponent;
+
+  /// A term with coefficient numerator / denominator where denominator is
+  /// positive. There is one exponent per variable.
+  struct RationalTerm {
+    BigInt numerator;
+    BigInt denominator;
+    std::vector<Exponent> exponents;
+  };
+  typedef std::vector<RationalTerm> RationalPoly;
+
+  /// Runs batchSize primes at a time. Use the thread count for that.
+  MultiModularGB(const Order& order, size_t batchSize);
+
+  void setUseSugar(bool value) {mUseSugar = value;}
+
+  /// Learn an F4Trace from the first prime of a batch and replay it for
+  /// the others. On by default.
+  void setUseTrace(bool value) {mUseTrace = value;}
+
+  /// Returns the reduced Groebner basis of ideal. The polynomials are
+  /// monic, the terms of each polynomial are in descending order and the
+  /// polynomials are in ascending order of lead term. Coefficients are in
+  /// lowest terms.
+  std::vector<RationalPoly> computeGroebnerBasis(
+    const std::vector<RationalPoly>& ideal
+  );
+
+  /// Returns the number of primes that the last computation used.
+  size_t primeCount() const {return mPrimeCount;}
+
+  /// Returns the number of primes in the last computation whose image
+  /// was not the one that got reconstructed.
+  size_t unluckyPrimeCount() const {return mUnluckyPrimeCount;}
+
+  /// Returns the number of primes in the last computation that did not
+  /// match the trace and so were computed without it.
+  size_t traceMismatchCount() const {return mTraceMismatchCount;}
+
+  /// Returns the number of times that the trace was replaced in the last
+  /// computation.
+  size_t traceRelearnCount() const {return mTraceRelearnCount;}
+
+private:
+  /// A reduced Groebner basis modulo prime. The polynomials are stored one
+  /// after the other. termCounts has the number of terms of each
+  /// polynomial and exponents has varCount exponents for each term.
+  struct Image {
+    coefficient prime;
+    std::vector<size_t> termCounts;
+    std::vector<Exponent> exponents;
+    std::vector<coefficient> coefficients;
+  };
+
+  /// The combination of the images with the same monomials. Each residue
+  /// is in the range [0, modulus) where modulus is the product of the
+  /// primes of those images.
+  struct Accumulator {
+    std::vector<size_t> termCounts;
+    std::vector<Exponent> exponents;
+    std::vector<BigInt> residues;
+    BigInt modulus;
+    size_t primeCount;
+
+    /// The coefficients from the last successful reconstruction. Empty if
+    /// the last attempt failed.
+    std::vector<BigInt> numerators;
+    std::vector<BigInt> denominators;
+
+    /// The value of primeCount at the last reconstruction.
+    size_t reconstructedPrimeCount;
+  };
+
+  /// Returns the largest prime less than below that does not divide any
+  /// denominator in ideal.
+  static coefficient nextPrime(
+    coefficient below,
+    const std::vector<RationalPoly>& ideal
+  );
+
+  /// Computes the reduced Groebner basis of ideal modulo prime. Records
+  /// into or replays trace if it is not null.
+  Image computeImage(
+    coefficient prime,
+    const std::vector<RationalPoly>& ideal,
+    F4Trace* trace
+  ) const;
+
+  /// Returns true if a and b have the same monomials.
+  static bool sameMonomials(const Image& a, const Image& b);
+
+  /// Adds image to the accumulator with the same monomials as image.
+  void accumulate(const Image& image);
+
+  /// Lifts the coefficients of accumulator to Q and stores the result in
+  /// accumulator. Returns true if that succeeded and gave the same result
+  /// as the previous time.
+  static bool reconstruct(Accumulator& accumulator);
+
+  /// Returns the basis from the last reconstruction of accumulator.
+  std::vector<RationalPoly> toBasis(const Accumulator& accumulator) const;
+
+  static bool rationalReconstruction(
+    const BigInt& residue,
+    const BigInt& modulus,
+    const BigInt& bound,
+    BigInt& numerator,
+    BigInt& denominator
+  );
+
+  const Order mOrder;
+  const size_t mBatchSize;
+  bool mUseSugar;
+  bool mUseTrace;
+  std::vector<Accumulator> mAccumulators;
+  size_t mPrimeCount;
+  size_t mUnluckyPrimeCount;
+  size_t mTraceMismatchCount;
+  size_t mTraceRelearnCount;
+};
+
+MATHICGB_NAMESPACE_END
+#endif
@@ -0,0 +1,216 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#include "stdinc.h"
+#include "PerfCounters.hpp"
+
+#include "mtbb.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+MATHICGB_NAMESPACE_BEGIN
+
+#ifdef __linux__
+namespace {
+  // Set once opening the counters has failed, so that we do not make a
+  // failing system call for every thread.
+  std::atomic<bool> unavailable(false);
+
+  const unsigned long long eventConfigs[PerfCounters::EventCount] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+  };
+
+  int openCounter(const unsigned long long config, const int groupFd) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP |
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // pid 0 and cpu -1 counts the calling thread on any cpu.
+    return static_cast<int>
+      (syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0));
+  }
+
+  /// The counters of one thread. They count from when they are opened
+  /// until the thread exits.
+  class ThreadCounters {
+  public:
+    ThreadCounters();
+    ~ThreadCounters();
+
+    bool open() const {return mFds[0] != -1;}
+
+    /// Adds the counts since the counters were opened to counts.
+    void addCounts(PerfCounters::Counter counts[PerfCounters::EventCount])
+      const;
+
+  private:
+    /// The first file descriptor is the group leader. All are -1 if the
+    /// counters are not available.
+    int mFds[PerfCounters::EventCount];
+  };
+
+  /// The open counters of all threads. The registry is never deleted since
+  /// threads of the task scheduler can exit after static destruction.
+  struct Registry {
+    Registry() {std::fill(exited, exited + PerfCounters::EventCount, 0);}
+
+    mgb::mtbb::mutex mutex;
+    std::vector<const ThreadCounters*> threads;
+
+    /// The counts of the threads that have exited.
+    PerfCounters::Counter exited[PerfCounters::EventCount];
+  };
+
+  Registry& registry() {
+    static Registry* const registry = new Registry();
+    return *registry;
+  }
+
+  /// Stores the counts of all threads since they opened their counters.
+  void readCounts(PerfCounters::Counter counts[PerfCounters::EventCount]) {
+    auto& r = registry();
+    const mgb::mtbb::mutex::scoped_lock lock(r.mutex);
+    std::copy(r.exited, r.exited + PerfCounters::EventCount, counts);
+    for (const auto thread : r.threads)
+      thread->addCounts(counts);
+  }
+
+  ThreadCounters::ThreadCounters() {
+    for (size_t i = 0; i < PerfCounters::EventCount; ++i)
+      mFds[i] = -1;
+    if (unavailable.load(std::memory_order_relaxed))
+      return;
+    for (size_t i = 0; i < PerfCounters::EventCount; ++i) {
+      mFds[i] = openCounter(eventConfigs[i], mFds[0]);
+      if (mFds[i] == -1) {
+        for (size_t j = 0; j < i; ++j) {
+          close(mFds[j]);
+          mFds[j] = -1;
+        }
+        unavailable.store(true, std::memory_order_relaxed);
+        return;
+      }
+    }
+    auto& r = registry();
+    const mgb::mtbb::mutex::scoped_lock lock(r.mutex);
+    r.threads.push_back(this);
+  }
+
+  ThreadCounters::~ThreadCounters() {
+    if (!open())
+      return;
+    {
+      // Keep the counts of this thread for the timers that are running.
+      auto& r = registry();
+      const mgb::mtbb::mutex::scoped_lock lock(r.mutex);
+      addCounts(r.exited);
+      r.threads.erase(std::find(r.threads.begin(), r.threads.end(), this));
+    }
+    for (size_t i = 0; i < PerfCounters::EventCount; ++i)
+      close(mFds[i]);
+  }
+
+  void ThreadCounters::addCounts(
+    PerfCounters::Counter counts[PerfCounters::EventCount]
+  ) const {
+    MATHICGB_ASSERT(open());
+
+    // The layout of the data for PERF_FORMAT_GROUP with the two time fields.
+    struct {
+      uint64 eventCount;
+      uint64 timeEnabled;
+      uint64 timeRunning;
+      uint64 values[PerfCounters::EventCount];
+    } data;
+    const auto bytes = read(mFds[0], &data, sizeof(data));
+    if (bytes != static_cast<ssize_t>(sizeof(data)) ||
+      data.eventCount != PerfCounters::EventCount)
+      return;
+
+    const double scale = data.timeRunning == 0 ? 0.0 :
+      static_cast<double>(data.timeEnabled) / data.timeRunning;
+    for (size_t i = 0; i < PerfCounters::EventCount; ++i)
+      counts[i] += static_cast<PerfCounters::Counter>(data.values[i] * scale);
+  }
+
+  /// Opens the counters of each thread of the task scheduler when it starts
+  /// running tasks.
+  class SchedulerObserver : public mgb::mtbb::task_scheduler_observer {
+  public:
+    virtual void on_scheduler_entry(bool) {PerfCounters::countThisThread();}
+  };
+}
+
+PerfCounters::PerfCounters(): mAvailable(countThisThread()) {
+  // The observer is never deleted for the same reason as the registry.
+  static SchedulerObserver* const observer = new SchedulerObserver();
+  observer->observe(true);
+  std::fill(mStart, mStart + EventCount, 0);
+}
+
+bool PerfCounters::countThisThread() {
+  static thread_local ThreadCounters counters;
+  return counters.open();
+}
+
+void PerfCounters::start() {
+  if (available())
+    readCounts(mStart);
+}
+
+bool PerfCounters::stop(Counter counts[EventCount]) {
+  if (!available())
+    return false;
+  Counter now[EventCount];
+  readCounts(now);
+
+  // Scaling can make a count a little smaller than it was before.
+  for (size_t i = 0; i < EventCount; ++i)
+    counts[i] = now[i] < mStart[i] ? 0 : now[i] - mStart[i];
+  return true;
+}
+#else
+PerfCounters::PerfCounters(): mAvailable(false) {
+  std::fill(mStart, mStart + EventCount, 0);
+}
+
+void PerfCounters::start() {}
+
+bool PerfCounters::stop(Counter /*counts*/[EventCount]) {
+  return false;
+}
+
+bool PerfCounters::countThisThread() {
+  return false;
+}
+#endif
+
+const char* PerfCounters::eventName(const Event event) {
+  switch (event) {
+  case Cycles: return "Cycles";
+  case Instructions: return "Instructions";
+  case CacheMisses: return "LLC misses";
+  case BranchMisses: return "Branch misses";
+  default:
+    MATHICGB_ASSERT(false);
+    return "";
+  }
+}
+
+MATHICGB_NAMESPACE_END
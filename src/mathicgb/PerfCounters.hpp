@@ -0,0 +1,70 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#ifndef MATHICGB_PERF_COUNTERS_GUARD
+#define MATHICGB_PERF_COUNTERS_GUARD
+
+MATHICGB_NAMESPACE_BEGIN
+
+/// Counts hardware events between start() and stop() using the
+/// perf_event_open system call of Linux. The counters tell whether a piece
+/// of code is limited by memory accesses or by computation.
+///
+/// Each thread that takes part has its own group of counters. The group is
+/// opened the first time the thread calls countThisThread() and then runs
+/// until the thread exits, so starting and stopping only reads the groups.
+/// Constructing a PerfCounters counts the calling thread and the threads
+/// of the task scheduler. The counts are the sum over all those threads,
+/// so a phase that runs in parallel is counted in full. If other work runs
+/// at the same time on those threads, then that gets counted too.
+///
+/// The counters are not available on other platforms, on machines without
+/// a performance monitoring unit (which includes many virtual machines) or
+/// when /proc/sys/kernel/perf_event_paranoid forbids it. Then available()
+/// returns false and stop() returns false, so the caller can fall back to
+/// just measuring time.
+class PerfCounters {
+public:
+  enum Event {
+    Cycles,
+    Instructions,
+    CacheMisses, /// Misses in the last level cache.
+    BranchMisses,
+    EventCount
+  };
+
+  typedef unsigned long long Counter;
+
+  /// Counts the calling thread and the threads of the task scheduler from
+  /// now on. The counts are not recorded until start() is called.
+  PerfCounters();
+
+  /// Returns true if the counters of the calling thread could be opened.
+  bool available() const {return mAvailable;}
+
+  /// Starts counting from zero. Does nothing if available() is false.
+  void start();
+
+  /// Stores the count of each event since start() at counts[event]. If the
+  /// events of a thread were only counted for part of the time, because
+  /// there are fewer hardware counters than events in use, then its counts
+  /// are scaled up by the fraction of the time. Returns false and leaves
+  /// counts unchanged if available() is false.
+  bool stop(Counter counts[EventCount]);
+
+  /// Opens the counters of the calling thread if that has not been done
+  /// yet. Returns true if they are open.
+  static bool countThisThread();
+
+  /// Returns a short name for event for use in reports.
+  static const char* eventName(Event event);
+
+private:
+  PerfCounters(const PerfCounters&); // not available
+  void operator=(const PerfCounters&); // not available
+
+  bool mAvailable;
+  Counter mStart[EventCount]; /// The counts of all threads at start().
+};
+
+MATHICGB_NAMESPACE_END
+#endif
@@ -66,7 +66,7 @@ const_monomial Poly::monomialAt(size_t index) const {
   return &monoms[index * R->maxMonomialSize()];
 }
 
-coefficient& Poly::coefficientAt(size_t index) {
+stored_coefficient& Poly::coefficientAt(size_t index) {
   MATHICGB_ASSERT(index < nTerms());
   return coeffs[index];
 }
@@ -94,8 +94,11 @@ Poly *Poly::copy() const
 
 void Poly::multByCoefficient(coefficient c)
 {
-  for (std::vector<coefficient>::iterator i = coeffs.begin(); i != coeffs.end(); i++)
-    R->coefficientMultTo(*i, c);
+  for (auto i = coeffs.begin(); i != coeffs.end(); i++) {
+    coefficient product = *i;
+    R->coefficientMultTo(product, c);
+    *i = static_cast<stored_coefficient>(product);
+  }
 }
 
 bool Poly::isMonic() const {
@@ -109,8 +112,11 @@ void Poly::makeMonic() {
   if (R->coefficientIsOne(c))
     return;
   R->coefficientReciprocalTo(c);
-  for (auto i = coeffs.begin(); i != coeffs.end(); i++)
-    R->coefficientMultTo(*i, c);
+  for (auto i = coeffs.begin(); i != coeffs.end(); i++) {
+    coefficient product = *i;
+    R->coefficientMultTo(product, c);
+    *i = static_cast<stored_coefficient>(product);
+  }
   MATHICGB_ASSERT(R->coefficientIsOne(getLeadCoefficient()));
 }
 
@@ -214,7 +220,9 @@ void Poly::multByTerm(coefficient a, const_monomial m)
   for (iterator i = begin(); i != j; ++i, ++p, n += R->maxMonomialSize())
     {
       monomial nmon = n;
-      R->coefficientMultTo(coeffs[p], a);
+      coefficient product = coeffs[p];
+      R->coefficientMultTo(product, a);
+      coeffs[p] = static_cast<stored_coefficient>(product);
       R->monomialMultTo(nmon, m); // changes the monomial pointed to by n.
     }
 }
@@ -274,7 +282,8 @@ void Poly::parseDoNotOrder(std::istream& i)
       }
       if (preceededByMinus)
         bigCoef = -bigCoef;
-      coeffs.push_back(R->toCoefficient(bigCoef));
+      coeffs.push_back
+        (static_cast<stored_coefficient>(R->toCoefficient(bigCoef)));
     }
 
     // read monic monomial
@@ -348,7 +357,7 @@ void Poly::display(FILE* file, bool printComponent) const
 size_t Poly::getMemoryUse() const
 {
   size_t total = sizeof(const PolyRing *);
-  total += sizeof(coefficient) * coeffs.capacity();
+  total += sizeof(stored_coefficient) * coeffs.capacity();
   total += sizeof(int) * monoms.capacity();
   return total;
 }
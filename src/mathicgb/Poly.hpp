@@ -4,17 +4,132 @@
 #define MATHICGB_POLY_GUARD
 
 #include "PolyRing.hpp"
+#include "MemoryBudget.hpp"
+#include <memtailor.h>
 #include <vector>
 #include <ostream>
 #include <utility>
 #include <cstdio>
 #include <iterator>
+#include <limits>
+#include <new>
+#include <memory>
 
 MATHICGB_NAMESPACE_BEGIN
 
+/// Memory for the terms of many polynomials, taken from a memt::Arena so
+/// that it comes in large contiguous blocks. Memory that is freed is not
+/// reused - it is only counted so that the owner can tell when it is time to
+/// move the live polynomials to a fresh PolyArena and free this one.
+/// PolyBasis does that.
+class PolyArena {
+public:
+  PolyArena(): mUnusedBytes(0), mAllocatedBytes(0) {}
+
+  ~PolyArena() {
+    MemoryBudget::singleton().freed
+      (MemoryBudget::PolyArenas, mAllocatedBytes);
+  }
+
+  void* alloc(size_t bytes) {
+    mAllocatedBytes += bytes;
+    MemoryBudget::singleton().allocated(MemoryBudget::PolyArenas, bytes);
+    return mArena.alloc(bytes);
+  }
+
+  void free(size_t bytes) {mUnusedBytes += bytes;}
+
+  /// Returns how many bytes has been allocated by this object.
+  size_t getMemoryUse() const {return mArena.getMemoryUse();}
+
+  /// Returns how many of the bytes allocated by this object have been
+  /// freed and so cannot be used again until the arena is discarded.
+  size_t getUnusedMemory() const {return mUnusedBytes;}
+
+private:
+  memt::Arena mArena;
+  size_t mUnusedBytes;
+  size_t mAllocatedBytes; // as reported to MemoryBudget
+};
+
+/// The allocator of the term storage of a Poly. Allocates from a PolyArena
+/// if there is one and otherwise from the heap.
+template<class T>
+class PolyAllocator {
+public:
+  typedef T value_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+  template<class U> struct rebind {typedef PolyAllocator<U> other;};
+
+  PolyAllocator(PolyArena* arena = 0): mArena(arena) {}
+
+  template<class U>
+  PolyAllocator(const PolyAllocator<U>& allocator):
+    mArena(allocator.arena()) {}
+
+  T* allocate(size_t count) {
+    const auto bytes = count * sizeof(T);
+    if (mArena == 0)
+      return static_cast<T*>(::operator new(bytes));
+    return static_cast<T*>(mArena->alloc(bytes));
+  }
+
+  void deallocate(T* ptr, size_t count) {
+    if (mArena == 0)
+      ::operator delete(ptr);
+    else
+      mArena->free(count * sizeof(T));
+  }
+
+  size_t max_size() const {
+    return std::numeric_limits<size_t>::max() / sizeof(T);
+  }
+
+  void construct(T* ptr, const T& value) {new (ptr) T(value);}
+  void destroy(T* ptr) {ptr->~T();}
+
+  /// A copy of a polynomial allocates from the heap, so that the copy
+  /// does not depend on the arena of the original.
+  PolyAllocator select_on_container_copy_construction() const {
+    return PolyAllocator();
+  }
+
+  PolyArena* arena() const {return mArena;}
+
+private:
+  PolyArena* mArena;
+};
+
+template<class T, class U>
+bool operator==(const PolyAllocator<T>& a, const PolyAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+
+template<class T, class U>
+bool operator!=(const PolyAllocator<T>& a, const PolyAllocator<U>& b) {
+  return a.arena() != b.arena();
+}
+
 class Poly {
 public:
-  Poly(const PolyRing& ring) : R(&ring) {MATHICGB_ASSERT(R != 0);}
+  typedef std::vector<stored_coefficient, PolyAllocator<stored_coefficient>>
+    CoefficientVector;
+  typedef std::vector<exponent, PolyAllocator<exponent>> MonomialVector;
+
+  /// The terms are stored in arena if it is not null. The arena must then
+  /// live for as long as this object.
+  Poly(const PolyRing& ring, PolyArena* arena = 0):
+    R(&ring),
+    coeffs(CoefficientVector::allocator_type(arena)),
+    monoms(MonomialVector::allocator_type(arena))
+  {
+    MATHICGB_ASSERT(R != 0);
+  }
 
   void parse(std::istream &i); // reads into this, sorts terms
   void parseDoNotOrder(std::istream &i); // reads into this, does not sort terms
@@ -25,8 +140,8 @@ public:
   class iterator {
     // only for const objects...
     size_t monsize;
-    std::vector<coefficient>::iterator ic;
-    std::vector<exponent>::iterator im;
+    CoefficientVector::iterator ic;
+    MonomialVector::iterator im;
     friend class Poly;
 
     iterator(Poly& f) : monsize(f.getRing()->maxMonomialSize()), ic(f.coeffs.begin()), im(f.monoms.begin()) {}
@@ -36,25 +151,25 @@ public:
     typedef std::pair<coefficient, const const_monomial> value_type;
     typedef ptrdiff_t difference_type;
     typedef value_type* pointer; // todo: is this OK?
-    typedef std::pair<coefficient&, const const_monomial> reference;
+    typedef std::pair<stored_coefficient&, const const_monomial> reference;
 
     iterator() {}
     iterator operator++() { ++ic; im += monsize; return *this; }
-    coefficient &getCoefficient() const { return *ic; }
+    stored_coefficient &getCoefficient() const { return *ic; }
     monomial getMonomial() const { return &*im; }
     size_t operator-(const iterator &b) const { return ic - b.ic; }
     friend bool operator==(const iterator &a, const iterator &b);
     friend bool operator!=(const iterator &a, const iterator &b);
     reference operator*() const {
-      return std::pair<coefficient&, monomial>(getCoefficient(), getMonomial());
+      return reference(getCoefficient(), getMonomial());
     }
   };
 
   class const_iterator {
     // only for const objects...
     size_t monsize;
-    std::vector<coefficient>::const_iterator ic;
-    std::vector<exponent>::const_iterator im;
+    CoefficientVector::const_iterator ic;
+    MonomialVector::const_iterator im;
     friend class Poly;
 
     const_iterator(const Poly& f) : monsize(f.getRing()->maxMonomialSize()), ic(f.coeffs.begin()), im(f.monoms.begin()) {}
@@ -90,7 +205,7 @@ public:
   // Cannot call this monomial() since that is already a type :-(
   monomial monomialAt(size_t index);
   const_monomial monomialAt(size_t index) const;
-  coefficient& coefficientAt(size_t index);
+  stored_coefficient& coefficientAt(size_t index);
   const coefficient coefficientAt(size_t index) const;
 
   /// all iterators are invalid after this
@@ -108,7 +223,7 @@ public:
   iterator begin() { return iterator(*this); }
   iterator end() { return iterator(*this,1); }
 
-  const coefficient* coefficientBegin() const {return coeffs.data();}
+  const stored_coefficient* coefficientBegin() const {return coeffs.data();}
 
 
   static Poly * add(const PolyRing *R,
@@ -135,6 +250,10 @@ public:
 
   size_t getMemoryUse() const;
 
+  /// Returns the arena that the terms are stored in or null if they are
+  /// stored on the heap.
+  PolyArena* arena() const {return coeffs.get_allocator().arena();}
+
   void setToZero();
 
   void copy(Poly &result) const;
@@ -152,12 +271,36 @@ public:
 
 private:
   const PolyRing *R;
-  std::vector<coefficient> coeffs;
-  std::vector<exponent> monoms;
+  CoefficientVector coeffs;
+  MonomialVector monoms;
 };
 
 std::ostream& operator<<(std::ostream& out, const Poly& p);
 
+/// Deletes a Poly whether it is on the heap or was constructed in its
+/// PolyArena. The space of a Poly in an arena is only counted as unused, so
+/// the arena must outlive the Poly. Converts from std::default_delete so
+/// that a std::unique_ptr<Poly> can be moved into an ArenaPolyPtr.
+class PolyDeleter {
+public:
+  PolyDeleter() {}
+  PolyDeleter(const std::default_delete<Poly>&) {}
+
+  void operator()(Poly* poly) const {
+    MATHICGB_ASSERT(poly != 0);
+    const auto arena = poly->arena();
+    if (arena == 0)
+      delete poly;
+    else {
+      poly->~Poly();
+      arena->free(sizeof(Poly));
+    }
+  }
+};
+
+/// Owns a Poly that may be in a PolyArena.
+typedef std::unique_ptr<Poly, PolyDeleter> ArenaPolyPtr;
+
 inline bool operator==(const Poly::iterator &a, const Poly::iterator &b)
 {
   return a.ic == b.ic;
@@ -179,14 +322,16 @@ inline bool operator!=(const Poly::const_iterator &a, const Poly::const_iterator
 inline void Poly::appendTerm(coefficient a, const_monomial m)
 {
   // the monomial will be copied on.
-  coeffs.push_back(a);
+  MATHICGB_ASSERT(0 <= a && a < R->charac());
+  coeffs.push_back(static_cast<stored_coefficient>(a));
   size_t len = R->maxMonomialSize();
   exponent const * e = m.unsafeGetRepresentation();
   monoms.insert(monoms.end(), e, e + len);
 }
 
 inline void Poly::appendTerm(coefficient a, PolyRing::Monoid::ConstMonoRef m) {
-  coeffs.push_back(a);
+  MATHICGB_ASSERT(0 <= a && a < R->charac());
+  coeffs.push_back(static_cast<stored_coefficient>(a));
   size_t len = R->maxMonomialSize();
   auto& monoid = ring().monoid();
   const auto offset = monoms.size();
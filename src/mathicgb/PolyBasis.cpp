@@ -13,7 +13,8 @@ PolyBasis::PolyBasis(
   std::unique_ptr<DivisorLookup> divisorLookup
 ):
   mRing(ring),
-  mDivisorLookup(std::move(divisorLookup))
+  mDivisorLookup(std::move(divisorLookup)),
+  mUseSugar(false)
 {
   MATHICGB_ASSERT(mDivisorLookup.get() != 0);
   mDivisorLookup->setBasis(*this);
@@ -25,7 +26,7 @@ PolyBasis::~PolyBasis() {
     if (it->retired)
       continue;
     MATHICGB_ASSERT(it->poly != 0);
-    delete it->poly;
+    destroy(it->poly);
   }
 }
 
@@ -44,12 +45,17 @@ std::unique_ptr<Basis> PolyBasis::initialIdeal() const {
 }
 
 void PolyBasis::insert(std::unique_ptr<Poly> poly) {
+  insert(std::move(poly), 0);
+}
+
+void PolyBasis::insert(std::unique_ptr<Poly> poly, Exponent sugar) {
   MATHICGB_ASSERT(poly.get() != 0);
   MATHICGB_ASSERT(!poly->isZero());
   poly->makeMonic();
+  Poly* const stored = store(std::move(poly));
   const size_t index = size();
   EntryIter const stop = mEntries.end();
-  const_monomial const lead = poly->getLeadMonomial();
+  const_monomial const lead = stored->getLeadMonomial();
 #ifdef DEBUG
   // lead monomials must be unique among basis elements
   for (EntryIter it = mEntries.begin(); it != stop; ++it) {
@@ -79,32 +85,163 @@ void PolyBasis::insert(std::unique_ptr<Poly> poly) {
 
   mDivisorLookup->insert(lead, index);
 
+  if (mUseSugar) {
+    const auto polyEnd = stored->end();
+    for (auto it = stored->begin(); it != polyEnd; ++it)
+      sugar = std::max(sugar, monoid().totalDegree(it.getMonomial()));
+  }
+
   mEntries.push_back(Entry());
   Entry& entry = mEntries.back();
-  entry.poly = poly.release();
+  entry.poly = stored;
   entry.leadMinimal = leadMinimal;
+  entry.sugar = sugar;
 
   MATHICGB_ASSERT(mEntries.back().poly != 0);
 }
 
+void PolyBasis::replaceSameLeadTerm(
+  size_t index,
+  std::unique_ptr<Poly> newValue
+) {
+  MATHICGB_ASSERT(index < size());
+  MATHICGB_ASSERT(!retired(index));
+  MATHICGB_ASSERT(newValue.get() != 0);
+  MATHICGB_ASSERT(!newValue->isZero());
+  MATHICGB_ASSERT(mRing.monomialEQ
+                  (leadMonomial(index), newValue->getLeadMonomial()));
+  Poly* const stored = store(std::move(newValue));
+  mDivisorLookup->remove(leadMonomial(index));
+  destroy(mEntries[index].poly);
+  mEntries[index].poly = stored;
+  mDivisorLookup->insert(leadMonomial(index), index);
+  MATHICGB_ASSERT(mEntries[index].poly != 0);
+  compactIfFragmented();
+}
+
 std::unique_ptr<Poly> PolyBasis::retire(size_t index) {
+  auto poly = retireWithoutCompacting(index);
+  compactIfFragmented();
+  return poly;
+}
+
+std::unique_ptr<Poly> PolyBasis::retireWithoutCompacting(size_t index) {
   MATHICGB_ASSERT(index < size());
   MATHICGB_ASSERT(!retired(index));
   mDivisorLookup->remove(leadMonomial(index));
-  std::unique_ptr<Poly> poly(mEntries[index].poly);
+  std::unique_ptr<Poly> poly;
+  if (mEntries[index].poly->arena() == 0)
+    poly.reset(mEntries[index].poly);
+  else {
+    // The arena can be freed while the caller still has poly, so the
+    // caller gets a copy.
+    poly.reset(copy(*mEntries[index].poly, 0));
+    destroy(mEntries[index].poly);
+  }
   mEntries[index].poly = 0;
   mEntries[index].retired = true;
   return poly;
 }
 
+void PolyBasis::setUseArena(bool value) {
+  if (value == usesArena())
+    return;
+  if (value) {
+    auto arena = make_unique<PolyArena>();
+    moveAll(arena.get());
+    mArena = std::move(arena);
+  } else {
+    moveAll(0);
+    mArena.reset();
+  }
+}
+
+void PolyBasis::compact() {
+  if (!usesArena())
+    return;
+  auto arena = make_unique<PolyArena>();
+  moveAll(arena.get());
+  mArena = std::move(arena);
+}
+
+void PolyBasis::compactIfFragmented() {
+  // Compacting copies the live polynomials, which is no more than the
+  // unused memory, so the time spent on compaction is proportional to the
+  // amount of memory that gets freed. The lower bound avoids compacting
+  // small bases over and over.
+  const size_t MinUnusedMemory = 1 << 20;
+  if (!usesArena())
+    return;
+  const auto unused = mArena->getUnusedMemory();
+  if (unused >= MinUnusedMemory && 2 * unused > mArena->getMemoryUse())
+    compact();
+}
+
+Poly* PolyBasis::store(std::unique_ptr<Poly> poly) {
+  MATHICGB_ASSERT(poly.get() != 0);
+  if (!usesArena())
+    return poly.release();
+  return copy(*poly, mArena.get());
+}
+
+Poly* PolyBasis::copy(const Poly& poly, PolyArena* arena) {
+  if (arena == 0)
+    return poly.copy();
+  Poly* const copied =
+    new (arena->alloc(sizeof(Poly))) Poly(poly.ring(), arena);
+  poly.copy(*copied);
+  return copied;
+}
+
+void PolyBasis::destroy(Poly* poly) {
+  PolyDeleter()(poly);
+}
+
+void PolyBasis::moveAll(PolyArena* arena) {
+  for (size_t i = 0; i < size(); ++i) {
+    if (retired(i))
+      continue;
+    auto& entry = mEntries[i];
+    Poly* const moved = copy(*entry.poly, arena);
+
+    // The divisor lookup may point to the lead monomial of the old copy.
+    mDivisorLookup->remove(leadMonomial(i));
+    destroy(entry.poly);
+    entry.poly = moved;
+    mDivisorLookup->insert(leadMonomial(i), i);
+  }
+}
+
 std::unique_ptr<Basis> PolyBasis::toBasisAndRetireAll() {
   auto basis = make_unique<Basis>(ring());
   for (size_t i = 0; i < size(); ++i)
     if (!retired(i))
-      basis->insert(retire(i));
+      basis->insert(retireWithoutCompacting(i));
+  if (usesArena())
+    mArena = make_unique<PolyArena>();
   return basis;
 }
 
+void PolyBasis::retireAll(
+  std::vector<ArenaPolyPtr>& polys,
+  std::unique_ptr<PolyArena>& arena
+) {
+  MATHICGB_ASSERT(arena.get() == 0);
+  polys.reserve(polys.size() + size());
+  for (size_t i = 0; i < size(); ++i) {
+    if (retired(i))
+      continue;
+    mDivisorLookup->remove(leadMonomial(i));
+    polys.push_back(ArenaPolyPtr(mEntries[i].poly));
+    mEntries[i].poly = 0;
+    mEntries[i].retired = true;
+  }
+  if (usesArena()) {
+    arena = std::move(mArena);
+    mArena = make_unique<PolyArena>();
+  }
+}
+
 size_t PolyBasis::divisor(const_monomial mon) const {
   size_t index = divisorLookup().divisor(mon);
   MATHICGB_ASSERT((index == static_cast<size_t>(-1)) ==
@@ -178,6 +315,8 @@ size_t PolyBasis::monomialCount() const {
 
 size_t PolyBasis::getMemoryUse() const {
   size_t sum = mEntries.capacity() * sizeof(mEntries.front());
+  if (usesArena())
+    return sum + mArena->getMemoryUse();
   EntryCIter const stop = mEntries.end();
   for (EntryCIter it = mEntries.begin(); it != stop; ++it)
     if (!it->retired)
@@ -185,10 +324,15 @@ size_t PolyBasis::getMemoryUse() const {
   return sum;
 }
 
+size_t PolyBasis::getUnusedMemory() const {
+  return usesArena() ? mArena->getUnusedMemory() : 0;
+}
+
 PolyBasis::Entry::Entry():
   poly(0),
   leadMinimal(0),
   retired(false),
+  sugar(0),
   usedAsStartCount(0),
   usedAsReducerCount(0),
   possibleReducerCount(0),
@@ -16,6 +16,7 @@ class Basis;
 class PolyBasis {
 public:
   typedef PolyRing::Monoid Monoid;
+  typedef Monoid::Exponent Exponent;
 
   // Ring must live for as long as this object.
   PolyBasis(
@@ -32,8 +33,22 @@ public:
   // Inserts a polynomial into the basis at index size().
   // Lead monomials must be unique among basis elements.
   // So the index is size() - 1 afterwards since size() will increase by 1.
+  // If usesSugar(), the sugar of the new basis element is its total degree.
   void insert(std::unique_ptr<Poly> poly);
 
+  // As insert(poly), but the sugar of the new basis element is the maximum
+  // of sugar and the total degree of poly. Use this for a polynomial
+  // that has been computed from S-pairs of the given sugar. If not
+  // usesSugar(), the sugar is just recorded as given.
+  void insert(std::unique_ptr<Poly> poly, Exponent sugar);
+
+  // Makes insert() compute the sugar of the inserted polynomials. That
+  // takes a pass over all of their terms, so it is off by default. Only
+  // affects the elements inserted afterwards.
+  void setUseSugar(bool value) {mUseSugar = value;}
+
+  bool usesSugar() const {return mUseSugar;}
+
   // Returns the index of a basis element whose lead term divides mon.
   // Returns -1 if there is no such basis element.
   size_t divisor(const_monomial mon) const;
@@ -48,19 +63,7 @@ public:
   // Replaces basis element at index with the given new value. The lead
   // term of the new polynomial must be the same as the previous one.
   // This is useful for auto-tail-reduction.
-  void replaceSameLeadTerm(size_t index, std::unique_ptr<Poly> newValue) {
-    MATHICGB_ASSERT(index < size());
-    MATHICGB_ASSERT(!retired(index));
-    MATHICGB_ASSERT(newValue.get() != 0);
-    MATHICGB_ASSERT(!newValue->isZero());
-    MATHICGB_ASSERT(mRing.monomialEQ
-                    (leadMonomial(index), newValue->getLeadMonomial()));
-    mDivisorLookup->remove(leadMonomial(index));
-    delete mEntries[index].poly;
-    mEntries[index].poly = newValue.release();
-    mDivisorLookup->insert(leadMonomial(index), index);    
-    MATHICGB_ASSERT(mEntries[index].poly != 0);
-  }
+  void replaceSameLeadTerm(size_t index, std::unique_ptr<Poly> newValue);
 
   // Returns the number of basis elements, including retired elements.
   size_t size() const {return mEntries.size();}
@@ -80,9 +83,21 @@ public:
 
   /// Returns an basis containing all non-retired basis elements and
   /// retires all those basis elements. The point of the simultaneous
-  /// retirement is that this way no polynomials need be copied.
+  /// retirement is that the arena, if any, is freed once at the end
+  /// instead of being compacted over and over as it empties. Polynomials
+  /// in the arena are copied, so use retireAll() to avoid having the basis
+  /// in memory twice.
   std::unique_ptr<Basis> toBasisAndRetireAll();
 
+  /// Retires all non-retired basis elements and appends them to polys
+  /// without copying them. If the basis uses an arena, the polynomials are
+  /// in it, so the arena is moved to arena, which must be null, and must
+  /// outlive the polynomials. The basis then gets a new arena.
+  void retireAll(
+    std::vector<ArenaPolyPtr>& polys,
+    std::unique_ptr<PolyArena>& arena
+  );
+
   // Returns true of the basis element at index has been retired.
   bool retired(size_t index) const {
     MATHICGB_ASSERT(index < size());
@@ -109,6 +124,16 @@ public:
     return poly(index).getLeadMonomial();
   }
 
+  // Returns the sugar of the basis element at index. This is an upper
+  // bound on the total degree of the polynomials that were involved in
+  // computing the basis element, as in the sugar strategy for choosing
+  // S-pairs. Also available for retired basis elements. Only meaningful
+  // if usesSugar() was true when the element was inserted.
+  Exponent sugar(size_t index) const {
+    MATHICGB_ASSERT(index < size());
+    return mEntries[index].sugar;
+  }
+
   coefficient leadCoefficient(size_t index) const {
     MATHICGB_ASSERT(index < size());
     MATHICGB_ASSERT(!retired(index));
@@ -156,6 +181,32 @@ public:
   // Returns how many bytes has been allocated by this object.
   size_t getMemoryUse() const;
 
+  // Returns how many of the bytes from getMemoryUse() are held by the
+  // arena but no longer used, such as the space of retired and replaced
+  // basis elements. Always zero if the basis does not use an arena.
+  size_t getUnusedMemory() const;
+
+  // Makes the basis keep the basis element polynomials and their terms in
+  // a PolyArena instead of allocating each one separately on the heap.
+  // Polynomials are copied into the arena as they are inserted and copied
+  // out of it when retired. The space of retired and replaced elements is
+  // reclaimed by compact(), which is called automatically once more than
+  // half of the arena is unused.
+  //
+  // Compaction moves the basis polynomials, so references to them and to
+  // their monomials are invalidated by insert(), retire() and
+  // replaceSameLeadTerm(). The DivisorLookup of the basis is kept up to
+  // date, but do not use an arena if other data structures point into the
+  // basis polynomials.
+  void setUseArena(bool value);
+
+  bool usesArena() const {return mArena.get() != 0;}
+
+  // Moves the basis element polynomials to a new arena and frees the old
+  // one, which releases the unused memory. Does nothing if the basis does
+  // not use an arena.
+  void compact();
+
   void usedAsStart(size_t index) const {
     MATHICGB_ASSERT(index < size());
     ++mEntries[index].usedAsStartCount;
@@ -200,6 +251,25 @@ private:
   // Slow versions use simpler code. Used to check results in debug mode.
   bool leadMinimalSlow(size_t index) const;
 
+  // Returns poly or a copy of poly in mArena if there is an arena.
+  Poly* store(std::unique_ptr<Poly> poly);
+
+  // Returns a copy of poly in arena, or on the heap if arena is null.
+  static Poly* copy(const Poly& poly, PolyArena* arena);
+
+  // Deletes poly whether or not it is in an arena.
+  static void destroy(Poly* poly);
+
+  // Moves all basis elements that are not retired to arena or to the heap
+  // if arena is null.
+  void moveAll(PolyArena* arena);
+
+  // As retire() except that the arena is not compacted.
+  std::unique_ptr<Poly> retireWithoutCompacting(size_t index);
+
+  // Calls compact() if more than half of mArena is unused.
+  void compactIfFragmented();
+
   class Entry {
   public:
     Entry();
@@ -207,6 +277,7 @@ private:
     Poly* poly;
     bool leadMinimal;
     bool retired;
+    Exponent sugar;
 
     // Statistics on reducer choice in reduction
     mutable unsigned long long usedAsStartCount;
@@ -221,6 +292,8 @@ private:
   const PolyRing& mRing;
   std::unique_ptr<DivisorLookup> mDivisorLookup;
   std::vector<Entry> mEntries;
+  std::unique_ptr<PolyArena> mArena;
+  bool mUseSugar;
 };
 
 MATHICGB_NAMESPACE_END
@@ -136,7 +136,10 @@ bool PolyGeoBucket::computeLeadTerm()
           continue;
         }
       // At this point we have equality
-      R->coefficientAddTo(heap[lead_so_far].first.getCoefficient(), heap[i].first.getCoefficient());
+      coefficient sum = heap[lead_so_far].first.getCoefficient();
+      R->coefficientAddTo(sum, heap[i].first.getCoefficient());
+      heap[lead_so_far].first.getCoefficient() =
+        static_cast<stored_coefficient>(sum);
       // now increment one of these
       ++heap[i].first;
       if (heap[i].first == heap[i].last)
@@ -11,12 +11,17 @@
 #include <cctype>
 #include <cstdlib>
 #include <limits>
+#include <sstream>
+#include <mathic.h>
 
 MATHICGB_NAMESPACE_BEGIN
 
 PolyRing::PolyRing(const Field& field, Monoid&& monoid):
   mField(field), mMonoid(std::move(monoid))
-{}
+{
+  checkCharacteristic();
+  computeInverses();
+}
 
 PolyRing::PolyRing(
   coefficient p0,
@@ -34,7 +39,26 @@ PolyRing::PolyRing(
         MonoOrder<exponent>::RevLexBaseOrderFromRight
     )
   )
-{}
+{
+  checkCharacteristic();
+  computeInverses();
+}
+
+void PolyRing::checkCharacteristic() const {
+  if (charac() > std::numeric_limits<stored_coefficient>::max()) {
+    std::ostringstream str;
+    str << "Characteristic " << charac()
+      << " is too large. MathicGB only supports 32 bit characteristics.";
+    mathic::reportError(str.str());
+  }
+}
+
+void PolyRing::computeInverses() {
+  // The table has at most 2^16 entries of 2 bytes each. Larger fields
+  // compute inverses one at a time.
+  if (charac() - 1 <= std::numeric_limits<uint16>::max())
+    field().inverseTable(mInverses);
+}
 
 ///////////////////////////////////////
 // (New) Monomial Routines ////////////
@@ -90,6 +90,13 @@ T modularNegativeNonZero(T a, T modulus) {
 typedef int32 exponent ;
 typedef uint32 HashValue;
 typedef long coefficient;
+
+/// Poly stores coefficients as this type, which takes half the space of
+/// coefficient. Arithmetic is done on coefficient and the result is
+/// narrowed when it is stored. That is exact since coefficients are
+/// always reduced modulo the characteristic, which the PolyRing
+/// constructors check fits into this type.
+typedef uint32 stored_coefficient;
 typedef MonoMonoid<exponent> Monoid;
 typedef PrimeField<unsigned long> Field;
 
@@ -463,11 +470,26 @@ public:
   ///////////////////////////////////////////
 
   const Monoid& monoid() const {return mMonoid;}
-  const Field field() const {return mField;}
+  const Field& field() const {return mField;}
 
 private:
+  // Reports an error if the characteristic does not fit in a
+  // stored_coefficient.
+  void checkCharacteristic() const;
+
+  // Sets up mInverses.
+  void computeInverses();
+
+  // Returns the inverse of a, which must not be zero.
+  coefficient inverse(coefficient a) const;
+
   Field mField;
   Monoid mMonoid;
+
+  // mInverses[a] is the inverse of a if the characteristic is small
+  // enough for the inverses to be precomputed. Otherwise mInverses is
+  // empty and the inverses are computed as needed.
+  std::vector<uint16> mInverses;
 };
 
 inline exponent PolyRing::weight(ConstMonomial a) const {
@@ -603,16 +625,24 @@ inline bool PolyRing::monomialIsLeastCommonMultiple(
   return monoid().isLcm(a, b, l);
 }
 
+inline coefficient PolyRing::inverse(const coefficient a) const {
+  MATHICGB_ASSERT(0 < a);
+  MATHICGB_ASSERT(a < charac());
+  if (!mInverses.empty())
+    return mInverses[a];
+  return field().inverse(field().toElementInRange(a)).value();
+}
+
 inline void PolyRing::coefficientReciprocalTo(coefficient& result) const
 {
-  result = field().inverse(field().toElementInRange(result)).value();
+  result = inverse(result);
 }
 
 inline void PolyRing::coefficientDivide(coefficient a, coefficient b, coefficient &result) const
  // result = a/b
 {
-  result = field().quotient
-    (field().toElementInRange(a), field().toElementInRange(b)).value();
+  const auto inverseB = field().toElementInRange(inverse(b));
+  result = field().product(field().toElementInRange(a), inverseB).value();
 }
 
 inline void PolyRing::coefficientFromInt(coefficient &result, int a) const
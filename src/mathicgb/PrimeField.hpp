@@ -6,12 +6,40 @@
 #include <limits>
 #include <type_traits>
 #include <ostream>
+#include <vector>
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
 
 MATHICGB_NAMESPACE_BEGIN
 
+namespace PrimeFieldInternal {
+#if defined(__SIZEOF_INT128__)
+#define MATHICGB_HAS_MULTIPLY_HIGH
+  /// Returns the upper 64 bits of the 128 bit product of a and b.
+  inline uint64 multiplyHigh(const uint64 a, const uint64 b) {
+    typedef unsigned __int128 uint128;
+    return static_cast<uint64>((static_cast<uint128>(a) * b) >> 64);
+  }
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define MATHICGB_HAS_MULTIPLY_HIGH
+  inline uint64 multiplyHigh(const uint64 a, const uint64 b) {
+    return __umulh(a, b);
+  }
+#endif
+}
+
 /// Implements arithmetic in a prime field. T must be an unsigned integer type
 /// that is used to store the elements of the field. The characteristic of the
 /// field must be a prime not exceeding std::numeric_limits<T>::max().
+///
+/// Products are reduced modulo the characteristic by Barrett reduction,
+/// which replaces the division of x % charac() by two multiplications with
+/// a reciprocal of the characteristic that the constructor computes. For
+/// characteristics below 2^16 the products fit in 32 bits and 64 bit
+/// multiplication is enough. Larger characteristics below 2^32 need the
+/// upper half of a 64 by 64 bit multiplication, so for those x % charac()
+/// is used on platforms without that.
 template<class T>
 class PrimeField {
 public:
@@ -41,7 +69,11 @@ public:
     T mValue;
   };
 
-  PrimeField(const T primeCharacteristic): mCharac(primeCharacteristic) {}
+  PrimeField(const T primeCharacteristic):
+    mCharac(primeCharacteristic),
+    mNarrowReciprocal(narrowReciprocal(primeCharacteristic)),
+    mWideReciprocal(wideReciprocal(primeCharacteristic))
+  {}
 
   Element zero() const {return Element(0);}
   Element one() const {return Element(1);}
@@ -149,8 +181,56 @@ public:
   /// Returns the multiplicative inverse a^-1 mod charac(). a must not be zero.
   Element inverse(const Element a) const;
 
+  /// Returns x mod charac(). This is faster than toElement(x) as it uses
+  /// Barrett reduction where possible. That makes it suitable for reducing
+  /// sums of many products that have been accumulated without reduction.
+  Element reduce(const uint64 x) const {
+#ifdef MATHICGB_HAS_MULTIPLY_HIGH
+    if (mWideReciprocal != 0) {
+      // The quotient is at most one too small since the reciprocal is
+      // rounded down and x < 2^64.
+      const auto quotient =
+        PrimeFieldInternal::multiplyHigh(x, mWideReciprocal);
+      auto remainder = x - quotient * charac();
+      if (remainder >= charac())
+        remainder -= charac();
+      MATHICGB_ASSERT(remainder == x % charac());
+      return Element(static_cast<T>(remainder));
+    }
+#endif
+    return Element(static_cast<T>(x % charac()));
+  }
+
+  /// Sets table so that table[a] is the inverse of a for 0 < a < charac()
+  /// and table[0] is zero. This takes O(charac()) time and space, so it is
+  /// only for small characteristics, where a look-up in the table is much
+  /// faster than inverse(). Entry must be able to hold the elements.
+  template<class Entry>
+  void inverseTable(std::vector<Entry>& table) const;
+
 private:
+  /// Returns floor(2^32 / charac) if the products of elements fit in 32
+  /// bits, that is if charac <= 2^16. Otherwise returns zero.
+  static uint64 narrowReciprocal(const T charac) {
+    if (static_cast<uint64>(charac) > (static_cast<uint64>(1) << 16))
+      return 0;
+    return (static_cast<uint64>(1) << 32) / charac;
+  }
+
+  /// Returns floor((2^64 - 1) / charac) if charac fits in 32 bits and the
+  /// platform can compute the upper half of a 64 bit product. Otherwise
+  /// returns zero.
+  static uint64 wideReciprocal(const T charac) {
+#ifdef MATHICGB_HAS_MULTIPLY_HIGH
+    if (static_cast<uint64>(charac) <= std::numeric_limits<uint32>::max())
+      return std::numeric_limits<uint64>::max() / charac;
+#endif
+    return 0;
+  }
+
   const T mCharac;
+  const uint64 mNarrowReciprocal;
+  const uint64 mWideReciprocal;
 };
 
 namespace PrimeFieldInternal {
@@ -175,7 +255,37 @@ auto PrimeField<T>::product(
   typedef typename PrimeFieldInternal::ModularProdType<T>::type BigT;
   BigT bigProd = static_cast<BigT>(a.value()) * b.value();
   MATHICGB_ASSERT(a.value() == 0 || bigProd / a.value() == b.value());
-  return Element(static_cast<T>(bigProd % charac()));
+  if (mNarrowReciprocal != 0) {
+    // bigProd < 2^32 and the reciprocal is below 2^32, so this does not
+    // overflow. The quotient is at most one too small.
+    const auto x = static_cast<uint64>(bigProd);
+    const auto quotient = (x * mNarrowReciprocal) >> 32;
+    auto remainder = x - quotient * charac();
+    if (remainder >= charac())
+      remainder -= charac();
+    MATHICGB_ASSERT(remainder == x % charac());
+    return Element(static_cast<T>(remainder));
+  }
+  return reduce(static_cast<uint64>(bigProd));
+}
+
+template<class T>
+template<class Entry>
+void PrimeField<T>::inverseTable(std::vector<Entry>& table) const {
+  MATHICGB_ASSERT(charac() - 1 <= std::numeric_limits<Entry>::max());
+  table.clear();
+  table.resize(charac());
+  if (charac() == 1)
+    return;
+  // charac() = q * a + r with 0 < r < a since charac() is prime, so
+  // 0 = q * a + r and then a^-1 = -q * r^-1 where r^-1 is already known.
+  table[1] = 1;
+  for (T a = 2; a < charac(); ++a) {
+    const auto minusQuotient = negativeNonZero(Element(charac() / a));
+    const auto inverseOfRemainder = Element(table[charac() % a]);
+    table[a] =
+      static_cast<Entry>(product(minusQuotient, inverseOfRemainder).value());
+  }
 }
 
 template<class T>
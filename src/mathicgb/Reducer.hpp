@@ -12,6 +12,7 @@ MATHICGB_NAMESPACE_BEGIN
 
 class SigPolyBasis;
 class PolyBasis;
+class F4Trace;
 
 /** Abstract base class for classes that allow reduction of polynomials.
 
@@ -28,6 +29,13 @@ public:
   /// larger sets of reductions at a time.
   virtual unsigned int preferredSetSize() const = 0;
 
+  /// Returns true if preferredSetSize() changes as the reducer learns how
+  /// long reductions take. Then the caller should ask for it before each
+  /// set of reductions and use that many, instead of handing over all the
+  /// S-pairs of a degree at once as it would otherwise do for a reducer
+  /// that prefers large sets. False by default.
+  virtual bool adaptiveSetSize() const {return false;}
+
   // ***** Methods that do reduction
 
   /** Clasically reduces poly by the basis elements of basis. The reduction
@@ -75,6 +83,12 @@ public:
     at a time - if such a thing is appropriate for the reducer. */
   virtual void setMemoryQuantum(size_t quantum) = 0;
 
+  /** Records the reductions to trace or replays them from trace,
+    depending on whether trace is learning. Does nothing by default,
+    since only F4Reducer supports traces. A null trace turns tracing
+    off. */
+  virtual void setTrace(F4Trace* /*trace*/) {}
+
   // ***** Kinds of reducers and creating a Reducer 
 
   enum ReducerType {
@@ -0,0 +1,106 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#include "stdinc.h"
+#include "SPairGroupSizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+MATHICGB_NAMESPACE_BEGIN
+
+namespace {
+  // How much of the weight of the previous matrices is kept when a new
+  // matrix is recorded.
+  const double Keep = 0.7;
+
+  // Matrices that take less time than this are not timed precisely enough
+  // to be useful for the model.
+  const double MinSeconds = 1e-4;
+
+  // The group size changes by at most this factor from one matrix to the
+  // next, so that a bad prediction does not do too much harm.
+  const size_t MaxChange = 4;
+
+  const size_t MaxGroupSize = 1000000;
+}
+
+SPairGroupSizer::SPairGroupSizer(
+  const double targetSeconds,
+  const size_t initialGroupSize
+):
+  mTargetSeconds(targetSeconds),
+  mGroupSize(std::max<size_t>(initialGroupSize, 1)),
+  mExponent(1.0),
+  mWeight(0),
+  mSumX(0),
+  mSumY(0),
+  mSumXX(0),
+  mSumXY(0),
+  mEntriesPerPair(0)
+{
+  MATHICGB_ASSERT(targetSeconds > 0);
+}
+
+void SPairGroupSizer::recordMatrix(
+  const size_t pairCount,
+  const size_t entryCount,
+  const double seconds
+) {
+  if (pairCount == 0 || entryCount == 0)
+    return;
+
+  const double entriesPerPair = static_cast<double>(entryCount) / pairCount;
+  mEntriesPerPair = mEntriesPerPair == 0 ?
+    entriesPerPair : (mEntriesPerPair + entriesPerPair) / 2;
+
+  if (seconds >= MinSeconds) {
+    const double x = std::log(static_cast<double>(entryCount));
+    const double y = std::log(seconds);
+    mWeight = Keep * mWeight + 1;
+    mSumX = Keep * mSumX + x;
+    mSumY = Keep * mSumY + y;
+    mSumXX = Keep * mSumXX + x * x;
+    mSumXY = Keep * mSumXY + x * y;
+
+    // Only fit the exponent if the matrices are different enough in size.
+    // Reduction is never cheaper than linear, and an exponent that is too
+    // large would make the group size jump around.
+    const double meanX = mSumX / mWeight;
+    const double meanY = mSumY / mWeight;
+    const double varianceX = mSumXX / mWeight - meanX * meanX;
+    const double covariance = mSumXY / mWeight - meanX * meanY;
+    if (varianceX > 0.05)
+      mExponent = std::min(std::max(covariance / varianceX, 1.0), 3.0);
+  }
+
+  size_t size;
+  if (mWeight == 0)
+    size = mGroupSize * MaxChange; // all matrices were too fast to time
+  else {
+    const double pairs = targetEntryCount() / mEntriesPerPair;
+    size = pairs >= MaxGroupSize ? MaxGroupSize : static_cast<size_t>(pairs);
+  }
+  size = std::min(size, mGroupSize * MaxChange);
+  size = std::max(size, mGroupSize / MaxChange);
+  mGroupSize = std::min(std::max<size_t>(size, 1), MaxGroupSize);
+}
+
+size_t SPairGroupSizer::groupSize(
+  const size_t bytesPerPair,
+  const size_t availableBytes
+) const {
+  if (bytesPerPair == 0)
+    return mGroupSize;
+  const auto fits = std::max<size_t>(availableBytes / bytesPerPair, 1);
+  return std::min(mGroupSize, fits);
+}
+
+double SPairGroupSizer::targetEntryCount() const {
+  MATHICGB_ASSERT(mWeight > 0);
+  const double meanX = mSumX / mWeight;
+  const double meanY = mSumY / mWeight;
+  const double logConstant = meanY - mExponent * meanX;
+  return std::exp((std::log(mTargetSeconds) - logConstant) / mExponent);
+}
+
+MATHICGB_NAMESPACE_END
@@ -0,0 +1,65 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#ifndef MATHICGB_S_PAIR_GROUP_SIZER_GUARD
+#define MATHICGB_S_PAIR_GROUP_SIZER_GUARD
+
+MATHICGB_NAMESPACE_BEGIN
+
+/// Chooses how many S-pairs to reduce in each F4 matrix so that building
+/// and reducing a matrix takes about a target amount of time. Too few
+/// S-pairs per matrix waste parallelism and repeat the work of finding
+/// reducers, while too many take a lot of memory and the reduction time
+/// grows faster than linearly in the size of the matrix.
+///
+/// The cost model is that the time for a matrix is c * entries^e. The
+/// constants c and e are fitted by least squares on the logarithms of the
+/// recorded matrices, with the older matrices weighted down so that the
+/// model follows the computation as it moves to higher degrees. The number
+/// of entries per S-pair is taken from the recent matrices too, since that
+/// also grows with the degree.
+class SPairGroupSizer {
+public:
+  /// Starts out at initialGroupSize S-pairs per matrix.
+  SPairGroupSizer(double targetSeconds, size_t initialGroupSize = 100);
+
+  double targetSeconds() const {return mTargetSeconds;}
+
+  /// Updates the model with a matrix that was built from pairCount S-pairs.
+  /// The matrix had the given number of non-zero entries and it took
+  /// seconds to build and reduce it.
+  void recordMatrix(size_t pairCount, size_t entryCount, double seconds);
+
+  /// Returns the number of S-pairs to put in the next matrix. If
+  /// bytesPerPair is not zero, then at most availableBytes / bytesPerPair
+  /// S-pairs are returned, but at least 1.
+  size_t groupSize(size_t bytesPerPair, size_t availableBytes) const;
+
+  /// As groupSize(0, 0) - that is, without a memory limit.
+  size_t groupSize() const {return mGroupSize;}
+
+  /// Returns the fitted exponent e of the cost model.
+  double exponent() const {return mExponent;}
+
+private:
+  /// Returns the number of entries that a matrix can have according to the
+  /// model if it is to take mTargetSeconds. Only call this if mWeight > 0.
+  double targetEntryCount() const;
+
+  const double mTargetSeconds;
+  size_t mGroupSize;
+  double mExponent;
+
+  /// Weighted sums of x = log(entries) and y = log(seconds) over the
+  /// recorded matrices, for the least squares fit of y = log(c) + e * x.
+  double mWeight;
+  double mSumX;
+  double mSumY;
+  double mSumXX;
+  double mSumXY;
+
+  /// Weighted average of entries per S-pair. 0 before the first matrix.
+  double mEntriesPerPair;
+};
+
+MATHICGB_NAMESPACE_END
+#endif
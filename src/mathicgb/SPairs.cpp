@@ -30,11 +30,20 @@ MATHICGB_DEFINE_LOG_ALIAS("SPairsDetail", "SPairs,SPairDegree,SPairLcm");
 
 MATHICGB_NAMESPACE_BEGIN
 
-SPairs::SPairs(const PolyBasis& basis, bool preferSparseSPairs):
+SPairs::SPairs(
+  const PolyBasis& basis,
+  const bool preferSparseSPairs,
+  const bool useSugar
+):
   mMonoid(basis.ring().monoid()),
   mOrderMonoid(OrderMonoid::create(mMonoid)),
   mBareMonoid(BareMonoid::create(mMonoid)),
-  mQueue(QueueConfiguration(basis, mOrderMonoid, preferSparseSPairs)),
+  mPreferSparseSPairs(preferSparseSPairs),
+  mUseSugar(useSugar),
+  mColumnCount(0),
+  mPairCount(0),
+  mLcmA(mOrderMonoid.alloc()),
+  mLcmB(mOrderMonoid.alloc()),
   mBasis(basis)
  {}
 
@@ -44,21 +53,18 @@ std::pair<size_t, size_t> SPairs::pop() {
   // Must call addPairs for new elements before popping.
   MATHICGB_ASSERT(mEliminated.columnCount() == mBasis.size());
 
-  while (!mQueue.empty()) {
-    const auto p = mQueue.topPair();
-    if (mBasis.retired(p.first) || mBasis.retired(p.second)) {
-      mQueue.pop();
+  auto lcm = bareMonoid().alloc(); // todo: just keep one around instead
+  while (!empty()) {
+    const auto& top = topColumn();
+    const std::pair<size_t, size_t> p(top.col, top.rows[top.head]);
+    popQueue();
+    if (mBasis.retired(p.first) || mBasis.retired(p.second))
       continue;
-    }
-    auto lcm = bareMonoid().alloc(); // todo: just keep one around instead
-    bareMonoid().copy(orderMonoid(), mQueue.topPairData(), lcm);
-    mQueue.pop();
-
-    MATHICGB_ASSERT(bareMonoid().isLcm(
+    bareMonoid().lcm(
       monoid(), mBasis.leadMonomial(p.first),
       monoid(), mBasis.leadMonomial(p.second),
       lcm
-    ));
+    );
     if (!advancedBuchbergerLcmCriterion(p.first, p.second, lcm)) {
       mEliminated.setBit(p.first, p.second, true);
       return p;
@@ -73,25 +79,28 @@ std::pair<size_t, size_t> SPairs::pop(exponent& w) {
   // Must call addPairs for new elements before popping.
   MATHICGB_ASSERT(mEliminated.columnCount() == mBasis.size());
 
-  for (; !mQueue.empty(); mQueue.pop()) {
-    const auto p = mQueue.topPair();
-    if (mBasis.retired(p.first) || mBasis.retired(p.second))
+  auto lcm = bareMonoid().alloc(); // todo: just keep one around instead
+  while (!empty()) {
+    const auto& top = topColumn();
+    const std::pair<size_t, size_t> p(top.col, top.rows[top.head]);
+    if (mBasis.retired(p.first) || mBasis.retired(p.second)) {
+      popQueue();
       continue;
-    auto lcm = bareMonoid().alloc(); // todo: just keep one around instead
-    bareMonoid().copy(orderMonoid(), mQueue.topPairData(), lcm);
+    }
+    if (w != 0 && w != top.degree)
+      break;
+    const auto degree = top.degree;
+    popQueue();
 
-    MATHICGB_ASSERT(bareMonoid().isLcm(
+    bareMonoid().lcm(
       monoid(), mBasis.leadMonomial(p.first),
       monoid(), mBasis.leadMonomial(p.second),
       lcm
-    ));
+    );
     if (advancedBuchbergerLcmCriterion(p.first, p.second, lcm))
       continue;
     if (w == 0)
-      w = bareMonoid().degree(lcm);
-    else if (w != bareMonoid().degree(lcm))
-      break;
-    mQueue.pop();
+      w = degree;
     mEliminated.setBit(p.first, p.second, true);
     MATHICGB_IF_STREAM_LOG(SPairLcm) {
       stream << "Scheduling S-pair with lcm ";
@@ -104,6 +113,286 @@ std::pair<size_t, size_t> SPairs::pop(exponent& w) {
   return std::make_pair(static_cast<size_t>(-1), static_cast<size_t>(-1));
 }
 
+exponent SPairs::popDegree(std::vector<std::pair<size_t, size_t>>& pairs) {
+  pairs.clear();
+  exponent degree = 0;
+  while (pairs.empty() && !empty())
+    degree = popFirstDegree(pairs);
+  return degree;
+}
+
+exponent SPairs::popFirstDegree(
+  std::vector<std::pair<size_t, size_t>>& pairs
+) {
+  MATHICGB_LOG_TIME(SPairLate);
+
+  // Must call addPairs for new elements before popping.
+  MATHICGB_ASSERT(mEliminated.columnCount() == mBasis.size());
+  MATHICGB_ASSERT(!empty());
+
+  pairs.clear();
+  auto lcm = bareMonoid().alloc();
+  const auto bucket = firstBucket();
+  const exponent degree = bucket->first;
+  auto columns = std::move(bucket->second.columns);
+  mBuckets.erase(bucket);
+
+  // The pairs of a column are in order and the degree is the most
+  // significant part of that order, so the pairs of this degree are
+  // at the front of each column.
+  for (auto& column : columns) {
+    const size_t col = column.col;
+    const auto& rows = column.rows;
+    while (column.head < rows.size()) {
+      if (mBasis.retired(col))
+        break; // pushColumn() drops the column
+      const size_t row = rows[column.head];
+      if (mBasis.retired(row)) {
+        ++column.head;
+        --mPairCount;
+        continue;
+      }
+      orderMonoid().lcm(
+        monoid(), mBasis.leadMonomial(col),
+        monoid(), mBasis.leadMonomial(row),
+        mLcmA
+      );
+      if (pairDegree(col, row, mLcmA) != degree)
+        break;
+      ++column.head;
+      --mPairCount;
+
+      bareMonoid().copy(orderMonoid(), mLcmA, lcm);
+      if (advancedBuchbergerLcmCriterion(col, row, lcm))
+        continue;
+      mEliminated.setBit(col, row, true);
+      pairs.emplace_back(col, row);
+      MATHICGB_IF_STREAM_LOG(SPairLcm) {
+        stream << "Scheduling S-pair with lcm ";
+        MathicIO<BareMonoid>().writeMonomial
+          (bareMonoid(), BareMonoid::HasComponent, lcm, stream);
+        stream << '.' << std::endl;
+      };
+    }
+    pushColumn(std::move(column));
+  }
+  return degree;
+}
+
+exponent SPairs::nextWeight() const {
+  MATHICGB_ASSERT(!empty());
+  if (lowWeightFirst())
+    return mBuckets.begin()->first;
+  else
+    return std::prev(mBuckets.end())->first;
+}
+
+exponent SPairs::weightDegree(const exponent w) const {
+  return lowWeightFirst() ? w : -w;
+}
+
+SPairs::Buckets::iterator SPairs::firstBucket() {
+  MATHICGB_ASSERT(!mBuckets.empty());
+  if (lowWeightFirst())
+    return mBuckets.begin();
+  else
+    return std::prev(mBuckets.end());
+}
+
+bool SPairs::lowWeightFirst() const {
+  // See the comment on MonoMonoid::isLexBaseOrder. A lower sugar always
+  // comes first.
+  return mUseSugar || orderMonoid().isLexBaseOrder();
+}
+
+const SPairs::Column& SPairs::topColumn() {
+  auto& bucket = firstBucket()->second;
+  MATHICGB_ASSERT(!bucket.columns.empty());
+  if (!bucket.isHeap) {
+    std::make_heap(
+      bucket.columns.begin(),
+      bucket.columns.end(),
+      [&](const Column& a, const Column& b) {return laterColumn(a, b);}
+    );
+    bucket.isHeap = true;
+  }
+  return bucket.columns.front();
+}
+
+void SPairs::popQueue() {
+  topColumn();
+  const auto bucketIt = firstBucket();
+  auto& columns = bucketIt->second.columns;
+  std::pop_heap(
+    columns.begin(),
+    columns.end(),
+    [&](const Column& a, const Column& b) {return laterColumn(a, b);}
+  );
+  Column column(std::move(columns.back()));
+  columns.pop_back();
+  if (columns.empty())
+    mBuckets.erase(bucketIt);
+
+  MATHICGB_ASSERT(column.head < column.rows.size());
+  ++column.head;
+  --mPairCount;
+  pushColumn(std::move(column));
+}
+
+void SPairs::pushColumn(Column&& column) {
+  auto& rows = column.rows;
+  if (mBasis.retired(column.col)) {
+    // None of the remaining pairs in the column are of any use.
+    mPairCount -= rows.size() - column.head;
+    return;
+  }
+  while (column.head < rows.size() && mBasis.retired(rows[column.head])) {
+    ++column.head;
+    --mPairCount;
+  }
+  if (column.head == rows.size())
+    return;
+
+  // Compacting small columns is not worth the reallocation.
+  const size_t minCompactCount = 16;
+  if (column.head >= minCompactCount && 2 * column.head >= rows.size())
+    compact(column);
+
+  orderMonoid().lcm(
+    monoid(), mBasis.leadMonomial(column.col),
+    monoid(), mBasis.leadMonomial(rows[column.head]),
+    mLcmA
+  );
+  column.degree = pairDegree(column.col, rows[column.head], mLcmA);
+
+  auto& bucket = mBuckets[column.degree];
+  bucket.columns.push_back(std::move(column));
+  if (bucket.isHeap) {
+    std::push_heap(
+      bucket.columns.begin(),
+      bucket.columns.end(),
+      [&](const Column& a, const Column& b) {return laterColumn(a, b);}
+    );
+  }
+}
+
+void SPairs::compact(Column& column) {
+  auto& rows = column.rows;
+  const auto pendingBegin = rows.begin() + column.head;
+  const auto pendingEnd = std::remove_if(
+    pendingBegin,
+    rows.end(),
+    [&](const Index row) {return mBasis.retired(row);}
+  );
+  mPairCount -= rows.end() - pendingEnd;
+  rows.erase(pendingEnd, rows.end());
+  rows.erase(rows.begin(), pendingBegin);
+  rows.shrink_to_fit();
+  column.head = 0;
+}
+
+void SPairs::removeRetiredColumns() {
+  for (auto it = mBuckets.begin(); it != mBuckets.end();) {
+    auto& columns = it->second.columns;
+    const auto newEnd = std::remove_if(
+      columns.begin(),
+      columns.end(),
+      [&](const Column& column) {return mBasis.retired(column.col);}
+    );
+    if (newEnd != columns.end()) {
+      for (auto column = newEnd; column != columns.end(); ++column)
+        mPairCount -= column->rows.size() - column->head;
+      columns.erase(newEnd, columns.end());
+      it->second.isHeap = false;
+    }
+    if (columns.empty())
+      it = mBuckets.erase(it);
+    else
+      ++it;
+  }
+}
+
+bool SPairs::laterPair(
+  size_t colA, size_t rowA, OrderMonoid::ConstMonoRef a,
+  size_t colB, size_t rowB, OrderMonoid::ConstMonoRef b
+) const {
+  const auto cmp = orderMonoid().compare(a, b);
+  if (cmp == GT)
+    return true;
+  if (cmp == LT)
+    return false;
+
+  const bool aRetired = mBasis.retired(rowA) || mBasis.retired(colA);
+  const bool bRetired = mBasis.retired(rowB) || mBasis.retired(colB);
+  if (aRetired || bRetired)
+    return !bRetired;
+
+  if (mPreferSparseSPairs) {
+    const auto termCountA =
+      mBasis.basisElement(colA).termCount() +
+      mBasis.basisElement(rowA).termCount();
+    const auto termCountB =
+      mBasis.basisElement(colB).termCount() +
+      mBasis.basisElement(rowB).termCount();
+    if (termCountA > termCountB)
+      return true;
+    if (termCountA < termCountB)
+      return false;
+  }
+  return colA + rowA > colB + rowB;
+}
+
+bool SPairs::laterColumn(const Column& a, const Column& b) const {
+  MATHICGB_ASSERT(a.head < a.rows.size());
+  MATHICGB_ASSERT(b.head < b.rows.size());
+  MATHICGB_ASSERT(a.degree == b.degree);
+
+  const size_t rowA = a.rows[a.head];
+  const size_t rowB = b.rows[b.head];
+  const bool aRetired = mBasis.retired(rowA) || mBasis.retired(a.col);
+  const bool bRetired = mBasis.retired(rowB) || mBasis.retired(b.col);
+  if (aRetired || bRetired)
+    return !bRetired;
+
+  orderMonoid().lcm(
+    monoid(), mBasis.leadMonomial(a.col),
+    monoid(), mBasis.leadMonomial(rowA),
+    mLcmA
+  );
+  orderMonoid().lcm(
+    monoid(), mBasis.leadMonomial(b.col),
+    monoid(), mBasis.leadMonomial(rowB),
+    mLcmB
+  );
+  MATHICGB_ASSERT(a.degree == pairDegree(a.col, rowA, mLcmA));
+  MATHICGB_ASSERT(b.degree == pairDegree(b.col, rowB, mLcmB));
+  return laterPair(a.col, rowA, mLcmA, b.col, rowB, mLcmB);
+}
+
+SPairs::Exponent SPairs::pairDegree(
+  const size_t col,
+  const size_t row,
+  OrderMonoid::ConstMonoRef lcm
+) const {
+  if (!mUseSugar)
+    return lcmDegree(lcm);
+  MATHICGB_ASSERT(mBasis.usesSugar());
+
+  // The sugar of the S-polynomial of col and row.
+  const auto colDegree = monoid().totalDegree(mBasis.leadMonomial(col));
+  const auto rowDegree = monoid().totalDegree(mBasis.leadMonomial(row));
+  return orderMonoid().totalDegree(lcm) + std::max(
+    mBasis.sugar(col) - colDegree,
+    mBasis.sugar(row) - rowDegree
+  );
+}
+
+SPairs::Exponent SPairs::lcmDegree(OrderMonoid::ConstMonoRef lcm) const {
+  if (orderMonoid().gradingCount() == 0)
+    return 0;
+  return orderMonoid().degree(lcm);
+}
+
 namespace {
   // Records multiples of a basis element.
   // Used in addPairs().
@@ -144,71 +433,26 @@ void SPairs::addPairsAssumeAutoReduce(
   size_t newGen,
   std::vector<size_t>& toRetireAndReduce
 ) {
-  {
-    MATHICGB_LOG_TIME(SPairEarly);
-
-    MATHICGB_ASSERT(mQueue.columnCount() == newGen);
-    MATHICGB_ASSERT(newGen < mBasis.size());
-    MATHICGB_ASSERT(!mBasis.retired(newGen));
-
-    while (mEliminated.columnCount() < mBasis.size()) {
-      if (mUseBuchbergerLcmHitCache) {
-        MATHICGB_ASSERT(mEliminated.columnCount() == mBuchbergerLcmHitCache.size());
-        mBuchbergerLcmHitCache.push_back(0);
-      }
-      mEliminated.addColumn();
-    }
-
-    RecordIndexes indexes(newGen, mEliminated, toRetireAndReduce);
-    mBasis.divisorLookup().multiples(mBasis.leadMonomial(newGen), indexes);
-  }
+  findMultiplesToRetire(newGen, toRetireAndReduce);
   addPairs(newGen);
 }
 
-namespace {
-  template<class PairIterator>
-  class SecondIterator {
-  public:
-	typedef typename PairIterator::iterator_category iterator_category;
-    typedef decltype(reinterpret_cast<typename PairIterator::value_type*>(0)->second) value_type;
-	typedef typename PairIterator::difference_type difference_type;
-	typedef value_type* pointer;
-	typedef value_type& reference;
-
-	SecondIterator(PairIterator pairIterator): mIterator(pairIterator) {}
-	SecondIterator& operator++() {++mIterator; return *this;}
-    const value_type operator*() const {return mIterator->second;}
-	difference_type operator-(const SecondIterator<PairIterator>& it) const {
-	  return mIterator - it.mIterator;
-	}
-	bool operator==(const SecondIterator<PairIterator>& it) const {
-	  return mIterator == it.mIterator;
-	}
-	bool operator!=(const SecondIterator<PairIterator>& it) const {
-	  return mIterator != it.mIterator;
-	}
-
-  private:
-	PairIterator mIterator;
-  };
-  template<class Iter>
-  SecondIterator<Iter> makeSecondIterator(Iter it) {
-    return SecondIterator<Iter>(it);
-  }
-}
-
-void SPairs::addPairs(size_t newGen) {
+void SPairs::findMultiplesToRetire(
+  size_t newGen,
+  std::vector<size_t>& toRetireAndReduce
+) {
   MATHICGB_LOG_TIME(SPairEarly);
 
-  // Must call addPairs with newGen parameter in the sequence 0, 1, ...
-  // newGen could be implicitly picked up from mQueue.columnCount(), but
-  // doing it this way ensures that what happens is what the client thinks
-  // is happening and offers an ASSERT to inform mistaken client code.
-  MATHICGB_ASSERT(mQueue.columnCount() == newGen);
-
+  MATHICGB_ASSERT(mColumnCount <= newGen);
   MATHICGB_ASSERT(newGen < mBasis.size());
   MATHICGB_ASSERT(!mBasis.retired(newGen));
 
+  addEliminatedColumns();
+  RecordIndexes indexes(newGen, mEliminated, toRetireAndReduce);
+  mBasis.divisorLookup().multiples(mBasis.leadMonomial(newGen), indexes);
+}
+
+void SPairs::addEliminatedColumns() {
   while (mEliminated.columnCount() < mBasis.size()) {
     if (mUseBuchbergerLcmHitCache) {
       MATHICGB_ASSERT(mEliminated.columnCount() == mBuchbergerLcmHitCache.size());
@@ -216,52 +460,202 @@ void SPairs::addPairs(size_t newGen) {
     }
     mEliminated.addColumn();
   }
+}
+
+void SPairs::addPairs(size_t newGen) {
+  MATHICGB_ASSERT(newGen < mBasis.size());
+  MATHICGB_ASSERT(!mBasis.retired(newGen));
+  addPairs(newGen, newGen + 1);
+}
+
+void SPairs::addReducedPairs(
+  const size_t newGenBegin,
+  const size_t newGenEnd
+) {
+  MATHICGB_ASSERT(mColumnCount == newGenBegin);
+  MATHICGB_ASSERT(newGenBegin <= newGenEnd);
+  MATHICGB_ASSERT(newGenEnd <= mBasis.size());
 
+  if (newGenEnd > std::numeric_limits<Index>::max())
+    throw std::overflow_error
+      ("Too large basis element index in constructing S-pairs.");
+
+  addEliminatedColumns();
+  for (size_t newGen = newGenBegin; newGen != newGenEnd; ++newGen) {
+    for (size_t oldGen = 0; oldGen < newGen; ++oldGen)
+      mEliminated.setBit(newGen, oldGen, true);
+    ++mColumnCount;
+  }
+}
+
+void SPairs::addPairs(const size_t newGenBegin, const size_t newGenEnd) {
+  MATHICGB_LOG_TIME(SPairEarly);
+
+  // Must call addPairs with newGen parameter in the sequence 0, 1, ...
+  // newGen could be implicitly picked up from mColumnCount, but
+  // doing it this way ensures that what happens is what the client thinks
+  // is happening and offers an ASSERT to inform mistaken client code.
+  MATHICGB_ASSERT(mColumnCount == newGenBegin);
+  MATHICGB_ASSERT(newGenBegin <= newGenEnd);
+  MATHICGB_ASSERT(newGenEnd <= mBasis.size());
 
-  if (newGen == std::numeric_limits<Queue::Index>::max())
+  if (newGenEnd > std::numeric_limits<Index>::max())
     throw std::overflow_error
       ("Too large basis element index in constructing S-pairs.");
 
+  addEliminatedColumns();
+  removeRetiredColumns();
+
   OrderMonoid::MonoVector prePairMonos(orderMonoid());
-  typedef std::pair<OrderMonoid::ConstMonoPtr, Queue::Index> PrePair;
   std::vector<PrePair> prePairs;
-  prePairMonos.reserve(newGen);
-  prePairs.reserve(newGen);
-
-  ConstMonoRef newLead = mBasis.leadMonomial(newGen);
   auto lcm = mBareMonoid.alloc();
-  for (size_t oldGen = 0; oldGen < newGen; ++oldGen) {
-    if (mBasis.retired(oldGen))
-      continue;
-    ConstMonoRef oldLead = mBasis.leadMonomial(oldGen);
-    if (monoid().relativelyPrime(newLead, oldLead)) {
-      ++mStats.relativelyPrimeHits;
-      mEliminated.setBit(newGen, oldGen, true);
-      continue;
+  for (size_t newGen = newGenBegin; newGen != newGenEnd; ++newGen) {
+    prePairMonos.clear();
+    prePairs.clear();
+
+    // A basis element that was retired earlier in the same batch gets an
+    // empty column.
+    if (!mBasis.retired(newGen)) {
+      // The pointers in prePairs must remain valid, so there must be no
+      // reallocation.
+      prePairMonos.reserve(newGen);
+      prePairs.reserve(newGen);
+
+      ConstMonoRef newLead = mBasis.leadMonomial(newGen);
+      for (size_t oldGen = 0; oldGen < newGen; ++oldGen) {
+        if (mBasis.retired(oldGen))
+          continue;
+        ConstMonoRef oldLead = mBasis.leadMonomial(oldGen);
+        if (monoid().relativelyPrime(newLead, oldLead)) {
+          ++mStats.relativelyPrimeHits;
+          mEliminated.setBit(newGen, oldGen, true);
+          continue;
+        }
+        mBareMonoid.lcm(monoid(), newLead, monoid(), oldLead, lcm);
+        if (simpleBuchbergerLcmCriterion(newGen, oldGen, lcm)) {
+          mEliminated.setBit(newGen, oldGen, true);
+          continue;
+        }
+
+        prePairMonos.push_back(bareMonoid(), lcm);
+        prePairs.emplace_back
+          (prePairMonos.back().ptr(), static_cast<Index>(oldGen));
+      }
+
+      std::sort(prePairs.begin(), prePairs.end(),
+        [&](const PrePair& a, const PrePair& b)
+      {
+        return laterPair
+          (newGen, b.second, *b.first, newGen, a.second, *a.first);
+      });
+      eliminateSameLcmPairs(newGen, prePairs);
     }
-    mBareMonoid.lcm(monoid(), newLead, monoid(), oldLead, lcm);
-    if (simpleBuchbergerLcmCriterion(newGen, oldGen, lcm)) {
-      mEliminated.setBit(newGen, oldGen, true);
+    ++mColumnCount;
+    if (prePairs.empty())
       continue;
-    }
 
-    prePairMonos.push_back(bareMonoid(), lcm);
-    prePairs.emplace_back
-      (prePairMonos.back().ptr(), static_cast<Queue::Index>(oldGen));
+    Column column(static_cast<Index>(newGen));
+    column.rows.reserve(prePairs.size());
+    if (mUseSugar) {
+      // The sugar comes first in the order. prePairs is already in order
+      // apart from that, so a stable sort by sugar finishes the job.
+      std::vector<std::pair<Exponent, Index>> sugarPairs;
+      sugarPairs.reserve(prePairs.size());
+      for (const auto& prePair : prePairs) {
+        const auto sugar = pairDegree(newGen, prePair.second, *prePair.first);
+        sugarPairs.emplace_back(sugar, prePair.second);
+      }
+      std::stable_sort(sugarPairs.begin(), sugarPairs.end(),
+        [](
+          const std::pair<Exponent, Index>& a,
+          const std::pair<Exponent, Index>& b
+        ) {return a.first < b.first;}
+      );
+      for (const auto& sugarPair : sugarPairs)
+        column.rows.push_back(sugarPair.second);
+    } else {
+      for (const auto& prePair : prePairs)
+        column.rows.push_back(prePair.second);
+    }
+    mPairCount += prePairs.size();
+    pushColumn(std::move(column));
   }
+}
 
-  std::sort(prePairs.begin(), prePairs.end(),
-    [&](const PrePair& a, const PrePair& b)
-  {
-    return mQueue.configuration().compare
-      (b.second, newGen, *b.first, a.second, newGen, *a.first);
-  });
-  mQueue.addColumnDescending
-	(makeSecondIterator(prePairs.begin()), makeSecondIterator(prePairs.end()));
+void SPairs::eliminateSameLcmPairs(
+  const size_t newGen,
+  std::vector<PrePair>& prePairs
+) {
+  MATHICGB_ASSERT(newGen < mBasis.size());
+  MATHICGB_ASSERT(mEliminated.columnCount() == mBasis.size());
+
+  // The root of a component is always its first element, so that we
+  // keep the pair that is popped first.
+  auto& components = mSameLcmComponents;
+  const auto root = [&](size_t i) {
+    while (components[i] != i)
+      i = components[i] = components[components[i]];
+    return i;
+  };
+
+  auto kept = prePairs.begin();
+  const auto end = prePairs.end();
+  for (auto runBegin = prePairs.begin(); runBegin != end;) {
+    OrderMonoid::ConstMonoRef lcm = *runBegin->first;
+    auto runEnd = runBegin;
+    for (++runEnd; runEnd != end; ++runEnd)
+      if (!orderMonoid().equal(lcm, *runEnd->first))
+        break;
+    const auto runSize = static_cast<size_t>(runEnd - runBegin);
+
+    components.resize(runSize);
+    for (size_t i = 0; i < runSize; ++i)
+      components[i] = i;
+    for (size_t i = 1; i < runSize; ++i) {
+      const size_t a = runBegin[i].second;
+      ConstMonoRef leadA = mBasis.leadMonomial(a);
+      for (size_t j = 0; j < i; ++j) {
+        const auto rootI = root(i);
+        const auto rootJ = root(j);
+        if (rootI == rootJ)
+          continue;
+        const size_t b = runBegin[j].second;
+        // lcm(a, b) != lcm if and only if lcm does not divide lcm(a, b).
+        if (
+          !eliminated(a, b) &&
+          monoid().dividesLcm
+            (orderMonoid(), lcm, monoid(), leadA, mBasis.leadMonomial(b))
+        )
+          continue; // no edge
+        if (rootI < rootJ)
+          components[rootJ] = rootI;
+        else
+          components[rootI] = rootJ;
+      }
+    }
+
+    for (size_t i = 0; i < runSize; ++i) {
+      if (root(i) == i)
+        *kept++ = runBegin[i];
+      else
+        ++mStats.sameLcmHits;
+    }
+    runBegin = runEnd;
+  }
+  prePairs.erase(kept, end);
 }
 
 size_t SPairs::getMemoryUse() const {
-  return mQueue.getMemoryUse();
+  size_t sum =
+    mEliminated.getMemoryUse() +
+    mBuchbergerLcmHitCache.capacity() * sizeof(mBuchbergerLcmHitCache.front());
+  for (const auto& bucket : mBuckets) {
+    const auto& columns = bucket.second.columns;
+    sum += sizeof(bucket) + columns.capacity() * sizeof(columns.front());
+    for (const auto& column : columns)
+      sum += column.rows.capacity() * sizeof(column.rows.front());
+  }
+  return sum;
 }
 
 bool SPairs::simpleBuchbergerLcmCriterion(
@@ -659,31 +1053,13 @@ bool SPairs::advancedBuchbergerLcmCriterionSlow(size_t a, size_t b) const {
 }
 
 SPairs::Stats SPairs::stats() const {
-  size_t const columnCount = mQueue.columnCount();
+  size_t const columnCount = mColumnCount;
   mStats.sPairsConsidered = columnCount * (columnCount - 1) / 2;
   return mStats;
 }
 
 std::string SPairs::name() const {
-  return mQueue.name();
-}
-
-void SPairs::QueueConfiguration::computePairData(
-  size_t a,
-  size_t b,
-  OrderMonoid::MonoRef orderBy
-) const {
-  MATHICGB_ASSERT(a != b);
-  MATHICGB_ASSERT(a < mBasis.size());
-  MATHICGB_ASSERT(b < mBasis.size());
-  if (mBasis.retired(a) || mBasis.retired(b)) {
-    // todo: do something special here?
-    return; //return false;
-  }
-  Monoid::ConstMonoRef leadA = mBasis.leadMonomial(a);
-  Monoid::ConstMonoRef leadB = mBasis.leadMonomial(b);
-  orderMonoid().lcm(monoid(), leadA, monoid(), leadB, orderBy);
-  return; //todo: return true;
+  return "compact column heap";
 }
 
 MATHICGB_NAMESPACE_END
@@ -7,6 +7,7 @@
 #include <utility>
 #include <mathic.h>
 #include <memory>
+#include <map>
 
 MATHICGB_NAMESPACE_BEGIN
 
@@ -38,13 +39,28 @@ public:
   typedef MonoMonoid<Exponent, true, false, true> OrderMonoid;
   //typedef Monoid OrderMonoid;
 
-  SPairs(const PolyBasis& basis, bool preferSparseSPairs);
+  // If useSugar is true then S-pairs are ordered first by their sugar and
+  // then by their lcm. Otherwise they are ordered by their lcm. The sugar
+  // of an S-pair is the sugar of its S-polynomial computed from the sugar
+  // of the basis elements in basis. Using sugar reduces the amount of
+  // intermediate expression swell for non-homogeneous input.
+  SPairs(const PolyBasis& basis, bool preferSparseSPairs, bool useSugar);
+
+  // Returns true if S-pairs are ordered according to their sugar.
+  bool useSugar() const {return mUseSugar;}
+
+  // Returns true if S-pairs have a degree, which is the case if using
+  // sugar or if the monomial order has a grading. Otherwise all S-pairs
+  // have degree zero, so popDegree() pops all of them at once.
+  bool hasDegrees() const {
+    return mUseSugar || mOrderMonoid.gradingCount() > 0;
+  }
 
   // Returns the number of S-pairs in the data structure.
-  size_t pairCount() const {return mQueue.pairCount();}
+  size_t pairCount() const {return mPairCount;}
 
   // Returns true if no pending S-pairs remain.
-  bool empty() const {return mQueue.empty();}
+  bool empty() const {return mBuckets.empty();}
 
   // Removes the minimal S-pair from the data structure and returns it.
   // The S-polynomial of that pair is assumed to reduce to zero, either
@@ -60,9 +76,38 @@ public:
 
   // As pop(), but only pops S-pairs whose lcm have the passed-in
   // weight. If deg is already 0, then instead set deg to the weight
-  // of the returned S-pair, if any.
+  // of the returned S-pair, if any. When using sugar, the weight is the
+  // sugar of the S-pair.
   std::pair<size_t, size_t> pop(exponent& w);
 
+  // Pops all the S-pairs whose lcm has the same degree as the lcm of the
+  // minimal S-pair and places those that are not found to be useless in
+  // pairs. Returns that degree. If all of those S-pairs turn out to be
+  // useless, the next degree is tried and so on. pairs is left empty only
+  // if there are no S-pairs left to return. This does the same thing as
+  // calling pop(w) until it returns (invalid,invalid), but it does not do
+  // any heap operations and the pairs are not ordered within the degree.
+  // When using sugar, this pops the S-pairs of minimal sugar instead.
+  exponent popDegree(std::vector<std::pair<size_t, size_t>>& pairs);
+
+  // As popDegree(), but only pops the S-pairs of the first degree, so
+  // pairs is left empty if all of those S-pairs turn out to be useless.
+  // Must not be empty().
+  exponent popFirstDegree(std::vector<std::pair<size_t, size_t>>& pairs);
+
+  // Returns the weight, as for pop(w), of the S-pairs that will be popped
+  // next. Some or all of those S-pairs may turn out to be useless. Must
+  // not be empty().
+  exponent nextWeight() const;
+
+  // Returns the degree of the S-pairs of weight w. That is the sugar if
+  // using sugar and otherwise the degree of the lcm for the most
+  // significant grading of the monomial order. Those are the same as the
+  // weight except that the weight of the lcm is the negative of the degree
+  // for orders that are not lex base orders. S-pairs are popped in
+  // ascending order of degree.
+  exponent weightDegree(exponent w) const;
+
   // Add the pairs (index,a) to the data structure for those a such that
   // a < index. Some of those pairs may be eliminated if they can be proven
   // to be useless. index must be a valid index of a basis element
@@ -71,12 +116,36 @@ public:
   // at zero for the first call.
   void addPairs(size_t index);
 
+  // As addPairs(index), but adds the pairs for all of the basis elements
+  // with index in [newGenBegin, newGenEnd) in one go. This is meant for
+  // adding a whole round of new basis elements at once, such as all the
+  // elements that come out of one F4 matrix. All of those elements must
+  // already be in the basis, so the criteria used to eliminate useless
+  // S-pairs get to see the entire round instead of only the elements
+  // that came before. Elements in the range that have been retired are
+  // allowed and get no pairs. newGenBegin must be the number of
+  // basis elements that pairs have already been added for.
+  void addPairs(size_t newGenBegin, size_t newGenEnd);
+
+  // As addPairs(newGenBegin, newGenEnd), but for basis elements that
+  // together with the elements before them already form a Groebner basis,
+  // so that all of their S-pairs reduce to zero. No S-pairs are added for
+  // them. Instead the pairs are recorded as done so that the criteria used
+  // to eliminate later S-pairs can take them into account.
+  void addReducedPairs(size_t newGenBegin, size_t newGenEnd);
+
   // As addPairs, but assuming auto-reduction of the basis will happen.
   // This method assumes that if lead(index) divides lead(x) for a basis
   // element x, then x will be retired from the basis and reduced. toReduce
   // will contain those indices x.
   void addPairsAssumeAutoReduce(size_t index, std::vector<size_t>& toRetireAndReduce);
 
+  // Does the part of addPairsAssumeAutoReduce that determines which
+  // basis elements to retire, but does not add any S-pairs. The pairs
+  // for index must be added later using addPairs(newGenBegin, newGenEnd).
+  void findMultiplesToRetire
+    (size_t index, std::vector<size_t>& toRetireAndReduce);
+
   // Returns true if the S-pair (a,b) is known to be useless. Even if the
   // S-pair is not useless now, it will become so later. At the latest, an
   // S-pair becomes useless when its S-polynomial has been reduced to zero.
@@ -96,6 +165,7 @@ public:
       buchbergerLcmSimpleHits(0),
       buchbergerLcmAdvancedHits(0),
       buchbergerLcmCacheHits(0),
+      sameLcmHits(0),
       late(false),
       buchbergerLcmSimpleHitsLate(0),
       buchbergerLcmCacheHitsLate(0)
@@ -106,6 +176,7 @@ public:
     unsigned long long buchbergerLcmSimpleHits;
     unsigned long long buchbergerLcmAdvancedHits;
     unsigned long long buchbergerLcmCacheHits;
+    unsigned long long sameLcmHits; // see eliminateSameLcmPairs()
     bool late;  // if set to true then simpleBuchbergerLcmCriterion sets the following 2 instead:
     unsigned long long buchbergerLcmSimpleHitsLate;
     unsigned long long buchbergerLcmCacheHitsLate;
@@ -163,72 +234,130 @@ private:
   const Monoid& mMonoid;
   OrderMonoid mOrderMonoid;
   BareMonoid mBareMonoid;
+  const bool mPreferSparseSPairs;
+  const bool mUseSugar;
 
-  class QueueConfiguration {
-  public:
-    QueueConfiguration(
-      const PolyBasis& basis,
-      const OrderMonoid& orderMonoid,
-      const bool preferSparseSPairs
-    ):
-      mBasis(basis),
-      mMonoid(basis.ring().monoid()),
-      mOrderMonoid(orderMonoid),
-      mPreferSparseSPairs(preferSparseSPairs) {}
-
-    typedef OrderMonoid::Mono PairData;
-    void computePairData
-    (size_t col, size_t row, OrderMonoid::MonoRef m) const;
-
-    typedef bool CompareResult;
-    bool compare(
-      size_t colA, size_t rowA, OrderMonoid::ConstMonoRef a,
-      size_t colB, size_t rowB, OrderMonoid::ConstMonoRef b
-      ) const {
-      const auto cmp = orderMonoid().compare(a, b);
-      if (cmp == GT)
-        return true;
-      if (cmp == LT)
-        return false;
-      
-      const bool aRetired = mBasis.retired(rowA) || mBasis.retired(colA);
-      const bool bRetired = mBasis.retired(rowB) || mBasis.retired(colB);
-      if (aRetired || bRetired)
-        return !bRetired;
-      
-      if (mPreferSparseSPairs) {
-        const auto termCountA =
-          mBasis.basisElement(colA).termCount() +
-          mBasis.basisElement(rowA).termCount();
-        const auto termCountB =
-          mBasis.basisElement(colB).termCount() +
-          mBasis.basisElement(rowB).termCount();
-        if (termCountA > termCountB)
-          return true;
-        if (termCountA < termCountB)
-          return false;
-      }
-      return colA + rowA > colB + rowB;
-    }
-    bool cmpLessThan(bool v) const {return v;}
-
-    // The following methods are not required of a configuration.
-	OrderMonoid::Mono allocPairData() {return orderMonoid().alloc();}
-	void freePairData(OrderMonoid::Mono&& mono) {
-      return orderMonoid().free(std::move(mono));
-    }
-
-  private:
-    const Monoid& monoid() const {return mMonoid;}
-    const OrderMonoid& orderMonoid() const {return mOrderMonoid;}
-
-	const PolyBasis& mBasis;
-    const Monoid& mMonoid;
-    const OrderMonoid& mOrderMonoid;
-    const bool mPreferSparseSPairs;
+  typedef uint32 Index;
+
+  // The pending S-pairs (col, row) with the same col are stored together
+  // in a Column. The rows of a Column are sorted in the order that the
+  // pairs are to be popped in. The Columns are kept in buckets according
+  // to the pairDegree() of their first pending pair.
+  //
+  // The point of this representation is to use little memory for large
+  // bases. A pair takes up a single Index and lcms are not stored. Only
+  // the pairDegree() of the first pending pair of a Column is kept inline.
+  // That is enough to find the right bucket without looking at the lcm,
+  // which is recomputed from the lead monomials when it is needed.
+  struct Column {
+    Column(Index col): col(col), head(0), degree(0) {}
+
+    std::vector<Index> rows; // rows[head], rows[head + 1], ... are pending
+    Index col;
+    Index head;
+    Exponent degree; // see pairDegree()
   };
-  typedef mathic::PairQueue<QueueConfiguration> Queue;
-  Queue mQueue;
+
+  // Returns true if the pair (colA, rowA) with lcm lcmA should be popped
+  // after the pair (colB, rowB) with lcm lcmB.
+  bool laterPair(
+    size_t colA, size_t rowA, OrderMonoid::ConstMonoRef lcmA,
+    size_t colB, size_t rowB, OrderMonoid::ConstMonoRef lcmB
+  ) const;
+
+  // Returns true if the first pending pair of a should be popped after
+  // that of b. a and b must have the same degree. Used as the comparison
+  // for the heap in a Bucket.
+  bool laterColumn(const Column& a, const Column& b) const;
+
+  // Returns the degree of lcm for the most significant grading of the
+  // monomial order, or zero if there are no gradings. Two pairs whose lcms
+  // have different lcmDegree are ordered by lcmDegree alone.
+  Exponent lcmDegree(OrderMonoid::ConstMonoRef lcm) const;
+
+  // Returns the sugar of the pair (col, row) if using sugar and otherwise
+  // lcmDegree(lcm). lcm must be the lcm of the pair. Two pairs with
+  // different pairDegree are ordered by pairDegree alone.
+  Exponent pairDegree
+    (size_t col, size_t row, OrderMonoid::ConstMonoRef lcm) const;
+
+  // The Columns whose first pending pair has a given pairDegree(). The
+  // Columns are only ordered into a heap once a pair is popped from the
+  // bucket by pop(), since popDegree() has no use for that order.
+  struct Bucket {
+    Bucket(): isHeap(false) {}
+
+    std::vector<Column> columns;
+    bool isHeap; // columns is a heap according to laterColumn()
+  };
+  typedef std::map<Exponent, Bucket> Buckets;
+
+  // Returns the bucket of the pairs that are to be popped first.
+  Buckets::iterator firstBucket();
+
+  // Returns true if the bucket with the lowest pairDegree() is popped first.
+  bool lowWeightFirst() const;
+
+  // Returns the Column with the first pair to be popped.
+  const Column& topColumn();
+
+  // Removes the first pair of topColumn().
+  void popQueue();
+
+  // Places column in the bucket for the pairDegree() of its first pending
+  // pair. Drops any first pairs whose row has been retired, or all of
+  // the Column if its col has been retired. Empty Columns are dropped.
+  void pushColumn(Column&& column);
+
+  // Removes the already popped pairs and the pairs with a retired row from
+  // column, so that it does not keep holding on to that memory.
+  void compact(Column& column);
+
+  // Removes the Columns whose col has been retired.
+  void removeRetiredColumns();
+
+  // The Columns that have pending pairs. Buckets without Columns are
+  // removed.
+  Buckets mBuckets;
+
+  // The number of basis elements that pairs have been added for.
+  size_t mColumnCount;
+
+  // The number of pairs in mBuckets that have not been popped or dropped.
+  size_t mPairCount;
+
+  // Scratch space for lcm computations.
+  mutable OrderMonoid::Mono mLcmA;
+  mutable OrderMonoid::Mono mLcmB;
+
+  // Adds columns to mEliminated until there is one for each basis element.
+  void addEliminatedColumns();
+
+  // A pair (lcm, other index) for an S-pair that has not been eliminated
+  // yet and that has not been added to mBuckets yet.
+  typedef std::pair<OrderMonoid::ConstMonoPtr, Index> PrePair;
+
+  // Implements the Gebauer-Moller criterion F for the pairs (newGen, x)
+  // for x in prePairs. prePairs must be sorted in the order that they will
+  // be placed in a Column, which places pairs with the same lcm next to each
+  // other. Let (newGen, a) and (newGen, b) be pairs with the same lcm L.
+  // Then S(newGen, b) has a representation if S(newGen, a) and S(a, b)
+  // do. So if we can show that S(a, b) has a representation, we only
+  // need to keep one of the two pairs. We know that for (a, b) if lcm(a, b)
+  // properly divides L or if (a, b) has been eliminated. Those
+  // relations define a graph on the pairs with lcm L and this method keeps
+  // just the first pair from each connected component of that graph.
+  //
+  // The pairs removed here are not marked as eliminated. We use the kept
+  // pair to justify removing them, but that pair has the same lcm as the
+  // removed pairs and has not been reduced yet. If we then marked the
+  // removed pairs as eliminated, the kept pair might itself get eliminated
+  // later on the strength of the pairs removed here. That would be circular
+  // and incorrect. See the comment on simpleBuchbergerLcmCriterion.
+  void eliminateSameLcmPairs(size_t newGen, std::vector<PrePair>& prePairs);
+
+  // Variable used only inside eliminateSameLcmPairs().
+  std::vector<size_t> mSameLcmComponents;
 
   // The bit at (i,j) is set to true if it is known that the S-pair between
   // basis element i and j does not have to be reduced. This can be due to a
@@ -249,43 +378,7 @@ private:
   // Variable used only inside advancedBuchbergerLcmCriterion().
   mutable std::vector<std::pair<size_t, Connection> >
     mAdvancedBuchbergerLcmCriterionGraph;
-
-  friend void mathic::PairQueueNamespace::constructPairData<QueueConfiguration>
-    (void*, Index, Index, QueueConfiguration&);
-  friend void mathic::PairQueueNamespace::destructPairData<QueueConfiguration>
-    (OrderMonoid::Mono*, Index, Index, QueueConfiguration&);
 };
 
 MATHICGB_NAMESPACE_END
-
-namespace mathic {
-  namespace PairQueueNamespace {
-    template<>
-    inline void constructPairData<mgb::SPairs::QueueConfiguration>(
-      void* memory,
-      const Index col,
-      const Index row,
-      mgb::SPairs::QueueConfiguration& conf
-    ) {
-      MATHICGB_ASSERT(memory != 0);
-      MATHICGB_ASSERT(col > row);
-      auto pd = new (memory)
-        mgb::SPairs::OrderMonoid::Mono(conf.allocPairData());
-      conf.computePairData(col, row, *pd);
-    }
-    
-    template<>
-    inline void destructPairData(
-      mgb::SPairs::OrderMonoid::Mono* pd,
-      const Index col,
-      const Index row,
-      mgb::SPairs::QueueConfiguration& conf
-    ) {
-      MATHICGB_ASSERT(pd != 0);
-      MATHICGB_ASSERT(col > row);
-      conf.freePairData(std::move(*pd));
-    }	
-  }
-}
-
 #endif
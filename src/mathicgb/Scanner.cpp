@@ -7,6 +7,7 @@
 #include <limits>
 #include <sstream>
 #include <cstring>
+#include <algorithm>
 
 MATHICGB_NAMESPACE_BEGIN
 
@@ -90,6 +91,40 @@ bool Scanner::match(const char* const str) {
   return true;
 }
 
+std::vector<char> Scanner::readRemaining() {
+  std::vector<char> text;
+  if (peek() == EOF)
+    return text;
+  text.push_back(static_cast<char>(peek()));
+  text.insert(text.end(), mBufferPos, mBuffer.end());
+  mBufferPos = mBuffer.end();
+
+  // Read the rest in one go instead of BufferSize at a time.
+  if (mFile != 0 || mStream != 0) {
+    auto size = text.size();
+    while (true) {
+      text.resize(size + std::max<size_t>(size, 1024 * 1024));
+      const auto readInto = text.data() + size;
+      const auto readCount = text.size() - size;
+      size_t didReadCount = 0;
+      if (mFile != 0)
+        didReadCount = fread(readInto, 1, readCount, mFile);
+      else {
+        mStream->read(readInto, readCount);
+        didReadCount = static_cast<size_t>(mStream->gcount());
+      }
+      size += didReadCount;
+      if (didReadCount < readCount)
+        break;
+    }
+    text.resize(size);
+  }
+
+  mLineCount += std::count(text.begin(), text.end(), '\n');
+  mChar = EOF;
+  return text;
+}
+
 bool Scanner::ensureBuffer(size_t min) {
   const auto got = size_t(std::distance(mBufferPos, mBuffer.end()) + 1);
   return got >= min || readBuffer(min - got);
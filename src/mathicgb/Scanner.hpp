@@ -16,6 +16,10 @@
 
 MATHICGB_NAMESPACE_BEGIN
 
+/// Reports a syntax error on line lineNumber in the same way as
+/// Scanner::reportError().
+void reportSyntaxError(std::string s, uint64 lineNumber);
+
 /// This class offers an input interface which is more convenient and
 /// often more efficient than dealing with a FILE* or std::istream
 /// directly. It keeps track of the current line number to report
@@ -105,6 +109,12 @@ public:
   template<class T>
   bool matchReadIntegerNoSign(T& t, bool negate = false);
 
+  /// Reads all of the remaining input, including any whitespace, and
+  /// returns it. There is no more input after this. This is for parsers
+  /// that work directly on the text in memory. The first character of the
+  /// returned text is on line lineCount() from before the call.
+  std::vector<char> readRemaining();
+
   /// Returns the next character or EOF. Does not skip whitespace.
   int peek() {return mChar;}
 
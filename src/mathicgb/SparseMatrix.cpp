@@ -4,6 +4,7 @@
 #include "SparseMatrix.hpp"
 
 #include "Poly.hpp"
+#include "MemoryBudget.hpp"
 #include <algorithm>
 
 MATHICGB_NAMESPACE_BEGIN
@@ -240,6 +241,8 @@ SparseMatrix::ColIndex SparseMatrix::computeColCount() const {
 void SparseMatrix::clear() {
   Block* block = &mBlock;
   while (block != 0) {
+    MemoryBudget::singleton().freed
+      (MemoryBudget::MatrixBlocks, block->memoryUse());
     delete[] block->mColIndices.releaseMemory();
     delete[] block->mScalars.releaseMemory();
     Block* const tmp = block->mPreviousBlock;
@@ -332,6 +335,10 @@ void SparseMatrix::reserveFreeEntries(const size_t freeCount) {
   MATHICGB_ASSERT(mBlock.mHasNoRows);
   MATHICGB_ASSERT(mBlock.mPreviousBlock == 0);
 
+  MemoryBudget::singleton().allocated(
+    MemoryBudget::MatrixBlocks,
+    count * (sizeof(ColIndex) + sizeof(Scalar))
+  );
   {
     const auto begin = new ColIndex[count];
     const auto capacityEnd = begin + count;
@@ -350,7 +357,12 @@ void SparseMatrix::reserveFreeEntries(const size_t freeCount) {
       (oldBlock->mColIndices.begin(), oldBlock->mColIndices.end());
     mBlock.mScalars.rawAssign
       (oldBlock->mScalars.begin(), oldBlock->mScalars.end());
-    delete oldBlock; // no reason to keep it around
+    // no reason to keep it around
+    MemoryBudget::singleton().freed
+      (MemoryBudget::MatrixBlocks, oldBlock->memoryUse());
+    delete[] oldBlock->mColIndices.releaseMemory();
+    delete[] oldBlock->mScalars.releaseMemory();
+    delete oldBlock;
   } else {
     mBlock.mColIndices.rawAssign
       (mRows.back().mIndicesEnd, oldBlock->mColIndices.end());
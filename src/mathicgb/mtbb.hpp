@@ -10,6 +10,7 @@ MATHICGB_NAMESPACE_BEGIN
 
 namespace mtbb {
   using ::tbb::task_scheduler_init;
+  using ::tbb::task_scheduler_observer;
   using ::tbb::mutex;
   using ::tbb::parallel_do_feeder;
   using ::tbb::enumerable_thread_specific;
@@ -18,6 +19,7 @@ namespace mtbb {
   using ::tbb::parallel_sort;
   using ::tbb::blocked_range;
   using ::tbb::tick_count;
+  using ::tbb::task_group;
 }
 
 MATHICGB_NAMESPACE_END
@@ -38,6 +40,16 @@ namespace mtbb {
     static const int automatic = 1;
   };
 
+  /// All tasks run on the thread that starts them, so there are no
+  /// scheduler threads to observe.
+  class task_scheduler_observer {
+  public:
+    virtual ~task_scheduler_observer() {}
+    void observe(bool = true) {}
+    virtual void on_scheduler_entry(bool) {}
+    virtual void on_scheduler_exit(bool) {}
+  };
+
   class mutex {
   public:
     mutex(): mLocked(false) {}
@@ -199,6 +211,14 @@ namespace mtbb {
     std::sort(begin, end, pred);
   }
 
+  class task_group {
+  public:
+    template<class Func>
+    void run(const Func& f) {f();}
+
+    void wait() {}
+  };
+
   class tick_count {
   private:
     // This really should be std::chrono::steady_clock, but GCC 4.5.3 doesn't
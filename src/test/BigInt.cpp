@@ -0,0 +1,82 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#include "mathicgb/stdinc.h"
+#include "mathicgb/BigInt.hpp"
+
+#include <gtest/gtest.h>
+#include <stdexcept>
+
+using namespace mgb;
+
+namespace {
+  BigInt big(const char* str) {
+    return BigInt::fromString(str);
+  }
+}
+
+TEST(BigInt, Small) {
+  const int64 values[] = {0, 1, -1, 7, -7, 4294967295ll, -4294967296ll,
+    123456789012345ll, -98765432109876ll};
+  const size_t count = sizeof(values) / sizeof(*values);
+  for (size_t i = 0; i < count; ++i) {
+    const auto a = values[i];
+    ASSERT_EQ(std::to_string(a), BigInt(a).toString());
+    for (size_t j = 0; j < count; ++j) {
+      const auto b = values[j];
+      ASSERT_EQ(BigInt(a + b), BigInt(a) + BigInt(b));
+      ASSERT_EQ(BigInt(a - b), BigInt(a) - BigInt(b));
+      ASSERT_EQ(a < b, BigInt(a) < BigInt(b));
+      ASSERT_EQ(a == b, BigInt(a) == BigInt(b));
+      if (b != 0) {
+        ASSERT_EQ(BigInt(a / b), BigInt(a) / BigInt(b));
+        ASSERT_EQ(BigInt(a % b), BigInt(a) % BigInt(b));
+      }
+    }
+  }
+}
+
+TEST(BigInt, String) {
+  ASSERT_EQ("0", big("-0").toString());
+  ASSERT_EQ("12", big("0012").toString());
+  const char* str = "-123456789012345678901234567890123456789";
+  ASSERT_EQ(str, big(str).toString());
+  ASSERT_THROW(big(""), std::invalid_argument);
+  ASSERT_THROW(big("-"), std::invalid_argument);
+  ASSERT_THROW(big("12a"), std::invalid_argument);
+}
+
+TEST(BigInt, LargeArithmetic) {
+  const auto a = big("123456789012345678901234567890");
+  const auto b = big("987654321098765432109876543210");
+  ASSERT_EQ(
+    "121932631137021795226185032733622923332237463801111263526900",
+    (a * b).toString()
+  );
+  ASSERT_EQ("1111111110111111111011111111100", (a + b).toString());
+  ASSERT_EQ("-864197532086419753208641975320", (a - b).toString());
+
+  BigInt q;
+  BigInt r;
+  BigInt::divide(b, a, q, r);
+  ASSERT_EQ("8", q.toString());
+  ASSERT_EQ("9000000000900000000090", r.toString());
+  BigInt::divide(-(a * b + BigInt(5)), a, q, r);
+  ASSERT_EQ(-b, q);
+  ASSERT_EQ(BigInt(-5), r);
+
+  ASSERT_EQ(a.mod(65521), (a % BigInt(65521)).mod(65521));
+  ASSERT_EQ(65521 - a.mod(65521), (-a).mod(65521));
+}
+
+TEST(BigInt, GcdSqrt) {
+  const auto a = big("123456789012345678901234567890");
+  const auto b = big("987654321098765432109876543210");
+  ASSERT_EQ("9000000000900000000090", BigInt::gcd(a, -b).toString());
+  ASSERT_EQ(BigInt(7), BigInt::gcd(BigInt(0), BigInt(-7)));
+
+  ASSERT_EQ(BigInt(0), BigInt::sqrt(BigInt(0)));
+  ASSERT_EQ(BigInt(3), BigInt::sqrt(BigInt(15)));
+  ASSERT_EQ(BigInt(4), BigInt::sqrt(BigInt(16)));
+  ASSERT_EQ(a, BigInt::sqrt(a * a));
+  ASSERT_EQ(a - BigInt(1), BigInt::sqrt(a * a - BigInt(1)));
+}
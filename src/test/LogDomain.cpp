@@ -0,0 +1,188 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#include "mathicgb/stdinc.h"
+#include "mathicgb/LogDomain.hpp"
+
+#include "mathicgb/LogDomainSet.hpp"
+#include <gtest/gtest.h>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+MATHICGB_DEFINE_LOG_DOMAIN_WITH_DEFAULTS(
+  LogDomainTest,
+  "Used by the LogDomain unit tests.",
+  1, 0, 1
+);
+
+using namespace mgb;
+
+TEST(LogDomain, ConcurrentIncrement) {
+  auto& log = MATHICGB_LOGGER(LogDomainTest);
+  log.reset();
+  ASSERT_FALSE(log.hasCount());
+  ASSERT_FALSE(log.hasTime());
+
+  const size_t threadCount = 8;
+  const size_t incrementCount = 100000;
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < threadCount; ++t) {
+    threads.emplace_back([&]() {
+      auto timer = log.timer();
+      for (size_t i = 0; i < incrementCount; ++i)
+        MATHICGB_LOG_INCREMENT(LogDomainTest);
+      MATHICGB_LOG_INCREMENT_BY(LogDomainTest, 2);
+    });
+  }
+  for (auto it = threads.begin(); it != threads.end(); ++it)
+    it->join();
+
+  ASSERT_TRUE(log.hasCount());
+  ASSERT_EQ(threadCount * (incrementCount + 2), log.count());
+  ASSERT_TRUE(log.hasTime());
+  ASSERT_LE(0.0, log.loggedSecondsReal());
+
+  log.setCount(5);
+  ASSERT_EQ(5, log.count());
+
+  log.setEnabled(false);
+  MATHICGB_LOG_INCREMENT_BY(LogDomainTest, 7);
+  ASSERT_EQ(5, log.count());
+
+  log.reset();
+  ASSERT_EQ(0, log.count());
+  ASSERT_FALSE(log.hasCount());
+  ASSERT_FALSE(log.hasTime());
+  ASSERT_EQ(0.0, log.loggedSecondsReal());
+}
+
+TEST(LogDomain, JsonTrace) {
+  auto& logs = LogDomainSet::singleton();
+  auto& log = MATHICGB_LOGGER(LogDomainTest);
+  log.reset();
+  ASSERT_FALSE(logs.tracing());
+  logs.recordTraceEvent("Ignored", 'i');
+
+  logs.performLogCommand("JsonTrace");
+  ASSERT_TRUE(logs.tracing());
+  {
+    auto timer = log.timer();
+    LogDomainSet::TraceArgs args;
+    args.push_back(std::make_pair("rows", 12.0));
+    args.push_back(std::make_pair("density", 0.5));
+    logs.recordTraceEvent("Stats", 'i', std::move(args));
+  }
+  logs.performLogCommand("-JsonTrace");
+  ASSERT_FALSE(logs.tracing());
+
+  std::ostringstream out;
+  logs.writeJsonTrace(out);
+  std::istringstream in(out.str());
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(in, line);)
+    lines.push_back(line);
+
+  // Other tests may have recorded events before, so look at the end.
+  ASSERT_LE(3u, lines.size());
+  const auto last = lines.size() - 1;
+  ASSERT_EQ(0, lines[last - 2].find
+    ("{\"name\":\"LogDomainTest\",\"ph\":\"B\""));
+  ASSERT_EQ(0, lines[last - 1].find("{\"name\":\"Stats\",\"ph\":\"i\""));
+  ASSERT_NE(std::string::npos,
+    lines[last - 1].find("\"args\":{\"rows\":12,\"density\":0.5}"));
+  ASSERT_EQ(0, lines[last].find
+    ("{\"name\":\"LogDomainTest\",\"ph\":\"E\""));
+  for (size_t i = 0; i < lines.size(); ++i)
+    ASSERT_EQ(std::string::npos, lines[i].find("Ignored"));
+
+  std::ostringstream chrome;
+  logs.writeChromeTrace(chrome);
+  ASSERT_EQ(0, chrome.str().find("{\"traceEvents\":["));
+  ASSERT_NE(std::string::npos, chrome.str().find("\"displayTimeUnit\""));
+}
+
+TEST(LogDomain, JsonTraceNonFinite) {
+  // JSON cannot represent NaN and infinity, so they are written as null.
+  typedef std::numeric_limits<double> Limits;
+  auto& logs = LogDomainSet::singleton();
+  logs.performLogCommand("JsonTrace");
+  {
+    LogDomainSet::TraceArgs args;
+    args.push_back(std::make_pair("nan", Limits::quiet_NaN()));
+    args.push_back(std::make_pair("inf", Limits::infinity()));
+    args.push_back(std::make_pair("minusInf", -Limits::infinity()));
+    args.push_back(std::make_pair("ratio", 0.25));
+    logs.recordTraceEvent("NonFinite", 'i', std::move(args));
+  }
+  logs.performLogCommand("-JsonTrace");
+
+  std::ostringstream out;
+  logs.writeJsonTrace(out);
+  const auto str = out.str();
+  const auto begin = str.rfind("{\"name\":\"NonFinite\"");
+  ASSERT_NE(std::string::npos, begin);
+  const auto line = str.substr(begin, str.find('\n', begin) - begin);
+  ASSERT_NE(std::string::npos, line.find("\"args\":{\"nan\":null,"
+    "\"inf\":null,\"minusInf\":null,\"ratio\":0.25}}"));
+}
+
+TEST(LogDomain, PerfCounters) {
+  auto& logs = LogDomainSet::singleton();
+  auto& log = MATHICGB_LOGGER(LogDomainTest);
+  log.reset();
+  ASSERT_FALSE(logs.perfCounting());
+
+  logs.performLogCommand("PerfCounters");
+  ASSERT_TRUE(logs.perfCounting());
+  bool available;
+  volatile unsigned long long sum = 0;
+  {
+    auto timer = log.timer();
+    available = PerfCounters().available();
+    for (unsigned long long i = 0; i < 100000; ++i)
+      sum += i;
+  }
+  logs.performLogCommand("-PerfCounters");
+  ASSERT_FALSE(logs.perfCounting());
+
+  // Without perf events the counters are not recorded but the time still
+  // is.
+  ASSERT_TRUE(log.hasTime());
+  ASSERT_EQ(available, log.hasPerfCounts());
+  if (available) {
+    ASSERT_LT(100000u, log.perfCount(PerfCounters::Instructions));
+    ASSERT_LT(0u, log.perfCount(PerfCounters::Cycles));
+  } else {
+    for (size_t i = 0; i < PerfCounters::EventCount; ++i)
+      ASSERT_EQ(0, log.perfCount(static_cast<PerfCounters::Event>(i)));
+  }
+
+  std::ostringstream out;
+  logs.printPerfReport(out);
+  ASSERT_EQ("", out.str());
+  log.reset();
+  ASSERT_FALSE(log.hasPerfCounts());
+}
+
+TEST(LogDomain, PerfCountersSumThreads) {
+  // The work is done by another thread that exits before the counters are
+  // stopped, as for a phase that runs in parallel.
+  PerfCounters counters;
+  counters.start();
+  std::thread worker([]() {
+    PerfCounters::countThisThread();
+    volatile unsigned long long sum = 0;
+    for (unsigned long long i = 0; i < 1000000; ++i)
+      sum += i;
+  });
+  worker.join();
+
+  PerfCounters::Counter counts[PerfCounters::EventCount] = {};
+  ASSERT_EQ(counters.available(), counters.stop(counts));
+  if (counters.available())
+    ASSERT_LT(1000000u, counts[PerfCounters::Instructions]);
+  else
+    ASSERT_EQ(0u, counts[PerfCounters::Instructions]);
+}
@@ -4,6 +4,7 @@
 #include "mathicgb/MathicIO.hpp"
 
 #include <gtest/gtest.h>
+#include <cstring>
 
 using namespace mgb;
 
@@ -159,6 +160,63 @@ TEST(MathicIO, ReadWriteBasis) {
   check("2 a b", "2\n a\n b\n", false);
 }
 
+TEST(MathicIO, ReadBasisParallel) {
+  typedef PolyRing::Monoid Monoid;
+  typedef PolyRing::Field Field;
+  PolyRing ring(Field(101), Monoid(28));
+
+  auto write = [&](const Basis& basis, const bool doComponent) {
+    std::ostringstream out;
+    MathicIO<>().writeBasis(basis, doComponent, out);
+    return out.str();
+  };
+
+  // Check that readBasisParallel() reads the same as readBasis() for every
+  // block size up to the length of str.
+  auto check = [&](const char* const str, const bool doComponent) {
+    Scanner serialIn(str);
+    const auto correct =
+      write(MathicIO<>().readBasis(ring, doComponent, serialIn), doComponent);
+    const auto length = std::strlen(str);
+    for (size_t blockBytes = 1; blockBytes <= length + 1; ++blockBytes) {
+      std::istringstream stream(str);
+      Scanner in(stream);
+      const auto basis =
+        MathicIO<>().readBasisParallel(ring, doComponent, in, blockBytes);
+      ASSERT_EQ(correct, write(basis, doComponent));
+      for (size_t i = 0; i < basis.size(); ++i)
+        ASSERT_TRUE(basis.getPoly(i)->termsAreInDescendingOrder());
+      ASSERT_TRUE(in.matchEOF());
+    }
+  };
+
+  check("0", false);
+  check("1 0", false);
+  check("3 +0 -0 0", false);
+  check("1 1", false);
+  check("2\n a\n b\n", false);
+  check("3\n a2+b+1\n\t1+b+a2\n  -3c4d-5b2c+100A7\n\n", false);
+  check("2 a<0>+b<1> 5<2>-b<0>+a<1>", true);
+  check("1 a12345b0+c", false);
+
+  auto checkError = [&](const char* const str, const bool doComponent) {
+    for (size_t blockBytes = 1; blockBytes < 4; ++blockBytes) {
+      Scanner in(str);
+      ASSERT_ANY_THROW
+        (MathicIO<>().readBasisParallel(ring, doComponent, in, blockBytes));
+    }
+  };
+  checkError("2 a", false);
+  checkError("1 a b", false);
+  checkError("1 a*b", false);
+  checkError("1 a+", false);
+  checkError("1 aa", false);
+  checkError("1 a1000000000000", false);
+  checkError("1 99999999999999999999a", false);
+  checkError("1 a<1", true);
+  checkError("1 a", true);
+}
+
 TEST(MathicIO, ReadWritePoly) {
   typedef PolyRing::Monoid Monoid;
   typedef PolyRing::Field Field;
@@ -5,6 +5,9 @@
 
 #include <gtest/gtest.h>
 #include <sstream>
+#include <vector>
+#include <chrono>
+#include <iostream>
 
 using namespace mgb;
 
@@ -226,3 +229,134 @@ TEST(PrimeField, PlusOne) {
   ASSERT_EQ
     (pf32.toElement(3015615332u), pf32.plusOne(pf32.toElement(3015615331u)));
 }
+
+namespace {
+  // Checks that product and reduce agree with % for many pseudo-random
+  // elements of pf.
+  template<class T>
+  void checkBarrett(const PrimeField<T>& pf) {
+    const uint64 p = pf.charac();
+    uint64 state = 12345;
+    for (size_t i = 0; i < 10000; ++i) {
+      state = state * 6364136223846793005ull + 1442695040888963407ull;
+      const uint64 a = (state >> 16) % p;
+      const uint64 b = (state >> 40) % p;
+      const auto product =
+        pf.product(pf.toElementInRange(a), pf.toElementInRange(b));
+      ASSERT_EQ((a * b) % p, static_cast<uint64>(product.value()));
+      ASSERT_EQ(state % p, static_cast<uint64>(pf.reduce(state).value()));
+    }
+    const uint64 max = std::numeric_limits<uint64>::max();
+    ASSERT_EQ(max % p, static_cast<uint64>(pf.reduce(max).value()));
+    ASSERT_EQ(0u, pf.reduce(0).value());
+    ASSERT_EQ(0u, pf.reduce(p).value());
+    ASSERT_EQ(p - 1, static_cast<uint64>(pf.reduce(p - 1).value()));
+    const auto minusOne = pf.toElement(-1);
+    ASSERT_EQ(pf.one(), pf.product(minusOne, minusOne));
+  }
+}
+
+TEST(PrimeField, Barrett) {
+  checkBarrett(PrimeField<unsigned char>(2));
+  checkBarrett(PrimeField<unsigned char>(251));
+  checkBarrett(PrimeField<uint16>(3));
+  checkBarrett(PrimeField<uint16>(32003));
+  checkBarrett(PrimeField<uint16>(65521));
+  checkBarrett(PrimeField<uint32>(65537));
+  checkBarrett(PrimeField<uint32>(2147483647u));
+  checkBarrett(PrimeField<uint32>(4294967291u));
+  checkBarrett(PrimeField<unsigned long>(101));
+  checkBarrett(PrimeField<unsigned long>(4294967291u));
+}
+
+TEST(PrimeField, InverseTable) {
+  const PrimeField<uint16> pf2(2);
+  std::vector<uint16> table;
+  pf2.inverseTable(table);
+  ASSERT_EQ(2u, table.size());
+  ASSERT_EQ(0u, table[0]);
+  ASSERT_EQ(1u, table[1]);
+
+  const PrimeField<unsigned long> pf(65521);
+  pf.inverseTable(table);
+  ASSERT_EQ(65521u, table.size());
+  ASSERT_EQ(0u, table[0]);
+  for (unsigned long a = 1; a < pf.charac(); ++a) {
+    const auto e = pf.toElementInRange(a);
+    ASSERT_EQ(pf.inverse(e).value(), table[a]);
+  }
+}
+
+TEST(PrimeField, DISABLED_ProductBenchmark) {
+  // Compares the products of PrimeField to those of a plain %. Run with
+  // --gtest_also_run_disabled_tests to see the times.
+  const size_t count = 100000000;
+  const auto time = [](const char* name, uint64 (*run)()) {
+    const auto start = std::chrono::steady_clock::now();
+    const auto checksum = run();
+    const auto end = std::chrono::steady_clock::now();
+    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>
+      (end - start).count();
+    std::cout << name << ": " << ms << " ms (checksum "
+      << checksum << ')' << std::endl;
+    return checksum;
+  };
+
+  struct Run {
+    static uint64 field() {
+      const PrimeField<unsigned long> pf(32003);
+      auto x = pf.toElement(2);
+      const auto factor = pf.toElement(12345);
+      uint64 sum = 0;
+      for (size_t i = 0; i < count; ++i) {
+        x = pf.product(x, factor);
+        sum += x.value();
+      }
+      return sum;
+    }
+
+    static uint64 modulus() {
+      volatile unsigned long volatileModulus = 32003;
+      const unsigned long p = volatileModulus;
+      unsigned long x = 2;
+      uint64 sum = 0;
+      for (size_t i = 0; i < count; ++i) {
+        x = (x * 12345) % p;
+        sum += x;
+      }
+      return sum;
+    }
+
+    static uint64 reduce() {
+      const PrimeField<uint16> pf(32003);
+      uint64 x = 2;
+      uint64 sum = 0;
+      for (size_t i = 0; i < count; ++i) {
+        x = pf.reduce(x * 12345 + i).value();
+        sum += x;
+      }
+      return sum;
+    }
+
+    static uint64 reduceModulus() {
+      volatile uint64 volatileModulus = 32003;
+      const uint64 p = volatileModulus;
+      uint64 x = 2;
+      uint64 sum = 0;
+      for (size_t i = 0; i < count; ++i) {
+        x = (x * 12345 + i) % p;
+        sum += x;
+      }
+      return sum;
+    }
+  };
+
+  ASSERT_EQ(
+    time("% product", &Run::modulus),
+    time("PrimeField::product", &Run::field)
+  );
+  ASSERT_EQ(
+    time("% of 64 bit value", &Run::reduceModulus),
+    time("PrimeField::reduce", &Run::reduce)
+  );
+}
@@ -0,0 +1,310 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#include "mathicgb/stdinc.h"
+
+#include "mathicgb/SPairs.hpp"
+#include "mathicgb/PolyBasis.hpp"
+#include "mathicgb/Basis.hpp"
+#include "mathicgb/Reducer.hpp"
+#include "mathicgb/MathicIO.hpp"
+#include "mathicgb/io-util.hpp"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <memory>
+
+using namespace mgb;
+
+namespace {
+  typedef std::pair<size_t, size_t> Pair;
+  const size_t Invalid = static_cast<size_t>(-1);
+
+  // Keeps the ring and basis alive for an SPairs.
+  struct BasisMaker {
+    BasisMaker(const std::string& ringStr):
+      mRing(ringFromString(ringStr)),
+      mBasis(*mRing, DivisorLookup::makeFactory(*mRing, 1)->create(true, true))
+    {}
+
+    void add(const std::string& str) {
+      std::unique_ptr<Poly> p(new Poly(*mRing));
+      std::istringstream in(str);
+      p->parse(in);
+      mBasis.insert(std::move(p));
+    }
+
+    const PolyRing& ring() const {return *mRing;}
+    PolyBasis& basis() {return mBasis;}
+
+  private:
+    std::unique_ptr<PolyRing> mRing;
+    PolyBasis mBasis;
+  };
+
+  // Pops all of the S-pairs and returns them in sorted order.
+  std::vector<Pair> popAll(SPairs& pairs) {
+    std::vector<Pair> popped;
+    while (true) {
+      const auto p = pairs.pop();
+      if (p.first == Invalid)
+        break;
+      popped.push_back(p);
+    }
+    std::sort(popped.begin(), popped.end());
+    return popped;
+  }
+
+  // Computes a Groebner basis of the ideal in idealStr by reducing the
+  // S-pairs one degree at a time. The pairs of the new basis elements from
+  // a degree are added in one batch if batch is true and otherwise one
+  // element at a time. Returns the reduced Groebner basis in ascending
+  // order of lead monomial and adds the number of S-pairs that were
+  // queued to queuedCount.
+  std::string degreeByDegreeBasis(
+    const char* const idealStr,
+    const bool batch,
+    size_t& queuedCount
+  ) {
+    std::istringstream inStream(idealStr);
+    Scanner in(inStream);
+    auto p = MathicIO<>().readRing(false, in);
+    auto& ring = *p.first;
+    const auto input = MathicIO<>().readBasis(ring, false, in);
+    const auto reducer = Reducer::makeReducer(Reducer::Reducer_F4_New, ring);
+    PolyBasis basis
+      (ring, DivisorLookup::makeFactory(ring, 1)->create(true, true));
+    SPairs pairs(basis, false, false);
+
+    auto insert = [&](std::vector<std::unique_ptr<Poly>>& polys) {
+      const size_t newGenBegin = basis.size();
+      const auto countBefore = pairs.pairCount();
+      for (auto it = polys.begin(); it != polys.end(); ++it) {
+        if (basis.divisor((*it)->getLeadMonomial()) != Invalid)
+          *it = reducer->classicReduce(**it, basis);
+        if ((*it)->isZero())
+          continue;
+        basis.insert(std::move(*it));
+        if (!batch)
+          pairs.addPairs(basis.size() - 1);
+      }
+      polys.clear();
+      if (batch)
+        pairs.addPairs(newGenBegin, basis.size());
+      queuedCount += pairs.pairCount() - countBefore;
+    };
+
+    std::vector<std::unique_ptr<Poly>> polys;
+    for (size_t i = 0; i < input.size(); ++i)
+      polys.emplace_back(input.getPoly(i)->copy());
+    insert(polys);
+
+    std::vector<Pair> group;
+    while (!pairs.empty()) {
+      pairs.popDegree(group);
+      if (group.empty())
+        break;
+      reducer->classicReduceSPolySet(group, basis, polys);
+      insert(polys);
+    }
+
+    std::vector<size_t> indices;
+    for (size_t i = 0; i < basis.size(); ++i)
+      if (!basis.retired(i) && basis.leadMinimal(i))
+        indices.push_back(i);
+    std::sort(indices.begin(), indices.end(), [&](size_t a, size_t b) {
+      return ring.monoid().lessThan
+        (basis.leadMonomial(a), basis.leadMonomial(b));
+    });
+    Basis reduced(ring);
+    for (auto it = indices.begin(); it != indices.end(); ++it) {
+      auto poly = reducer->classicTailReduce(basis.poly(*it), basis);
+      poly->makeMonic();
+      reduced.insert(std::move(poly));
+    }
+    return toString(&reduced);
+  }
+}
+
+TEST(SPairs, BatchEliminatesWithinRound) {
+  // The S-pair of a2c and b2c is useless because of abc, which comes
+  // after both of them in the same round.
+  const char* const leads[] = {"a2c", "b2c", "abc"};
+
+  BasisMaker batchMaker("101 4 1\n1 1 1 1");
+  for (size_t i = 0; i < 3; ++i)
+    batchMaker.add(leads[i]);
+  SPairs batch(batchMaker.basis(), false, false);
+  batch.addPairs(0, 3);
+  ASSERT_EQ(2u, batch.pairCount());
+  ASSERT_TRUE(batch.eliminated(0, 1));
+
+  // One element at a time, the pair is queued since abc is not there yet.
+  BasisMaker singleMaker("101 4 1\n1 1 1 1");
+  SPairs single(singleMaker.basis(), false, false);
+  for (size_t i = 0; i < 3; ++i) {
+    singleMaker.add(leads[i]);
+    single.addPairs(i);
+  }
+  ASSERT_EQ(3u, single.pairCount());
+
+  // The useless pair is caught when it is popped, so the pairs that get
+  // reduced are the same.
+  const auto batchPairs = popAll(batch);
+  ASSERT_EQ(2u, batchPairs.size());
+  ASSERT_EQ(Pair(2, 0), batchPairs[0]);
+  ASSERT_EQ(Pair(2, 1), batchPairs[1]);
+  ASSERT_EQ(batchPairs, popAll(single));
+}
+
+TEST(SPairs, BatchSameBasisAsSingle) {
+  // homogenized cyclic-4
+  const char* const idealStr =
+    "32003 5 1 1 1 1 1 1\n4\n"
+    "a+b+c+d\n"
+    "ab+bc+cd+da\n"
+    "abc+bcd+cda+dab\n"
+    "abcd-e4\n";
+  size_t batchQueued = 0;
+  size_t singleQueued = 0;
+  const auto batchBasis = degreeByDegreeBasis(idealStr, true, batchQueued);
+  const auto singleBasis = degreeByDegreeBasis(idealStr, false, singleQueued);
+  ASSERT_EQ(singleBasis, batchBasis);
+  ASSERT_LE(batchQueued, singleQueued);
+}
+
+TEST(SPairs, CompactColumn) {
+  // The basis elements a^i*b^(n+1-i) for i = 1, ..., n followed by abc
+  // give a single column of n pairs that all have the same degree.
+  const size_t n = 40;
+  BasisMaker maker("101 4 1\n1 1 1 1");
+  for (size_t i = 1; i <= n; ++i) {
+    std::ostringstream out;
+    out << 'a' << i << 'b' << n + 1 - i;
+    maker.add(out.str());
+  }
+  maker.add("abc");
+  auto& basis = maker.basis();
+  const auto& monoid = maker.ring().monoid();
+
+  SPairs pairs(basis, false, false);
+  pairs.addReducedPairs(0, n);
+  pairs.addPairs(n, n + 1);
+  ASSERT_EQ(n, pairs.pairCount());
+  const auto memoryBefore = pairs.getMemoryUse();
+
+  // Check that the pairs come out in ascending order of lcm.
+  auto lcm = monoid.alloc();
+  auto previousLcm = monoid.alloc();
+  std::vector<size_t> popped;
+  auto popAndCheck = [&]() {
+    const auto p = pairs.pop();
+    ASSERT_EQ(n, p.first);
+    ASSERT_NE(Invalid, p.second);
+    monoid.lcm(basis.leadMonomial(p.first), basis.leadMonomial(p.second), lcm);
+    if (!popped.empty()) {
+      ASSERT_TRUE(monoid.lessThan(previousLcm, lcm));
+    }
+    monoid.copy(lcm, previousLcm);
+    popped.push_back(p.second);
+  };
+
+  // Popping more than half of the column compacts it.
+  const size_t firstPopCount = 3 * n / 4;
+  for (size_t i = 0; i < firstPopCount; ++i)
+    popAndCheck();
+  ASSERT_EQ(n - firstPopCount, pairs.pairCount());
+  ASSERT_LT(pairs.getMemoryUse(), memoryBefore);
+
+  // The remaining pairs still come out in order after compaction, except
+  // for those whose row is retired.
+  std::vector<size_t> retired;
+  for (size_t row = 0; row < n && retired.size() < 3; ++row) {
+    if (std::find(popped.begin(), popped.end(), row) == popped.end()) {
+      basis.retire(row);
+      retired.push_back(row);
+    }
+  }
+  while (!pairs.empty())
+    popAndCheck();
+  ASSERT_EQ(0u, pairs.pairCount());
+  ASSERT_EQ(n - retired.size(), popped.size());
+  std::sort(popped.begin(), popped.end());
+  for (size_t row = 0, i = 0; row < n; ++row) {
+    if (std::find(retired.begin(), retired.end(), row) != retired.end())
+      continue;
+    ASSERT_EQ(row, popped[i]);
+    ++i;
+  }
+}
+
+TEST(SPairs, PopDegree) {
+  // The pairs are (1,0) in degree 3, (2,1) and (3,0) in degree 4 and
+  // (3,2) in degree 5. The other pairs are relatively prime.
+  const char* const leads[] = {"ab", "bc", "c2d", "a2d"};
+  BasisMaker maker("101 4 1\n1 1 1 1");
+  for (size_t i = 0; i < 4; ++i)
+    maker.add(leads[i]);
+  SPairs pairs(maker.basis(), false, false);
+  ASSERT_TRUE(pairs.hasDegrees());
+  pairs.addPairs(0, 4);
+  ASSERT_EQ(4u, pairs.pairCount());
+
+  std::vector<Pair> group;
+  auto w = pairs.popDegree(group);
+  ASSERT_EQ(3, pairs.weightDegree(w));
+  ASSERT_EQ(std::vector<Pair>(1, Pair(1, 0)), group);
+  ASSERT_EQ(3u, pairs.pairCount());
+  ASSERT_EQ(4, pairs.weightDegree(pairs.nextWeight()));
+
+  w = pairs.popFirstDegree(group);
+  ASSERT_EQ(4, pairs.weightDegree(w));
+  std::sort(group.begin(), group.end());
+  ASSERT_EQ(2u, group.size());
+  ASSERT_EQ(Pair(2, 1), group[0]);
+  ASSERT_EQ(Pair(3, 0), group[1]);
+  ASSERT_EQ(1u, pairs.pairCount());
+
+  w = pairs.popDegree(group);
+  ASSERT_EQ(5, pairs.weightDegree(w));
+  ASSERT_EQ(std::vector<Pair>(1, Pair(3, 2)), group);
+  ASSERT_EQ(0u, pairs.pairCount());
+  ASSERT_TRUE(pairs.empty());
+
+  // Popping from an empty queue gives no pairs.
+  group.push_back(Pair(1, 0));
+  pairs.popDegree(group);
+  ASSERT_TRUE(group.empty());
+}
+
+TEST(SPairs, PopDegreeSkipsUselessDegree) {
+  // Retiring bc leaves no useful pairs of degree 3 and only (3,0) in
+  // degree 4.
+  const char* const leads[] = {"ab", "bc", "c2d", "a2d"};
+  for (int first = 0; first < 2; ++first) {
+    BasisMaker maker("101 4 1\n1 1 1 1");
+    for (size_t i = 0; i < 4; ++i)
+      maker.add(leads[i]);
+    SPairs pairs(maker.basis(), false, false);
+    pairs.addPairs(0, 4);
+    maker.basis().retire(1);
+
+    std::vector<Pair> group;
+    if (first == 0) {
+      const auto w = pairs.popFirstDegree(group);
+      ASSERT_EQ(3, pairs.weightDegree(w));
+      ASSERT_TRUE(group.empty());
+      ASSERT_FALSE(pairs.empty());
+    }
+    const auto w = pairs.popDegree(group);
+    ASSERT_EQ(4, pairs.weightDegree(w));
+    ASSERT_EQ(std::vector<Pair>(1, Pair(3, 0)), group);
+    ASSERT_EQ(5, pairs.weightDegree(pairs.nextWeight()));
+  }
+}
+
+TEST(SPairs, HasDegrees) {
+  BasisMaker maker("101 4 lex 0\n");
+  maker.add("ab");
+  ASSERT_FALSE(SPairs(maker.basis(), false, false).hasDegrees());
+  ASSERT_TRUE(SPairs(maker.basis(), false, true).hasDegrees());
+}
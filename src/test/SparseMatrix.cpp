@@ -6,6 +6,7 @@
 #include "mathicgb/Poly.hpp"
 #include "mathicgb/PolyRing.hpp"
 #include "mathicgb/io-util.hpp"
+#include "mathicgb/MemoryBudget.hpp"
 #include <gtest/gtest.h>
 #include <memory>
 #include <string>
@@ -88,3 +89,28 @@ TEST(SparseMatrix, toRow) {
   mat.rowToPolynomial(2, monomials, p);
   ASSERT_EQ(*parsePoly(*ring, "20a3+40a1"), p);
 }
+
+TEST(SparseMatrix, MemoryBudget) {
+  auto& budget = MemoryBudget::singleton();
+  const auto before = budget.inUse(MemoryBudget::MatrixBlocks);
+  {
+    SparseMatrix mat(100);
+    for (SparseMatrix::ColIndex col = 0; col < 1000; ++col) {
+      mat.appendEntry(col, 1);
+      if (col % 10 == 9)
+        mat.rowDone();
+    }
+    // memoryUse() also counts the Block objects.
+    const auto tracked = budget.inUse(MemoryBudget::MatrixBlocks) - before;
+    const auto entryBytes =
+      sizeof(SparseMatrix::ColIndex) + sizeof(SparseMatrix::Scalar);
+    ASSERT_LE(1000 * entryBytes, tracked);
+    ASSERT_LT(tracked, mat.memoryUse());
+    ASSERT_LE(budget.inUse(MemoryBudget::MatrixBlocks), budget.peak());
+
+    SparseMatrix moved(std::move(mat));
+    mat.clear();
+    ASSERT_LT(before, budget.inUse(MemoryBudget::MatrixBlocks));
+  }
+  ASSERT_EQ(before, budget.inUse(MemoryBudget::MatrixBlocks));
+}
@@ -11,15 +11,24 @@
 #include "mathicgb/SigPolyBasis.hpp"
 #include "mathicgb/SignatureGB.hpp"
 #include "mathicgb/ClassicGBAlg.hpp"
+#include "mathicgb/F4Trace.hpp"
+#include "mathicgb/HilbertSeries.hpp"
+#include "mathicgb/Fglm.hpp"
 #include "mathicgb/mtbb.hpp"
 #include "mathicgb/MathicIO.hpp"
+#include "mathicgb/MemoryBudget.hpp"
+#include "mathicgb/SPairGroupSizer.hpp"
+#include "mathicgb/F4Reducer.hpp"
+#include "mathicgb/LogDomainSet.hpp"
 #include "mathicgb/Scanner.hpp"
+#include "mathicgb/MultiModularGB.hpp"
 #include "test/ideals.hpp"
 #include <cstdio>
 #include <string>
 #include <iostream>
 #include <sstream>
 #include <memory>
+#include <limits>
 #include <gtest/gtest.h>
 
 using namespace mgb;
@@ -304,24 +313,31 @@ spairQueue	reducerType	divLookup	monTable	buchberger	postponeKoszul	useBaseDivis
 
     mgb::mtbb::task_scheduler_init scheduler(threadCount);
     if (buchberger) {
-      const auto reducer = Reducer::makeReducer
-        (Reducer::reducerType(reducerType), ring);
-      ClassicGBAlg alg(
-        std::move(basis),
-        *reducer,
-        divLookup,
-        preferSparseReducers,
-        spairQueue
-      );
-      alg.setUseAutoTopReduction(autoTopReduce);
-      alg.setUseAutoTailReduction(autoTailReduce);
-      alg.setSPairGroupSize(sPairGroupSize);
-      alg.computeGrobnerBasis();
-      std::unique_ptr<Basis> initialIdeal =
-        alg.basis().initialIdeal();
-      EXPECT_EQ(initialIdealStr, toString(initialIdeal.get()))
-        << reducerType << ' ' << divLookup << ' '
-        << monTable << ' ' << postponeKoszul << ' ' << useBaseDivisors;
+      for (int useSugar = 0; useSugar <= 1; ++useSugar) {
+        const auto reducer = Reducer::makeReducer
+          (Reducer::reducerType(reducerType), ring);
+        Basis basisCopy(ring);
+        for (size_t i = 0; i < basis.size(); ++i)
+          basisCopy.insert(make_unique<Poly>(*basis.getPoly(i)));
+        ClassicGBAlg alg(
+          std::move(basisCopy),
+          *reducer,
+          divLookup,
+          preferSparseReducers,
+          spairQueue,
+          useSugar != 0
+        );
+        alg.setUseAutoTopReduction(autoTopReduce);
+        alg.setUseAutoTailReduction(autoTailReduce);
+        alg.setSPairGroupSize(sPairGroupSize);
+        alg.computeGrobnerBasis();
+        std::unique_ptr<Basis> initialIdeal =
+          alg.basis().initialIdeal();
+        EXPECT_EQ(initialIdealStr, toString(initialIdeal.get()))
+          << reducerType << ' ' << divLookup << ' '
+          << monTable << ' ' << postponeKoszul << ' ' << useBaseDivisors
+          << ' ' << useSugar;
+      }
     } else {
       SignatureGB alg(
         std::move(basis),
@@ -408,3 +424,434 @@ TEST(GB, gerdt93_0_7) {
   testGB(gerdt93IdealComponentFirst(false), gerdt93_gb_strat0_free7,
          gerdt93_syzygies_strat0_free7, gerdt93_initial_strat0_free7, 9);
 }
+
+namespace {
+  // Returns the Groebner basis of the ideal in idealStr as computed by
+  // F4. Records into or replays trace if it is not null.
+  std::string f4Basis(const std::string& idealStr, F4Trace* trace) {
+    std::istringstream inStream(idealStr);
+    Scanner in(inStream);
+    auto p = MathicIO<>().readRing(false, in);
+    auto& ring = *p.first;
+    auto basis = MathicIO<>().readBasis(ring, false, in);
+    const auto reducer = Reducer::makeReducer(Reducer::Reducer_F4_New, ring);
+    ClassicGBAlg alg(std::move(basis), *reducer, 2, true, 0, false);
+    alg.setUseAutoTopReduction(true);
+    alg.setUseAutoTailReduction(false);
+    alg.setTrace(trace);
+    alg.computeGrobnerBasis();
+    auto gb = alg.basis().toBasisAndRetireAll();
+    return toString(gb.get());
+  }
+}
+
+TEST(GB, F4Trace) {
+  // cyclic-4 modulo two different primes
+  const char* cyclic4 =
+    "1 1 1 1 1\n4\n"
+    "a+b+c+d\n"
+    "ab+bc+cd+da\n"
+    "abc+bcd+cda+dab\n"
+    "abcd-1\n";
+  const auto ideal101 = std::string("101 4 ") + cyclic4;
+  const auto ideal32003 = std::string("32003 4 ") + cyclic4;
+
+  F4Trace trace;
+  const auto learned = f4Basis(ideal101, &trace);
+  ASSERT_EQ(f4Basis(ideal101, 0), learned);
+  ASSERT_FALSE(trace.steps.empty());
+  ASSERT_FALSE(trace.matrices.empty());
+  trace.finishLearning();
+
+  ASSERT_EQ(learned, f4Basis(ideal101, &trace));
+  ASSERT_EQ(f4Basis(ideal32003, 0), f4Basis(ideal32003, &trace));
+
+  // A different ideal does not match the trace.
+  const char* other = "101 4 1 1 1 1 1\n2\na2-b\nb2-c\n";
+  ASSERT_THROW(f4Basis(other, &trace), F4Trace::Mismatch);
+}
+
+TEST(GB, HilbertSeries) {
+  // (x^2) in 2 variables: 1 - t^2 and 1, 2, 2, 2, ... monomials per degree.
+  const std::vector<HilbertSeries::Exponent> x2 = {2, 0};
+  const auto series = HilbertSeries::fromMonomialIdeal(2, x2);
+  ASSERT_EQ(3u, series.numerator().size());
+  ASSERT_EQ(BigInt(1), series.numerator()[0]);
+  ASSERT_TRUE(series.numerator()[1].isZero());
+  ASSERT_EQ(BigInt(-1), series.numerator()[2]);
+  ASSERT_EQ(BigInt(1), series.hilbertFunction(0));
+  ASSERT_EQ(BigInt(2), series.hilbertFunction(1));
+  ASSERT_EQ(BigInt(2), series.hilbertFunction(7));
+
+  // (xy, xz, yz) in 3 variables: 1 + 2t is the reduced form of
+  // 1 - 3t^2 + 2t^3 over (1 - t)^3, so 1, 3, 3, 3, ... monomials.
+  const std::vector<HilbertSeries::Exponent> lines = {
+    1, 1, 0,
+    1, 0, 1,
+    0, 1, 1,
+    1, 1, 1 // not minimal
+  };
+  const auto linesSeries = HilbertSeries::fromMonomialIdeal(3, lines);
+  const std::vector<BigInt> expected = {1, 0, -3, 2};
+  ASSERT_EQ(HilbertSeries(3, expected), linesSeries);
+  ASSERT_EQ(BigInt(3), linesSeries.hilbertFunction(1));
+  ASSERT_EQ(BigInt(3), linesSeries.hilbertFunction(5));
+
+  // The zero ideal leaves every monomial.
+  const auto none = HilbertSeries::fromMonomialIdeal(3, {});
+  ASSERT_EQ(BigInt(1), none.hilbertFunction(0));
+  ASSERT_EQ(BigInt(10), none.hilbertFunction(3));
+}
+
+namespace {
+  // Returns the Groebner basis of the ideal in idealStr as computed by
+  // Buchberger's algorithm with the Hilbert series in series, if any. If
+  // learn is not null, the Hilbert series of the basis is stored there.
+  std::string hilbertBasis(
+    const std::string& idealStr,
+    const HilbertSeries* series,
+    std::unique_ptr<HilbertSeries>* learn,
+    unsigned long long& skipCount
+  ) {
+    std::istringstream inStream(idealStr);
+    Scanner in(inStream);
+    auto p = MathicIO<>().readRing(false, in);
+    auto& ring = *p.first;
+    auto basis = MathicIO<>().readBasis(ring, false, in);
+    const auto reducer =
+      Reducer::makeReducer(Reducer::Reducer_Geobucket_Hashed, ring);
+    ClassicGBAlg alg(std::move(basis), *reducer, 2, true, 0, false);
+    alg.setHilbertSeries(series);
+    alg.computeGrobnerBasis();
+    skipCount = alg.hilbertSkipCount();
+    if (learn != 0)
+      *learn = make_unique<HilbertSeries>
+        (HilbertSeries::fromLeadMonomials(alg.basis()));
+    auto gb = alg.basis().toBasisAndRetireAll();
+    return toString(gb.get());
+  }
+}
+
+TEST(GB, HilbertSeriesSkipsPairs) {
+  // homogenized cyclic-4 with the Hilbert series from modulo another prime
+  const char* cyclic4 =
+    "1 1 1 1 1 1\n4\n"
+    "a+b+c+d\n"
+    "ab+bc+cd+da\n"
+    "abc+bcd+cda+dab\n"
+    "abcd-e4\n";
+  const auto ideal101 = std::string("101 5 ") + cyclic4;
+  const auto ideal32003 = std::string("32003 5 ") + cyclic4;
+
+  std::unique_ptr<HilbertSeries> series;
+  unsigned long long skipped = 0;
+  hilbertBasis(ideal101, 0, &series, skipped);
+  ASSERT_EQ(0u, skipped);
+  ASSERT_TRUE(series.get() != 0);
+
+  const auto plain = hilbertBasis(ideal32003, 0, 0, skipped);
+  ASSERT_EQ(plain, hilbertBasis(ideal32003, series.get(), 0, skipped));
+  ASSERT_LT(0u, skipped);
+
+  // A series that is larger than that of the basis in some degree is
+  // reported. Here it is the series of the zero ideal.
+  const std::vector<BigInt> wrong = {1};
+  const HilbertSeries wrongSeries(5, wrong);
+  ASSERT_ANY_THROW(hilbertBasis(ideal32003, &wrongSeries, 0, skipped));
+
+  // Inhomogeneous generators are reported, also with a series that
+  // matches their lead monomials.
+  const char* inhomogeneous = "1 1 1 1 1\n2\nab+c\nb2+d\n";
+  std::unique_ptr<HilbertSeries> inhomogeneousSeries;
+  hilbertBasis(std::string("101 4 ") + inhomogeneous, 0,
+    &inhomogeneousSeries, skipped);
+  ASSERT_THROW(hilbertBasis(std::string("32003 4 ") + inhomogeneous,
+    inhomogeneousSeries.get(), 0, skipped), mathic::MathicException);
+}
+
+namespace {
+  // Returns the reduced Groebner basis of the ideal of the Groebner basis
+  // gb in ascending order of lead monomial.
+  std::string reducedBasis(const PolyBasis& gb, Reducer& reducer) {
+    const auto& ring = gb.ring();
+    std::vector<size_t> indices;
+    for (size_t i = 0; i < gb.size(); ++i)
+      if (!gb.retired(i))
+        indices.push_back(i);
+    std::sort(indices.begin(), indices.end(), [&](size_t a, size_t b) {
+      return ring.monoid().lessThan(gb.leadMonomial(a), gb.leadMonomial(b));
+    });
+    Basis reduced(ring);
+    for (auto it = indices.begin(); it != indices.end(); ++it) {
+      auto poly = reducer.classicTailReduce(gb.poly(*it), gb);
+      poly->makeMonic();
+      reduced.insert(std::move(poly));
+    }
+    return toString(&reduced);
+  }
+
+  // Returns the reduced Groebner basis of the ideal in idealStr in
+  // ascending order of lead monomial. If fglmRing is not null, the basis
+  // is converted to the order of fglmRing with FGLM.
+  std::string reducedBasis(
+    const std::string& idealStr,
+    const PolyRing* fglmRing
+  ) {
+    std::istringstream inStream(idealStr);
+    Scanner in(inStream);
+    auto p = MathicIO<>().readRing(false, in);
+    auto& ring = *p.first;
+    auto basis = MathicIO<>().readBasis(ring, false, in);
+    const auto reducer = Reducer::makeReducer(Reducer::Reducer_F4_New, ring);
+    ClassicGBAlg alg(std::move(basis), *reducer, 2, true, 0, false);
+    alg.setUseAutoTopReduction(true);
+    alg.setUseAutoTailReduction(false);
+    alg.computeGrobnerBasis();
+    auto& gb = alg.basis();
+
+    if (fglmRing != 0) {
+      EXPECT_TRUE(Fglm::zeroDimensional(gb));
+      return toString(Fglm(gb).convert(*fglmRing).get());
+    }
+    return reducedBasis(gb, *reducer);
+  }
+}
+
+TEST(GB, Fglm) {
+  // cyclic-5 has 70 solutions counted with multiplicity
+  const char* cyclic5 =
+    "5\n"
+    "a+b+c+d+e\n"
+    "ab+bc+cd+de+ea\n"
+    "abc+bcd+cde+dea+eab\n"
+    "abcd+bcde+cdea+deab+eabc\n"
+    "abcde-1\n";
+  const auto grevlex = std::string("101 5 1 1 1 1 1 1\n") + cyclic5;
+  const auto lex = std::string("101 5 lex 0\n") + cyclic5;
+
+  std::istringstream lexStream(lex);
+  Scanner lexIn(lexStream);
+  const auto lexRing = MathicIO<>().readRing(false, lexIn).first;
+  const auto converted = reducedBasis(grevlex, lexRing.get());
+  ASSERT_EQ(reducedBasis(lex, 0), converted);
+
+  // Converting to the same order gives the reduced basis.
+  std::istringstream grevlexStream(grevlex);
+  Scanner grevlexIn(grevlexStream);
+  const auto grevlexRing = MathicIO<>().readRing(false, grevlexIn).first;
+  ASSERT_EQ(reducedBasis(grevlex, 0), reducedBasis(grevlex, grevlexRing.get()));
+}
+
+TEST(GB, FglmZeroDimensional) {
+  const auto isZeroDimensional = [](const char* idealStr) {
+    std::istringstream inStream(idealStr);
+    Scanner in(inStream);
+    auto p = MathicIO<>().readRing(false, in);
+    auto& ring = *p.first;
+    auto basis = MathicIO<>().readBasis(ring, false, in);
+    const auto reducer = Reducer::makeReducer(Reducer::Reducer_F4_New, ring);
+    ClassicGBAlg alg(std::move(basis), *reducer, 2, true, 0, false);
+    alg.computeGrobnerBasis();
+    return Fglm::zeroDimensional(alg.basis());
+  };
+  ASSERT_TRUE(isZeroDimensional("101 2 1 1 1\n2\na2-b\nb3-1\n"));
+  ASSERT_TRUE(isZeroDimensional("101 2 1 1 1\n2\na2-b\na-1\n"));
+  ASSERT_FALSE(isZeroDimensional("101 2 1 1 1\n1\na2-b\n"));
+  ASSERT_FALSE(isZeroDimensional("101 2 1 1 1\n2\nab\nb2\n"));
+}
+
+TEST(GB, DegreeBound) {
+  // homogenized cyclic-4
+  const char* idealStr =
+    "32003 5 1 1 1 1 1 1\n4\n"
+    "a+b+c+d\n"
+    "ab+bc+cd+da\n"
+    "abc+bcd+cda+dab\n"
+    "abcd-e4\n";
+  const auto noBound = std::numeric_limits<exponent>::max();
+
+  // Check both popping a whole degree at a time and one S-pair at a time.
+  const Reducer::ReducerType types[] =
+    {Reducer::Reducer_F4_New, Reducer::Reducer_Geobucket_Hashed};
+  for (size_t t = 0; t < sizeof(types) / sizeof(*types); ++t) {
+    std::istringstream inStream(idealStr);
+    Scanner in(inStream);
+    auto p = MathicIO<>().readRing(false, in);
+    auto& ring = *p.first;
+    const auto reducer = Reducer::makeReducer(types[t], ring);
+    const auto makeAlg = [&](Basis&& basis) {
+      return make_unique<ClassicGBAlg>
+        (std::move(basis), *reducer, 2, true, 0, false);
+    };
+    auto basis = MathicIO<>().readBasis(ring, false, in);
+    Basis copy(ring);
+    for (size_t i = 0; i < basis.size(); ++i)
+      copy.insert(make_unique<Poly>(*basis.getPoly(i)));
+
+    auto full = makeAlg(std::move(copy));
+    full->computeGrobnerBasis();
+    ASSERT_FALSE(full->hasPendingSPairs());
+    ASSERT_EQ(noBound, full->completeDegree());
+    const auto expected = reducedBasis(full->basis(), *reducer);
+
+    auto alg = makeAlg(std::move(basis));
+    alg->setDegreeBound(3);
+    alg->computeGrobnerBasis();
+    ASSERT_TRUE(alg->hasPendingSPairs());
+    ASSERT_EQ(3, alg->completeDegree());
+    const auto size = alg->basis().size();
+
+    // Stopping again at the same bound does nothing.
+    alg->computeGrobnerBasis();
+    ASSERT_EQ(size, alg->basis().size());
+
+    alg->setDegreeBound(5);
+    alg->computeGrobnerBasis();
+    ASSERT_LE(5, alg->completeDegree());
+    ASSERT_LT(size, alg->basis().size());
+
+    // Continue from a copy of the state.
+    std::ostringstream out;
+    alg->writeState(out);
+    std::istringstream stateStream(out.str());
+    Scanner stateIn(stateStream);
+    auto resumed = makeAlg(Basis(ring));
+    resumed->readState(stateIn);
+    ASSERT_EQ(alg->completeDegree(), resumed->completeDegree());
+    resumed->computeGrobnerBasis();
+    ASSERT_EQ(expected, reducedBasis(resumed->basis(), *reducer));
+
+    alg->setDegreeBound(noBound);
+    alg->computeGrobnerBasis();
+    ASSERT_FALSE(alg->hasPendingSPairs());
+    ASSERT_EQ(expected, reducedBasis(alg->basis(), *reducer));
+
+    // The state of a finished computation has nothing left to do.
+    std::ostringstream completeOut;
+    alg->writeState(completeOut);
+    std::istringstream completeStream(completeOut.str());
+    Scanner completeIn(completeStream);
+    auto completed = makeAlg(Basis(ring));
+    completed->readState(completeIn);
+    ASSERT_FALSE(completed->hasPendingSPairs());
+  }
+}
+
+TEST(GB, MemoryBudget) {
+  const char* cyclic5 =
+    "101 5 1 1 1 1 1 1\n5\n"
+    "a+b+c+d+e\n"
+    "ab+bc+cd+de+ea\n"
+    "abc+bcd+cde+dea+eab\n"
+    "abcd+bcde+cdea+deab+eabc\n"
+    "abcde-1\n";
+  const auto expected = reducedBasis(cyclic5, 0);
+
+  // With a budget that is always exceeded, every group of S-pairs after
+  // the first one is reduced one S-pair at a time. The result is the same.
+  auto& logs = LogDomainSet::singleton();
+  logs.performLogCommand("F4SPairGroupSplits");
+  auto& splits = *logs.logDomain("F4SPairGroupSplits");
+  splits.setCount(0);
+  auto& budget = MemoryBudget::singleton();
+  budget.setBudget(1);
+  const auto split = reducedBasis(cyclic5, 0);
+  budget.setBudget(0);
+  ASSERT_LT(0u, splits.count());
+  logs.performLogCommand("-F4SPairGroupSplits");
+  ASSERT_EQ(expected, split);
+  ASSERT_EQ(0u, budget.inUse(MemoryBudget::MatrixBlocks));
+  ASSERT_EQ(0u, budget.inUse(MemoryBudget::DenseRows));
+}
+
+TEST(GB, SPairGroupSizer) {
+  // Matrices take 1 microsecond per entry and have 100 entries per S-pair,
+  // so 500 S-pairs take 0.05 seconds.
+  SPairGroupSizer sizer(0.05, 100);
+  ASSERT_EQ(100u, sizer.groupSize());
+  sizer.recordMatrix(100, 10000, 0.01);
+  ASSERT_EQ(400u, sizer.groupSize()); // can only grow by a factor of 4
+  sizer.recordMatrix(400, 40000, 0.04);
+  ASSERT_EQ(500u, sizer.groupSize());
+  ASSERT_NEAR(1.0, sizer.exponent(), 1e-9);
+
+  // Limited by memory.
+  ASSERT_EQ(500u, sizer.groupSize(10, 1000000));
+  ASSERT_EQ(100u, sizer.groupSize(10, 1000));
+  ASSERT_EQ(1u, sizer.groupSize(10, 0));
+
+  // Quadratic time. A matrix with 250 S-pairs takes 0.05 seconds.
+  SPairGroupSizer quadratic(0.05, 100);
+  const auto seconds = [](double pairs) {
+    const auto entries = 100 * pairs;
+    return 0.05 * (entries / 25000) * (entries / 25000);
+  };
+  quadratic.recordMatrix(100, 10000, seconds(100));
+  quadratic.recordMatrix(1000, 100000, seconds(1000));
+  ASSERT_NEAR(2.0, quadratic.exponent(), 1e-9);
+  quadratic.recordMatrix(300, 30000, seconds(300));
+  ASSERT_NEAR(250.0, quadratic.groupSize(), 1.0);
+
+  // Matrices that are too fast to time make the group size grow.
+  SPairGroupSizer fast(1.0, 10);
+  fast.recordMatrix(10, 100, 0.0);
+  ASSERT_EQ(40u, fast.groupSize());
+}
+
+TEST(GB, MatrixTimeTarget) {
+  const char* cyclic5 =
+    "101 5 1 1 1 1 1 1\n5\n"
+    "a+b+c+d+e\n"
+    "ab+bc+cd+de+ea\n"
+    "abc+bcd+cde+dea+eab\n"
+    "abcd+bcde+cdea+deab+eabc\n"
+    "abcde-1\n";
+  std::istringstream inStream(cyclic5);
+  Scanner in(inStream);
+  auto p = MathicIO<>().readRing(false, in);
+  auto& ring = *p.first;
+  auto basis = MathicIO<>().readBasis(ring, false, in);
+
+  // A target that no matrix can meet makes the matrices small, which still
+  // gives the same basis.
+  F4Reducer reducer(ring, F4Reducer::NewType);
+  ASSERT_FALSE(reducer.adaptiveSetSize());
+  reducer.setMatrixTimeTarget(1e-9);
+  ASSERT_TRUE(reducer.adaptiveSetSize());
+  ClassicGBAlg alg(std::move(basis), reducer, 2, true, 0, false);
+  alg.computeGrobnerBasis();
+  ASSERT_EQ(reducedBasis(cyclic5, 0), reducedBasis(alg.basis(), reducer));
+}
+
+TEST(GB, MultiModularRelearnsTrace) {
+  typedef MultiModularGB::RationalTerm Term;
+  const auto term = [](int64 numerator, size_t x, size_t y) {
+    Term t;
+    t.numerator = BigInt(numerator);
+    t.denominator = BigInt(1);
+    t.exponents.push_back(x);
+    t.exponents.push_back(y);
+    return t;
+  };
+
+  // The first prime is 65521. The S-polynomial of x2+65520y2 and xy+y2
+  // reduces to 65521y3, which is zero modulo 65521, so that row is left out
+  // of the trace learned from 65521. Replaying that trace for any other
+  // prime leaves out y3 without a mismatch, so the trace has to be
+  // replaced.
+  std::vector<MultiModularGB::RationalPoly> ideal(2);
+  ideal[0].push_back(term(1, 2, 0));
+  ideal[0].push_back(term(65520, 0, 2));
+  ideal[1].push_back(term(1, 1, 1));
+  ideal[1].push_back(term(1, 0, 2));
+
+  MultiModularGB gb(MultiModularGB::Order(2), 2);
+  const auto basis = gb.computeGroebnerBasis(ideal);
+  ASSERT_EQ(3u, basis.size());
+  ASSERT_EQ(2u, basis[0].size());
+  ASSERT_EQ(2u, basis[1].size());
+  ASSERT_TRUE(BigInt(65520) == basis[1][1].numerator);
+  ASSERT_EQ(1u, basis[2].size());
+  ASSERT_EQ(3u, basis[2][0].exponents[1]);
+  ASSERT_EQ(1u, gb.traceRelearnCount());
+}
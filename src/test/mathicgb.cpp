@@ -3,6 +3,7 @@
 #include "mathicgb/stdinc.h"
 
 #include "mathicgb.h"
+#include "mathicgb/MemoryBudget.hpp"
 #include <gtest/gtest.h>
 
 using namespace mgb;
@@ -275,6 +276,71 @@ namespace {
     s.appendPolynomialDone();
     s.idealDone();
   }
+
+  template<class Stream>
+  void makeCyclic3(Stream& s) { // variables x,y,z.
+    s.idealBegin(3);
+      s.appendPolynomialBegin(3); // x+y+z
+        for (size_t var = 0; var < 3; ++var) {
+          s.appendTermBegin();
+            s.appendExponent(var, 1);
+          s.appendTermDone(1);
+        }
+      s.appendPolynomialDone();
+      s.appendPolynomialBegin(3); // xy+yz+zx
+        for (size_t var = 0; var < 3; ++var) {
+          s.appendTermBegin();
+            s.appendExponent(var < 2 ? 0 : 1, 1);
+            s.appendExponent(var < 1 ? 1 : 2, 1);
+          s.appendTermDone(1);
+        }
+      s.appendPolynomialDone();
+      s.appendPolynomialBegin(2); // xyz-1
+        s.appendTermBegin();
+          s.appendExponent(0, 1);
+          s.appendExponent(1, 1);
+          s.appendExponent(2, 1);
+        s.appendTermDone(1);
+        s.appendTermBegin();
+        s.appendTermDone(s.modulus() - 1);
+      s.appendPolynomialDone();
+    s.idealDone();
+  }
+
+  template<class Stream>
+  void makeCyclic3LexBasis(Stream& s) { // lex with x > y > z.
+    s.idealBegin(3);
+      s.appendPolynomialBegin(2); // z^3-1
+        s.appendTermBegin();
+          s.appendExponent(0, 0);
+          s.appendExponent(1, 0);
+          s.appendExponent(2, 3);
+        s.appendTermDone(1);
+        s.appendTermBegin();
+          s.appendExponent(0, 0);
+          s.appendExponent(1, 0);
+          s.appendExponent(2, 0);
+        s.appendTermDone(s.modulus() - 1);
+      s.appendPolynomialDone();
+      s.appendPolynomialBegin(3); // y^2+yz+z^2
+        for (size_t zExponent = 0; zExponent < 3; ++zExponent) {
+          s.appendTermBegin();
+            s.appendExponent(0, 0);
+            s.appendExponent(1, 2 - zExponent);
+            s.appendExponent(2, zExponent);
+          s.appendTermDone(1);
+        }
+      s.appendPolynomialDone();
+      s.appendPolynomialBegin(3); // x+y+z
+        for (size_t var = 0; var < 3; ++var) {
+          s.appendTermBegin();
+            for (size_t v = 0; v < 3; ++v)
+              s.appendExponent(v, v == var ? 1 : 0);
+          s.appendTermDone(1);
+        }
+      s.appendPolynomialDone();
+    s.idealDone();
+  }
 }
 
 TEST(MathicGBLib, NullIdealStream) {
@@ -458,6 +524,352 @@ TEST(MathicGBLib, EasyReGB) {
     << "\nDisplayed computed:\n" << computedStr.str();
 }
 
+TEST(MathicGBLib, ExtendGB) {
+  mgb::GroebnerConfiguration configuration(101, 3);
+  std::ostringstream correctStr;
+  mgb::IdealStreamLog<> correct(correctStr, 101, 3);
+  makeGroebnerBasis(correct);
+
+  // Adding nothing to a Groebner basis gives the same basis.
+  {
+    mgb::GroebnerInputIdealStream basis(configuration);
+    makeGroebnerBasis(basis);
+    mgb::GroebnerInputIdealStream generators(configuration);
+    generators.idealBegin(0);
+    generators.idealDone();
+    std::ostringstream computedStr;
+    mgb::IdealStreamLog<> computed(computedStr, 101, 3);
+    mgb::IdealStreamChecker<decltype(computed)> checked(computed);
+    mgb::extendGroebnerBasis(basis, generators, checked);
+    EXPECT_EQ(correctStr.str(), computedStr.str());
+  }
+
+  // x^2 - y is a Groebner basis by itself. Adding x^3 - z gives the ideal
+  // of makeBasis.
+  {
+    mgb::GroebnerInputIdealStream basis(configuration);
+    basis.idealBegin(1);
+      basis.appendPolynomialBegin(2); // x^2 - y
+        basis.appendTermBegin();
+          basis.appendExponent(0, 2);
+        basis.appendTermDone(1);
+        basis.appendTermBegin();
+          basis.appendExponent(1, 1);
+        basis.appendTermDone(100);
+      basis.appendPolynomialDone();
+    basis.idealDone();
+    mgb::GroebnerInputIdealStream generators(configuration);
+    generators.idealBegin(1);
+      generators.appendPolynomialBegin(2); // x^3 - z
+        generators.appendTermBegin();
+          generators.appendExponent(0, 3);
+        generators.appendTermDone(1);
+        generators.appendTermBegin();
+          generators.appendExponent(2, 1);
+        generators.appendTermDone(100);
+      generators.appendPolynomialDone();
+    generators.idealDone();
+    std::ostringstream computedStr;
+    mgb::IdealStreamLog<> computed(computedStr, 101, 3);
+    mgb::IdealStreamChecker<decltype(computed)> checked(computed);
+    mgb::extendGroebnerBasis(basis, generators, checked);
+    EXPECT_EQ(correctStr.str(), computedStr.str());
+  }
+
+  // The basis and the generators must be in the same ring.
+  {
+    mgb::GroebnerInputIdealStream basis(configuration);
+    makeGroebnerBasis(basis);
+    mgb::GroebnerInputIdealStream generators
+      (mgb::GroebnerConfiguration(103, 3));
+    makeBasis(generators);
+    mgb::NullIdealStream computed(101, 3);
+    ASSERT_THROW(
+      mgb::extendGroebnerBasis(basis, generators, computed),
+      std::invalid_argument
+    );
+  }
+}
+
+TEST(MathicGBLib, SignatureGB) {
+  mgb::GroebnerConfiguration configuration(101, 3);
+  configuration.setAlgorithm(mgb::GroebnerConfiguration::SignatureAlgorithm);
+  {
+    mgb::GroebnerInputIdealStream input(configuration);
+    makeBasis(input);
+    std::ostringstream out;
+    mgb::IdealStreamLog<> computed(out, 101, 3);
+    mgb::IdealStreamChecker<decltype(computed)> checked(computed);
+    mgb::computeGroebnerBasis(input, checked);
+    EXPECT_EQ(
+      "IdealStreamLog s(stream, 101, 3);\n"
+      "s.idealBegin(3); // polyCount\n"
+      "s.appendPolynomialBegin(2);\n"
+      "s.appendTermBegin();\n"
+      "s.appendExponent(0, 0); // index, exponent\n"
+      "s.appendExponent(1, 2); // index, exponent\n"
+      "s.appendExponent(2, 0); // index, exponent\n"
+      "s.appendTermDone(1); // coefficient\n"
+      "s.appendTermBegin();\n"
+      "s.appendExponent(0, 1); // index, exponent\n"
+      "s.appendExponent(1, 0); // index, exponent\n"
+      "s.appendExponent(2, 1); // index, exponent\n"
+      "s.appendTermDone(100); // coefficient\n"
+      "s.appendPolynomialDone();\n"
+      "s.appendPolynomialBegin(2);\n"
+      "s.appendTermBegin();\n"
+      "s.appendExponent(0, 1); // index, exponent\n"
+      "s.appendExponent(1, 1); // index, exponent\n"
+      "s.appendExponent(2, 0); // index, exponent\n"
+      "s.appendTermDone(1); // coefficient\n"
+      "s.appendTermBegin();\n"
+      "s.appendExponent(0, 0); // index, exponent\n"
+      "s.appendExponent(1, 0); // index, exponent\n"
+      "s.appendExponent(2, 1); // index, exponent\n"
+      "s.appendTermDone(100); // coefficient\n"
+      "s.appendPolynomialDone();\n"
+      "s.appendPolynomialBegin(2);\n"
+      "s.appendTermBegin();\n"
+      "s.appendExponent(0, 2); // index, exponent\n"
+      "s.appendExponent(1, 0); // index, exponent\n"
+      "s.appendExponent(2, 0); // index, exponent\n"
+      "s.appendTermDone(1); // coefficient\n"
+      "s.appendTermBegin();\n"
+      "s.appendExponent(0, 0); // index, exponent\n"
+      "s.appendExponent(1, 1); // index, exponent\n"
+      "s.appendExponent(2, 0); // index, exponent\n"
+      "s.appendTermDone(100); // coefficient\n"
+      "s.appendPolynomialDone();\n"
+      "s.idealDone();\n",
+      out.str()
+    );
+  }
+
+  // The syzygies of x^2 - y, 0 and x^3 - z are generated by e_1 and by
+  // (x^3 - z)e_0 - (x^2 - y)e_2, whose lead term is x^2e_2 in the default
+  // Schreyer order with ascending components.
+  {
+    mgb::GroebnerInputIdealStream input(configuration);
+    input.idealBegin(3);
+      input.appendPolynomialBegin(2); // x^2 - y
+        input.appendTermBegin();
+          input.appendExponent(0, 2);
+        input.appendTermDone(1);
+        input.appendTermBegin();
+          input.appendExponent(1, 1);
+        input.appendTermDone(100);
+      input.appendPolynomialDone();
+      input.appendPolynomialBegin(0);
+      input.appendPolynomialDone();
+      input.appendPolynomialBegin(2); // x^3 - z
+        input.appendTermBegin();
+          input.appendExponent(0, 3);
+        input.appendTermDone(1);
+        input.appendTermBegin();
+          input.appendExponent(2, 1);
+        input.appendTermDone(100);
+      input.appendPolynomialDone();
+    input.idealDone();
+    mgb::NullIdealStream computed(101, 3);
+    std::ostringstream syzygyOut;
+    mgb::IdealStreamLog<> syzygies(syzygyOut, 101, 3);
+    mgb::computeGroebnerBasis(input, computed, syzygies);
+    EXPECT_EQ(
+      "IdealStreamLog s(stream, 101, 3);\n"
+      "s.idealBegin(0); // polyCount\n"
+      "s.idealDone();\n"
+      "s.idealBegin(1); // polyCount\n"
+      "s.appendPolynomialBegin(1);\n"
+      "s.appendTermBegin();\n"
+      "s.appendExponent(0, 0); // index, exponent\n"
+      "s.appendExponent(1, 0); // index, exponent\n"
+      "s.appendExponent(2, 0); // index, exponent\n"
+      "s.appendTermDone(1); // coefficient\n"
+      "s.appendPolynomialDone();\n"
+      "s.idealDone();\n"
+      "s.idealBegin(1); // polyCount\n"
+      "s.appendPolynomialBegin(1);\n"
+      "s.appendTermBegin();\n"
+      "s.appendExponent(0, 2); // index, exponent\n"
+      "s.appendExponent(1, 0); // index, exponent\n"
+      "s.appendExponent(2, 0); // index, exponent\n"
+      "s.appendTermDone(1); // coefficient\n"
+      "s.appendPolynomialDone();\n"
+      "s.idealDone();\n",
+      syzygyOut.str()
+    );
+  }
+}
+
+TEST(MathicGBLib, Fglm) {
+  mgb::GroebnerConfiguration configuration(101, 3);
+  configuration.setMonomialOrder(
+    mgb::GroebnerConfiguration::LexDescendingBaseOrder,
+    std::vector<mgb::GroebnerConfiguration::Exponent>()
+  );
+  configuration.setUseFglm(true);
+  {
+    mgb::GroebnerInputIdealStream input(configuration);
+    std::ostringstream computedStr;
+    mgb::IdealStreamLog<> computed(computedStr, 101, 3);
+    mgb::IdealStreamChecker<decltype(computed)> checked(computed);
+    makeCyclic3(input);
+    mgb::computeGroebnerBasis(input, checked);
+
+    std::ostringstream correctStr;
+    mgb::IdealStreamLog<> correct(correctStr, 101, 3);
+    makeCyclic3LexBasis(correct);
+    EXPECT_EQ(correctStr.str(), computedStr.str());
+  }
+
+  // The ideal of x^2 - y and x^3 - z is not zero-dimensional, so the basis
+  // is computed directly.
+  configuration.setMonomialOrder(
+    mgb::GroebnerConfiguration::RevLexDescendingBaseOrder,
+    std::vector<mgb::GroebnerConfiguration::Exponent>(3, 1)
+  );
+  {
+    mgb::GroebnerInputIdealStream input(configuration);
+    std::ostringstream computedStr;
+    mgb::IdealStreamLog<> computed(computedStr, 101, 3);
+    makeBasis(input);
+    mgb::computeGroebnerBasis(input, computed);
+
+    std::ostringstream correctStr;
+    mgb::IdealStreamLog<> correct(correctStr, 101, 3);
+    makeGroebnerBasis(correct);
+    EXPECT_EQ(correctStr.str(), computedStr.str());
+  }
+}
+
+TEST(MathicGBLib, Session) {
+  mgb::GroebnerConfiguration configuration(101, 3);
+  configuration.setMaxThreadCount(2);
+  mgb::GroebnerSession session(configuration);
+
+  std::ostringstream correctStr;
+  mgb::IdealStreamLog<> correct(correctStr, 101, 3);
+  makeGroebnerBasis(correct);
+
+  // The same input stream can be used again once it has been cleared.
+  mgb::GroebnerInputIdealStream input(configuration);
+  for (int i = 0; i < 2; ++i) {
+    std::ostringstream computedStr;
+    mgb::IdealStreamLog<> computed(computedStr, 101, 3);
+    mgb::IdealStreamChecker<decltype(computed)> checked(computed);
+    makeBasis(input);
+    session.computeGroebnerBasis(input, checked);
+    EXPECT_EQ(correctStr.str(), computedStr.str());
+  }
+
+  const size_t count = 5;
+  std::vector<std::unique_ptr<mgb::GroebnerInputIdealStream>> inputs;
+  std::vector<std::unique_ptr<std::ostringstream>> outStrs;
+  std::vector<std::unique_ptr<mgb::IdealStreamLog<>>> outputs;
+  for (size_t i = 0; i < count; ++i) {
+    inputs.emplace_back(new mgb::GroebnerInputIdealStream(configuration));
+    if (i % 2 == 0)
+      makeBasis(*inputs.back());
+    else
+      makeGroebnerBasis(*inputs.back());
+    outStrs.emplace_back(new std::ostringstream());
+    outputs.emplace_back(new mgb::IdealStreamLog<>(*outStrs.back(), 101, 3));
+  }
+  std::vector<mgb::GroebnerInputIdealStream*> inputPtrs;
+  std::vector<mgb::IdealStreamLog<>*> outputPtrs;
+  for (size_t i = 0; i < count; ++i) {
+    inputPtrs.push_back(inputs[i].get());
+    outputPtrs.push_back(outputs[i].get());
+  }
+  session.computeGroebnerBases(inputPtrs, outputPtrs);
+  for (size_t i = 0; i < count; ++i)
+    EXPECT_EQ(correctStr.str(), outStrs[i]->str()) << i;
+}
+
+TEST(MathicGBLib, NormalForms) {
+  mgb::GroebnerConfiguration configuration(101, 3);
+  mgb::GroebnerInputIdealStream basis(configuration);
+  makeGroebnerBasis(basis);
+  mgb::GroebnerReducer reducer(basis);
+
+  // The ideal of makeBasis is contained in the ideal of the basis.
+  for (int i = 0; i < 2; ++i) {
+    mgb::GroebnerInputIdealStream input(configuration);
+    makeBasis(input);
+    std::ostringstream out;
+    mgb::IdealStreamLog<> computed(out, 101, 3);
+    reducer.computeNormalForms(input, computed);
+    EXPECT_EQ(
+      "IdealStreamLog s(stream, 101, 3);\n"
+      "s.idealBegin(2); // polyCount\n"
+      "s.appendPolynomialBegin(0);\n"
+      "s.appendPolynomialDone();\n"
+      "s.appendPolynomialBegin(0);\n"
+      "s.appendPolynomialDone();\n"
+      "s.idealDone();\n",
+      out.str()
+    );
+  }
+
+  // x^3 reduces to z and y^3 reduces to z^2, while z^3 is already reduced.
+  mgb::GroebnerInputIdealStream input(configuration);
+  input.idealBegin(3);
+    input.appendPolynomialBegin(3); // x^3 + y^3 + 2
+      input.appendTermBegin();
+        input.appendExponent(0, 3);
+      input.appendTermDone(1);
+      input.appendTermBegin();
+        input.appendExponent(1, 3);
+      input.appendTermDone(1);
+      input.appendTermBegin();
+      input.appendTermDone(2);
+    input.appendPolynomialDone();
+    input.appendPolynomialBegin(0); // 0
+    input.appendPolynomialDone();
+    input.appendPolynomialBegin(1); // 3z^3
+      input.appendTermBegin();
+        input.appendExponent(2, 3);
+      input.appendTermDone(3);
+    input.appendPolynomialDone();
+  input.idealDone();
+
+  std::ostringstream out;
+  mgb::IdealStreamLog<> computed(out, 101, 3);
+  reducer.computeNormalForms(input, computed);
+  EXPECT_EQ(
+    "IdealStreamLog s(stream, 101, 3);\n"
+    "s.idealBegin(3); // polyCount\n"
+    "s.appendPolynomialBegin(3);\n"
+    "s.appendTermBegin();\n"
+    "s.appendExponent(0, 0); // index, exponent\n"
+    "s.appendExponent(1, 0); // index, exponent\n"
+    "s.appendExponent(2, 2); // index, exponent\n"
+    "s.appendTermDone(1); // coefficient\n"
+    "s.appendTermBegin();\n"
+    "s.appendExponent(0, 0); // index, exponent\n"
+    "s.appendExponent(1, 0); // index, exponent\n"
+    "s.appendExponent(2, 1); // index, exponent\n"
+    "s.appendTermDone(1); // coefficient\n"
+    "s.appendTermBegin();\n"
+    "s.appendExponent(0, 0); // index, exponent\n"
+    "s.appendExponent(1, 0); // index, exponent\n"
+    "s.appendExponent(2, 0); // index, exponent\n"
+    "s.appendTermDone(2); // coefficient\n"
+    "s.appendPolynomialDone();\n"
+    "s.appendPolynomialBegin(0);\n"
+    "s.appendPolynomialDone();\n"
+    "s.appendPolynomialBegin(1);\n"
+    "s.appendTermBegin();\n"
+    "s.appendExponent(0, 0); // index, exponent\n"
+    "s.appendExponent(1, 0); // index, exponent\n"
+    "s.appendExponent(2, 3); // index, exponent\n"
+    "s.appendTermDone(3); // coefficient\n"
+    "s.appendPolynomialDone();\n"
+    "s.idealDone();\n",
+    out.str()
+  );
+}
+
 TEST(MathicGBLib, Cyclic5) {
   for (int i = 0; i < 2; ++i) {
     mgb::GroebnerConfiguration configuration(101, 5);
@@ -474,6 +886,74 @@ TEST(MathicGBLib, Cyclic5) {
   }
 }
 
+namespace {
+  // Records the memory held by polynomial arenas while a basis is written.
+  class ExportMemoryStream : public mgb::NullIdealStream {
+  public:
+    ExportMemoryStream(Coefficient modulus, VarIndex varCount):
+      NullIdealStream(modulus, varCount),
+      polyCount(0),
+      writtenCount(0),
+      arenasAtBegin(0),
+      minArenasBeforeLast(0),
+      arenasAtEnd(0),
+      inUseAtBegin(0),
+      peak(0)
+    {}
+
+    void idealBegin(size_t count) {
+      auto& budget = MemoryBudget::singleton();
+      polyCount = count;
+      arenasAtBegin = budget.inUse(MemoryBudget::PolyArenas);
+      minArenasBeforeLast = arenasAtBegin;
+      inUseAtBegin = budget.inUse();
+      budget.resetRecentPeak();
+    }
+
+    void appendPolynomialDone() {
+      ++writtenCount;
+      const auto arenas =
+        MemoryBudget::singleton().inUse(MemoryBudget::PolyArenas);
+      if (writtenCount < polyCount)
+        minArenasBeforeLast = std::min(minArenasBeforeLast, arenas);
+    }
+
+    void idealDone() {
+      auto& budget = MemoryBudget::singleton();
+      arenasAtEnd = budget.inUse(MemoryBudget::PolyArenas);
+      peak = budget.recentPeak();
+    }
+
+    size_t polyCount;
+    size_t writtenCount;
+    size_t arenasAtBegin;
+    size_t minArenasBeforeLast;
+    size_t arenasAtEnd;
+    size_t inUseAtBegin;
+    size_t peak;
+  };
+}
+
+TEST(MathicGBLib, ExportMemory) {
+  auto& budget = MemoryBudget::singleton();
+  const auto arenasBefore = budget.inUse(MemoryBudget::PolyArenas);
+  mgb::GroebnerConfiguration configuration(101, 5);
+  mgb::GroebnerInputIdealStream input(configuration);
+  makeCyclic5Basis(input);
+  ExportMemoryStream out(input.modulus(), input.varCount());
+  mgb::computeGroebnerBasis(input, out);
+
+  // The basis is written straight from the arena of the algorithm instead
+  // of from a copy, so that arena is held until the last polynomial has
+  // been written and the memory in use does not grow during the export.
+  ASSERT_LT(1u, out.polyCount);
+  ASSERT_EQ(out.polyCount, out.writtenCount);
+  ASSERT_LT(arenasBefore, out.arenasAtBegin);
+  ASSERT_EQ(out.arenasAtBegin, out.minArenasBeforeLast);
+  ASSERT_LE(out.peak, out.inUseAtBegin);
+  ASSERT_EQ(arenasBefore, out.arenasAtEnd);
+}
+
 namespace {
   class TestCallback : public mgb::GroebnerConfiguration::Callback {
   public:
@@ -526,12 +1006,13 @@ TEST(MathicGBLib, SimpleEliminationGB) {
   Exponent v[] = {1,0,0,0,  1,1,1,1};
   std::vector<Exponent> gradings(v, v + sizeof(v)/sizeof(*v));
 
-  for (int i = 0; i < 2; ++i) {
+  for (int i = 0; i < 4; ++i) {
     mgb::GroebnerConfiguration configuration(101, 4);
-    const auto reducer = i == 0 ?
+    const auto reducer = i % 2 == 0 ?
       mgb::GroebnerConfiguration::ClassicReducer :
       mgb::GroebnerConfiguration::MatrixReducer;
     configuration.setReducer(reducer);
+    configuration.setUseSugar(i / 2 == 1);
     configuration.setMonomialOrder(
       mgb::GroebnerConfiguration::BaseOrder::RevLexDescendingBaseOrder, 
       gradings
@@ -596,3 +1077,75 @@ TEST(MathicGBLib, GlobalOrderOrNot) {
   ASSERT_FALSE(conf.setMonomialOrder(lex, mat));
   ASSERT_FALSE(conf.setMonomialOrder(revLex, mat));
 }
+
+namespace {
+  mgb::RationalTerm rationalTerm(
+    const char* coefficient,
+    mgb::GroebnerConfiguration::Exponent x,
+    mgb::GroebnerConfiguration::Exponent y
+  ) {
+    mgb::RationalTerm term;
+    term.coefficient = coefficient;
+    term.exponents.push_back(x);
+    term.exponents.push_back(y);
+    return term;
+  }
+}
+
+TEST(MathicGBLib, RationalGB) {
+  mgb::GroebnerConfiguration conf(101, 2);
+  conf.setMaxThreadCount(2);
+  std::vector<mgb::RationalPolynomial> ideal(2);
+  ideal[0].push_back(rationalTerm("-1/2", 0, 0)); // x^2 - 1/2
+  ideal[0].push_back(rationalTerm("1", 2, 0));
+  ideal[1].push_back(rationalTerm("2", 1, 1)); // 2xy - 2
+  ideal[1].push_back(rationalTerm("-4/2", 0, 0));
+
+  // The basis is {x - 1/2y, y^2 - 2}.
+  const auto basis = mgb::computeRationalGroebnerBasis(conf, ideal);
+  ASSERT_EQ(2, basis.size());
+  ASSERT_EQ(2, basis[0].size());
+  ASSERT_EQ("1", basis[0][0].coefficient);
+  ASSERT_EQ(1, basis[0][0].exponents[0]);
+  ASSERT_EQ(0, basis[0][0].exponents[1]);
+  ASSERT_EQ("-1/2", basis[0][1].coefficient);
+  ASSERT_EQ(0, basis[0][1].exponents[0]);
+  ASSERT_EQ(1, basis[0][1].exponents[1]);
+  ASSERT_EQ(2, basis[1].size());
+  ASSERT_EQ("1", basis[1][0].coefficient);
+  ASSERT_EQ(2, basis[1][0].exponents[1]);
+  ASSERT_EQ("-2", basis[1][1].coefficient);
+  ASSERT_EQ(0, basis[1][1].exponents[1]);
+}
+
+TEST(MathicGBLib, RationalGBLargeCoefficients) {
+  // The coefficient needs many primes to reconstruct.
+  mgb::GroebnerConfiguration conf(101, 2);
+  conf.setMaxThreadCount(1);
+  std::vector<mgb::RationalPolynomial> ideal(1);
+  ideal[0].push_back(rationalTerm("1", 1, 0));
+  ideal[0].push_back(rationalTerm("-123456789123456789/1000000007", 0, 1));
+
+  const auto basis = mgb::computeRationalGroebnerBasis(conf, ideal);
+  ASSERT_EQ(1, basis.size());
+  ASSERT_EQ(2, basis[0].size());
+  ASSERT_EQ("1", basis[0][0].coefficient);
+  ASSERT_EQ(1, basis[0][0].exponents[0]);
+  ASSERT_EQ("-123456789123456789/1000000007", basis[0][1].coefficient);
+  ASSERT_EQ(1, basis[0][1].exponents[1]);
+}
+
+TEST(MathicGBLib, RationalGBBadCoefficient) {
+  mgb::GroebnerConfiguration conf(101, 2);
+  std::vector<mgb::RationalPolynomial> ideal(1);
+  ideal[0].push_back(rationalTerm("1/0", 1, 0));
+  ASSERT_THROW(
+    mgb::computeRationalGroebnerBasis(conf, ideal),
+    std::invalid_argument
+  );
+  ideal[0][0].coefficient = "1/x";
+  ASSERT_THROW(
+    mgb::computeRationalGroebnerBasis(conf, ideal),
+    std::invalid_argument
+  );
+}
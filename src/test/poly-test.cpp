@@ -8,6 +8,7 @@
 #include "mathicgb/MonTableKDTree.hpp"
 #include "mathicgb/MonTableDivList.hpp"
 #include "mathicgb/MTArray.hpp"
+#include "mathicgb/DivisorLookup.hpp"
 #include "mathicgb/io-util.hpp"
 #include "mathicgb/MonomialHashTable.hpp"
 #include "mathicgb/PolyHashTable.hpp"
@@ -15,11 +16,16 @@
 #include "mathicgb/PolyGeoBucket.hpp"
 #include "mathicgb/SigPolyBasis.hpp"
 #include "mathicgb/SignatureGB.hpp"
+#include "mathicgb/PolyBasis.hpp"
+#include "mathicgb/MemoryBudget.hpp"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <vector>
 #include <cstdio>
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <limits>
 
 using namespace mgb;
 
@@ -87,6 +93,35 @@ TEST(Poly,parse) {
   EXPECT_TRUE(testPolyParse(R.get(), "<1>+13af3<0>+14cde<0>"));
 }
 
+TEST(Poly, storedCoefficients) {
+  // Rings with characteristics this large cannot be represented if
+  // coefficient is only 32 bits.
+  if (std::numeric_limits<coefficient>::max() <=
+    std::numeric_limits<stored_coefficient>::max())
+    return;
+
+  // The largest 32 bit prime, so coefficients use all of the bits of a
+  // stored_coefficient.
+  std::unique_ptr<PolyRing> R
+    (ringFromString("4294967291 6 1\n1 1 1 1 1 1"));
+  const coefficient p = R->charac();
+  Poly f(*R);
+  std::istringstream in("-a2<0>+2a<0>");
+  f.parseDoNotOrder(in);
+  EXPECT_EQ(p - 1, f.getLeadCoefficient());
+  EXPECT_EQ(2, f.coefficientAt(1));
+
+  f.multByCoefficient(p - 1);
+  EXPECT_TRUE(f.isMonic());
+  EXPECT_EQ(p - 2, f.coefficientAt(1));
+
+  f.makeMonic();
+  EXPECT_EQ(p - 2, f.coefficientAt(1));
+
+  // 4294967311 is the smallest prime that does not fit in 32 bits.
+  EXPECT_ANY_THROW(ringFromString("4294967311 6 1\n1 1 1 1 1 1"));
+}
+
 bool testMonomialParse(PolyRing* R, std::string s)
 {
   Monomial m = stringToMonomial(R, s);
@@ -580,6 +615,106 @@ TEST(MTArray,KDTree1) {
   EXPECT_FALSE(M->member(monomialParseFromString(R.get(), "ad<1>"),not_used));
 }
 
+namespace {
+  std::string monomialString(const std::vector<int>& exponents) {
+    std::ostringstream out;
+    for (size_t var = 0; var < exponents.size(); ++var)
+      if (exponents[var] > 0)
+        out << static_cast<char>('a' + var) << exponents[var];
+    out << "<0>";
+    return out.str();
+  }
+
+  std::vector<std::vector<int>> monomialsOfDegree(int degree) {
+    std::vector<std::vector<int>> monomials;
+    for (int a = 0; a <= degree; ++a)
+      for (int b = 0; a + b <= degree; ++b)
+        for (int c = 0; a + b + c <= degree; ++c)
+          monomials.push_back({a, b, c, degree - a - b - c});
+    return monomials;
+  }
+
+  bool dividesExponents(const std::vector<int>& a, const std::vector<int>& b) {
+    for (size_t var = 0; var < a.size(); ++var)
+      if (a[var] > b[var])
+        return false;
+    return true;
+  }
+}
+
+TEST(DivisorLookup, insertRemoveAcrossRebuilds) {
+  // Insert enough elements to trigger several automatic rebuilds while
+  // removing elements along the way, and check that queries agree with a
+  // brute force search after each update.
+  std::unique_ptr<PolyRing> R(ringFromString("32003 4 1\n1 1 1 1"));
+  const auto gens = monomialsOfDegree(8);
+  const auto queries = monomialsOfDegree(9);
+  for (int type = 1; type <= 4; ++type) {
+    auto lookup = DivisorLookup::makeFactory(*R, type)->create(false, true);
+    std::vector<std::vector<int>> live;
+    std::vector<size_t> liveIndices;
+
+    const auto check = [&]() {
+      ASSERT_EQ(live.size(), lookup->size()) << type;
+      for (size_t q = 0; q < queries.size(); ++q) {
+        const auto mon = monomialParseFromString
+          (R.get(), monomialString(queries[q]));
+        const auto index = lookup->divisor(mon);
+        const auto found = std::find
+          (liveIndices.begin(), liveIndices.end(), index);
+        if (index == static_cast<size_t>(-1)) {
+          for (size_t i = 0; i < live.size(); ++i)
+            ASSERT_FALSE(dividesExponents(live[i], queries[q])) << type;
+        } else {
+          ASSERT_TRUE(found != liveIndices.end()) << type;
+          ASSERT_TRUE(dividesExponents
+            (live[found - liveIndices.begin()], queries[q])) << type;
+        }
+      }
+    };
+
+    for (size_t i = 0; i < gens.size(); ++i) {
+      // Visit the generators in a scrambled but deterministic order.
+      const auto& gen = gens[(i * 37) % gens.size()];
+      lookup->insert(monomialParseFromString(R.get(), monomialString(gen)), i);
+      live.push_back(gen);
+      liveIndices.push_back(i);
+
+      if (i % 11 == 10) {
+        // Remove the element inserted 5 steps ago if it is still there.
+        const auto it = std::find(liveIndices.begin(), liveIndices.end(), i - 5);
+        if (it != liveIndices.end()) {
+          const auto pos = it - liveIndices.begin();
+          lookup->remove
+            (monomialParseFromString(R.get(), monomialString(live[pos])));
+          live.erase(live.begin() + pos);
+          liveIndices.erase(liveIndices.begin() + pos);
+        }
+      }
+      if (i % 17 == 16) {
+        // Remove the multiples of a degree 5 divisor of gen.
+        auto divisor = gen;
+        for (size_t var = 0; var < divisor.size(); ++var) {
+          if (divisor[var] > 0) {
+            --divisor[var];
+            break;
+          }
+        }
+        lookup->removeMultiples
+          (monomialParseFromString(R.get(), monomialString(divisor)));
+        for (size_t j = 0; j < live.size();) {
+          if (dividesExponents(divisor, live[j])) {
+            live.erase(live.begin() + j);
+            liveIndices.erase(liveIndices.begin() + j);
+          } else
+            ++j;
+        }
+      }
+      check();
+    }
+  }
+}
+
 //#warning "remove this code"
 #if 0
 bool test_find_signatures(const PolyRing *R, 
@@ -820,3 +955,128 @@ TEST(MonomialHashTable,test1) {
   H.getStats(stats);
   //H.dump(1);
 }
+
+TEST(PolyBasis, arena) {
+  std::unique_ptr<PolyRing> R = ringFromString("32003 3 1\n1 1 1");
+  PolyBasis basis
+    (*R, DivisorLookup::makeFactory(*R, 1)->create(true, true));
+  const auto poly = [&](const char* str) {
+    return polyParseFromString(R.get(), str);
+  };
+  basis.insert(poly("a2+b"));
+  basis.setUseArena(true);
+  ASSERT_TRUE(basis.usesArena());
+  ASSERT_EQ(0, basis.getUnusedMemory());
+  basis.insert(poly("b2+c"));
+  basis.insert(poly("c3+a+1"));
+  ASSERT_EQ(*poly("a2+b"), basis.poly(0));
+  ASSERT_EQ(*poly("b2+c"), basis.poly(1));
+  ASSERT_EQ(*poly("c3+a+1"), basis.poly(2));
+
+  basis.replaceSameLeadTerm(1, poly("b2+a"));
+  ASSERT_EQ(*poly("b2+a"), basis.poly(1));
+  ASSERT_LT(0, basis.getUnusedMemory());
+  ASSERT_LT(basis.getUnusedMemory(), basis.getMemoryUse());
+
+  auto retired = basis.retire(0);
+  ASSERT_EQ(*poly("a2+b"), *retired);
+  ASSERT_EQ(0, retired->arena());
+
+  basis.compact();
+  ASSERT_EQ(0, basis.getUnusedMemory());
+  ASSERT_EQ(*poly("b2+a"), basis.poly(1));
+  ASSERT_EQ(*poly("c3+a+1"), basis.poly(2));
+
+  // The divisor lookup must point to the moved lead monomials.
+  const auto mono = monomialParseFromString(R.get(), "ab2c");
+  ASSERT_EQ(1, basis.divisor(mono));
+  R->freeMonomial(mono);
+
+  basis.setUseArena(false);
+  ASSERT_FALSE(basis.usesArena());
+  ASSERT_EQ(0, basis.poly(1).arena());
+  ASSERT_EQ(*poly("c3+a+1"), basis.poly(2));
+}
+
+TEST(PolyBasis, retireAll) {
+  std::unique_ptr<PolyRing> R = ringFromString("32003 3 1\n1 1 1");
+  PolyBasis basis
+    (*R, DivisorLookup::makeFactory(*R, 1)->create(true, true));
+  const auto poly = [&](const char* str) {
+    return polyParseFromString(R.get(), str);
+  };
+  basis.setUseArena(true);
+  basis.insert(poly("a2+b"));
+  basis.insert(poly("b2+c"));
+  basis.insert(poly("c3+a+1"));
+  basis.retire(1);
+
+  auto& budget = MemoryBudget::singleton();
+  const auto arenaInUse = budget.inUse(MemoryBudget::PolyArenas);
+  budget.resetRecentPeak();
+  const auto inUse = budget.inUse();
+  std::vector<ArenaPolyPtr> polys;
+  std::unique_ptr<PolyArena> arena;
+  basis.retireAll(polys, arena);
+
+  // The polynomials were not copied out of the arena, which is now ours.
+  ASSERT_LE(budget.recentPeak(), inUse);
+  ASSERT_EQ(arenaInUse, budget.inUse(MemoryBudget::PolyArenas));
+  ASSERT_TRUE(arena.get() != 0);
+  ASSERT_TRUE(basis.usesArena());
+  ASSERT_EQ(2, polys.size());
+  ASSERT_EQ(arena.get(), polys[0]->arena());
+  ASSERT_EQ(arena.get(), polys[1]->arena());
+  ASSERT_EQ(*poly("a2+b"), *polys[0]);
+  ASSERT_EQ(*poly("c3+a+1"), *polys[1]);
+  for (size_t i = 0; i < basis.size(); ++i)
+    ASSERT_TRUE(basis.retired(i));
+  const auto noDivisor = static_cast<size_t>(-1);
+  ASSERT_EQ(noDivisor, basis.divisor(polys[0]->getLeadMonomial()));
+
+  polys.clear();
+  arena.reset();
+  ASSERT_LT(budget.inUse(MemoryBudget::PolyArenas), arenaInUse);
+}
+
+TEST(PolyBasis, toBasisAndRetireAllMemory) {
+  std::unique_ptr<PolyRing> R = ringFromString("32003 3 1\n1 1 1");
+  PolyBasis basis
+    (*R, DivisorLookup::makeFactory(*R, 1)->create(true, true));
+  basis.setUseArena(true);
+
+  // The basis must be large enough that retiring the elements one at a
+  // time would compact the arena.
+  const size_t polyCount = 1000;
+  const size_t termCount = 100;
+  std::vector<std::string> strs;
+  for (size_t i = 0; i < polyCount; ++i) {
+    std::ostringstream out;
+    out << "a" << termCount + 2 << "c" << i + 2;
+    for (size_t j = 0; j < termCount; ++j)
+      out << "+b" << j + 2 << "c" << i + 2;
+    strs.push_back(out.str());
+    basis.insert(polyParseFromString(R.get(), strs.back()));
+  }
+  ASSERT_LT(2u << 20, basis.getMemoryUse());
+
+  auto& budget = MemoryBudget::singleton();
+  const auto memoryUse = basis.getMemoryUse();
+  const auto arenaInUse = budget.inUse(MemoryBudget::PolyArenas);
+  const auto inUse = budget.inUse();
+  budget.resetRecentPeak();
+  const auto out = basis.toBasisAndRetireAll();
+
+  // No new arena was allocated and the old one has been freed.
+  ASSERT_LE(budget.recentPeak(), inUse);
+  ASSERT_LT(budget.inUse(MemoryBudget::PolyArenas), arenaInUse);
+  ASSERT_LE(basis.getMemoryUse(), memoryUse);
+  ASSERT_EQ(0, basis.getUnusedMemory());
+
+  ASSERT_EQ(polyCount, out->size());
+  for (size_t i = 0; i < polyCount; ++i) {
+    ASSERT_TRUE(basis.retired(i));
+    ASSERT_EQ(0, out->getPoly(i)->arena());
+    ASSERT_EQ(*polyParseFromString(R.get(), strs[i]), *out->getPoly(i));
+  }
+}